@@ -53,6 +53,16 @@
 #include "controller_device_handle.h"
 #include "controller_device_send.h"
 #include "controller_transaction.h"
+#include "controller_dbview.h"
+#include "controller_state_cache.h"
+#include "controller_transient.h"
+#include "controller_kvstore.h"
+#include "controller_device_read.h"
+#include "controller_reactor.h"
+#include "controller_uring.h"
+#include "controller_msglog.h"
+#include "controller_template.h"
+#include "controller_memo.h"
 #include "controller_rpc.h"
 
 /*! Called to get state data from plugin by programmatically adding state
@@ -76,6 +86,8 @@ controller_statedata(clixon_handle   h,
         goto done;
     if (controller_transaction_statedata(h, nsc, xpath, xstate) < 0)
         goto done;
+    if (controller_state_cache_statedata(h, nsc, xpath, xstate) < 0)
+        goto done;
     retval = 0;
  done:
     return retval;
@@ -95,8 +107,10 @@ disconnect_device_byxml(clixon_handle h,
         device_handle_conn_state_get(dh) != CS_CLOSED){
         device_close_connection(dh, NULL); /* Regular disconnect, no reason */
     }
-    if (dh)
+    if (dh){
+        device_read_close(dh, NULL);
         device_handle_free(dh);
+    }
     return 0;
 }
 
@@ -117,6 +131,7 @@ controller_commit_processes(clixon_handle h,
     cxobj  **vec = NULL;
     size_t   veclen;
     char    *body;
+    cxobj   *x;
 
     if (xpath_vec_flag(target, nsc, "processes/services/enabled",
                        XML_FLAG_CHANGE|XML_FLAG_ADD,
@@ -133,6 +148,12 @@ controller_commit_processes(clixon_handle h,
                 goto done;
         }
     }
+    /* Service output may differ after process restart or memo changes */
+    if (((x = xpath_first(target, nsc, "processes/services")) != NULL &&
+         xml_flag(x, XML_FLAG_CHANGE|XML_FLAG_ADD)) ||
+        ((x = xpath_first(src, nsc, "processes/services")) != NULL &&
+         xml_flag(x, XML_FLAG_CHANGE|XML_FLAG_DEL)))
+        controller_memo_free(h);
     retval = 0;
  done:
     if (vec)
@@ -140,6 +161,54 @@ controller_commit_processes(clixon_handle h,
     return retval;
 }
 
+/*! Send device-change notification of added and deleted devices
+ *
+ * Used by clients to keep a local cache of device names
+ * @param[in] h       Clixon handle
+ * @param[in] vecadd  Vector of added device XML nodes
+ * @param[in] lenadd  Length of vecadd
+ * @param[in] vecdel  Vector of deleted device XML nodes
+ * @param[in] lendel  Length of vecdel
+ * @retval    0       OK
+ * @retval   -1       Error
+ * @see controller_devcache_match  CLI device name cache
+ */
+static int
+controller_device_change_notify(clixon_handle h,
+                                cxobj       **vecadd,
+                                size_t        lenadd,
+                                cxobj       **vecdel,
+                                size_t        lendel)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+    char *name;
+    int   i;
+
+    if (lenadd == 0 && lendel == 0)
+        goto ok;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<device-change xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+    for (i=0; i<lenadd; i++)
+        if ((name = xml_find_body(vecadd[i], "name")) != NULL)
+            cprintf(cb, "<added>%s</added>", name);
+    for (i=0; i<lendel; i++)
+        if ((name = xml_find_body(vecdel[i], "name")) != NULL)
+            cprintf(cb, "<deleted>%s</deleted>", name);
+    cprintf(cb, "</device-change>");
+    if (stream_notify(h, "device-change", "%s", cbuf_get(cb)) < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
 /*! Commit device config
  *
  * @param[in] h    Clixon handle
@@ -154,6 +223,7 @@ controller_commit_processes(clixon_handle h,
  * 2b) if enable changed to true, connect
  * 2c) if device changed addr,user,type changed, disconnect + connect (NYI)
  * 3) if device added, connect
+ * @see controller_commit_done  Notify added and removed devices
  */
 static int
 controller_commit_device(clixon_handle h,
@@ -165,9 +235,13 @@ controller_commit_device(clixon_handle h,
     cxobj   **vec0= NULL;
     cxobj   **vec1 = NULL;
     cxobj   **vec2 = NULL;
+    cxobj   **vec4 = NULL;
+    cxobj   **vec5 = NULL;
     size_t    veclen0;
     size_t    veclen1;
     size_t    veclen2;
+    size_t    veclen4;
+    size_t    veclen5;
     int       i;
     char     *body;
     uint32_t  dt;
@@ -185,6 +259,32 @@ controller_commit_device(clixon_handle h,
         }
         clicon_data_int_set(h, "controller-device-timeout", dt);
     }
+    if (xpath_vec_flag(target, nsc, "devices/state-cache-size",
+                       XML_FLAG_ADD | XML_FLAG_CHANGE,
+                       &vec4, &veclen4) < 0)
+        goto done;
+    for (i=0; i<veclen4; i++){
+        if ((body = xml_body(vec4[i])) == NULL)
+            continue;
+        if (parse_uint32(body, &dt, NULL) < 1){
+            clixon_err(OE_UNIX, errno, "error parsing limit:%s", body);
+            goto done;
+        }
+        clicon_data_int_set(h, "controller-state-cache-size", dt);
+    }
+    if (xpath_vec_flag(target, nsc, "devices/read-session-idle-timeout",
+                       XML_FLAG_ADD | XML_FLAG_CHANGE,
+                       &vec5, &veclen5) < 0)
+        goto done;
+    for (i=0; i<veclen5; i++){
+        if ((body = xml_body(vec5[i])) == NULL)
+            continue;
+        if (parse_uint32(body, &dt, NULL) < 1){
+            clixon_err(OE_UNIX, errno, "error parsing limit:%s", body);
+            goto done;
+        }
+        clicon_data_int_set(h, "controller-read-session-idle", dt);
+    }
 
     /* 1) if device removed, disconnect */
     if (xpath_vec_flag(src, nsc, "devices/device",
@@ -217,10 +317,184 @@ controller_commit_device(clixon_handle h,
         free(vec1);
     if (vec2)
         free(vec2);
+    if (vec4)
+        free(vec4);
+    if (vec5)
+        free(vec5);
 
     return retval;
 }
 
+/*! Check if any node given by xpaths is added, changed or deleted in a commit
+ *
+ * @param[in] nsc     Namespace context
+ * @param[in] src     Pre-state xml tree
+ * @param[in] target  Post target xml tree
+ * @param[in] xpaths  NULL-terminated vector of xpaths
+ * @retval    1       Changed
+ * @retval    0       Not changed
+ * @retval   -1       Error
+ */
+static int
+controller_commit_changed(cvec        *nsc,
+                          cxobj       *src,
+                          cxobj       *target,
+                          const char **xpaths)
+{
+    int     retval = -1;
+    cxobj **vec = NULL;
+    size_t  veclen = 0;
+    int     i;
+
+    for (i=0; xpaths[i] && veclen == 0; i++){
+        if (src && xpath_vec_flag(src, nsc, "%s", XML_FLAG_DEL | XML_FLAG_CHANGE,
+                                  &vec, &veclen, xpaths[i]) < 0)
+            goto done;
+        if (vec){
+            free(vec);
+            vec = NULL;
+        }
+        if (veclen == 0 && target &&
+            xpath_vec_flag(target, nsc, "%s", XML_FLAG_ADD | XML_FLAG_CHANGE,
+                           &vec, &veclen, xpaths[i]) < 0)
+            goto done;
+        if (vec){
+            free(vec);
+            vec = NULL;
+        }
+    }
+    retval = veclen > 0;
+ done:
+    if (vec)
+        free(vec);
+    return retval;
+}
+
+/*! Commit message log config, and message log and pacing of devices
+ *
+ * If devices/message-log is deleted, or its file, the log file is closed.
+ * Message log and pacing of connected devices are applied again if set on the device
+ * or on its device-profile.
+ * @param[in] h       Clixon handle
+ * @param[in] nsc     Namespace context
+ * @param[in] src     Pre-state xml tree
+ * @param[in] target  Post target xml tree
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+static int
+controller_commit_msglog(clixon_handle h,
+                         cvec         *nsc,
+                         cxobj        *src,
+                         cxobj        *target)
+{
+    int           retval = -1;
+    cxobj       **vec = NULL;
+    size_t        veclen;
+    cxobj        *xml = NULL;
+    cxobj        *x;
+    cxobj        *xprof;
+    char         *body;
+    char         *name;
+    device_handle dh;
+    const char   *leafs[] = {"sample", "rate-limit", "max-length", "buffer-size"};
+    uint32_t      vals[4] = {1, 100, 1024, 1048576};
+    const char   *logpaths[] = {"devices/message-log", "devices/message-log/*", NULL};
+    const char   *devpaths[] = {"devices/device/message-log",
+                                "devices/device/device-profile",
+                                "devices/device/pacing/*",
+                                "devices/device-profile/message-log",
+                                "devices/device-profile/pacing/*",
+                                "devices/device-profile", /* deleted profile */
+                                NULL};
+    int           i;
+    int           ret;
+
+    if ((ret = controller_commit_changed(nsc, src, target, logpaths)) < 0)
+        goto done;
+    if (ret){
+        if (target)
+            xml = xpath_first(target, nsc, "devices/message-log");
+        for (i=0; xml && i<4; i++){
+            if ((x = xml_find_type(xml, NULL, leafs[i], CX_ELMNT)) == NULL ||
+                (body = xml_body(x)) == NULL)
+                continue;
+            if (parse_uint32(body, &vals[i], NULL) < 1){
+                clixon_err(OE_UNIX, errno, "error parsing %s:%s", leafs[i], body);
+                goto done;
+            }
+        }
+        if (controller_msglog_config(h, xml?xml_find_body(xml, "file"):NULL,
+                                     vals[0], vals[1], vals[2], vals[3]) < 0)
+            goto done;
+    }
+    if ((ret = controller_commit_changed(nsc, src, target, devpaths)) < 0)
+        goto done;
+    if (ret == 0 || target == NULL)
+        goto ok;
+    if (xpath_vec(target, nsc, "devices/device", &vec, &veclen) < 0)
+        goto done;
+    for (i=0; i<veclen; i++){
+        if ((name = xml_find_body(vec[i], "name")) == NULL ||
+            (dh = device_handle_find(h, name)) == NULL)
+            continue;
+        xprof = NULL;
+        if ((body = xml_find_body(vec[i], "device-profile")) != NULL)
+            xprof = xpath_first(vec[i], NULL, "../device-profile[name='%s']", body);
+        if (controller_device_settings(dh, vec[i], xprof) < 0)
+            goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    if (vec)
+        free(vec);
+    return retval;
+}
+
+/*! Commit device templates, invalidate compiled templates that are changed or deleted
+ *
+ * @param[in] h       Clixon handle
+ * @param[in] nsc     Namespace context
+ * @param[in] src     Pre-state xml tree
+ * @param[in] target  Post target xml tree
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+static int
+controller_commit_template(clixon_handle h,
+                           cvec         *nsc,
+                           cxobj        *src,
+                           cxobj        *target)
+{
+    int      retval = -1;
+    cxobj  **vec = NULL;
+    size_t   veclen;
+    int      i;
+
+    if (xpath_vec_flag(src, nsc, "devices/template",
+                       XML_FLAG_DEL | XML_FLAG_CHANGE,
+                       &vec, &veclen) < 0)
+        goto done;
+    for (i=0; i<veclen; i++)
+        controller_template_invalidate(xml_find_body(vec[i], "name"));
+    if (vec){
+        free(vec);
+        vec = NULL;
+    }
+    if (xpath_vec_flag(target, nsc, "devices/template",
+                       XML_FLAG_ADD | XML_FLAG_CHANGE,
+                       &vec, &veclen) < 0)
+        goto done;
+    for (i=0; i<veclen; i++)
+        controller_template_invalidate(xml_find_body(vec[i], "name"));
+    retval = 0;
+ done:
+    if (vec)
+        free(vec);
+    return retval;
+}
+
 /*! Transaction commit
  */
 int
@@ -239,6 +513,8 @@ controller_commit(clixon_handle    h,
         goto done;
     if (controller_commit_device(h, nsc, src, target) < 0)
         goto done;
+    if (controller_commit_msglog(h, nsc, src, target) < 0)
+        goto done;
     if (controller_commit_processes(h, nsc, src, target) < 0)
         goto done;
     retval = 0;
@@ -248,6 +524,49 @@ controller_commit(clixon_handle    h,
     return retval;
 }
 
+/*! Transaction commit done
+ *
+ * Notify added and removed devices when the commit is final, a failure in a
+ * later commit callback reverts the devices and should not be notified.
+ */
+int
+controller_commit_done(clixon_handle    h,
+                       transaction_data td)
+{
+    int     retval = -1;
+    cxobj  *src;
+    cxobj  *target;
+    cvec   *nsc = NULL;
+    cxobj **vecadd = NULL;
+    cxobj **vecdel = NULL;
+    size_t  lenadd = 0;
+    size_t  lendel = 0;
+
+    src = transaction_src(td);
+    target = transaction_target(td);
+    if ((nsc = xml_nsctx_init(NULL, CONTROLLER_NAMESPACE)) == NULL)
+        goto done;
+    if (src && xpath_vec_flag(src, nsc, "devices/device",
+                              XML_FLAG_DEL,
+                              &vecdel, &lendel) < 0)
+        goto done;
+    if (target && xpath_vec_flag(target, nsc, "devices/device",
+                                 XML_FLAG_ADD,
+                                 &vecadd, &lenadd) < 0)
+        goto done;
+    if (controller_device_change_notify(h, vecadd, lenadd, vecdel, lendel) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (vecadd)
+        free(vecadd);
+    if (vecdel)
+        free(vecdel);
+    if (nsc)
+        cvec_free(nsc);
+    return retval;
+}
+
 /*! YANG schema mount
  *
  * Given an XML mount-point xt, return XML yang-lib modules-set
@@ -468,13 +787,13 @@ controller_reset(clixon_handle h,
 
     if ((nsc = xml_nsctx_init(NULL, CONTROLLER_NAMESPACE)) == NULL)
         goto done;
-    if ((ret = xmldb_get0(h, "running", YB_MODULE, nsc, xpath, 1, 0, &xtop, NULL, NULL)) < 0)
+    if ((ret = controller_dbview_get(h, "running", &xtop)) < 0)
         goto done;
     if (ret == 0){
         clixon_err(OE_DB, 0, "Error when reading from running_db, unknown error");
         goto done;
     }
-    if ((xse = xpath_first(xtop, 0, "processes/services/enabled")) != NULL){
+    if ((xse = xpath_first(xtop, nsc, "%s", xpath)) != NULL){
         if (strcmp(xml_body(xse), "true") == 0)
             if (clixon_process_operation(h, ACTION_PROCESS, PROC_OP_START, 0) < 0)
                 goto done;
@@ -484,7 +803,7 @@ controller_reset(clixon_handle h,
     if (nsc)
         cvec_free(nsc);
     if (xtop)
-        xml_free(xtop);
+        controller_dbview_release(h, &xtop);
     return retval;
 }
 
@@ -497,6 +816,8 @@ controller_reset(clixon_handle h,
 static int
 controller_start(clixon_handle h)
 {
+    if (controller_kvstore_import(h) < 0)
+        return -1;
     return 0;
 }
 
@@ -513,6 +834,14 @@ controller_exit(clixon_handle h)
     while ((dh = device_handle_each(h, dh)) != NULL)
         device_close_connection(dh, "controller exit");
     device_handle_free_all(h);
+    controller_state_cache_free(h);
+    controller_transient_free(h);
+    controller_memo_free(h);
+    controller_reactor_free();
+    controller_uring_exit();
+    controller_msglog_exit();
+    controller_template_exit();
+    controller_kvstore_close();
     return 0;
 }
 
@@ -543,6 +872,7 @@ controller_lockdb(clixon_handle h,
         (ct = ct_list) != NULL) {
         do {
             if (ct->ct_state != TS_DONE &&
+                !ct->ct_readonly &&
                 ct->ct_client_id == id){
                 if (xmldb_lock(h, db, TRANSACTION_CLIENT_ID) < 0)
                     goto done;
@@ -568,6 +898,7 @@ static clixon_plugin_api api = {
     .ca_reset        = controller_reset,
     .ca_statedata    = controller_statedata,
     .ca_trans_commit = controller_commit,
+    .ca_trans_commit_done = controller_commit_done,
     .ca_yang_mount   = controller_yang_mount,
     .ca_version      = controller_version,
     .ca_lockdb       = controller_lockdb,
@@ -583,6 +914,10 @@ clixon_plugin_init(clixon_handle h)
         clixon_err(OE_YANG, 0, "The clixon controller requires CLICON_YANG_SCHEMA_MOUNT set to true");
         goto done;
     }
+    if (controller_uring_init(h) < 0)
+        goto done;
+    if (controller_kvstore_init(h) < 0)
+        goto done;
     /* Register callback for rpc calls */
     if (controller_rpc_init(h) < 0)
         goto done;
@@ -597,6 +932,26 @@ clixon_plugin_init(clixon_handle h)
                    "A transaction has been completed.",
                    0, NULL) < 0)
         goto done;
+    /* see controller_device_change_notify */
+    if (stream_add(h, "device-change",
+                   "Devices have been added or removed.",
+                   0, NULL) < 0)
+        goto done;
+    /* see controller_transaction_get_reply */
+    if (stream_add(h, "device-state-reply",
+                   "Replies from devices of a get-device-state request.",
+                   0, NULL) < 0)
+        goto done;
+    /* see controller_transaction_get_reply */
+    if (stream_add(h, "device-rpc-reply",
+                   "Replies from devices of a device-rpc request.",
+                   0, NULL) < 0)
+        goto done;
+    /* see controller_transaction_done */
+    if (stream_add(h, "drift-scan-reply",
+                   "Drifted devices of a drift-scan request.",
+                   0, NULL) < 0)
+        goto done;
     /* Register pyapi sub-process */
     if (action_daemon_register(h) < 0)
         goto done;
@@ -46,6 +46,7 @@
 #include "controller.h"
 #include "controller_lib.h"
 #include "controller_cli_callbacks.h"
+#include "controller_cli_devcache.h"
 
 /*! Start cli with -- -g
  *
@@ -124,6 +125,8 @@ controller_cli_exit(clixon_handle h)
         clicon_data_int_del(h, "controller-transaction-notify-socket");
         close(s);
     }
+    if (controller_devcache_exit(h) < 0)
+        goto done;
     if ((s = clicon_client_socket_get(h)) > 0){
         close(s);
         clicon_client_socket_set(h, -1);
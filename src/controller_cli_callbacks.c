@@ -47,6 +47,7 @@
 #include "controller.h"
 #include "controller_lib.h"
 #include "controller_cli_callbacks.h"
+#include "controller_cli_devcache.h"
 
 /*!
  *
@@ -130,40 +131,86 @@ cli_apipath2xpath(clixon_handle h,
     return retval;
 }
 
-/*! Send get yanglib of all mountpoints to backend and return matching devices/yang-libs
+/*! Send device-match rpc to backend and return names of matching devices
  *
- * @param[in]  h         Clixon handle
- * @param[in]  pattern   Name glob pattern
- * @param[in]  single    pattern is a single device that can be used in an xpath
- * @param[in]  yanglib   0: only device name, 1: Also include config/yang-librarylib
- * @param[out] xdevsp    XML on the form <data><devices><device><name>x</name>...</data>
- * @retval     0         OK
- * @retval    -1         Error
- * @note due to https://github.com/clicon/clixon/issues/485, there is some complex filtering
- * in the yanglib case marked with "485" below
+ * @param[in]  h        Clixon handle
+ * @param[in]  pattern  Name glob pattern
+ * @param[out] xretp    XML on the form <rpc-reply><device><name>x</name>..., free with xml_free
+ * @retval     0        OK
+ * @retval    -1        Error
  */
 int
-rpc_get_yanglib_mount_match(clixon_handle h,
-                            char         *pattern,
-                            int           single,
-                            int           yanglib,
-                            cxobj       **xdevsp)
+rpc_device_match(clixon_handle h,
+                 char         *pattern,
+                 cxobj       **xretp)
 {
     int        retval = -1;
     cbuf      *cb = NULL;
     cxobj     *xtop = NULL;
     cxobj     *xrpc;
-    cxobj     *xdevs = NULL;
-    cxobj     *xdev;
-    cxobj     *xy;
-    char      *devname;
     cxobj     *xret = NULL;
     cxobj     *xerr;
-    cxobj     *xp;
-    yang_stmt *yspec;
-    int        ret;
 
-    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_PLUGIN, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<rpc xmlns=\"%s\" username=\"%s\" %s>",
+            NETCONF_BASE_NAMESPACE,
+            clicon_username_get(h),
+            NETCONF_MESSAGE_ID_ATTR);
+    cprintf(cb, "<device-match xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+    cprintf(cb, "<pattern>%s</pattern>", pattern);
+    cprintf(cb, "</device-match>");
+    cprintf(cb, "</rpc>");
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xtop, NULL) < 0)
+        goto done;
+    /* Skip top-level */
+    xrpc = xml_child_i(xtop, 0);
+    /* Send to backend */
+    if (clicon_rpc_netconf_xml(h, xrpc, &xret, NULL) < 0)
+        goto done;
+    if ((xerr = xpath_first(xret, NULL, "rpc-reply/rpc-error")) != NULL){
+        clixon_err_netconf(h, OE_XML, 0, xerr, "Match devices");
+        goto done;
+    }
+    *xretp = xret;
+    xret = NULL;
+    retval = 0;
+ done:
+    if (xtop)
+        xml_free(xtop);
+    if (xret)
+        xml_free(xret);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Send get yanglib of a single mountpoint to backend
+ *
+ * @param[in]  h        Clixon handle
+ * @param[in]  devname  Name of device
+ * @param[out] xconfigp XML on the form <config><yang-library>..., or NULL. Free with xml_free
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @note due to https://github.com/clicon/clixon/issues/485, there is some complex filtering
+ * marked with "485" below
+ */
+static int
+rpc_get_yanglib_mount_one(clixon_handle h,
+                          char         *devname,
+                          cxobj       **xconfigp)
+{
+    int        retval = -1;
+    cbuf      *cb = NULL;
+    cxobj     *xtop = NULL;
+    cxobj     *xrpc;
+    cxobj     *xret = NULL;
+    cxobj     *xerr;
+    cxobj     *xconfig;
+    cxobj     *xy;
+
     if ((cb = cbuf_new()) == NULL){
         clixon_err(OE_PLUGIN, errno, "cbuf_new");
         goto done;
@@ -173,24 +220,16 @@ rpc_get_yanglib_mount_match(clixon_handle h,
             clicon_username_get(h),
             NETCONF_MESSAGE_ID_ATTR);
     cprintf(cb, "<get");
-    if (yanglib) // 485
-        cprintf(cb, " %s:depth=\"%d\" xmlns:%s=\"%s\"",
-                CLIXON_LIB_PREFIX,
-                8,
-                CLIXON_LIB_PREFIX, CLIXON_LIB_NS);
+    cprintf(cb, " %s:depth=\"%d\" xmlns:%s=\"%s\"", // 485
+            CLIXON_LIB_PREFIX,
+            8,
+            CLIXON_LIB_PREFIX, CLIXON_LIB_NS);
     cprintf(cb, ">");
     cprintf(cb, "<filter type=\"xpath\"");
-    cprintf(cb, " select=\"/ctrl:devices/ctrl:device");
-    if (single)
-        cprintf(cb, "[ctrl:name='%s']", pattern);
-    if (yanglib){
-        cprintf(cb, "/ctrl:config");
+    cprintf(cb, " select=\"/ctrl:devices/ctrl:device[ctrl:name='%s']/ctrl:config", devname);
 #if 0 // 485
-        cprintf(cb, "/yanglib:yang-library");
+    cprintf(cb, "/yanglib:yang-library");
 #endif
-    }
-    else
-        cprintf(cb, "/ctrl:name");
     cprintf(cb, "\"");
     cprintf(cb, " xmlns:ctrl=\"%s\" xmlns:yanglib=\"urn:ietf:params:xml:ns:yang:ietf-yang-library\">",
                     CONTROLLER_NAMESPACE);
@@ -208,50 +247,174 @@ rpc_get_yanglib_mount_match(clixon_handle h,
         clixon_err_netconf(h, OE_XML, 0, xerr, "Get configuration");
         goto done;
     }
-    if ((xdevs = xpath_first(xret, NULL, "rpc-reply/data/devices")) != NULL){
-        if ((yspec = clicon_dbspec_yang(h)) == NULL){
-            clixon_err(OE_FATAL, 0, "No DB_SPEC");
+    if ((xconfig = xpath_first(xret, NULL, "rpc-reply/data/devices/device/config")) != NULL &&
+        (xy = xml_find_type(xconfig, NULL, "yang-library", CX_ELMNT)) != NULL){
+        /* Remove everything except yang-library (485) */
+        xml_flag_set(xy, XML_FLAG_MARK);
+        if (xml_tree_prune_flagged_sub(xconfig, XML_FLAG_MARK, 1, NULL) < 0)
             goto done;
+        xml_flag_reset(xy, XML_FLAG_MARK);
+        xml_rm(xconfig);
+        *xconfigp = xconfig;
+    }
+    retval = 0;
+ done:
+    if (xtop)
+        xml_free(xtop);
+    if (xret)
+        xml_free(xret);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Get matching devices and optionally their yang-libs from backend
+ *
+ * If only names are requested, they are taken from the local device name cache.
+ * Otherwise device names are matched in the backend using the device-match rpc.
+ * If yanglib is set, the yang-library is retrieved only once for each distinct
+ * module-set digest, and then copied to all other devices with the same digest.
+ * @param[in]  h         Clixon handle
+ * @param[in]  pattern   Name glob pattern
+ * @param[in]  single    pattern is a single device (not used, glob matches itself)
+ * @param[in]  yanglib   0: only device name, 1: Also include config/yang-library
+ * @param[out] xdevsp    XML on the form <data><devices><device><name>x</name>...</data>
+ * @retval     0         OK
+ * @retval    -1         Error
+ */
+int
+rpc_get_yanglib_mount_match(clixon_handle h,
+                            char         *pattern,
+                            int           single,
+                            int           yanglib,
+                            cxobj       **xdevsp)
+{
+    int        retval = -1;
+    cbuf      *cb = NULL;
+    cxobj     *xmatch = NULL;
+    cxobj     *xreply;
+    cxobj     *xt = NULL;
+    cxobj     *xdevs;
+    cxobj     *xdev;
+    cxobj     *xconfig;
+    cxobj     *xconfig0;
+    cxobj     *xerr = NULL;
+    cxobj     *x;
+    char      *devname;
+    char      *digest;
+    char      *devname0;
+    cvec      *digests = NULL; /* digest -> first device with that digest */
+    cvec      *names = NULL;
+    cg_var    *cv;
+    yang_stmt *yspec;
+    int        ret;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_PLUGIN, errno, "cbuf_new");
+        goto done;
+    }
+    if (!yanglib){
+        /* Only names: use local device name cache */
+        if ((names = cvec_new(0)) == NULL){
+            clixon_err(OE_UNIX, errno, "cvec_new");
+            goto done;
+        }
+        if (controller_devcache_match(h, pattern, names) < 0)
+            goto done;
+        if (cvec_len(names) == 0)
+            goto ok;
+        cprintf(cb, "<devices xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+        cv = NULL;
+        while ((cv = cvec_each(names, cv)) != NULL)
+            cprintf(cb, "<device><name>%s</name></device>", cv_string_get(cv));
+        cprintf(cb, "</devices>");
+    }
+    else {
+        if (rpc_device_match(h, pattern, &xmatch) < 0)
+            goto done;
+        if ((xreply = xpath_first(xmatch, NULL, "rpc-reply")) == NULL ||
+            xml_find_type(xreply, NULL, "device", CX_ELMNT) == NULL)
+            goto ok;
+        cprintf(cb, "<devices xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+        x = NULL;
+        while ((x = xml_child_each(xreply, x, CX_ELMNT)) != NULL) {
+            if (strcmp(xml_name(x), "device") != 0)
+                continue;
+            if ((devname = xml_find_body(x, "name")) == NULL)
+                continue;
+            cprintf(cb, "<device><name>%s</name></device>", devname);
         }
-        xdev = NULL;
-        while ((xdev = xml_child_each(xdevs, xdev, CX_ELMNT)) != NULL) {
-            if ((devname = xml_find_body(xdev, "name")) == NULL ||
-                fnmatch(pattern, devname, 0) == 0){ /* Match */
-                if (yanglib &&
-                    (xy = xpath_first(xdev, 0, "config/yang-library")) != NULL){
-                    xml_flag_set(xml_find(xdev, "name"), XML_FLAG_MARK);
-                    xml_flag_set(xy, XML_FLAG_MARK);
+        cprintf(cb, "</devices>");
+    }
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xt, NULL) < 0)
+        goto done;
+    if (xml_name_set(xt, "data") < 0)
+        goto done;
+    xdevs = xml_find_type(xt, NULL, "devices", CX_ELMNT);
+    if (yanglib){
+        if ((digests = cvec_new(0)) == NULL){
+            clixon_err(OE_UNIX, errno, "cvec_new");
+            goto done;
+        }
+        x = NULL;
+        while ((x = xml_child_each(xreply, x, CX_ELMNT)) != NULL) {
+            if (strcmp(xml_name(x), "device") != 0)
+                continue;
+            if ((devname = xml_find_body(x, "name")) == NULL)
+                continue;
+            if ((digest = xml_find_body(x, "module-set-digest")) == NULL)
+                continue; /* Not connected, no yang-lib */
+            if ((xdev = xpath_first(xdevs, NULL, "device[name='%s']", devname)) == NULL)
+                continue;
+            xconfig = NULL;
+            if ((cv = cvec_find(digests, digest)) != NULL){
+                devname0 = cv_string_get(cv);
+                if ((xconfig0 = xpath_first(xdevs, NULL, "device[name='%s']/config", devname0)) != NULL &&
+                    (xconfig = xml_dup(xconfig0)) == NULL)
+                    goto done;
+            }
+            else {
+                if (rpc_get_yanglib_mount_one(h, devname, &xconfig) < 0)
+                    goto done;
+                if (xconfig != NULL &&
+                    cvec_add_string(digests, digest, devname) < 0){
+                    clixon_err(OE_UNIX, errno, "cvec_add_string");
+                    goto done;
                 }
-                else
-                    xml_flag_set(xdev, XML_FLAG_MARK);
             }
+            if (xconfig && xml_addsub(xdev, xconfig) < 0)
+                goto done;
         }
-        /* 2. Remove all unmarked nodes, ie non-matching nodes */
-        if (xml_tree_prune_flagged_sub(xdevs, XML_FLAG_MARK, 1, NULL) < 0)
+        if ((yspec = clicon_dbspec_yang(h)) == NULL){
+            clixon_err(OE_FATAL, 0, "No DB_SPEC");
             goto done;
-        /* Populate XML with Yang spec. Binding is done in clicon_rpc_netconf of RPC only
-         * where <data> is ANYDATA
-         */
+        }
+        /* Populate XML with Yang spec. */
         if ((ret = xml_bind_yang0(h, xdevs, YB_MODULE, yspec, &xerr)) < 0)
             goto done;
         if (ret == 0){
             clixon_err_netconf(h, OE_XML, 0, xerr, "Get devices config");
             goto done;
         }
-        /* Double check that there is at least one device */
-        if (xdevsp && xpath_first(xdevs, NULL, "device/name") != NULL &&
-            (xp = xml_parent(xdevs))){
-            xml_rm(xp);
-            xml_spec_set(xp, NULL);
-            *xdevsp = xp;
-        }
     }
+    if (xdevsp){
+        *xdevsp = xt;
+        xt = NULL;
+    }
+ ok:
     retval = 0;
  done:
-    if (xtop)
-        xml_free(xtop);
-    if (xret)
-        xml_free(xret);
+    if (digests)
+        cvec_free(digests);
+    if (names)
+        cvec_free(names);
+    if (xerr)
+        xml_free(xerr);
+    if (xt)
+        xml_free(xt);
+    if (xmatch)
+        xml_free(xmatch);
     if (cb)
         cbuf_free(cb);
     return retval;
@@ -895,6 +1058,61 @@ get_service_key(yang_stmt *yspec,
     return retval;
 }
 
+/*! Show device edits computed by a controller commit with push PREVIEW
+ *
+ * @param[in] h      Clixon handle
+ * @param[in] tidstr Transaction id
+ * @retval    0      OK
+ * @retval   -1      Error
+ */
+static int
+cli_commit_preview_show(clixon_handle h,
+                        char         *tidstr)
+{
+    int     retval = -1;
+    cvec   *nsc = NULL;
+    cxobj  *xn = NULL;
+    cxobj  *xerr;
+    cxobj **vec = NULL;
+    size_t  veclen;
+    cxobj  *xp;
+    char   *str;
+    int     i;
+
+    if ((nsc = xml_nsctx_init("co", CONTROLLER_NAMESPACE)) == NULL)
+        goto done;
+    if (clicon_rpc_get(h, "co:transactions", nsc, CONTENT_ALL, -1, "report-all", &xn) < 0)
+        goto done;
+    if ((xerr = xpath_first(xn, NULL, "/rpc-error")) != NULL){
+        clixon_err_netconf(h, OE_XML, 0, xerr, "Get transactions");
+        goto done;
+    }
+    if (xpath_vec(xn, nsc, "co:transactions/co:transaction[co:tid='%s']/co:preview", &vec, &veclen, tidstr) < 0)
+        goto done;
+    if (veclen == 0)
+        cligen_output(stdout, "No device changes\n");
+    for (i=0; i<veclen; i++){
+        xp = vec[i];
+        cligen_output(stdout, "%s: deleted:%s added:%s changed:%s size:%s\n",
+                      xml_find_body(xp, "name"),
+                      xml_find_body(xp, "deleted"),
+                      xml_find_body(xp, "added"),
+                      xml_find_body(xp, "changed"),
+                      xml_find_body(xp, "edit-size"));
+        if ((str = xml_find_body(xp, "edit-config")) != NULL)
+            cligen_output(stdout, "%s\n", str);
+    }
+    retval = 0;
+ done:
+    if (vec)
+        free(vec);
+    if (nsc)
+        cvec_free(nsc);
+    if (xn)
+        xml_free(xn);
+    return retval;
+}
+
 /*! Make a controller commit rpc with its many variants
  *
  * Relies on hardcoded "name" and "instance" variables in cvv
@@ -902,7 +1120,7 @@ get_service_key(yang_stmt *yspec,
  * @param[in] cvv   Name pattern
  * @param[in] argv  Source:running/candidate,
                     actions:NONE/CHANGE/FORCE,
-                    push:NONE/VALIDATE/COMMIT,
+                    push:NONE/VALIDATE/COMMIT/PREVIEW,
  * @retval    0     OK
  * @retval   -1     Error
  * @see controller-commit in clixon-controller.yang
@@ -963,7 +1181,7 @@ cli_rpc_controller_commit(clixon_handle h,
     }
     push_type = cv_string_get(cv);
     if (push_type_str2int(push_type) == -1){
-        clixon_err(OE_PLUGIN, EINVAL, "<push-type> argument is %s, expected NONE/VALIDATE/COMMIT", push_type);
+        clixon_err(OE_PLUGIN, EINVAL, "<push-type> argument is %s, expected NONE/VALIDATE/COMMIT/PREVIEW", push_type);
         goto done;
     }
     if ((cv = cvec_find(cvv, "name")) != NULL)
@@ -1038,6 +1256,10 @@ cli_rpc_controller_commit(clixon_handle h,
         if (cli_rpc_commit_diff(h) < 0)
             goto done;
     }
+    if (push_type_str2int(push_type) == PT_PREVIEW){
+        if (cli_commit_preview_show(h, tidstr) < 0)
+            goto done;
+    }
     cligen_output(stderr, "OK\n");
  ok:
     retval = 0;
@@ -2258,8 +2480,446 @@ cli_auto_del_devs(clixon_handle h,
     return retval;
 }
 
+/*! Lexical state of streaming XML load
+ */
+enum load_stream_state{
+    LS_TEXT = 0,  /* Character data between tags */
+    LS_TAG,       /* Inside start/end tag, or not yet known markup */
+    LS_COMMENT,   /* Inside <!-- --> */
+    LS_CDATA,     /* Inside <![CDATA[ ]]> */
+    LS_PI,        /* Inside <? ?> */
+};
+
+/*! Streaming XML load state
+ *
+ * The input is not parsed into a tree. Instead, each child of top-level <devices> and
+ * each other top-level element is captured as raw text and sent in bounded
+ * edit-config batches.
+ * @see cli_load_stream_xml
+ */
+struct load_stream {
+    clixon_handle          ls_h;
+    enum operation_type    ls_op;         /* Operation of next batch */
+    enum operation_type    ls_entryop;    /* Operation of each captured entry, or OP_NONE */
+    size_t                 ls_batchsize;  /* Send batch when this many bytes captured */
+    enum load_stream_state ls_state;      /* Lexical state */
+    char                   ls_quote;      /* Quote char if inside attribute value, else 0 */
+    cbuf                  *ls_tok;        /* Current markup token */
+    int                    ls_depth;      /* Current element depth, top-level is 1 */
+    int                    ls_root;       /* Top-level element seen */
+    int                    ls_base;       /* 1 if top-level element is <config>, else 0 */
+    int                    ls_indevices;  /* Inside top-level <devices> */
+    int                    ls_capdepth;   /* Depth of captured element, 0 if none */
+    int                    ls_capdevice;  /* Captured element is a <device> */
+    cbuf                  *ls_capbuf;     /* Current capture buffer: ls_devbuf or ls_others */
+    cbuf                  *ls_configtag;  /* Start tag of <config> */
+    cbuf                  *ls_configname; /* Qualified name of <config> */
+    cbuf                  *ls_devicestag; /* Start tag of <devices> */
+    cbuf                  *ls_devicesname;/* Qualified name of <devices> */
+    cbuf                  *ls_devbuf;     /* Captured children of <devices> */
+    cbuf                  *ls_others;     /* Captured other top-level elements */
+    cbuf                  *ls_msg;        /* Edit-config message */
+    int                    ls_batchdevs;  /* Number of devices in current batch */
+    uint64_t               ls_devices;    /* Number of devices sent */
+    int                    ls_batches;    /* Number of edit-configs sent */
+    int                    ls_progress;   /* Print progress on stderr */
+};
+
+/*! Send captured elements as one edit-config to candidate
+ *
+ * @param[in]  ls   Streaming load state
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+load_stream_flush(struct load_stream *ls)
+{
+    int retval = -1;
+
+    if (cbuf_len(ls->ls_devbuf) == 0 && cbuf_len(ls->ls_others) == 0)
+        goto ok;
+    cbuf_reset(ls->ls_msg);
+    if (cbuf_len(ls->ls_configtag))
+        cbuf_append_str(ls->ls_msg, cbuf_get(ls->ls_configtag));
+    else
+        cprintf(ls->ls_msg, "<%s>", DATASTORE_TOP_SYMBOL);
+    cbuf_append_str(ls->ls_msg, cbuf_get(ls->ls_others));
+    if (cbuf_len(ls->ls_devbuf)){
+        cbuf_append_str(ls->ls_msg, cbuf_get(ls->ls_devicestag));
+        cbuf_append_str(ls->ls_msg, cbuf_get(ls->ls_devbuf));
+        cprintf(ls->ls_msg, "</%s>", cbuf_get(ls->ls_devicesname));
+    }
+    if (cbuf_len(ls->ls_configname))
+        cprintf(ls->ls_msg, "</%s>", cbuf_get(ls->ls_configname));
+    else
+        cprintf(ls->ls_msg, "</%s>", DATASTORE_TOP_SYMBOL);
+    clixon_debug(CLIXON_DBG_CTRL, "batch %d: %d devices %zu bytes",
+                 ls->ls_batches, ls->ls_batchdevs, cbuf_len(ls->ls_msg));
+    if (clicon_rpc_edit_config(ls->ls_h, "candidate",
+                               ls->ls_op,
+                               cbuf_get(ls->ls_msg)) < 0)
+        goto done;
+    /* Only first batch replaces, the rest are added to it */
+    if (ls->ls_op == OP_REPLACE)
+        ls->ls_op = OP_MERGE;
+    ls->ls_batches++;
+    ls->ls_devices += ls->ls_batchdevs;
+    ls->ls_batchdevs = 0;
+    cbuf_reset(ls->ls_devbuf);
+    cbuf_reset(ls->ls_others);
+    if (ls->ls_progress)
+        cligen_output(stderr, "\rLoaded %" PRIu64 " devices in %d batches",
+                      ls->ls_devices, ls->ls_batches);
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Start capture of an element, add entry operation to its start tag if set
+ *
+ * Operations such as create or delete are put on each device entry and other
+ * top-level element, not on the enclosing containers that are re-sent in every batch.
+ * @param[in]  ls     Streaming load state
+ * @param[in]  t      Start tag
+ * @param[in]  empty  Start tag is an empty element tag: <x/>
+ */
+static void
+load_stream_capture_start(struct load_stream *ls,
+                          char               *t,
+                          int                 empty)
+{
+    size_t len;
+
+    ls->ls_capdepth = ls->ls_depth;
+    if (ls->ls_entryop == OP_NONE){
+        cbuf_append_str(ls->ls_capbuf, t);
+        return;
+    }
+    len = strlen(t) - (empty ? 2 : 1);
+    cbuf_append_buf(ls->ls_capbuf, t, len);
+    cprintf(ls->ls_capbuf, " xmlns:%s=\"%s\" %s:operation=\"%s\"",
+            NETCONF_BASE_PREFIX, NETCONF_BASE_NAMESPACE,
+            NETCONF_BASE_PREFIX, xml_operation2str(ls->ls_entryop));
+    cbuf_append_str(ls->ls_capbuf, t + len);
+}
+
+/*! End of captured element, send batch if large enough
+ *
+ * @param[in]  ls   Streaming load state
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+load_stream_capture_end(struct load_stream *ls)
+{
+    if (ls->ls_capdevice)
+        ls->ls_batchdevs++;
+    ls->ls_capdepth = 0;
+    ls->ls_capdevice = 0;
+    ls->ls_capbuf = NULL;
+    if (cbuf_len(ls->ls_devbuf) + cbuf_len(ls->ls_others) >= ls->ls_batchsize)
+        return load_stream_flush(ls);
+    return 0;
+}
+
+/*! Handle one complete markup token
+ *
+ * @param[in]  ls   Streaming load state
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+load_stream_token(struct load_stream *ls)
+{
+    int     retval = -1;
+    char   *t;
+    size_t  len;
+    size_t  n;
+    char   *local;
+    size_t  llen;
+    int     empty;
+    int     level;
+
+    t = cbuf_get(ls->ls_tok);
+    len = cbuf_len(ls->ls_tok);
+    if (t[1] == '?' || t[1] == '!'){ /* PI, comment, CDATA, DOCTYPE */
+        if (ls->ls_capdepth)
+            cbuf_append_str(ls->ls_capbuf, t);
+        goto ok;
+    }
+    if (t[1] == '/'){ /* End tag */
+        if (ls->ls_capdepth){
+            cbuf_append_str(ls->ls_capbuf, t);
+            if (ls->ls_depth == ls->ls_capdepth &&
+                load_stream_capture_end(ls) < 0)
+                goto done;
+        }
+        else if (ls->ls_depth - ls->ls_base == 1)
+            ls->ls_indevices = 0;
+        if (--ls->ls_depth < 0){
+            clixon_err(OE_XML, 0, "Unbalanced end tag: %s", t);
+            goto done;
+        }
+        goto ok;
+    }
+    empty = (len > 2 && t[len-2] == '/');
+    n = strcspn(t+1, " \t\r\n/>");
+    /* Local name without prefix */
+    if ((local = memchr(t+1, ':', n)) != NULL)
+        local++;
+    else
+        local = t+1;
+    llen = n - (local - (t+1));
+    level = ++ls->ls_depth - ls->ls_base;
+    if (ls->ls_capdepth)
+        cbuf_append_str(ls->ls_capbuf, t);
+    else if (ls->ls_depth == 1 && !ls->ls_root){
+        ls->ls_root = 1;
+        if (llen == strlen(DATASTORE_TOP_SYMBOL) &&
+            strncmp(local, DATASTORE_TOP_SYMBOL, llen) == 0){
+            ls->ls_base = 1;
+            cbuf_append_str(ls->ls_configtag, t);
+            cbuf_append_buf(ls->ls_configname, t+1, n);
+            level = 0;
+        }
+        else
+            level = 1;
+    }
+    if (ls->ls_capdepth)
+        ;
+    else if (level == 1){
+        if (llen == strlen("devices") && strncmp(local, "devices", llen) == 0){
+            if (!empty){
+                cbuf_reset(ls->ls_devicestag);
+                cbuf_append_str(ls->ls_devicestag, t);
+                cbuf_reset(ls->ls_devicesname);
+                cbuf_append_buf(ls->ls_devicesname, t+1, n);
+                ls->ls_indevices = 1;
+            }
+        }
+        else {
+            ls->ls_capbuf = ls->ls_others;
+            load_stream_capture_start(ls, t, empty);
+        }
+    }
+    else if (level == 2 && ls->ls_indevices){
+        ls->ls_capbuf = ls->ls_devbuf;
+        ls->ls_capdevice = (llen == strlen("device") && strncmp(local, "device", llen) == 0);
+        load_stream_capture_start(ls, t, empty);
+    }
+    if (empty){
+        if (ls->ls_capdepth && ls->ls_depth == ls->ls_capdepth &&
+            load_stream_capture_end(ls) < 0)
+            goto done;
+        ls->ls_depth--;
+    }
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Check if markup token ends with a string
+ */
+static int
+load_stream_tok_endswith(cbuf       *tok,
+                         const char *str)
+{
+    size_t len = cbuf_len(tok);
+    size_t slen = strlen(str);
+
+    return len >= slen && strcmp(cbuf_get(tok) + len - slen, str) == 0;
+}
+
+/*! Process a block of XML input
+ *
+ * @param[in]  ls   Streaming load state
+ * @param[in]  buf  Input bytes
+ * @param[in]  len  Number of bytes in buf
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+load_stream_input(struct load_stream *ls,
+                  char               *buf,
+                  size_t              len)
+{
+    int    retval = -1;
+    size_t i = 0;
+    size_t j;
+    char   c;
+    int    tokend;
+
+    while (i < len){
+        if (ls->ls_state == LS_TEXT){
+            /* Copy run of character data in one go */
+            for (j = i; j < len && buf[j] != '<'; j++)
+                ;
+            if (ls->ls_capdepth && j > i)
+                cbuf_append_buf(ls->ls_capbuf, buf+i, j-i);
+            if (j < len){
+                cbuf_reset(ls->ls_tok);
+                cbuf_append_buf(ls->ls_tok, "<", 1);
+                ls->ls_state = LS_TAG;
+                ls->ls_quote = 0;
+                j++;
+            }
+            i = j;
+            continue;
+        }
+        c = buf[i++];
+        cbuf_append_buf(ls->ls_tok, &c, 1);
+        tokend = 0;
+        switch (ls->ls_state){
+        case LS_TAG:
+            if (ls->ls_quote){
+                if (c == ls->ls_quote)
+                    ls->ls_quote = 0;
+            }
+            else if (c == '"' || c == '\'')
+                ls->ls_quote = c;
+            else if (c == '>')
+                tokend++;
+            else if (strcmp(cbuf_get(ls->ls_tok), "<!--") == 0)
+                ls->ls_state = LS_COMMENT;
+            else if (strcmp(cbuf_get(ls->ls_tok), "<![CDATA[") == 0)
+                ls->ls_state = LS_CDATA;
+            else if (strcmp(cbuf_get(ls->ls_tok), "<?") == 0)
+                ls->ls_state = LS_PI;
+            break;
+        case LS_COMMENT:
+            tokend = (c == '>' && load_stream_tok_endswith(ls->ls_tok, "-->"));
+            break;
+        case LS_CDATA:
+            tokend = (c == '>' && load_stream_tok_endswith(ls->ls_tok, "]]>"));
+            break;
+        case LS_PI:
+            tokend = (c == '>' && load_stream_tok_endswith(ls->ls_tok, "?>"));
+            break;
+        default:
+            break;
+        }
+        if (tokend){
+            ls->ls_state = LS_TEXT;
+            if (load_stream_token(ls) < 0)
+                goto done;
+        }
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Load XML configuration from file in bounded batches without parsing it into a tree
+ *
+ * Cut the input at devices/device boundaries and send each batch as a separate
+ * edit-config to candidate. Memory use is bounded by the batch size in both CLI and
+ * backend. The file is assumed to be of the form:
+ *   <config><devices><device>...</device>...</devices>...</config>
+ * where <config> is optional. Other top-level elements are sent as-is.
+ * If operation is replace, the first batch replaces candidate and the rest are merged.
+ * Other operations than merge, replace and none, eg create or delete, are put on each
+ * device entry and other top-level element, and the edit-configs are merged, since
+ * <devices> is sent again in every batch.
+ * @param[in]  h          Clixon handle
+ * @param[in]  fp         Open file
+ * @param[in]  op         Operation
+ * @param[in]  batchsize  Approximate max size in bytes of each edit-config
+ * @retval     0          OK
+ * @retval    -1          Error
+ * @note The input is not validated as XML until it reaches the backend, a malformed
+ *       file may leave candidate partially loaded.
+ */
+static int
+cli_load_stream_xml(clixon_handle       h,
+                    FILE               *fp,
+                    enum operation_type op,
+                    size_t              batchsize)
+{
+    int                retval = -1;
+    struct load_stream ls = {0,};
+    char              *buf = NULL;
+    size_t             buflen = BUFSIZ*16;
+    size_t             n;
+
+    ls.ls_h = h;
+    switch (op){
+    case OP_MERGE:
+    case OP_REPLACE:
+    case OP_NONE:
+        ls.ls_op = op;
+        ls.ls_entryop = OP_NONE;
+        break;
+    default:
+        ls.ls_op = OP_MERGE;
+        ls.ls_entryop = op;
+        break;
+    }
+    ls.ls_batchsize = batchsize;
+    ls.ls_progress = isatty(STDERR_FILENO);
+    if ((ls.ls_tok = cbuf_new()) == NULL ||
+        (ls.ls_configtag = cbuf_new()) == NULL ||
+        (ls.ls_configname = cbuf_new()) == NULL ||
+        (ls.ls_devicestag = cbuf_new()) == NULL ||
+        (ls.ls_devicesname = cbuf_new()) == NULL ||
+        (ls.ls_devbuf = cbuf_new()) == NULL ||
+        (ls.ls_others = cbuf_new()) == NULL ||
+        (ls.ls_msg = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if ((buf = malloc(buflen)) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    while ((n = fread(buf, 1, buflen, fp)) > 0){
+        if (load_stream_input(&ls, buf, n) < 0)
+            goto done;
+    }
+    if (ferror(fp)){
+        clixon_err(OE_UNIX, errno, "fread");
+        goto done;
+    }
+    if (ls.ls_depth != 0 || ls.ls_state != LS_TEXT){
+        clixon_err(OE_XML, 0, "Unexpected end of file");
+        goto done;
+    }
+    if (load_stream_flush(&ls) < 0)
+        goto done;
+    if (ls.ls_batches == 0){
+        clixon_err(OE_XML, 0, "No XML in file");
+        goto done;
+    }
+    if (ls.ls_progress)
+        cligen_output(stderr, "\n");
+    retval = 0;
+ done:
+    if (buf)
+        free(buf);
+    if (ls.ls_tok)
+        cbuf_free(ls.ls_tok);
+    if (ls.ls_configtag)
+        cbuf_free(ls.ls_configtag);
+    if (ls.ls_configname)
+        cbuf_free(ls.ls_configname);
+    if (ls.ls_devicestag)
+        cbuf_free(ls.ls_devicestag);
+    if (ls.ls_devicesname)
+        cbuf_free(ls.ls_devicesname);
+    if (ls.ls_devbuf)
+        cbuf_free(ls.ls_devbuf);
+    if (ls.ls_others)
+        cbuf_free(ls.ls_others);
+    if (ls.ls_msg)
+        cbuf_free(ls.ls_msg);
+    return retval;
+}
+
 /*! Load configuration from file
  *
+ * If batchsize is given, the file is streamed and sent in batches,
+ * see cli_load_stream_xml
  * @param[in]  h     Clixon handle
  * @param[in]  cvv0  Vector of cli string and instantiated variables
  * @param[in]  argv  Vector. First element xml key format string, eg "/aaa/%s"
@@ -2304,6 +2964,15 @@ cli_auto_load_devs(clixon_handle h,
     }
     else
         fp = stdin;
+    if ((cv = cvec_find(cvv, "batchsize")) != NULL){
+        if (format != FORMAT_XML){
+            clixon_err(OE_PLUGIN, 0, "Batched load only supported for xml format");
+            goto done;
+        }
+        if (cli_load_stream_xml(h, fp, op, cv_uint32_get(cv)) < 0)
+            goto done;
+        goto ok;
+    }
     /* XXX Do without YANG (for the time being) */
     switch (format){
     case FORMAT_XML:
@@ -2347,6 +3016,7 @@ cli_auto_load_devs(clixon_handle h,
                                op,
                                cbuf_get(cb)) < 0)
         goto done;
+ ok:
     retval = 0;
  done:
     if (cb)
@@ -2546,6 +3216,150 @@ show_device_capability(clixon_handle h,
     return retval;
 }
 
+/*! Get config and state data from devices and print device replies
+ *
+ * Subscribe to device-state-reply, send get-device-state with aggregated replies and wait
+ * for the transaction to complete.
+ * @param[in]  h     Clixon handle
+ * @param[in]  cvv   name: device pattern, xpath: XPath filter (optional)
+ * @param[in]  argv  Not used
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+cli_show_device_state(clixon_handle h,
+                      cvec         *cvv,
+                      cvec         *argv)
+{
+    int                retval = -1;
+    cbuf              *cb = NULL;
+    cbuf              *cbmsg = NULL;
+    cg_var            *cv;
+    char              *name = "*";
+    char              *xpath = NULL;
+    cxobj             *xtop = NULL;
+    cxobj             *xrpc;
+    cxobj             *xret = NULL;
+    cxobj             *xreply;
+    cxobj             *xerr;
+    cxobj             *xid;
+    cxobj             *xn = NULL;
+    cxobj             *xr = NULL;
+    cxobj             *xd;
+    cxobj             *xdata;
+    cxobj             *x;
+    char              *tidstr;
+    char              *str;
+    transaction_result result = 0;
+    int                exists = 0;
+    int                s = -1;
+    int                eof = 0;
+
+    if ((cv = cvec_find(cvv, "name")) != NULL)
+        name = cv_string_get(cv);
+    if ((cv = cvec_find(cvv, "xpath")) != NULL)
+        xpath = cv_string_get(cv);
+    /* Subscribe before request so that no replies are lost */
+    if (clicon_rpc_create_subscription(h, "device-state-reply", NULL, &s) < 0)
+        goto done;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_PLUGIN, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<rpc xmlns=\"%s\" username=\"%s\" %s>",
+            NETCONF_BASE_NAMESPACE,
+            clicon_username_get(h),
+            NETCONF_MESSAGE_ID_ATTR);
+    cprintf(cb, "<get-device-state xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+    cprintf(cb, "<devname>%s</devname>", name);
+    if (xpath){
+        cprintf(cb, "<xpath>");
+        if (xml_chardata_cbuf_append(cb, 0, xpath) < 0)
+            goto done;
+        cprintf(cb, "</xpath>");
+    }
+    cprintf(cb, "<aggregate>true</aggregate>");
+    cprintf(cb, "</get-device-state>");
+    cprintf(cb, "</rpc>");
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xtop, NULL) < 0)
+        goto done;
+    /* Skip top-level */
+    xrpc = xml_child_i(xtop, 0);
+    /* Send to backend */
+    if (clicon_rpc_netconf_xml(h, xrpc, &xret, NULL) < 0)
+        goto done;
+    if ((xreply = xpath_first(xret, NULL, "rpc-reply")) == NULL){
+        clixon_err(OE_CFG, 0, "Malformed rpc reply");
+        goto done;
+    }
+    if ((xerr = xpath_first(xreply, NULL, "rpc-error")) != NULL){
+        clixon_err_netconf(h, OE_XML, 0, xerr, "Get device state");
+        goto done;
+    }
+    if ((xid = xpath_first(xreply, NULL, "tid")) == NULL){
+        clixon_err(OE_CFG, 0, "No returned id");
+        goto done;
+    }
+    tidstr = xml_body(xid);
+    if (transaction_exist(h, tidstr, &exists) < 0)
+        goto done;
+    if (exists){
+        if (transaction_notification_poll(h, tidstr, &result) < 0)
+            goto done;
+    }
+    /* Aggregated replies are sent before transaction is done */
+    while (xr == NULL){
+        if (clixon_msg_rcv11(s, NULL, 1, &cbmsg, &eof) < 0)
+            goto done;
+        if (eof){
+            clixon_err(OE_PROTO, ESHUTDOWN, "Socket unexpected close");
+            goto done;
+        }
+        if (clixon_xml_parse_string(cbuf_get(cbmsg), YB_NONE, NULL, &xn, NULL) < 0)
+            goto done;
+        cbuf_free(cbmsg);
+        cbmsg = NULL;
+        if ((x = xpath_first(xn, NULL, "notification/device-state-reply")) != NULL &&
+            (str = xml_find_body(x, "tid")) != NULL &&
+            strcmp(str, tidstr) == 0){
+            xr = x;
+            break;
+        }
+        xml_free(xn);
+        xn = NULL;
+    }
+    xd = NULL;
+    while ((xd = xml_child_each(xr, xd, CX_ELMNT)) != NULL){
+        if (strcmp(xml_name(xd), "device") != 0)
+            continue;
+        cligen_output(stdout, "%s:\n", xml_find_body(xd, "name"));
+        if ((str = xml_find_body(xd, "reason")) != NULL)
+            cligen_output(stdout, "Failed: %s\n", str);
+        if ((xdata = xml_find_type(xd, NULL, "data", CX_ELMNT)) != NULL){
+            x = NULL;
+            while ((x = xml_child_each(xdata, x, CX_ELMNT)) != NULL){
+                if (clixon_xml2file(stdout, x, 0, 1, NULL, cligen_output, 0, 1) < 0)
+                    goto done;
+            }
+        }
+    }
+    retval = 0;
+ done:
+    if (s != -1)
+        close(s);
+    if (cb)
+        cbuf_free(cb);
+    if (cbmsg)
+        cbuf_free(cbmsg);
+    if (xn)
+        xml_free(xn);
+    if (xret)
+        xml_free(xret);
+    if (xtop)
+        xml_free(xtop);
+    return retval;
+}
+
 /*! Apply template on devices
  *
  * @param[in] h
@@ -44,6 +44,7 @@
 extern "C" {
 #endif
 
+int rpc_device_match(clixon_handle h, char *pattern, cxobj **xretp);
 int rpc_get_yanglib_mount_match(clixon_handle h, char *pattern, int single, int yanglib, cxobj **xdevsp);
 int cli_show_auto_devs(clixon_handle h, cvec *cvv, cvec *argv);
 int cli_rpc_pull(clixon_handle h, cvec *cvv, cvec *argv);
@@ -61,6 +62,7 @@ int cli_auto_load_devs(clixon_handle h, cvec *cvv0, cvec *argv);
 int cli_controller_show_version(clixon_handle h, cvec *vars, cvec *argv);
 int show_yang_revisions(clixon_handle h, cvec *cvv, cvec *argv);
 int show_device_capability(clixon_handle h, cvec *cvv, cvec *argv);
+int cli_show_device_state(clixon_handle h, cvec *cvv, cvec *argv);
 
 #ifdef __cplusplus
 }
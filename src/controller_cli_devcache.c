@@ -0,0 +1,490 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2024 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * CLI device name cache
+  * Device names are read once from the backend and then kept up-to-date using the
+  * device-change notification stream. Names are stored in a prefix tree (trie).
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+#include <clixon/clixon.h>
+#include <clixon/clixon_cli.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_lib.h"
+#include "controller_cli_callbacks.h"
+#include "controller_cli_devcache.h"
+
+/*! Trie node of device name cache
+ *
+ * Children are a sorted single-linked list of siblings, which is small compared to
+ * a 256-wide vector when there are many devices.
+ */
+struct devcache_node {
+    struct devcache_node *dn_child; /* First child, sorted on dn_c */
+    struct devcache_node *dn_next;  /* Next sibling */
+    char                  dn_c;     /* Character of this node, '\0' for root */
+    int                   dn_end;   /* A device name ends in this node */
+};
+typedef struct devcache_node devcache_node;
+
+/*! Create new trie node
+ *
+ * @param[in]  c     Character of node
+ * @retval     dn    New node
+ * @retval     NULL  Error
+ */
+static devcache_node *
+devcache_node_new(char c)
+{
+    devcache_node *dn;
+
+    if ((dn = malloc(sizeof(*dn))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        return NULL;
+    }
+    memset(dn, 0, sizeof(*dn));
+    dn->dn_c = c;
+    return dn;
+}
+
+/*! Free trie node and all its children and siblings
+ *
+ * @param[in]  dn    Trie node
+ */
+static void
+devcache_node_free(devcache_node *dn)
+{
+    devcache_node *dnext;
+
+    while (dn != NULL){
+        dnext = dn->dn_next;
+        devcache_node_free(dn->dn_child);
+        free(dn);
+        dn = dnext;
+    }
+}
+
+/*! Add device name to trie
+ *
+ * @param[in]  root  Trie root
+ * @param[in]  name  Device name
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+devcache_add(devcache_node *root,
+             const char    *name)
+{
+    int             retval = -1;
+    devcache_node  *dn = root;
+    devcache_node **dp;
+    devcache_node  *dnew;
+    const char     *p;
+
+    for (p = name; *p != '\0'; p++){
+        dp = &dn->dn_child;
+        while (*dp != NULL && (*dp)->dn_c < *p)
+            dp = &(*dp)->dn_next;
+        if (*dp == NULL || (*dp)->dn_c != *p){
+            if ((dnew = devcache_node_new(*p)) == NULL)
+                goto done;
+            dnew->dn_next = *dp;
+            *dp = dnew;
+        }
+        dn = *dp;
+    }
+    dn->dn_end = 1;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Delete device name from trie and remove empty nodes
+ *
+ * @param[in]  dn    Trie node
+ * @param[in]  name  Remaining part of device name
+ * @retval     1     Node dn is empty and can be removed by caller
+ * @retval     0     Node dn is not empty
+ */
+static int
+devcache_del(devcache_node *dn,
+             const char    *name)
+{
+    devcache_node **dp;
+    devcache_node  *dc;
+
+    if (*name == '\0')
+        dn->dn_end = 0;
+    else {
+        dp = &dn->dn_child;
+        while (*dp != NULL && (*dp)->dn_c != *name)
+            dp = &(*dp)->dn_next;
+        if ((dc = *dp) != NULL && devcache_del(dc, name+1) == 1){
+            *dp = dc->dn_next;
+            free(dc);
+        }
+    }
+    return (dn->dn_end == 0 && dn->dn_child == NULL) ? 1 : 0;
+}
+
+/*! Find trie node matching a name prefix
+ *
+ * @param[in]  root    Trie root
+ * @param[in]  prefix  Name prefix
+ * @param[in]  len     Length of prefix
+ * @retval     dn      Trie node
+ * @retval     NULL    No device with that prefix
+ */
+static devcache_node *
+devcache_prefix(devcache_node *root,
+                const char    *prefix,
+                size_t         len)
+{
+    devcache_node *dn = root;
+    size_t         i;
+
+    for (i = 0; i < len && dn != NULL; i++){
+        dn = dn->dn_child;
+        while (dn != NULL && dn->dn_c != prefix[i])
+            dn = dn->dn_next;
+    }
+    return dn;
+}
+
+/*! Add all names in trie (sub)tree matching pattern to a vector
+ *
+ * @param[in]     dn      Trie node
+ * @param[in,out] cb      Name up to and including dn
+ * @param[in]     pattern Glob pattern, or NULL for all
+ * @param[in,out] cvv     Vector of names
+ * @retval        0       OK
+ * @retval       -1       Error
+ */
+static int
+devcache_collect(devcache_node *dn,
+                 cbuf          *cb,
+                 const char    *pattern,
+                 cvec          *cvv)
+{
+    int            retval = -1;
+    devcache_node *dc;
+    size_t         len;
+
+    if (dn->dn_end &&
+        (pattern == NULL || fnmatch(pattern, cbuf_get(cb), 0) == 0)){
+        if (cvec_add_string(cvv, NULL, cbuf_get(cb)) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+    len = cbuf_len(cb);
+    for (dc = dn->dn_child; dc != NULL; dc = dc->dn_next){
+        cprintf(cb, "%c", dc->dn_c);
+        if (devcache_collect(dc, cb, pattern, cvv) < 0)
+            goto done;
+        cbuf_trunc(cb, len);
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Apply a device-change notification to the cache
+ *
+ * @param[in]  root  Trie root
+ * @param[in]  str   Notification as XML string
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+devcache_notification(devcache_node *root,
+                      char          *str)
+{
+    int    retval = -1;
+    cxobj *xt = NULL;
+    cxobj *xn;
+    cxobj *x;
+    char  *name;
+
+    if (clixon_xml_parse_string(str, YB_NONE, NULL, &xt, NULL) < 0)
+        goto done;
+    if ((xn = xpath_first(xt, 0, "notification/device-change")) == NULL){
+        clixon_err(OE_NETCONF, EFAULT, "Notification malformed");
+        goto done;
+    }
+    x = NULL;
+    while ((x = xml_child_each(xn, x, CX_ELMNT)) != NULL) {
+        if ((name = xml_body(x)) == NULL)
+            continue;
+        if (strcmp(xml_name(x), "added") == 0){
+            if (devcache_add(root, name) < 0)
+                goto done;
+        }
+        else if (strcmp(xml_name(x), "deleted") == 0)
+            devcache_del(root, name);
+    }
+    retval = 0;
+ done:
+    if (xt)
+        xml_free(xt);
+    return retval;
+}
+
+/*! Create device name cache: subscribe to device changes and read all names
+ *
+ * Subscribe before reading names so that no change is lost in between.
+ * @param[in]  h     Clixon handle
+ * @param[out] rootp Trie root
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+devcache_create(clixon_handle   h,
+                devcache_node **rootp)
+{
+    int            retval = -1;
+    devcache_node *root = NULL;
+    cxobj         *xdevs = NULL;
+    cxobj         *xdev;
+    char          *name;
+    int            s;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if (clicon_rpc_create_subscription(h, "device-change", NULL, &s) < 0)
+        goto done;
+    if (clicon_data_int_set(h, "controller-devcache-socket", s) < 0)
+        goto done;
+    if ((root = devcache_node_new('\0')) == NULL)
+        goto done;
+    if (rpc_device_match(h, "*", &xdevs) < 0)
+        goto done;
+    xdev = NULL;
+    while ((xdev = xml_child_each(xml_find(xdevs, "rpc-reply"), xdev, CX_ELMNT)) != NULL) {
+        if (strcmp(xml_name(xdev), "device") != 0)
+            continue;
+        if ((name = xml_find_body(xdev, "name")) == NULL)
+            continue;
+        if (devcache_add(root, name) < 0)
+            goto done;
+    }
+    clicon_ptr_set(h, "controller-devcache", root);
+    *rootp = root;
+    root = NULL;
+    retval = 0;
+ done:
+    if (xdevs)
+        xml_free(xdevs);
+    if (root)
+        devcache_node_free(root);
+    return retval;
+}
+
+/*! Get up-to-date device name cache, create it if it does not exist
+ *
+ * Read all pending device-change notifications and apply them. If the notification
+ * socket is closed, re-create the cache.
+ * @param[in]  h     Clixon handle
+ * @param[out] rootp Trie root
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+devcache_get(clixon_handle   h,
+             devcache_node **rootp)
+{
+    int            retval = -1;
+    devcache_node *root = NULL;
+    cbuf          *cb = NULL;
+    int            s;
+    int            eof = 0;
+    int            ret = 0;
+
+    if (clicon_ptr_get(h, "controller-devcache", (void**)&root) < 0 || root == NULL){
+        if (devcache_create(h, rootp) < 0)
+            goto done;
+        goto ok;
+    }
+    s = clicon_data_int_get(h, "controller-devcache-socket");
+    while (s > 0 && (ret = clixon_event_poll(s)) > 0){
+        if (clixon_msg_rcv11(s, NULL, 0, &cb, &eof) < 0)
+            goto done;
+        if (eof)
+            break;
+        clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "%s", cbuf_get(cb));
+        if (devcache_notification(root, cbuf_get(cb)) < 0)
+            goto done;
+        cbuf_free(cb);
+        cb = NULL;
+    }
+    if (s <= 0 || eof || ret < 0){
+        /* Changes may have been lost, start over */
+        if (controller_devcache_exit(h) < 0)
+            goto done;
+        if (devcache_create(h, rootp) < 0)
+            goto done;
+        goto ok;
+    }
+    *rootp = root;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Get names of devices matching a glob pattern from the device name cache
+ *
+ * The literal prefix of the pattern (up to the first wildcard) is looked up in the
+ * trie, only names under that prefix are matched against the pattern.
+ * @param[in]  h       Clixon handle
+ * @param[in]  pattern Glob pattern
+ * @param[out] cvv     Vector of matching names, sorted
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+controller_devcache_match(clixon_handle h,
+                          char         *pattern,
+                          cvec         *cvv)
+{
+    int            retval = -1;
+    devcache_node *root = NULL;
+    devcache_node *dn;
+    cbuf          *cb = NULL;
+    size_t         len;
+
+    if (devcache_get(h, &root) < 0)
+        goto done;
+    len = strcspn(pattern, "*?[\\");
+    if ((dn = devcache_prefix(root, pattern, len)) == NULL)
+        goto ok;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (pattern[len] == '\0'){ /* No wildcards */
+        if (dn->dn_end && cvec_add_string(cvv, NULL, pattern) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+        goto ok;
+    }
+    cbuf_append_buf(cb, pattern, len);
+    /* Only trailing '*': all names under prefix match, skip fnmatch */
+    if (devcache_collect(dn, cb, strcmp(pattern+len, "*")==0?NULL:pattern, cvv) < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Free device name cache and close notification socket
+ *
+ * @param[in]  h     Clixon handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_devcache_exit(clixon_handle h)
+{
+    devcache_node *root = NULL;
+    int            s;
+
+    if (clicon_ptr_get(h, "controller-devcache", (void**)&root) == 0 && root != NULL){
+        devcache_node_free(root);
+        clicon_ptr_del(h, "controller-devcache");
+    }
+    if ((s = clicon_data_int_get(h, "controller-devcache-socket")) > 0){
+        close(s);
+        clicon_data_int_del(h, "controller-devcache-socket");
+    }
+    return 0;
+}
+
+/*! CLIgen expand callback of device names using the device name cache
+ *
+ * Replacement of expand_dbvar("running","/clixon-controller:devices/device/name")
+ * without a backend round-trip for each completion.
+ * The last token of the command so far is the partially typed name, only names
+ * with that prefix are looked up in the trie.
+ * @param[in]   h         Clixon handle
+ * @param[in]   name      Name of this function
+ * @param[in]   cvv       The command so far. Eg: cvec [0]:"a 5 b"; [1]: x=5;
+ * @param[in]   argv      Arguments given at the callback (not used)
+ * @param[out]  commands  Vector of device names
+ * @param[out]  helptexts Vector of help-texts (not used)
+ * @retval      0         OK
+ * @retval     -1         Error
+ */
+int
+expand_device_name(void *h,
+                   char *name,
+                   cvec *cvv,
+                   cvec *argv,
+                   cvec *commands,
+                   cvec *helptexts)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+    char *str = NULL;
+    char *prefix = "";
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (cvec_len(cvv) > 0)
+        str = cv_string_get(cvec_i(cvv, 0));
+    if (str != NULL && *str != '\0' && !isspace(str[strlen(str)-1])){
+        if ((prefix = strrchr(str, ' ')) != NULL)
+            prefix++;
+        else
+            prefix = str;
+    }
+    /* Wildcards in prefix are kept, names are then matched with fnmatch */
+    cprintf(cb, "%s*", prefix);
+    if (controller_devcache_match((clixon_handle)h, cbuf_get(cb), commands) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
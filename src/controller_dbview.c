@@ -0,0 +1,194 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Read-only views of the backend datastore cache
+  * A view is the cached datastore tree itself, obtained without copying it. Internal readers
+  * that only inspect configuration use a view instead of a private copy.
+  * Rules for a view:
+  * - It must not be modified, neither the tree nor its flags. A caller that needs to modify
+  *   must copy the subtree it changes, eg with xml_dup()
+  * - It is only valid until the datastore is written or the backend returns to the event loop.
+  *   The backend is single-threaded, so a view taken and released within one callback without
+  *   intervening datastore writes is a consistent snapshot
+  * - Default values are included (report-all)
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_dbview.h"
+
+/*! Get a read-only view of a whole datastore without copying it
+ *
+ * No xpath is applied: marking nodes would modify the shared cache. Use xpath_first() or
+ * xpath_vec() on the returned tree instead.
+ * @param[in]  h    Clixon handle
+ * @param[in]  db   Name of datastore, eg "running"
+ * @param[out] xtp  Top of datastore tree. Release with controller_dbview_release
+ * @retval     1    OK
+ * @retval     0    Datastore could not be read, xtp is NULL
+ * @retval    -1    Error
+ * @code
+ *   cxobj *xt = NULL;
+ *   if (controller_dbview_get(h, "running", &xt) < 0)
+ *      err;
+ *   ...
+ *   controller_dbview_release(h, &xt);
+ * @endcode
+ */
+int
+controller_dbview_get(clixon_handle h,
+                      const char   *db,
+                      cxobj       **xtp)
+{
+    int retval = -1;
+    int ret;
+
+    if (xtp == NULL){
+        clixon_err(OE_XML, EINVAL, "xtp is NULL");
+        goto done;
+    }
+    *xtp = NULL;
+    if ((ret = xmldb_get0(h, db, YB_MODULE, NULL, NULL, 0, WITHDEFAULTS_REPORT_ALL, xtp, NULL, NULL)) < 0)
+        goto done;
+    if (ret == 0){
+        if (*xtp)
+            xmldb_get0_free(h, xtp);
+        *xtp = NULL;
+        retval = 0;
+        goto done;
+    }
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "%s", db);
+    retval = 1;
+ done:
+    return retval;
+}
+
+/*! Release a read-only datastore view
+ *
+ * With a datastore cache the tree is left in place, otherwise it is freed.
+ * @param[in]     h    Clixon handle
+ * @param[in,out] xtp  View obtained with controller_dbview_get, set to NULL on return
+ * @retval        0    OK
+ * @retval       -1    Error
+ */
+int
+controller_dbview_release(clixon_handle h,
+                          cxobj       **xtp)
+{
+    int retval = -1;
+
+    if (xtp == NULL || *xtp == NULL)
+        goto ok;
+    if (xmldb_get0_clear(h, *xtp) < 0)
+        goto done;
+    if (xmldb_get0_free(h, xtp) < 0)
+        goto done;
+    *xtp = NULL;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Copy a subtree of a view without default values
+ *
+ * Same result as xmldb_get0() with WITHDEFAULTS_EXPLICIT on the subtree, but only the
+ * subtree is visited, not the whole cached datastore. Use this when a caller needs to
+ * modify part of a view.
+ * Non-presence containers that only contain default values are not copied.
+ * @param[in]  x0    Subtree of view
+ * @param[in]  xp    Parent of copy, or NULL
+ * @param[out] x1p   Copy, added as child of xp if given, else free with xml_free. NULL if
+ *                   x0 is a default value
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_dbview_copy(cxobj  *x0,
+                       cxobj  *xp,
+                       cxobj **x1p)
+{
+    int        retval = -1;
+    cxobj     *x1 = NULL;
+    cxobj     *xc0;
+    cxobj     *xc1;
+    yang_stmt *ys;
+    int        elmnts = 0;
+
+    *x1p = NULL;
+    if (xml_type(x0) == CX_ELMNT && xml_flag(x0, XML_FLAG_DEFAULT))
+        goto ok;
+    if ((x1 = xml_new(xml_name(x0), NULL, xml_type(x0))) == NULL)
+        goto done;
+    if (xml_copy_one(x0, x1) < 0)
+        goto done;
+    xc0 = NULL;
+    while ((xc0 = xml_child_each(x0, xc0, -1)) != NULL){
+        if (xml_type(xc0) == CX_ELMNT)
+            elmnts++;
+        if (controller_dbview_copy(xc0, x1, &xc1) < 0)
+            goto done;
+    }
+    if (elmnts && xml_child_nr_type(x1, CX_ELMNT) == 0 &&
+        (ys = xml_spec(x0)) != NULL &&
+        yang_keyword_get(ys) == Y_CONTAINER &&
+        yang_find(ys, Y_PRESENCE, NULL) == NULL)
+        goto ok;
+    if (xp && xml_addsub(xp, x1) < 0)
+        goto done;
+    *x1p = x1;
+    x1 = NULL;
+ ok:
+    retval = 0;
+ done:
+    if (x1)
+        xml_free(x1);
+    return retval;
+}
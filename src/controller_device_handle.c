@@ -42,6 +42,7 @@
 #include <syslog.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <sys/stat.h>
 #include <netinet/in.h>
@@ -55,9 +56,11 @@
 
 /* Controller includes */
 #include "controller.h"
+#include "controller_lib.h"
 #include "controller_netconf.h"
 #include "controller_device_state.h"
 #include "controller_device_handle.h"
+#include "controller_pacing.h"
 
 /*
  * Constants
@@ -66,6 +69,12 @@
 
 #define devhandle(dh) (assert(device_handle_check(dh)==0),(struct controller_device_handle *)(dh))
 
+/* Hash of device handles indexed by name, see device_handle_find */
+#define DEVICE_HANDLE_NAMES "controller-device-names"
+
+/* Hash of number of devices indexed by transaction id, see device_handle_tid_nr */
+#define DEVICE_HANDLE_TIDS  "controller-device-tids"
+
 /*! Internal structure of clixon controller device handle.
  */
 struct controller_device_handle{
@@ -82,12 +91,15 @@ struct controller_device_handle{
     uint64_t           cdh_msg_id;     /* Client message-id to device */
     int                cdh_pid;        /* Sub-process-id Only applies for NETCONF/SSH */
     uint64_t           cdh_tid;        /* if >0, dev is part of transaction, 0 means unassigned */
+    uint64_t           cdh_stale_id;   /* Message-id of timed out request, reply is dropped */
     cbuf              *cdh_frame_buf;  /* Remaining expecting chunk bytes */
     int                cdh_frame_state;/* Framing state for detecting EOM */
     size_t             cdh_frame_size; /* Remaining expecting chunk bytes */
     netconf_framing_type cdh_framing_type; /* Netconf framing type of device */
     cxobj             *cdh_xcaps;      /* Capabilities as XML tree */
     cxobj             *cdh_yang_lib;   /* RFC 8525 yang-library module list */
+    uint64_t           cdh_yang_lib_digest; /* Cached digest of yang-lib, 0 if not computed */
+    uint64_t           cdh_synced_digest; /* Cached digest of SYNCED config, 0 if not computed */
     struct timeval     cdh_sync_time;  /* Time when last sync (0 if unsynched) */
     int                cdh_nr_schemas; /* How many schemas from this device */
     char              *cdh_schema_name; /* Pending schema name */
@@ -96,6 +108,12 @@ struct controller_device_handle{
     char              *cdh_domain;      /* YANG domain (for isolation) */
     cbuf              *cdh_outmsg1;     /* Pending outgoing netconf message #1 for delayed output */
     cbuf              *cdh_outmsg2;     /* Pending outgoing netconf message #2 for delayed output */
+    char              *cdh_dest;        /* Destination of last connect, eg user@addr for ssh */
+    int                cdh_stricthostkey; /* Strict hostkey checking of last connect */
+    void              *cdh_read_session; /* Secondary read-only session, see controller_device_read.c */
+    uint64_t           cdh_read_requests; /* Number of requests sent on read sessions */
+    void              *cdh_msglog;      /* Message log sampling state, see controller_msglog.c */
+    void              *cdh_pacing;      /* Request pacing state, see controller_pacing.c */
 };
 
 /*! Check struct magic number for sanity checks
@@ -113,6 +131,65 @@ device_handle_check(device_handle dh)
     return cdh->cdh_magic == CLIXON_CLIENT_MAGIC ? 0 : -1;
 }
 
+/*! Get hash table stored in clixon handle, create it if needed
+ *
+ * @param[in]  h     Clixon handle
+ * @param[in]  key   Name of hash table
+ * @retval     hash  Hash table
+ * @retval     NULL  Error
+ */
+static clicon_hash_t *
+device_handle_hash(clixon_handle h,
+                   const char   *key)
+{
+    clicon_hash_t *hash = NULL;
+
+    if (clicon_ptr_get(h, key, (void**)&hash) < 0 || hash == NULL){
+        if ((hash = clicon_hash_init()) == NULL){
+            clixon_err(OE_UNIX, errno, "clicon_hash_init");
+            return NULL;
+        }
+        clicon_ptr_set(h, key, hash);
+    }
+    return hash;
+}
+
+/*! Add to number of devices in a transaction
+ *
+ * @param[in]  h     Clixon handle
+ * @param[in]  tid   Transaction id, 0 is ignored
+ * @param[in]  delta 1 or -1
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+device_handle_tid_count(clixon_handle h,
+                        uint64_t      tid,
+                        int           delta)
+{
+    clicon_hash_t *hash;
+    char           key[24];
+    uint32_t      *nrp;
+    uint32_t       nr = 0;
+
+    if (tid == 0)
+        return 0;
+    if ((hash = device_handle_hash(h, DEVICE_HANDLE_TIDS)) == NULL)
+        return -1;
+    snprintf(key, sizeof(key), "%" PRIu64, tid);
+    if ((nrp = clicon_hash_value(hash, key, NULL)) != NULL)
+        nr = *nrp;
+    if (delta < 0 && nr > 0)
+        nr--;
+    else if (delta > 0)
+        nr++;
+    if (nr == 0)
+        clicon_hash_del(hash, key);
+    else if (clicon_hash_add(hash, key, &nr, sizeof(nr)) == NULL)
+        return -1;
+    return 0;
+}
+
 /*! Free handle itself
  *
  * @param[in]  dh  Controller device handle
@@ -141,6 +218,15 @@ device_handle_free1(struct controller_device_handle *cdh)
         cbuf_free(cdh->cdh_outmsg1);
     if (cdh->cdh_outmsg2)
         cbuf_free(cdh->cdh_outmsg2);
+    if (cdh->cdh_dest)
+        free(cdh->cdh_dest);
+    if (cdh->cdh_msglog)
+        free(cdh->cdh_msglog);
+    if (cdh->cdh_pacing){
+        /* Cancel pacing timer and free queued messages */
+        controller_pacing_close((device_handle)cdh);
+        free(cdh->cdh_pacing);
+    }
     free(cdh);
     return 0;
 }
@@ -158,6 +244,7 @@ device_handle_new(clixon_handle h,
 {
     struct controller_device_handle *cdh = NULL;
     struct controller_device_handle *cdh_list = NULL;
+    clicon_hash_t                   *hash;
     size_t                           sz;
 
     clixon_debug(CLIXON_DBG_CTRL, "");
@@ -182,6 +269,11 @@ device_handle_new(clixon_handle h,
         device_handle_free1(cdh);
         return NULL;
     }
+    if ((hash = device_handle_hash(h, DEVICE_HANDLE_NAMES)) == NULL ||
+        clicon_hash_add(hash, name, &cdh, sizeof(cdh)) == NULL){
+        device_handle_free1(cdh);
+        return NULL;
+    }
     (void)clicon_ptr_get(h, "client-list", (void**)&cdh_list);
     ADDQ(cdh, cdh_list);
     clicon_ptr_set(h, "client-list", (void*)cdh_list);
@@ -201,8 +293,14 @@ device_handle_free(device_handle dh)
     struct controller_device_handle *cdh_list = NULL;
     struct controller_device_handle *c;
     clixon_handle                    h;
+    clicon_hash_t                   *hash = NULL;
+    struct controller_device_handle **cp;
 
     h = (clixon_handle)cdh->cdh_h;
+    if (clicon_ptr_get(h, DEVICE_HANDLE_NAMES, (void**)&hash) == 0 && hash != NULL &&
+        (cp = clicon_hash_value(hash, cdh->cdh_name, NULL)) != NULL && *cp == cdh)
+        clicon_hash_del(hash, cdh->cdh_name);
+    device_handle_tid_count(h, cdh->cdh_tid, -1);
     clicon_ptr_get(h, "client-list", (void**)&cdh_list);
     if ((c = cdh_list) != NULL) {
         do {
@@ -227,6 +325,7 @@ device_handle_free_all(clixon_handle h)
 {
     struct controller_device_handle *cdh_list = NULL;
     struct controller_device_handle *c;
+    clicon_hash_t                   *hash = NULL;
 
     clicon_ptr_get(h, "client-list", (void**)&cdh_list);
     while ((c = cdh_list) != NULL) {
@@ -234,11 +333,21 @@ device_handle_free_all(clixon_handle h)
         device_handle_free1(c);
     }
     clicon_ptr_set(h, "client-list", (void*)cdh_list);
+    if (clicon_ptr_get(h, DEVICE_HANDLE_NAMES, (void**)&hash) == 0 && hash != NULL){
+        clicon_hash_free(hash);
+        clicon_ptr_del(h, DEVICE_HANDLE_NAMES);
+    }
+    hash = NULL;
+    if (clicon_ptr_get(h, DEVICE_HANDLE_TIDS, (void**)&hash) == 0 && hash != NULL){
+        clicon_hash_free(hash);
+        clicon_ptr_del(h, DEVICE_HANDLE_TIDS);
+    }
     return 0;
 }
 
 /*! Find clixon-client given name
  *
+ * Lookup in hash of device names, not a scan of the device list
  * @param[in]  h     Clixon  handle
  * @param[in]  name  Client name
  * @retval     dh    Device handle
@@ -247,18 +356,15 @@ device_handle
 device_handle_find(clixon_handle h,
                    const char   *name)
 {
-    struct controller_device_handle *cdh_list = NULL;
-    struct controller_device_handle *c = NULL;
+    clicon_hash_t                    *hash = NULL;
+    struct controller_device_handle **cp;
 
-    if (clicon_ptr_get(h, "client-list", (void**)&cdh_list) == 0 &&
-        (c = cdh_list) != NULL) {
-        do {
-            if (strcmp(c->cdh_name, name) == 0)
-                return c;
-            c = NEXTQ(struct controller_device_handle *, c);
-        } while (c && c != cdh_list);
-    }
-    return NULL;
+    if (name == NULL ||
+        clicon_ptr_get(h, DEVICE_HANDLE_NAMES, (void**)&hash) < 0 || hash == NULL)
+        return NULL;
+    if ((cp = clicon_hash_value(hash, name, NULL)) == NULL)
+        return NULL;
+    return *cp;
 }
 
 /*! Iterator over device-handles
@@ -315,6 +421,15 @@ device_handle_connect(device_handle      dh,
     }
     h = cdh->cdh_h;
     cdh->cdh_type = socktype;
+    if (cdh->cdh_dest){
+        free(cdh->cdh_dest);
+        cdh->cdh_dest = NULL;
+    }
+    if (dest && (cdh->cdh_dest = strdup(dest)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    cdh->cdh_stricthostkey = stricthostkey;
     switch (socktype){
     case CLIXON_CLIENT_IPC:
         if (clicon_rpc_connect(h, &cdh->cdh_socket) < 0)
@@ -441,6 +556,19 @@ device_handle_msg_id_getinc(device_handle dh)
     return cdh->cdh_msg_id++;
 }
 
+/*! Get msg-id of next message
+ *
+ * @param[in]  dh     Device handle
+ * @retval     msgid
+ */
+uint64_t
+device_handle_msg_id_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_msg_id;
+}
+
 /*! Get transaction id
  *
  * @param[in]  dh     Device handle
@@ -465,10 +593,66 @@ device_handle_tid_set(device_handle dh,
 {
     struct controller_device_handle *cdh = devhandle(dh);
 
+    if (cdh->cdh_tid != tid){
+        if (device_handle_tid_count(cdh->cdh_h, cdh->cdh_tid, -1) < 0)
+            return -1;
+        if (device_handle_tid_count(cdh->cdh_h, tid, 1) < 0)
+            return -1;
+    }
     cdh->cdh_tid = tid;
     return 0;
 }
 
+/*! Get number of devices in a transaction
+ *
+ * @param[in]  h      Clixon handle
+ * @param[in]  tid    Transaction-id
+ * @retval     nr     Number of devices with transaction-id tid
+ */
+uint32_t
+device_handle_tid_nr(clixon_handle h,
+                     uint64_t      tid)
+{
+    clicon_hash_t *hash = NULL;
+    char           key[24];
+    uint32_t      *nrp;
+
+    if (clicon_ptr_get(h, DEVICE_HANDLE_TIDS, (void**)&hash) < 0 || hash == NULL)
+        return 0;
+    snprintf(key, sizeof(key), "%" PRIu64, tid);
+    if ((nrp = clicon_hash_value(hash, key, NULL)) == NULL)
+        return 0;
+    return *nrp;
+}
+
+/*! Get message-id of timed out request
+ *
+ * @param[in]  dh     Device handle
+ * @retval     id     Message-id whose reply is dropped, 0 if none
+ */
+uint64_t
+device_handle_stale_id_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_stale_id;
+}
+
+/*! Set message-id of timed out request, a late reply with this id is dropped
+ *
+ * @param[in]  dh     Device handle
+ * @param[in]  id     Message-id, 0 if none
+ */
+int
+device_handle_stale_id_set(device_handle dh,
+                           uint64_t      id)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    cdh->cdh_stale_id = id;
+    return 0;
+}
+
 clixon_handle
 device_handle_handle_get(device_handle dh)
 {
@@ -777,6 +961,7 @@ device_handle_yang_lib_set(device_handle dh,
     if (cdh->cdh_yang_lib != NULL)
         xml_free(cdh->cdh_yang_lib);
     cdh->cdh_yang_lib = xylib;
+    cdh->cdh_yang_lib_digest = 0;
     return 0;
 }
 
@@ -800,6 +985,7 @@ device_handle_yang_lib_append(device_handle dh,
     cxobj                           *xm1;
     char                            *name;
 
+    cdh->cdh_yang_lib_digest = 0;
     /* Sanity check */
     if (xylib){
         if ((xms1 = xml_find_type(xylib, NULL, "module-set", CX_ELMNT)) == NULL){
@@ -849,6 +1035,32 @@ device_handle_yang_lib_append(device_handle dh,
     return retval;
 }
 
+/*! Get digest of RFC 8525 yang library
+ *
+ * Computed on demand and cached until yang-lib is changed
+ * @param[in]  dh     Device handle
+ * @param[out] digest Digest of module-set, 0 if no yang-lib
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see controller_yang_lib_digest
+ */
+int
+device_handle_yang_lib_digest_get(device_handle dh,
+                                  uint64_t     *digest)
+{
+    int                              retval = -1;
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    if (cdh->cdh_yang_lib_digest == 0 && cdh->cdh_yang_lib != NULL){
+        if (controller_yang_lib_digest(cdh->cdh_yang_lib, &cdh->cdh_yang_lib_digest) < 0)
+            goto done;
+    }
+    *digest = cdh->cdh_yang_lib_digest;
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Get sync timestamp
  *
  * @param[in]  dh     Device handle
@@ -882,6 +1094,35 @@ device_handle_sync_time_set(device_handle   dh,
     return 0;
 }
 
+/*! Get cached digest of last synced config
+ *
+ * @param[in]  dh     Device handle
+ * @retval     digest Digest, 0 if not computed
+ * @see device_config_synced_digest
+ */
+uint64_t
+device_handle_synced_digest_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_synced_digest;
+}
+
+/*! Set cached digest of last synced config
+ *
+ * @param[in]  dh     Device handle
+ * @param[in]  digest Digest, 0 invalidates
+ */
+int
+device_handle_synced_digest_set(device_handle dh,
+                                uint64_t      digest)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    cdh->cdh_synced_digest = digest;
+    return 0;
+}
+
 /*! Get nr of schemas
  *
  * @param[in]  dh     Device handle
@@ -1090,3 +1331,143 @@ device_handle_outmsg_set(device_handle dh,
     }
     return 0;
 }
+
+/*! Get destination of last connect
+ *
+ * @param[in]  dh     Device handle
+ * @param[out] stricthostkey  Strict hostkey checking of last connect (if not NULL)
+ * @retval     dest   Destination, eg user@addr
+ * @retval     NULL   Not connected
+ */
+char*
+device_handle_dest_get(device_handle dh,
+                       int          *stricthostkey)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    if (stricthostkey)
+        *stricthostkey = cdh->cdh_stricthostkey;
+    return cdh->cdh_dest;
+}
+
+/*! Get secondary read-only session
+ *
+ * @param[in]  dh     Device handle
+ * @retval     rs     Read session
+ * @retval     NULL   No read session
+ */
+void*
+device_handle_read_session_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_read_session;
+}
+
+/*! Set secondary read-only session
+ *
+ * @param[in]  dh     Device handle
+ * @param[in]  rs     Read session, or NULL
+ */
+int
+device_handle_read_session_set(device_handle dh,
+                               void         *rs)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    cdh->cdh_read_session = rs;
+    return 0;
+}
+
+/*! Increment number of requests sent on secondary read sessions
+ *
+ * @param[in]  dh   Device handle
+ */
+int
+device_handle_read_requests_inc(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    cdh->cdh_read_requests++;
+    return 0;
+}
+
+/*! Get number of requests sent on secondary read sessions
+ *
+ * @param[in]  dh   Device handle
+ * @retval     nr   Number of requests
+ */
+uint64_t
+device_handle_read_requests_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_read_requests;
+}
+
+/*! Get message log state
+ *
+ * @param[in]  dh     Device handle
+ * @retval     ml     Message log state
+ * @retval     NULL   Messages of device are not logged
+ */
+void*
+device_handle_msglog_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_msglog;
+}
+
+/*! Set message log state
+ *
+ * The state is freed with the device handle
+ * @param[in]  dh     Device handle
+ * @param[in]  ml     Message log state (malloced, no pointers), or NULL
+ */
+int
+device_handle_msglog_set(device_handle dh,
+                         void         *ml)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    if (cdh->cdh_msglog)
+        free(cdh->cdh_msglog);
+    cdh->cdh_msglog = ml;
+    return 0;
+}
+
+/*! Get request pacing state
+ *
+ * @param[in]  dh     Device handle
+ * @retval     pd     Pacing state
+ * @retval     NULL   Requests to device are not paced
+ */
+void*
+device_handle_pacing_get(device_handle dh)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    return cdh->cdh_pacing;
+}
+
+/*! Set request pacing state
+ *
+ * A previous state is flushed and freed, as is the state when the device handle is freed
+ * @param[in]  dh     Device handle
+ * @param[in]  pd     Pacing state (malloced), or NULL
+ * @see controller_pacing_close
+ */
+int
+device_handle_pacing_set(device_handle dh,
+                         void         *pd)
+{
+    struct controller_device_handle *cdh = devhandle(dh);
+
+    if (cdh->cdh_pacing && cdh->cdh_pacing != pd){
+        controller_pacing_close(dh);
+        free(cdh->cdh_pacing);
+    }
+    cdh->cdh_pacing = pd;
+    return 0;
+}
@@ -65,8 +65,12 @@ char  *device_handle_name_get(device_handle dh);
 int    device_handle_socket_get(device_handle dh);
 int    device_handle_sockerr_get(device_handle dh);
 uint64_t device_handle_msg_id_getinc(device_handle dh);
+uint64_t device_handle_msg_id_get(device_handle dh);
 uint64_t device_handle_tid_get(device_handle dh);
 int      device_handle_tid_set(device_handle dh, uint64_t tid);
+uint32_t device_handle_tid_nr(clixon_handle h, uint64_t tid);
+uint64_t device_handle_stale_id_get(device_handle dh);
+int      device_handle_stale_id_set(device_handle dh, uint64_t id);
 clixon_handle device_handle_handle_get(device_handle dh);
 conn_state    device_handle_conn_state_get(device_handle dh);
 yang_config_t device_handle_yang_config_get(device_handle dh);
@@ -87,8 +91,11 @@ int    device_handle_capabilities_find(clixon_handle ch, const char *name);
 cxobj *device_handle_yang_lib_get(device_handle dh);
 int    device_handle_yang_lib_set(device_handle dh, cxobj *xylib);
 int    device_handle_yang_lib_append(device_handle dh, cxobj *xylib);
+int    device_handle_yang_lib_digest_get(device_handle dh, uint64_t *digest);
 int    device_handle_sync_time_get(device_handle dh, struct timeval *t);
 int    device_handle_sync_time_set(device_handle dh, struct timeval *t);
+uint64_t device_handle_synced_digest_get(device_handle dh);
+int    device_handle_synced_digest_set(device_handle dh, uint64_t digest);
 int    device_handle_nr_schemas_get(device_handle dh);
 int    device_handle_nr_schemas_set(device_handle dh, int nr);
 char  *device_handle_schema_name_get(device_handle dh);
@@ -101,6 +108,15 @@ char  *device_handle_domain_get(device_handle dh);
 int    device_handle_domain_set(device_handle dh, char *domain);
 cbuf  *device_handle_outmsg_get(device_handle dh, int nr);
 int    device_handle_outmsg_set(device_handle dh, int nr, cbuf *cb);
+char  *device_handle_dest_get(device_handle dh, int *stricthostkey);
+void  *device_handle_read_session_get(device_handle dh);
+int    device_handle_read_session_set(device_handle dh, void *rs);
+int    device_handle_read_requests_inc(device_handle dh);
+uint64_t device_handle_read_requests_get(device_handle dh);
+void  *device_handle_msglog_get(device_handle dh);
+int    device_handle_msglog_set(device_handle dh, void *ml);
+void  *device_handle_pacing_get(device_handle dh);
+int    device_handle_pacing_set(device_handle dh, void *pd);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,593 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Secondary read-only NETCONF session per device
+  * Read requests are queued on the session and sent one at a time. The session is opened
+  * over ssh to the same destination as the primary session on the first request and closed
+  * after devices/read-session-idle-timeout seconds without requests.
+  * Framing is negotiated in the hello exchange. The framing of the primary session is used if
+  * the device announces it on the read session.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_device_state.h"
+#include "controller_device_handle.h"
+#include "controller_device_send.h"
+#include "controller_device_read.h"
+#include "controller_reactor.h"
+#include "controller_uring.h"
+#include "controller_msglog.h"
+
+/* Idle timeout in seconds, if devices/read-session-idle-timeout is not set */
+#define READ_SESSION_IDLE_DEFAULT 60
+
+/*! State of read session
+ */
+enum read_state {
+    RS_HELLO,  /* Connected, waiting for hello from device */
+    RS_IDLE,   /* Open, no outstanding request */
+    RS_BUSY,   /* Open, waiting for reply of first request */
+};
+
+/*! Queued read request
+ */
+struct read_request {
+    qelem_t           rr_qelem;  /* List header */
+    char             *rr_rpc;    /* RPC to send, without <rpc> */
+    device_read_cb_t *rr_fn;     /* Called when done */
+    uint64_t          rr_id;     /* Argument to rr_fn */
+};
+typedef struct read_request read_request;
+
+/*! Secondary read session of a device
+ */
+struct read_session {
+    enum read_state rs_state;
+    uint64_t        rs_gen;         /* Generation, unique per session */
+    netconf_framing_type rs_framing; /* EOM or chunked framing */
+    int             rs_socket;      /* Input/output socket */
+    int             rs_sockerr;     /* Stderr socket, -1 is closed */
+    int             rs_pid;         /* ssh sub-process */
+    uint64_t        rs_msg_id;      /* Message-id to device */
+    cbuf           *rs_frame_buf;   /* Received data of incomplete frame */
+    int             rs_frame_state; /* Framing state for detecting EOM */
+    size_t          rs_frame_size;  /* Remaining expecting chunk bytes */
+    read_request   *rs_requests;    /* Queue, first is outstanding in BUSY state */
+};
+typedef struct read_session read_session;
+
+static int read_session_input_cb(int s, void *arg);
+static int read_session_timeout(int s, void *arg);
+
+/* Generation of last opened read session */
+static uint64_t _read_session_gen = 0;
+
+/*! Check if a read session is still the open read session of a device
+ *
+ * A pointer compare is not enough since a new session may reuse the allocation
+ * @param[in]  dh   Device handle
+ * @param[in]  gen  Generation of the session
+ * @retval     1    Same session
+ * @retval     0    Closed, or replaced with another session
+ */
+static int
+read_session_alive(device_handle dh,
+                   uint64_t      gen)
+{
+    read_session *rs;
+
+    return (rs = device_handle_read_session_get(dh)) != NULL && rs->rs_gen == gen;
+}
+
+/*! Restart timer of read session
+ *
+ * The timer is a reply timeout in HELLO and BUSY states and an idle timeout in IDLE state
+ * @param[in]  h   Clixon handle
+ * @param[in]  dh  Device handle
+ * @param[in]  rs  Read session
+ */
+static int
+read_session_timer(clixon_handle h,
+                   device_handle dh,
+                   read_session *rs)
+{
+    struct timeval t;
+    struct timeval t1 = {0,};
+    int            d;
+
+    (void)clixon_event_unreg_timeout(read_session_timeout, dh);
+    if (rs->rs_state == RS_IDLE){
+        if ((d = clicon_data_int_get(h, "controller-read-session-idle")) < 0)
+            d = READ_SESSION_IDLE_DEFAULT;
+    }
+    else if ((d = clicon_data_int_get(h, "controller-device-timeout")) < 0)
+        d = 60;
+    t1.tv_sec = d;
+    gettimeofday(&t, NULL);
+    timeradd(&t, &t1, &t);
+    return clixon_event_reg_timeout(t, read_session_timeout, dh, "Device read session");
+}
+
+/*! Send first queued request if session is idle
+ *
+ * @param[in]  h   Clixon handle
+ * @param[in]  dh  Device handle
+ * @param[in]  rs  Read session
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
+static int
+read_session_send(clixon_handle h,
+                  device_handle dh,
+                  read_session *rs)
+{
+    int           retval = -1;
+    cbuf         *cb = NULL;
+    read_request *rr;
+
+    if (rs->rs_state != RS_IDLE)
+        goto ok;
+    if ((rr = rs->rs_requests) != NULL){
+        if ((cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(cb, "<rpc xmlns=\"%s\" message-id=\"%" PRIu64 "\">",
+                NETCONF_BASE_NAMESPACE, rs->rs_msg_id++);
+        cprintf(cb, "%s", rr->rr_rpc);
+        cprintf(cb, "</rpc>");
+        if (netconf_output_encap(rs->rs_framing, cb) < 0)
+            goto done;
+        if (device_send_msg(dh, rs->rs_socket, cb) < 0)
+            goto done;
+        device_handle_read_requests_inc(dh);
+        rs->rs_state = RS_BUSY;
+    }
+    if (read_session_timer(h, dh, rs) < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Dequeue first request and call its callback
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  dh      Device handle
+ * @param[in]  rs      Read session
+ * @param[in]  xreply  rpc-reply, or NULL
+ * @param[in]  reason  Failure reason, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+read_session_reply(clixon_handle h,
+                   device_handle dh,
+                   read_session *rs,
+                   cxobj        *xreply,
+                   char         *reason)
+{
+    int           retval = -1;
+    read_request *rr;
+
+    if ((rr = rs->rs_requests) == NULL)
+        return 0;
+    DELQ(rr, rs->rs_requests, read_request *);
+    if (rr->rr_fn(h, dh, rr->rr_id, xreply, reason) < 0)
+        goto done;
+    retval = 0;
+ done:
+    free(rr->rr_rpc);
+    free(rr);
+    return retval;
+}
+
+/*! Queue a read request on the secondary session of a device, open it if closed
+ *
+ * @param[in]  h    Clixon handle
+ * @param[in]  dh   Device handle
+ * @param[in]  rpc  RPC to send without <rpc>, eg <get>...</get>
+ * @param[in]  fn   Called with the reply or failure reason when done
+ * @param[in]  id   Argument to fn
+ * @retval     1    Queued, fn will be called
+ * @retval     0    No read session possible, the device has no open primary session
+ * @retval    -1    Error
+ */
+int
+device_read_request(clixon_handle     h,
+                    device_handle     dh,
+                    char             *rpc,
+                    device_read_cb_t *fn,
+                    uint64_t          id)
+{
+    int           retval = -1;
+    read_session *rs = NULL;
+    read_request *rr = NULL;
+    char         *dest;
+    int           stricthostkey = 1;
+    cbuf         *cb = NULL;
+
+    if (device_handle_conn_state_get(dh) == CS_CLOSED ||
+        (dest = device_handle_dest_get(dh, &stricthostkey)) == NULL)
+        goto noread;
+    if ((rr = malloc(sizeof(*rr))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memset(rr, 0, sizeof(*rr));
+    if ((rr->rr_rpc = strdup(rpc)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    rr->rr_fn = fn;
+    rr->rr_id = id;
+    if ((rs = device_handle_read_session_get(dh)) == NULL){
+        clixon_debug(CLIXON_DBG_CTRL, "%s: open read session", device_handle_name_get(dh));
+        if ((rs = malloc(sizeof(*rs))) == NULL){
+            clixon_err(OE_UNIX, errno, "malloc");
+            goto done;
+        }
+        memset(rs, 0, sizeof(*rs));
+        rs->rs_socket = -1;
+        rs->rs_sockerr = -1;
+        rs->rs_state = RS_HELLO;
+        rs->rs_gen = ++_read_session_gen;
+        rs->rs_framing = NETCONF_SSH_EOM; /* Hello is always EOM */
+        rs->rs_msg_id = 1;
+        if ((rs->rs_frame_buf = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        device_handle_read_session_set(dh, rs);
+#ifdef SSH_BIN
+        if (clixon_client_connect_ssh(h, dest, stricthostkey,
+                                      &rs->rs_pid, &rs->rs_socket, &rs->rs_sockerr) < 0)
+            goto done;
+#else
+        clixon_err(OE_UNIX, 0, "No ssh bin");
+        goto done;
+#endif
+        if ((cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(cb, "Netconf ssh read %s", dest);
+        if (controller_reactor_reg_fd(rs->rs_socket, read_session_input_cb, dh, cbuf_get(cb)) < 0)
+            goto done;
+        if (read_session_timer(h, dh, rs) < 0)
+            goto done;
+    }
+    ADDQ(rr, rs->rs_requests);
+    rr = NULL;
+    if (read_session_send(h, dh, rs) < 0)
+        goto done;
+    retval = 1;
+ done:
+    if (retval < 0 && rs && rs->rs_requests == NULL)
+        device_read_close(dh, NULL);
+    if (cb)
+        cbuf_free(cb);
+    if (rr){
+        if (rr->rr_rpc)
+            free(rr->rr_rpc);
+        free(rr);
+    }
+    return retval;
+ noread:
+    retval = 0;
+    goto done;
+}
+
+/*! Close the secondary session of a device, fail all queued requests
+ *
+ * @param[in]  dh     Device handle
+ * @param[in]  reason Reason given to queued requests, or NULL
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+device_read_close(device_handle dh,
+                  char         *reason)
+{
+    int           retval = -1;
+    clixon_handle h;
+    read_session *rs;
+
+    if ((rs = device_handle_read_session_get(dh)) == NULL)
+        return 0;
+    clixon_debug(CLIXON_DBG_CTRL, "%s: close read session", device_handle_name_get(dh));
+    h = device_handle_handle_get(dh);
+    /* Detach first: callbacks may make new requests */
+    device_handle_read_session_set(dh, NULL);
+    (void)clixon_event_unreg_timeout(read_session_timeout, dh);
+    if (rs->rs_socket != -1){
+        controller_reactor_unreg_fd(rs->rs_socket, read_session_input_cb);
+        controller_uring_close(rs->rs_socket);
+        if (rs->rs_sockerr != -1)
+            close(rs->rs_sockerr);
+        if (rs->rs_pid){
+            if (clixon_proc_socket_close(rs->rs_pid, rs->rs_socket) < 0)
+                goto done;
+        }
+        else
+            close(rs->rs_socket);
+    }
+    while (rs->rs_requests != NULL)
+        if (read_session_reply(h, dh, rs, NULL, reason?reason:"Read session closed") < 0)
+            goto done;
+    retval = 0;
+ done:
+    while (rs->rs_requests != NULL){
+        read_request *rr = rs->rs_requests;
+        DELQ(rr, rs->rs_requests, read_request *);
+        free(rr->rr_rpc);
+        free(rr);
+    }
+    if (rs->rs_frame_buf)
+        cbuf_free(rs->rs_frame_buf);
+    free(rs);
+    return retval;
+}
+
+/*! Reply timeout or idle timeout of read session
+ *
+ * @param[in] s    Not used
+ * @param[in] arg  Device handle
+ */
+static int
+read_session_timeout(int   s,
+                     void *arg)
+{
+    device_handle dh = (device_handle)arg;
+    read_session *rs;
+
+    if ((rs = device_handle_read_session_get(dh)) == NULL)
+        return 0;
+    if (rs->rs_state == RS_IDLE)
+        return device_read_close(dh, NULL);
+    return device_read_close(dh, "Timeout waiting for remote peer on read session");
+}
+
+/*! Receive hello on read session, negotiate framing and send hello
+ *
+ * Use the framing of the primary session if the device announces it, otherwise the
+ * other base capability
+ * @param[in]  dh    Device handle
+ * @param[in]  rs    Read session
+ * @param[in]  xmsg  Hello message
+ * @retval     1     OK
+ * @retval     0     No base capability
+ * @retval    -1     Error
+ */
+static int
+read_session_hello(device_handle dh,
+                   read_session *rs,
+                   cxobj        *xmsg)
+{
+    cxobj               *xcaps;
+    cxobj               *x;
+    char                *b;
+    int                  base10 = 0;
+    int                  base11 = 0;
+    netconf_framing_type framing;
+
+    if ((xcaps = xml_find_type(xmsg, NULL, "capabilities", CX_ELMNT)) != NULL){
+        x = NULL;
+        while ((x = xml_child_each(xcaps, x, CX_ELMNT)) != NULL){
+            if ((b = xml_body(x)) == NULL)
+                continue;
+            if (strcmp(b, NETCONF_BASE_CAPABILITY_1_0) == 0)
+                base10++;
+            else if (strcmp(b, NETCONF_BASE_CAPABILITY_1_1) == 0)
+                base11++;
+        }
+    }
+    framing = device_handle_framing_type_get(dh);
+    if (framing == NETCONF_SSH_CHUNKED && !base11)
+        framing = NETCONF_SSH_EOM;
+    else if (framing == NETCONF_SSH_EOM && !base10)
+        framing = NETCONF_SSH_CHUNKED;
+    if ((framing == NETCONF_SSH_EOM && !base10) ||
+        (framing == NETCONF_SSH_CHUNKED && !base11))
+        return 0;
+    if (clixon_client_hello(rs->rs_socket, device_handle_name_get(dh), framing) < 0)
+        return -1;
+    rs->rs_framing = framing;
+    return 1;
+}
+
+/*! Handle one message from device on read session
+ *
+ * @param[in]  h     Clixon handle
+ * @param[in]  dh    Device handle
+ * @param[in]  rs    Read session
+ * @param[in]  xmsg  Message
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+read_session_msg(clixon_handle h,
+                 device_handle dh,
+                 read_session *rs,
+                 cxobj        *xmsg)
+{
+    int      retval = -1;
+    char    *rpcname;
+    uint64_t gen;
+    int      ret;
+
+    rpcname = xml_name(xmsg);
+    switch (rs->rs_state){
+    case RS_HELLO:
+        if (strcmp(rpcname, "hello") != 0)
+            goto unexpected;
+        if ((ret = read_session_hello(dh, rs, xmsg)) < 0)
+            goto done;
+        if (ret == 0){
+            retval = device_read_close(dh, "No base netconf capability found on read session");
+            goto done;
+        }
+        rs->rs_state = RS_IDLE;
+        break;
+    case RS_BUSY:
+        if (strcmp(rpcname, "rpc-reply") != 0)
+            goto unexpected;
+        rs->rs_state = RS_IDLE;
+        gen = rs->rs_gen;
+        if (read_session_reply(h, dh, rs, xmsg, NULL) < 0)
+            goto done;
+        /* Callback may have closed the session */
+        if (!read_session_alive(dh, gen))
+            goto ok;
+        break;
+    case RS_IDLE:
+    default:
+        goto unexpected;
+    }
+    if (read_session_send(h, dh, rs) < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+ unexpected:
+    clixon_debug(CLIXON_DBG_CTRL, "%s: Unexpected msg %s on read session",
+                 device_handle_name_get(dh), rpcname);
+    retval = device_read_close(dh, "Unexpected message on read session");
+    goto done;
+}
+
+/*! Handle input data on read session, called by event loop
+ *
+ * @param[in] s    Socket
+ * @param[in] arg  Device handle
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+static int
+read_session_input_cb(int   s,
+                      void *arg)
+{
+    int            retval = -1;
+    device_handle  dh = (device_handle)arg;
+    clixon_handle  h;
+    read_session  *rs;
+    unsigned char  buf[BUFSIZ];
+    unsigned char *p;
+    ssize_t        len;
+    size_t         plen;
+    int            eof = 0;
+    int            eom = 0;
+    cxobj         *xtop = NULL;
+    cxobj         *xerr = NULL;
+    cxobj         *xmsg;
+    uint64_t       gen;
+    int            ret;
+
+    h = device_handle_handle_get(dh);
+    if ((rs = device_handle_read_session_get(dh)) == NULL)
+        goto ok;
+    gen = rs->rs_gen;
+    if ((len = netconf_input_read2(s, buf, sizeof(buf), &eof)) < 0)
+        goto done;
+    if (eof){
+        if (device_read_close(dh, "Read session closed by device") < 0)
+            goto done;
+        goto ok;
+    }
+    p = buf;
+    plen = len;
+    while (plen > 0){
+        if (netconf_input_msg2(&p, &plen,
+                               rs->rs_frame_buf,
+                               rs->rs_framing,
+                               &rs->rs_frame_state,
+                               &rs->rs_frame_size,
+                               &eom) < 0)
+            goto done;
+        if (eom == 0)
+            break;
+        clixon_debug(CLIXON_DBG_MSG, "Recv read [%s]: %s",
+                     device_handle_name_get(dh), cbuf_get(rs->rs_frame_buf));
+        if (controller_msglog(dh, 'R', cbuf_get(rs->rs_frame_buf), cbuf_len(rs->rs_frame_buf)) < 0)
+            goto done;
+        if ((ret = netconf_input_frame2(rs->rs_frame_buf, YB_NONE, NULL, &xtop, &xerr)) < 0)
+            goto done;
+        cbuf_reset(rs->rs_frame_buf);
+        if (ret == 0){
+            if (device_read_close(dh, "Invalid frame on read session") < 0)
+                goto done;
+            goto ok;
+        }
+        if ((xmsg = xml_child_i_type(xtop, 0, CX_ELMNT)) != NULL &&
+            read_session_msg(h, dh, rs, xmsg) < 0)
+            goto done;
+        xml_free(xtop);
+        xtop = NULL;
+        /* Session may have been closed */
+        if (!read_session_alive(dh, gen))
+            break;
+    }
+ ok:
+    retval = 0;
+ done:
+    if (xerr)
+        xml_free(xerr);
+    if (xtop)
+        xml_free(xtop);
+    return retval;
+}
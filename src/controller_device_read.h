@@ -0,0 +1,74 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Secondary read-only NETCONF session per device
+  * The primary session of a device is owned by the device state machine during transactions.
+  * A secondary session is opened lazily when a read is requested, used for one request at a
+  * time and closed when idle. It is also closed when the primary session is closed.
+  */
+
+#ifndef _CONTROLLER_DEVICE_READ_H
+#define _CONTROLLER_DEVICE_READ_H
+
+/*
+ * Types
+ */
+/*! Callback when a read request is done
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  dh      Device handle
+ * @param[in]  id      Id given in request
+ * @param[in]  xreply  rpc-reply from device, or NULL on failure
+ * @param[in]  reason  Failure reason, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+typedef int (device_read_cb_t)(clixon_handle h, device_handle dh, uint64_t id,
+                               cxobj *xreply, char *reason);
+
+/*
+ * Prototypes
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int device_read_request(clixon_handle h, device_handle dh, char *rpc,
+                        device_read_cb_t *fn, uint64_t id);
+int device_read_close(device_handle dh, char *reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONTROLLER_DEVICE_READ_H */
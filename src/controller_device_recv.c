@@ -177,6 +177,93 @@ device_state_recv_hello(clixon_handle h,
     goto done;
 }
 
+/*! Get data of a get-config reply from device and bind it to the device YANG
+ *
+ * The data is kept in xmsg. If it is already bound, eg by device_state_recv_digest, it is
+ * not bound again.
+ * @param[in]  h          Clixon handle
+ * @param[in]  dh         Device handle
+ * @param[in]  xmsg       XML tree of incoming message
+ * @param[in]  rpcname    Name of RPC, only "rpc-reply" expected here
+ * @param[in]  conn_state Device connection state
+ * @param[out] xdatap     <data> in xmsg
+ * @retval     1          OK
+ * @retval     0          Closed
+ * @retval    -1          Error
+ */
+static int
+device_state_recv_data_bind(clixon_handle h,
+                            device_handle dh,
+                            cxobj        *xmsg,
+                            char         *rpcname,
+                            conn_state    conn_state,
+                            cxobj       **xdatap)
+{
+    int        retval = -1;
+    cxobj     *xdata;
+    cxobj     *x;
+    cxobj     *xerr = NULL;
+    cbuf      *cberr = NULL;
+    cvec      *nsc = NULL;
+    yang_stmt *yspec1 = NULL;
+    int        ret;
+
+    if ((ret = rpc_reply_sanity(dh, xmsg, rpcname, conn_state)) < 0)
+        goto done;
+    if (ret == 0)
+        goto closed;
+    if ((xdata = xml_find_type(xmsg, NULL, "data", CX_ELMNT)) == NULL){
+        device_close_connection(dh, "No data in get reply");
+        goto closed;
+    }
+    /* Already bound */
+    if ((x = xml_child_i_type(xdata, 0, CX_ELMNT)) != NULL && xml_spec(x) != NULL)
+        goto ok;
+    /* Move all xmlns declarations to <data> */
+    if (xmlns_set_all(xdata, nsc) < 0)
+        goto done;
+    xml_sort(xdata);
+    if (controller_mount_yspec_get(h, device_handle_name_get(dh), &yspec1) < 0)
+        goto done;
+    if (yspec1 == NULL){
+        device_close_connection(dh, "No YANGs available");
+        goto closed;
+    }
+    /*
+     * <config> clixon-controller:root
+     * <data>  ietf-netconf:data (dont bother to bind this node, its just a placeholder)
+     * <x>     bind to yspec1
+     */
+    if ((ret = xml_bind_yang(h, xdata, YB_MODULE, yspec1, &xerr)) < 0)
+        goto done;
+    if (ret == 0){
+        if ((cberr = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(cberr, "YANG bind failed at mountpoint ");
+        if (xerr && netconf_err2cb(h,
+                                   xml_find_type(xerr, NULL, "rpc-error", CX_ELMNT),
+                                   cberr) < 0)
+            goto done;
+        if (device_close_connection(dh, "%s", cbuf_get(cberr)) < 0)
+            goto done;
+        goto closed;
+    }
+ ok:
+    *xdatap = xdata;
+    retval = 1;
+ done:
+    if (xerr)
+        xml_free(xerr);
+    if (cberr)
+        cbuf_free(cberr);
+    return retval;
+ closed:
+    retval = 0;
+    goto done;
+}
+
 /*! Receive config data from device and add config to mount-point
  *
  * @param[in] h          Clixon handle.
@@ -206,15 +293,11 @@ device_state_recv_config(clixon_handle h,
     cxobj                  *xt = NULL;
     cxobj                  *xa;
     cbuf                   *cbret = NULL;
-    cbuf                   *cberr = NULL;
     char                   *name;
-    cvec                   *nsc = NULL;
-    yang_stmt              *yspec1;
     int                     ret;
     cxobj                  *x;
     cxobj                  *xroot;
     yang_stmt              *yroot;
-    cxobj                  *xerr = NULL;
     uint64_t                tid;
     controller_transaction *ct;
     int                     merge = 0;
@@ -222,18 +305,10 @@ device_state_recv_config(clixon_handle h,
     cxobj                  *xt1 = NULL;
 
     clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "");
-    if ((ret = rpc_reply_sanity(dh, xmsg, rpcname, conn_state)) < 0)
+    if ((ret = device_state_recv_data_bind(h, dh, xmsg, rpcname, conn_state, &xdata)) < 0)
         goto done;
     if (ret == 0)
         goto closed;
-    if ((xdata = xml_find_type(xmsg, NULL, "data", CX_ELMNT)) == NULL){
-        device_close_connection(dh, "No data in get reply");
-        goto closed;
-    }
-    /* Move all xmlns declarations to <data> */
-    if (xmlns_set_all(xdata, nsc) < 0)
-        goto done;
-    xml_sort(xdata);
     name = device_handle_name_get(dh);
     if ((cbret = cbuf_new()) == NULL){
         clixon_err(OE_UNIX, errno, "cbuf_new");
@@ -250,37 +325,6 @@ device_state_recv_config(clixon_handle h,
         clixon_err(OE_YANG, 0, "Device root is not a YANG schema mount-point");
         goto done;
     }
-    yspec1 = NULL;
-    if (controller_mount_yspec_get(h, name, &yspec1) < 0)
-        goto done;
-    if (yspec1 == NULL){
-        device_close_connection(dh, "No YANGs available");
-        goto closed;
-    }
-    /*
-     * <config> clixon-controller:root
-     * <data>  ietf-netconf:data (dont bother to bind this node, its just a placeholder)
-     * <x>     bind to yspec1
-     */
-    if ((ret = xml_bind_yang(h, xdata, YB_MODULE, yspec1, &xerr)) < 0)
-        goto done;
-    if (ret == 0){
-        if ((cberr = cbuf_new()) == NULL){
-            clixon_err(OE_UNIX, errno, "cbuf_new");
-            goto done;
-        }
-        cprintf(cberr, "YANG bind failed at mountpoint ");
-        // xpath not prefix/namespace independent
-        if (xerr && (x = xpath_first(xerr, NULL, "rpc-error/error-message")) != NULL){
-            if (netconf_err2cb(h,
-                               xml_find_type(xerr, NULL, "rpc-error", CX_ELMNT),
-                               cberr) < 0)
-                goto done;
-        }
-        if (device_close_connection(dh, "%s", cbuf_get(cberr)) < 0)
-            goto done;
-        goto closed;
-    }
     /* Add all xdata children to xroot
      * XXX:
      * 1. idempotent?
@@ -358,10 +402,6 @@ device_state_recv_config(clixon_handle h,
         xml_free(xt1);
     if (xt)
         xml_free(xt);
-    if (xerr)
-        xml_free(xerr);
-    if (cberr)
-        cbuf_free(cberr);
     if (cbret)
         cbuf_free(cbret);
     return retval;
@@ -370,6 +410,51 @@ device_state_recv_config(clixon_handle h,
     goto done;
 }
 
+/*! Receive config data from device and compute its digest without storing it
+ *
+ * The data is bound to the device YANG and sorted, but kept in xmsg. A following
+ * device_state_recv_config of the same xmsg does not bind it again.
+ * @param[in]  h          Clixon handle
+ * @param[in]  dh         Device handle
+ * @param[in]  xmsg       XML tree of incoming message
+ * @param[in]  rpcname    Name of RPC, only "rpc-reply" expected here
+ * @param[in]  conn_state Device connection state
+ * @param[out] digest     Digest of device config
+ * @retval     1          OK
+ * @retval     0          Closed
+ * @retval    -1          Error
+ * @see controller_config_digest
+ * @see device_state_recv_config  which also stores the config
+ */
+int
+device_state_recv_digest(clixon_handle h,
+                         device_handle dh,
+                         cxobj        *xmsg,
+                         char         *rpcname,
+                         conn_state    conn_state,
+                         uint64_t     *digest)
+{
+    int    retval = -1;
+    cxobj *xdata;
+    int    ret;
+
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "");
+    if ((ret = device_state_recv_data_bind(h, dh, xmsg, rpcname, conn_state, &xdata)) < 0)
+        goto done;
+    if (ret == 0)
+        goto closed;
+    if (xml_sort_recurse(xdata) < 0)
+        goto done;
+    if (controller_config_digest(xdata, digest) < 0)
+        goto done;
+    retval = 1;
+ done:
+    return retval;
+ closed:
+    retval = 0;
+    goto done;
+}
+
 /*! Receive netconf-state schema list from device using RFC 6022 state
  *
  * @param[in] h          Clixon handle.
@@ -674,3 +759,76 @@ device_state_recv_ok(clixon_handle h,
     goto done;
 }
 
+
+/*! Controller input wresp to get-device-state handling, read rpc-reply with data
+ *
+ * @param[in]  h          Clixon handle.
+ * @param[in]  dh         Clixon client handle.
+ * @param[in]  xmsg       XML tree of incoming message
+ * @param[in]  rpcname    Name of RPC, only "rpc-reply" expected here
+ * @param[in]  conn_state Device connection state
+ * @param[out] xdatap     Pointer to <data> in xmsg, or NULL if no data (retval = 2)
+ * @param[out] cberr      Error, free with cbuf_err (retval = 0)
+ * @retval     2          OK
+ * @retval     1          Closed
+ * @retval     0          Failed: received rpc-error (not closed)
+ * @retval    -1          Error
+ * @see device_state_recv_ok
+ */
+int
+device_state_recv_data(clixon_handle h,
+                       device_handle dh,
+                       cxobj        *xmsg,
+                       char         *rpcname,
+                       conn_state    conn_state,
+                       cxobj       **xdatap,
+                       cbuf        **cberr)
+{
+    int    retval = -1;
+    int    ret;
+    cxobj *xerr;
+    cxobj *x;
+    char  *b;
+    cbuf  *cb = NULL;
+
+    if ((ret = rpc_reply_sanity(dh, xmsg, rpcname, conn_state)) < 0)
+        goto done;
+    if (ret == 0)
+        goto closed;
+    xerr = NULL;
+    while ((xerr = xml_child_each(xmsg, xerr, CX_ELMNT)) != NULL) {
+        if (strcmp(xml_name(xerr), "rpc-error") != 0)
+            continue;
+        if ((x = xml_find_type(xerr, NULL, "error-severity", CX_ELMNT)) != NULL &&
+            (b = xml_body(x)) != NULL &&
+            strcmp(b, "warning") == 0)
+            continue;
+        if ((cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(cb, "Device %s in state %s:",
+                device_handle_name_get(dh),
+                device_state_int2str(conn_state));
+        if (netconf_err2cb(h, xerr, cb) < 0)
+            goto done;
+        if (cberr){
+            *cberr = cb;
+            cb = NULL;
+        }
+        goto failed;
+    }
+    if (xdatap)
+        *xdatap = xml_find_type(xmsg, NULL, "data", CX_ELMNT);
+    retval = 2;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+ failed:
+    retval = 0;
+    goto done;
+ closed:
+    retval = 1;
+    goto done;
+}
@@ -52,6 +52,53 @@
 #include "controller_device_state.h"
 #include "controller_device_handle.h"
 #include "controller_device_send.h"
+#include "controller_uring.h"
+#include "controller_msglog.h"
+#include "controller_pacing.h"
+#include "controller_trace.h"
+
+/*! Send a framed netconf message to a device, without pacing
+ *
+ * @param[in]  dh   Device handle
+ * @param[in]  s    Socket
+ * @param[in]  cb   Framed message
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see device_send_msg
+ */
+int
+device_send_msg_now(device_handle dh,
+                    int           s,
+                    cbuf         *cb)
+{
+    CONTROLLER_TRACE2(device_send, device_handle_name_get(dh), cbuf_len(cb));
+    if (controller_msglog(dh, 'S', cbuf_get(cb), cbuf_len(cb)) < 0)
+        return -1;
+    return controller_uring_send(s, device_handle_name_get(dh), cb, device_output_error_cb, dh);
+}
+
+/*! Send a framed netconf message to a device
+ *
+ * If the device is paced, the message may be queued and sent later, see controller_pacing.c
+ * @param[in]  dh   Device handle
+ * @param[in]  s    Socket
+ * @param[in]  cb   Framed message, not used after return
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+device_send_msg(device_handle dh,
+                int           s,
+                cbuf         *cb)
+{
+    int ret;
+
+    if ((ret = controller_pacing_send(dh, s, cb)) < 0)
+        return -1;
+    if (ret == 1) /* Queued */
+        return 0;
+    return device_send_msg_now(dh, s, cb);
+}
 
 /*! Send a <lock>/<unlock> target candidate
  *
@@ -90,7 +137,7 @@ device_send_lock(clixon_handle h,
     encap = device_handle_framing_type_get(dh);
     if (netconf_output_encap(encap, cb) < 0)
         goto done;
-    if (clixon_msg_send10(s, device_handle_name_get(dh), cb) < 0)
+    if (device_send_msg(dh, s, cb) < 0)
         goto done;
     retval = 0;
  done:
@@ -137,7 +184,39 @@ device_send_get_config(clixon_handle h,
     if (netconf_output_encap(encap, cb) < 0)
         goto done;
     s = device_handle_socket_get(dh);
-    if (clixon_msg_send10(s, device_handle_name_get(dh), cb) < 0)
+    if (device_send_msg(dh, s, cb) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Send a <get> request with an optional filter to a device
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  dh      Clixon client handle
+ * @param[in]  filter  Filter element as string, eg <filter type="xpath" select="..."/>, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see device_send_get_config
+ * @see device_send_rpc
+ */
+int
+device_send_get(clixon_handle h,
+                device_handle dh,
+                char         *filter)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_PLUGIN, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<get>%s</get>", filter ? filter : "");
+    if (device_send_rpc(h, dh, cbuf_get(cb)) < 0)
         goto done;
     retval = 0;
  done:
@@ -186,7 +265,7 @@ device_get_schema_sendit(clixon_handle h,
     encap = device_handle_framing_type_get(dh);
     if (netconf_output_encap(encap, cb) < 0)
         goto done;
-    if (clixon_msg_send10(s, device_handle_name_get(dh), cb) < 0)
+    if (device_send_msg(dh, s, cb) < 0)
         goto done;
     clixon_debug(CLIXON_DBG_CTRL, "%s: sent get-schema(%s@%s) seq:%" PRIu64, name, identifier, version, seq);
     retval = 0;
@@ -323,7 +402,7 @@ device_send_get_schema_list(clixon_handle h,
     encap = device_handle_framing_type_get(dh);
     if (netconf_output_encap(encap, cb) < 0)
         goto done;
-    if (clixon_msg_send10(s, device_handle_name_get(dh), cb) < 0)
+    if (device_send_msg(dh, s, cb) < 0)
         goto done;
     retval = 0;
  done:
@@ -357,6 +436,110 @@ remove_subtree(cxobj *xn)
     return retval;
 }
 
+/*! Check if yang node is an ordered-by user list or leaf-list
+ */
+static int
+device_user_ordered(yang_stmt *y)
+{
+    return y != NULL &&
+        (yang_keyword_get(y) == Y_LIST || yang_keyword_get(y) == Y_LEAF_LIST) &&
+        yang_find(y, Y_ORDERED_BY, "user") != NULL;
+}
+
+/*! Add yang:insert attributes to an ordered-by user entry given its previous sibling
+ *
+ * @param[in]  x      Added list or leaf-list entry
+ * @param[in]  xprev  Previous entry of same list, or NULL if first
+ * @param[in]  cb     Work buffer
+ */
+static int
+device_edit_insert1(cxobj *x,
+                    cxobj *xprev,
+                    cbuf  *cb)
+{
+    yang_stmt *y = xml_spec(x);
+    cvec      *cvk;
+    cg_var    *cvi = NULL;
+    char      *prefix;
+    char      *v;
+
+    if (xml_add_attr(x, "insert", xprev ? "after" : "first", "yang", YANG_XML_NAMESPACE) == NULL)
+        return -1;
+    if (xprev == NULL)
+        return 0;
+    if (yang_keyword_get(y) == Y_LEAF_LIST){
+        if (xml_add_attr(x, "value", xml_body(xprev), "yang", NULL) == NULL)
+            return -1;
+        return 0;
+    }
+    /* Key predicates of previous entry, prefixed with the list module prefix */
+    prefix = yang_find_myprefix(y);
+    cbuf_reset(cb);
+    cvk = yang_cvec_get(y);
+    while ((cvi = cvec_each(cvk, cvi)) != NULL){
+        v = xml_find_body(xprev, cv_string_get(cvi));
+        cprintf(cb, "[%s:%s=%s%s%s]", prefix, cv_string_get(cvi),
+                v && strchr(v, '\'') ? "\"" : "'", v ? v : "",
+                v && strchr(v, '\'') ? "\"" : "'");
+    }
+    if (xml_add_attr(x, "key", cbuf_get(cb), "yang", NULL) == NULL)
+        return -1;
+    if (xmlns_set(x, prefix, yang_find_mynamespace(y)) < 0)
+        return -1;
+    return 0;
+}
+
+/*! Add yang:insert attributes to added entries of ordered-by user lists
+ *
+ * Positions added entries of an edit-config in the wanted tree, otherwise the device
+ * appends them last. Must be called when the entries are marked with XML_FLAG_MARK and
+ * before unmarked nodes are pruned, since the previous sibling determines the position.
+ * All marked entries of a parent are handled when the first of them is encountered.
+ * @param[in]  vec    Added nodes in the wanted tree
+ * @param[in]  len    Length of vec
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see device_create_edit_config_diff
+ */
+static int
+device_edit_insert(cxobj **vec,
+                   int     len)
+{
+    int        retval = -1;
+    cbuf      *cb = NULL;
+    cxobj     *xprev;
+    cxobj     *x;
+    yang_stmt *y;
+    int        i;
+
+    for (i=0; i<len; i++){
+        if (!device_user_ordered(xml_spec(vec[i])) ||
+            xml_find_type(vec[i], "yang", "insert", CX_ATTR) != NULL)
+            continue;
+        if (cb == NULL && (cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        xprev = NULL;
+        x = NULL;
+        while ((x = xml_child_each(xml_parent(vec[i]), x, CX_ELMNT)) != NULL){
+            y = xml_spec(x);
+            if (!device_user_ordered(y))
+                continue;
+            if (xml_flag(x, XML_FLAG_MARK) &&
+                xml_find_type(x, "yang", "insert", CX_ATTR) == NULL &&
+                device_edit_insert1(x, (xprev && xml_spec(xprev) == y) ? xprev : NULL, cb) < 0)
+                goto done;
+            xprev = x;
+        }
+    }
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
 /*! Create edit-config to a device given a diff between two XML trees x0 and x1
  *
  * 1. Add netconf operation attributes to add/del/change nodes in x0 and x1 and mark
@@ -442,6 +625,9 @@ device_create_edit_config_diff(clixon_handle h,
             goto done;
         xml_flag_set(xn, XML_FLAG_MARK);
     }
+    /* Position added entries of ordered-by user lists */
+    if (device_edit_insert(avec, alen) < 0)
+        goto done;
     /* 2. Remove all unmarked nodes, ie unchanged nodes */
     if (xml_tree_prune_flagged_sub(x0, XML_FLAG_MARK, 1, NULL) < 0)
         goto done;
@@ -509,12 +695,11 @@ device_create_edit_config_diff(clixon_handle h,
  *
  * @param[in]  h       Clixon handle.
  * @param[in]  dh      Clixon client handle.
- * @param[in]  s       Netconf socket
  * @param[in]  msgbody NETCONF RPC message fields (not including header)
  * @retval     0       OK
  * @retval    -1       Error
  */
-static int
+int
 device_send_rpc(clixon_handle h,
                 device_handle dh,
                 char         *msgbody)
@@ -538,7 +723,7 @@ device_send_rpc(clixon_handle h,
     encap = device_handle_framing_type_get(dh);
     if (netconf_output_encap(encap, cb) < 0)
         goto done;
-    if (clixon_msg_send10(s, device_handle_name_get(dh), cb) < 0)
+    if (device_send_msg(dh, s, cb) < 0)
         goto done;
     retval = 0;
  done:
@@ -44,8 +44,12 @@
 extern "C" {
 #endif
 
+int device_send_msg_now(device_handle dh, int s, cbuf *cb);
+int device_send_msg(device_handle dh, int s, cbuf *cb);
 int device_send_lock(clixon_handle h, device_handle dh, int lock);
 int device_send_get_config(clixon_handle h, device_handle ch, int s);
+int device_send_get(clixon_handle h, device_handle dh, char *filter);
+int device_send_rpc(clixon_handle h, device_handle dh, char *msgbody);
 int device_send_get_schema_next(clixon_handle h, device_handle dh, int s, int *nr);
 int device_send_get_schema_list(clixon_handle h, device_handle dh, int s);
 int device_create_edit_config_diff(clixon_handle h, device_handle dh,
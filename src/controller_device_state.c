@@ -72,6 +72,16 @@
 #include "controller_device_send.h"
 #include "controller_device_recv.h"
 #include "controller_transaction.h"
+#include "controller_state_cache.h"
+#include "controller_transient.h"
+#include "controller_kvstore.h"
+#include "controller_pacing.h"
+#include "controller_device_read.h"
+#include "controller_reactor.h"
+#include "controller_uring.h"
+#include "controller_msglog.h"
+#include "controller_trace.h"
+#include "controller_span.h"
 
 /*! Mapping between enum conn_state and yang connection-state
  *
@@ -94,6 +104,9 @@ static const map_str2int csmap[] = {
     {"PUSH-COMMIT-SYNC", CS_PUSH_COMMIT_SYNC},
     {"PUSH-DISCARD",     CS_PUSH_DISCARD},
     {"PUSH_UNLOCK",      CS_PUSH_UNLOCK},
+    {"DEVICE-GET",       CS_DEVICE_GET},
+    {"DEVICE-RPC",       CS_DEVICE_RPC},
+    {"DEVICE-DRIFT",     CS_DEVICE_DRIFT},
     {NULL,              -1}
 };
 
@@ -188,9 +201,17 @@ device_close_connection(device_handle dh,
         va_end(ap);
         clixon_debug(CLIXON_DBG_CTRL, "%s %s", name, str);
     }
+    /* Secondary read session follows the primary session */
+    if (device_read_close(dh, str) < 0)
+        goto done;
+    /* Drop requests queued by pacing */
+    if (controller_pacing_close(dh) < 0)
+        goto done;
     /* Handle case already closed */
     if ((s = device_handle_socket_get(dh)) != -1){
-        clixon_event_unreg_fd(s, device_input_cb); /* deregister events */
+        if (!controller_uring_recv_active())
+            controller_reactor_unreg_fd(s, device_input_cb); /* deregister events */
+        controller_uring_close(s);
         if (device_handle_disconnect(dh) < 0) /* close socket, reap sub-processes */
             goto done;
     }
@@ -215,20 +236,47 @@ device_close_connection(device_handle dh,
  * @param[in] arg  Device handle
  * @retval    0    OK
  * @retval   -1    Error
+ * @see device_input_data  Called with the data read
  */
 int
 device_input_cb(int   s,
                 void *arg)
+{
+    unsigned char buf[BUFSIZ]; /* from stdio.h, typically 8K */
+    ssize_t       len;
+    int           eof = 0;
+
+    if ((len = netconf_input_read2(s, buf, sizeof(buf), &eof)) < 0)
+        return -1;
+    return device_input_data(s, buf, len, eof, arg);
+}
+
+/*! Handle input data from device, whole or part of a frame
+ *
+ * Called when data is read from the socket in the event loop, or received with io_uring
+ * @param[in] s    Socket
+ * @param[in] buf  Input data
+ * @param[in] len  Length of input data
+ * @param[in] eof  Socket closed by device
+ * @param[in] arg  Device handle
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see controller_uring_recv_reg
+ */
+int
+device_input_data(int            s,
+                  unsigned char *buf,
+                  size_t         len,
+                  int            eof,
+                  void          *arg)
 {
     int                     retval = -1;
     device_handle           dh = (device_handle)arg;
     clixon_handle           h;
-    unsigned char           buf[BUFSIZ]; /* from stdio.h, typically 8K */
-    ssize_t                 buflen = sizeof(buf);
     char                   *buferr=NULL; /* from stderr.h, typically 8K */
     ssize_t                 buferrlen = 1024;
+    ssize_t                 errlen;
     int                     eom = 0;
-    int                     eof = 0;
     int                     frame_state; /* only used for chunked framing not eom */
     size_t                  frame_size;
     netconf_framing_type    framing_type;
@@ -237,8 +285,7 @@ device_input_cb(int   s,
     cxobj                  *xtop = NULL;
     cxobj                  *xmsg;
     cxobj                  *xerr = NULL;
-    unsigned char          *p = buf;
-    ssize_t                 len;
+    unsigned char          *p;
     size_t                  plen;
     char                   *name;
     uint64_t                tid;
@@ -254,9 +301,7 @@ device_input_cb(int   s,
     name = device_handle_name_get(dh);
     if ((tid = device_handle_tid_get(dh)) != 0)
         ct = controller_transaction_find(h, tid);
-    /* Read input data from socket and append to cbbuf */
-    if ((len = netconf_input_read2(s, buf, buflen, &eof)) < 0)
-        goto done;
+    CONTROLLER_TRACE2(frame_read, name, len);
     if (eof){
         if ((sockerr = device_handle_sockerr_get(dh)) != -1){
             if ((buferr = malloc(buferrlen)) == NULL){
@@ -268,14 +313,14 @@ device_input_cb(int   s,
                 strncpy(buferr, "ssh sub-process killed", buferrlen);
             }
             else {
-                if ((len = read(sockerr, buferr, buferrlen-1)) < 0){ // XXX hangs on SIGCHLD?
+                if ((errlen = read(sockerr, buferr, buferrlen-1)) < 0){ // XXX hangs on SIGCHLD?
                     free(buferr);
                     buferr = NULL;
                 }
                 /* Special case for removing CR at end of stderr string */
-                while (len>0 && (buferr[len-1] == '\r' || buferr[len-1] == '\n')) {
-                    buferr[len - 1] = '\0';
-                    len--;
+                while (errlen>0 && (buferr[errlen-1] == '\r' || buferr[errlen-1] == '\n')) {
+                    buferr[errlen - 1] = '\0';
+                    errlen--;
                 }
             }
         }
@@ -309,7 +354,10 @@ device_input_cb(int   s,
             /* Extra data to read, save data and continue on next round */
             break;
         }
+        CONTROLLER_TRACE2(frame_complete, name, cbuf_len(cbmsg));
         clixon_debug(CLIXON_DBG_MSG, "Recv [%s]: %s", name, cbuf_get(cbmsg));
+        if (controller_msglog(dh, 'R', cbuf_get(cbmsg), cbuf_len(cbmsg)) < 0)
+            goto done;
         if ((ret = netconf_input_frame2(cbmsg, YB_NONE, NULL, &xtop, &xerr)) < 0)
             goto done;
         cbuf_reset(cbmsg);
@@ -330,6 +378,10 @@ device_input_cb(int   s,
             goto ok;
         }
         xmsg = xml_child_i_type(xtop, 0, CX_ELMNT);
+        /* A reply frees a paced request, queued requests are sent before any new */
+        if (xmsg && strcmp(xml_name(xmsg), "rpc-reply") == 0 &&
+            controller_pacing_reply(dh) < 0)
+            goto done;
         if (xmsg && device_state_handler(h, dh, s, xmsg) < 0)
             goto done;
     } /* while */
@@ -350,6 +402,57 @@ device_input_cb(int   s,
     return retval;
 }
 
+/*! A queued write to a device socket failed, called from the event loop
+ *
+ * Closes the device, or its read session, as a read of a closed socket would
+ * @param[in] s    Socket
+ * @param[in] err  Errno of write
+ * @param[in] arg  Device handle
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see controller_uring_send
+ */
+int
+device_output_error_cb(int   s,
+                       int   err,
+                       void *arg)
+{
+    int                     retval = -1;
+    device_handle           dh = (device_handle)arg;
+    clixon_handle           h;
+    controller_transaction *ct = NULL;
+    uint64_t                tid;
+    char                   *name;
+    cbuf                   *cb = NULL;
+
+    h = device_handle_handle_get(dh);
+    name = device_handle_name_get(dh);
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "Write to device failed: %s", strerror(err));
+    if (s != device_handle_socket_get(dh)){
+        if (device_read_close(dh, cbuf_get(cb)) < 0)
+            goto done;
+        goto ok;
+    }
+    if ((tid = device_handle_tid_get(dh)) != 0)
+        ct = controller_transaction_find(h, tid);
+    if (ct){
+        if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_CLOSE, name, cbuf_get(cb)) < 0)
+            goto done;
+    }
+    else if (device_close_connection(dh, "%s", cbuf_get(cb)) < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
 /*! Given devicename and XML tree, create XML tree and device mount-point
  *
  * @param[in]  devicename Name of device
@@ -516,6 +619,8 @@ device_schemas_local_check(clixon_handle h,
 
 /*! Timeout callback of transient states, close connection
  *
+ * A read or rpc of a get-device-state, device-rpc or drift-scan transaction fails
+ * without closing the device. The late reply, if any, is dropped.
  * @param[in] arg    In effect client handle
  * @retval    0      OK
  * @retval   -1      Error
@@ -530,6 +635,7 @@ device_state_timeout(int   s,
     controller_transaction *ct = NULL;
     clixon_handle           h;
     char                   *name;
+    conn_state              state;
 
     name = device_handle_name_get(dh);
     clixon_debug(CLIXON_DBG_CTRL, "%s", name);
@@ -537,7 +643,16 @@ device_state_timeout(int   s,
 
     if ((tid = device_handle_tid_get(dh)) != 0)
         ct = controller_transaction_find(h, tid);
-    if (ct){
+    state = device_handle_conn_state_get(dh);
+    if (ct && ct->ct_get &&
+        (state == CS_DEVICE_GET || state == CS_DEVICE_RPC || state == CS_DEVICE_DRIFT)){
+        device_handle_stale_id_set(dh, device_handle_msg_id_get(dh) - 1);
+        if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, "Timeout waiting for remote peer") < 0)
+            goto done;
+        if (device_state_set(dh, CS_OPEN) < 0)
+            goto done;
+    }
+    else if (ct){
         if (controller_transaction_failed(device_handle_handle_get(dh), tid, ct, dh, TR_FAILED_DEV_CLOSE, name, "Timeout waiting for remote peer") < 0)
             goto done;
     }
@@ -564,11 +679,18 @@ device_state_timeout_register(device_handle dh)
     clixon_handle  h;
     cbuf          *cb = NULL;
     char                   *name;
+    uint64_t       tid;
+    controller_transaction *ct;
 
     name = device_handle_name_get(dh);
     gettimeofday(&t, NULL);
     h = device_handle_handle_get(dh);
     d = clicon_data_int_get(h, "controller-device-timeout");
+    /* Transaction may override device timeout */
+    if ((tid = device_handle_tid_get(dh)) != 0 &&
+        (ct = controller_transaction_find(h, tid)) != NULL &&
+        ct->ct_timeout != 0)
+        d = ct->ct_timeout;
     if (d != -1)
         t1.tv_sec = d;
     else
@@ -638,11 +760,25 @@ int
 device_state_set(device_handle dh,
                  conn_state    state)
 {
-    int        retval = -1;
-    conn_state state0;
+    int                     retval = -1;
+    conn_state              state0;
+    uint64_t                tid;
+    controller_transaction *ct;
+    struct timeval          t0;
 
     /* From state handling */
     state0 = device_handle_conn_state_get(dh);
+    CONTROLLER_TRACE3(device_state, device_handle_name_get(dh), state0, state);
+    /* Trace span of device request in transaction */
+    if (state0 != CS_CLOSED && state0 != CS_OPEN &&
+        (tid = device_handle_tid_get(dh)) != 0 &&
+        (ct = controller_transaction_find(device_handle_handle_get(dh), tid)) != NULL &&
+        ct->ct_spans != NULL){
+        device_handle_conn_time_get(dh, &t0);
+        controller_span_add(ct, device_state_int2str(state0), &t0,
+                            device_handle_name_get(dh),
+                            state == CS_CLOSED ? "Device closed" : NULL);
+    }
     if (state0 != CS_CLOSED && state0 != CS_OPEN){
         if (device_state_timeout_unregister(dh) < 0)
             goto done;
@@ -676,9 +812,10 @@ device_config_write(clixon_handle h,
                     cxobj        *xdata,
                     cbuf         *cbret)
 {
-    int    retval = -1;
-    cbuf  *cb = NULL;
-    char  *db;
+    int           retval = -1;
+    cbuf         *cb = NULL;
+    char         *db;
+    device_handle dh;
 
     if (devname == NULL || config_type == NULL){
         clixon_err(OE_UNIX, EINVAL, "devname or config_type is NULL");
@@ -688,12 +825,29 @@ device_config_write(clixon_handle h,
         clixon_err(OE_UNIX, errno, "cbuf_new");
         goto done;
     }
-    cprintf(cb, "device-%s-%s", devname, config_type);
-    db = cbuf_get(cb);
-    if (xmldb_db_reset(h, db) < 0)
+    CONTROLLER_TRACE2(config_write_start, devname, config_type);
+    /* Transient configs are kept in memory, see controller_transient.c */
+    if (strcmp(config_type, "TRANSIENT") == 0 &&
+        (retval = controller_transient_put(h, devname, xdata)) != 0)
         goto done;
-    retval = xmldb_put(h, db, OP_REPLACE, xdata, clicon_username_get(h), cbret);
+    if (controller_kvstore_active()){
+        if (controller_kvstore_config_write(h, devname, config_type, xdata) < 0)
+            goto done;
+        retval = 1;
+    }
+    else {
+        cprintf(cb, "device-%s-%s", devname, config_type);
+        db = cbuf_get(cb);
+        if (xmldb_db_reset(h, db) < 0)
+            goto done;
+        retval = xmldb_put(h, db, OP_REPLACE, xdata, clicon_username_get(h), cbret);
+    }
+    /* Invalidate cached digest of last synced config */
+    if (strcmp(config_type, "SYNCED") == 0 &&
+        (dh = device_handle_find(h, devname)) != NULL)
+        device_handle_synced_digest_set(dh, 0);
  done:
+    CONTROLLER_TRACE3(config_write_done, devname, config_type, retval);
     if (cb)
         cbuf_free(cb);
     return retval;
@@ -732,11 +886,22 @@ device_config_read(clixon_handle h,
         clixon_err(OE_UNIX, errno, "cbuf_new");
         goto done;
     }
-    cprintf(cb, "device-%s-%s", devname, config_type);
-    db = cbuf_get(cb);
-    if (xmldb_get0(h, db, YB_MODULE, nsc, NULL, 1, WITHDEFAULTS_EXPLICIT, &xt, NULL, NULL) < 0)
+    CONTROLLER_TRACE2(config_read_start, devname, config_type);
+    if (strcmp(config_type, "TRANSIENT") == 0 &&
+        (retval = controller_transient_get(h, devname, xdatap)) != 0)
         goto done;
-    if ((xroot = xpath_first(xt, NULL, "devices/device/config")) == NULL){
+    if (controller_kvstore_active()){
+        if (controller_kvstore_config_read(h, devname, config_type, &xt) < 0)
+            goto done;
+    }
+    else {
+        cprintf(cb, "device-%s-%s", devname, config_type);
+        db = cbuf_get(cb);
+        if (xmldb_get0(h, db, YB_MODULE, nsc, NULL, 1, WITHDEFAULTS_EXPLICIT, &xt, NULL, NULL) < 0)
+            goto done;
+    }
+    if (xt == NULL ||
+        (xroot = xpath_first(xt, NULL, "devices/device/config")) == NULL){
         if ((*cberr = cbuf_new()) == NULL){
             clixon_err(OE_UNIX, errno, "cbuf_new");
             goto done;
@@ -750,6 +915,7 @@ device_config_read(clixon_handle h,
     }
     retval = 1;
  done:
+    CONTROLLER_TRACE3(config_read_done, devname, config_type, retval);
     if (xt)
         xml_free(xt);
     if (cb)
@@ -783,6 +949,8 @@ device_config_copy(clixon_handle h,
         clixon_err(OE_UNIX, EINVAL, "devname, from or to is NULL");
         goto done;
     }
+    if (controller_kvstore_active())
+        return controller_kvstore_config_copy(devname, from, to);
     if ((db0 = cbuf_new()) == NULL){
         clixon_err(OE_UNIX, errno, "cbuf_new");
         goto done;
@@ -804,6 +972,51 @@ device_config_copy(clixon_handle h,
     return retval;
 }
 
+/*! Get digest of last synced device config
+ *
+ * Computed from the SYNCED datastore on demand and cached in the device handle until
+ * the SYNCED datastore is written.
+ * @param[in]  h      Clixon handle
+ * @param[in]  dh     Device handle
+ * @param[out] digest Digest of synced config
+ * @retval     1      OK
+ * @retval     0      No synced config
+ * @retval    -1      Error
+ * @see controller_config_digest
+ */
+int
+device_config_synced_digest(clixon_handle h,
+                            device_handle dh,
+                            uint64_t     *digest)
+{
+    int      retval = -1;
+    cxobj   *xroot = NULL;
+    cbuf    *cberr = NULL;
+    uint64_t d;
+    int      ret;
+
+    if ((d = device_handle_synced_digest_get(dh)) == 0){
+        if ((ret = device_config_read(h, device_handle_name_get(dh), "SYNCED", &xroot, &cberr)) < 0)
+            goto done;
+        if (ret == 0)
+            goto nosync;
+        if (controller_config_digest(xroot, &d) < 0)
+            goto done;
+        device_handle_synced_digest_set(dh, d);
+    }
+    *digest = d;
+    retval = 1;
+ done:
+    if (cberr)
+        cbuf_free(cberr);
+    if (xroot)
+        xml_free(xroot);
+    return retval;
+ nosync:
+    retval = 0;
+    goto done;
+}
+
 /*! Compare transient and last synced
  *
  * @param[in]  h      Clixon handle.
@@ -844,8 +1057,15 @@ device_config_compare(clixon_handle           h,
             clixon_err(OE_UNIX, errno, "cbuf_new");
             goto done;
         }
-        cprintf(*cberr0, "Device %s has changed config. See: diff device-%s-SYNCED_db device-%s-TRANSIENT_db",
-                name, name, name);
+        /* Referred to in the message */
+        if (controller_transient_persist(h, name) < 0)
+            goto done;
+        if (controller_kvstore_active())    /* No datastore files to diff */
+            cprintf(*cberr0, "Device %s has changed config. See: datastore-diff devname %s config-type1 SYNCED config-type2 TRANSIENT",
+                    name, name);
+        else
+            cprintf(*cberr0, "Device %s has changed config. See: diff device-%s-SYNCED_db device-%s-TRANSIENT_db",
+                    name, name, name);
          retval = 1;
     }
     else
@@ -863,6 +1083,44 @@ device_config_compare(clixon_handle           h,
     goto done;
 }
 
+/*! Text diff between last synced and transient device config
+ *
+ * @param[in]  h      Clixon handle
+ * @param[in]  name   Device name
+ * @param[out] cb     Diff in text form, empty if equal
+ * @retval     1      OK
+ * @retval     0      No synced or transient config
+ * @retval    -1      Error
+ * @see device_config_compare
+ */
+static int
+device_config_diff_transient(clixon_handle h,
+                             char         *name,
+                             cbuf         *cb)
+{
+    int    retval = -1;
+    cxobj *x0 = NULL;
+    cxobj *x1 = NULL;
+    cbuf  *cberr = NULL;
+    int    ret;
+
+    if ((ret = device_config_read(h, name, "SYNCED", &x0, &cberr)) < 0)
+        goto done;
+    if (ret && (ret = device_config_read(h, name, "TRANSIENT", &x1, &cberr)) < 0)
+        goto done;
+    if (ret && clixon_text_diff2cbuf(cb, x0, x1) < 0)
+        goto done;
+    retval = ret;
+ done:
+    if (cberr)
+        cbuf_free(cberr);
+    if (x0)
+        xml_free(x0);
+    if (x1)
+        xml_free(x1);
+    return retval;
+}
+
 /*! Check if there is another equivalent xyanglib and if so reuse that yspec
  *
  * Prereq: schema-list (xyanglib) is completely known.
@@ -1074,6 +1332,46 @@ device_commit_when_done(clixon_handle           h,
     goto done;
 }
 
+/*! Check if pulled device configs should be committed before all devices are done
+ *
+ * Progressive commit of a pull: every CONTROLLER_PULL_BATCH_SIZE devices or, checked when
+ * a device config is received, CONTROLLER_PULL_BATCH_INTERVAL seconds after the previous
+ * batch. Pulled configs are then visible in running early and the changes in tmpdev are
+ * bounded.
+ * Committed batches are kept if a later device fails. The transaction result is then
+ * failed, and the devices pulled successfully since the last batch are committed when the
+ * transaction ends, see controller_transaction_pull_flush.
+ * @param[in]  h     Clixon handle
+ * @param[in]  ct    Pull transaction
+ * @retval     1     Commit batch now
+ * @retval     0     Not yet
+ */
+static int
+device_pull_batch_due(clixon_handle           h,
+                      controller_transaction *ct)
+{
+    int            size;
+    int            interval;
+    struct timeval now;
+    struct timeval td;
+
+    gettimeofday(&now, NULL);
+    if (ct->ct_pull_batch_time.tv_sec == 0)
+        ct->ct_pull_batch_time = now;
+    ct->ct_pull_batch_nr++;
+    size = clicon_option_int(h, "CONTROLLER_PULL_BATCH_SIZE");
+    interval = clicon_option_int(h, "CONTROLLER_PULL_BATCH_INTERVAL");
+    timersub(&now, &ct->ct_pull_batch_time, &td);
+    if ((size > 0 && ct->ct_pull_batch_nr >= (uint32_t)size) ||
+        (interval > 0 && td.tv_sec >= interval)){
+        clixon_debug(CLIXON_DBG_CTRL, "pull batch of %u devices", ct->ct_pull_batch_nr);
+        ct->ct_pull_batch_nr = 0;
+        ct->ct_pull_batch_time = now;
+        return 1;
+    }
+    return 0;
+}
+
 /*! Main state machine for controller transactions+devices
  *
  * @param[in]  h     Clixon handle
@@ -1103,6 +1401,14 @@ device_state_handler(clixon_handle h,
     cbuf       *cberr = NULL;
     cbuf       *cbmsg;
     cxobj      *xyanglib;
+    cxobj      *xdata = NULL;
+    cxobj      *x;
+    cbuf       *cbdata = NULL;
+    uint64_t    digest = 0;
+    uint64_t    synced = 0;
+    uint64_t    stale;
+    uint64_t    msgid = 0;
+    char       *str;
 
     rpcname = xml_name(xmsg);
     conn_state = device_handle_conn_state_get(dh);
@@ -1111,6 +1417,16 @@ device_state_handler(clixon_handle h,
     yspec0 = clicon_dbspec_yang(h);
     if ((tid = device_handle_tid_get(dh)) != 0)
         ct = controller_transaction_find(h, tid);
+    /* Late reply of a request that has timed out, see device_state_timeout */
+    if ((stale = device_handle_stale_id_get(dh)) != 0 &&
+        strcmp(rpcname, "rpc-reply") == 0 &&
+        (str = xml_find_type_value(xmsg, NULL, "message-id", CX_ATTR)) != NULL &&
+        parse_uint64(str, &msgid, NULL) == 1 &&
+        msgid == stale){
+        clixon_debug(CLIXON_DBG_CTRL, "%s: Dropped late reply message-id %" PRIu64, name, msgid);
+        device_handle_stale_id_set(dh, 0);
+        goto ok;
+    }
     switch (conn_state){
         /* Here starts states of OPEN transaction */
     case CS_CONNECTING:
@@ -1331,6 +1647,15 @@ device_state_handler(clixon_handle h,
                 break;
             xmldb_delete(h, "tmpdev");
         }
+        else if (!ct->ct_pull_transient &&
+                 device_pull_batch_due(h, ct)){
+            /* Progressive commit of devices pulled so far. After the commit running is
+             * equal to tmpdev, so the next batch continues on tmpdev without a copy */
+            if ((ret = device_commit_when_done(h, dh, ct, "tmpdev")) < 0)
+                goto done;
+            if (ret == 0)
+                break;
+        }
         /* The device is OK */
         if (device_state_check_ok(h, dh, ct) < 0)
             goto done;
@@ -1402,13 +1727,13 @@ device_state_handler(clixon_handle h,
                     goto done;
                 break;
             }
-            if (clixon_msg_send10(s, device_handle_name_get(dh), cbmsg) < 0)
+            if (device_send_msg(dh, s, cbmsg) < 0)
                 goto done;
             if (device_state_set(dh, CS_PUSH_EDIT2) < 0)
                 goto done;
             break;
         }
-        if (clixon_msg_send10(s, device_handle_name_get(dh), cbmsg) < 0)
+        if (device_send_msg(dh, s, cbmsg) < 0)
             goto done;
         if (device_state_set(dh, CS_PUSH_EDIT) < 0)
             goto done;
@@ -1449,7 +1774,7 @@ device_state_handler(clixon_handle h,
                 goto done;
             break;
         }
-        if (clixon_msg_send10(s, device_handle_name_get(dh), cbmsg) < 0)
+        if (device_send_msg(dh, s, cbmsg) < 0)
             goto done;
         if (device_state_set(dh, CS_PUSH_EDIT2) < 0)
             goto done;
@@ -1726,6 +2051,137 @@ device_state_handler(clixon_handle h,
         if (device_state_check_ok(h, dh, ct) < 0)
             goto done;
         break;
+    case CS_DEVICE_GET:
+        if (device_state_check_sanity(dh, tid, ct, name, conn_state, rpcname) == 0)
+            break;
+        /* Retval: 2 OK, 1 Closed, 0 Failed, -1 Error */
+        if ((ret = device_state_recv_data(h, dh, xmsg, rpcname, conn_state, &xdata, &cberr)) < 0)
+            goto done;
+        if (ret == 0){      /* 1. The device has failed: received rpc-error, keep it open */
+            if (device_state_set(dh, CS_OPEN) < 0)
+                goto done;
+            if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, cbuf_get(cberr)) < 0)
+                goto done;
+            break;
+        }
+        else if (ret == 1){ /* 1. The device has failed and is closed */
+            if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, device_handle_logmsg_get(dh)) < 0)
+                goto done;
+            break;
+        }
+        /* A reply without <data> is not cached */
+        if (xdata != NULL){
+            if ((cbdata = cbuf_new()) == NULL){
+                clixon_err(OE_UNIX, errno, "cbuf_new");
+                goto done;
+            }
+            x = NULL;
+            while ((x = xml_child_each(xdata, x, CX_ELMNT)) != NULL){
+                if (clixon_xml2cbuf(cbdata, x, 0, 0, NULL, -1, 0) < 0)
+                    goto done;
+            }
+            if (controller_state_cache_put(h, name, ct->ct_get_filter, cbuf_get(cbdata)) < 0)
+                goto done;
+        }
+        if (controller_transaction_get_reply(h, ct, dh, cbdata?cbuf_get(cbdata):NULL, NULL) < 0)
+            goto done;
+        /* Other transactions waiting for the same get */
+        if (controller_transaction_get_shared(h, dh, ct->ct_get_filter,
+                                              cbdata?cbuf_get(cbdata):NULL, NULL) < 0)
+            goto done;
+        /* The device is OK */
+        if (device_state_check_ok(h, dh, ct) < 0)
+            goto done;
+        /* Send get to next waiting device, if any */
+        if (ct->ct_state != TS_DONE &&
+            controller_transaction_get_dispatch(h, ct) < 0)
+            goto done;
+        break;
+    case CS_DEVICE_RPC:
+        if (device_state_check_sanity(dh, tid, ct, name, conn_state, rpcname) == 0)
+            break;
+        /* Retval: 2 OK, 1 Closed, 0 Failed, -1 Error */
+        if ((ret = device_state_recv_data(h, dh, xmsg, rpcname, conn_state, NULL, &cberr)) < 0)
+            goto done;
+        if (ret == 0){      /* 1. The device has failed: received rpc-error, keep it open
+                             * Fail before leaving DEVICE-RPC state to record reply time */
+            if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, cbuf_get(cberr)) < 0)
+                goto done;
+            if (device_state_set(dh, CS_OPEN) < 0)
+                goto done;
+            break;
+        }
+        else if (ret == 1){ /* 1. The device has failed and is closed */
+            if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, device_handle_logmsg_get(dh)) < 0)
+                goto done;
+            break;
+        }
+        /* Reply is the content of rpc-reply, eg <ok/> or output parameters */
+        if ((cbdata = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        x = NULL;
+        while ((x = xml_child_each(xmsg, x, CX_ELMNT)) != NULL){
+            if (strcmp(xml_name(x), "rpc-error") == 0)
+                continue;
+            if (clixon_xml2cbuf(cbdata, x, 0, 0, NULL, -1, 0) < 0)
+                goto done;
+        }
+        if (controller_transaction_get_reply(h, ct, dh, cbuf_get(cbdata), NULL) < 0)
+            goto done;
+        /* The device is OK */
+        if (device_state_check_ok(h, dh, ct) < 0)
+            goto done;
+        /* Send rpc to next waiting device, if any */
+        if (ct->ct_state != TS_DONE &&
+            controller_transaction_get_dispatch(h, ct) < 0)
+            goto done;
+        break;
+    case CS_DEVICE_DRIFT:
+        if (device_state_check_sanity(dh, tid, ct, name, conn_state, rpcname) == 0)
+            break;
+        /* Compute digest of device config as received, do not store it */
+        if ((ret = device_state_recv_digest(h, dh, xmsg, rpcname, conn_state, &digest)) < 0)
+            goto done;
+        if (ret == 0){ /* closed */
+            if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, device_handle_logmsg_get(dh)) < 0)
+                goto done;
+            break;
+        }
+        /* 0: No synced config, 1: digest of last synced config */
+        if ((ret = device_config_synced_digest(h, dh, &synced)) < 0)
+            goto done;
+        ct->ct_drift_nr++;
+        if (ret == 0 || digest != synced){
+            ct->ct_drift_drifted++;
+            /* Diff on demand: store as transient and compare with synced */
+            if (ret == 1 && ct->ct_drift_diff){
+                if ((ret = device_state_recv_config(h, dh, xmsg, yspec0, rpcname, conn_state, 1, 0)) < 0)
+                    goto done;
+                if (ret == 0){ /* closed */
+                    if (controller_transaction_failed(h, tid, ct, dh, TR_FAILED_DEV_LEAVE, name, device_handle_logmsg_get(dh)) < 0)
+                        goto done;
+                    break;
+                }
+                if ((cbdata = cbuf_new()) == NULL){
+                    clixon_err(OE_UNIX, errno, "cbuf_new");
+                    goto done;
+                }
+                if (device_config_diff_transient(h, name, cbdata) < 0)
+                    goto done;
+            }
+            if (controller_transaction_get_reply(h, ct, dh, cbdata?cbuf_get(cbdata):NULL, NULL) < 0)
+                goto done;
+        }
+        /* The device is OK */
+        if (device_state_check_ok(h, dh, ct) < 0)
+            goto done;
+        /* Send get-config to next waiting device, if any */
+        if (ct->ct_state != TS_DONE &&
+            controller_transaction_get_dispatch(h, ct) < 0)
+            goto done;
+        break;
     case CS_PUSH_WAIT:
     case CS_CLOSED:
     case CS_OPEN:
@@ -1740,11 +2196,14 @@ device_state_handler(clixon_handle h,
             goto done;
         break;
     }
+ ok:
     retval = 0;
  done:
     clixon_debug(CLIXON_DBG_CTRL|CLIXON_DBG_DETAIL, "retval:%d", retval);
     if (cberr)
         cbuf_free(cberr);
+    if (cbdata)
+        cbuf_free(cbdata);
     return retval;
 }
 
@@ -1811,6 +2270,9 @@ devices_statedata(clixon_handle   h,
                 goto done;
             cprintf(cb, "<sync-timestamp>%s</sync-timestamp>", timestr);
         }
+        if (device_handle_read_requests_get(dh) != 0)
+            cprintf(cb, "<read-session-requests>%" PRIu64 "</read-session-requests>",
+                    device_handle_read_requests_get(dh));
         if ((logmsg = device_handle_logmsg_get(dh)) != NULL){
             cprintf(cb, "<logmsg>");
             xml_chardata_cbuf_append(cb, 0, logmsg);
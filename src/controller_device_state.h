@@ -86,6 +86,9 @@ enum conn_state_t {
                      controller (only used if CONTROLLER_EXTRA_PUSH_SYNC */
     CS_PUSH_DISCARD,  /* discard sent, waiting for reply ok */
     CS_PUSH_UNLOCK,   /* Unlock device candidate */
+    CS_DEVICE_GET,    /* get-device-state: get sent, waiting for reply */
+    CS_DEVICE_RPC,    /* device-rpc: rpc sent, waiting for reply */
+    CS_DEVICE_DRIFT,  /* drift-scan: get-config sent, waiting for reply */
 };
 typedef enum conn_state_t conn_state;
 
@@ -115,6 +118,8 @@ conn_state   device_state_str2int(char *str);
 yang_config_t  yang_config_str2int(char *str);
 int          device_close_connection(device_handle ch, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 int          device_input_cb(int s, void *arg);
+int          device_input_data(int s, unsigned char *buf, size_t len, int eof, void *arg);
+int          device_output_error_cb(int s, int err, void *arg);
 int          device_send_get_config(clixon_handle h, device_handle ch, int s);
 int          device_state_mount_point_get(char *devicename, yang_stmt *yspec,
                                           cxobj **xtp, cxobj **xrootp);
@@ -123,6 +128,7 @@ int          device_state_timeout_unregister(device_handle ch);
 int          device_state_set(device_handle dh, conn_state state);
 int          device_config_read(clixon_handle h, char *devname, char *config_type, cxobj **xrootp, cbuf **cberr);
 int          device_config_write(clixon_handle h, char *name, char *config_type, cxobj *xdata, cbuf *cbret);
+int          device_config_synced_digest(clixon_handle h, device_handle dh, uint64_t *digest);
 int          device_state_handler(clixon_handle h, device_handle ch, int s, cxobj *xmsg);
 int          devices_statedata(clixon_handle h, cvec *nsc, char *xpath, cxobj *xstate);
 
@@ -0,0 +1,950 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Embedded key-value store of per-device configs
+  * If built with CONTROLLER_LMDB (configure --with-lmdb) and CONTROLLER_DEVICE_STORE is set,
+  * the device-<name>-<type> configs, eg SYNCED and spilled TRANSIENT configs, are kept in a
+  * single LMDB file instead of in one datastore file per device and type.
+  * Keys are <type>/<devname>, values are the device config children serialized as XML.
+  * Each update is one LMDB write transaction, several updates may be grouped with
+  * controller_kvstore_begin/commit. Enumeration is a cursor walk over a key prefix.
+  * Commits are synced to disk, group updates to amortize the cost.
+  * The map is grown when full, a grouped transaction is then replayed in a larger map.
+  * Existing device-<name>-SYNCED datastores are imported the first time the store is used.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <dirent.h>
+#ifdef CONTROLLER_LMDB
+#include <lmdb.h>
+#endif
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_kvstore.h"
+
+#ifdef CONTROLLER_LMDB
+/*! Initial map size, the file is sparse and grows with the data
+ */
+#define KVSTORE_MAPSIZE_INIT (1ULL << 30)
+
+/*! Update in an ongoing begin/commit transaction, kept to be replayed if the map is grown
+ */
+typedef struct kvstore_op {
+    struct kvstore_op *ko_next;
+    char              *ko_key;
+    char              *ko_val;   /* Value, or NULL to delete */
+    size_t             ko_vlen;
+} kvstore_op;
+
+static MDB_env    *_kv_env = NULL;     /* Open environment, or NULL */
+static MDB_dbi     _kv_dbi;            /* Main database */
+static MDB_txn    *_kv_txn = NULL;     /* Ongoing write transaction of begin/commit */
+static kvstore_op *_kv_ops = NULL;     /* Updates of ongoing transaction, in order */
+static kvstore_op *_kv_opslast = NULL; /* Last of _kv_ops */
+#endif /* CONTROLLER_LMDB */
+static size_t      _kv_mapsize = 0;    /* Current map size, or initial if not open */
+
+#ifdef CONTROLLER_LMDB
+/*! Double the map size, only when no transaction is ongoing
+ */
+static int
+kvstore_grow(void)
+{
+    int ret;
+
+    if ((ret = mdb_env_set_mapsize(_kv_env, _kv_mapsize * 2)) != 0){
+        clixon_err(OE_DB, 0, "mdb_env_set_mapsize: %s", mdb_strerror(ret));
+        return -1;
+    }
+    _kv_mapsize *= 2;
+    clixon_debug(CLIXON_DBG_CTRL, "Device store map size %zu", _kv_mapsize);
+    return 0;
+}
+
+/*! Put or delete one key in a write transaction
+ *
+ * @retval     0     OK, also if a deleted key does not exist
+ * @retval    !0     LMDB error code
+ */
+static int
+kvstore_txn_update(MDB_txn    *txn,
+                   const char *key,
+                   const char *val,
+                   size_t      vlen)
+{
+    MDB_val k;
+    MDB_val v;
+    int     ret;
+
+    k.mv_data = (void*)key;
+    k.mv_size = strlen(key);
+    v.mv_data = (void*)val;
+    v.mv_size = vlen;
+    if (val != NULL)
+        ret = mdb_put(txn, _kv_dbi, &k, &v, 0);
+    else if ((ret = mdb_del(txn, _kv_dbi, &k, NULL)) == MDB_NOTFOUND)
+        ret = 0;
+    return ret;
+}
+
+/*! Free updates of ongoing transaction
+ */
+static void
+kvstore_ops_free(void)
+{
+    kvstore_op *ko;
+
+    while ((ko = _kv_ops) != NULL){
+        _kv_ops = ko->ko_next;
+        free(ko->ko_key);
+        if (ko->ko_val)
+            free(ko->ko_val);
+        free(ko);
+    }
+    _kv_opslast = NULL;
+}
+
+/*! Append an update of the ongoing transaction
+ */
+static int
+kvstore_ops_add(const char *key,
+                const char *val,
+                size_t      vlen)
+{
+    kvstore_op *ko;
+
+    if ((ko = calloc(1, sizeof(*ko))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        return -1;
+    }
+    if ((ko->ko_key = strdup(key)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        free(ko);
+        return -1;
+    }
+    if (val != NULL){
+        if ((ko->ko_val = malloc(vlen?vlen:1)) == NULL){
+            clixon_err(OE_UNIX, errno, "malloc");
+            free(ko->ko_key);
+            free(ko);
+            return -1;
+        }
+        memcpy(ko->ko_val, val, vlen);
+        ko->ko_vlen = vlen;
+    }
+    if (_kv_opslast)
+        _kv_opslast->ko_next = ko;
+    else
+        _kv_ops = ko;
+    _kv_opslast = ko;
+    return 0;
+}
+
+/*! Map is full in ongoing transaction: grow map and redo the updates so far in a new transaction
+ *
+ * The map size can only be changed with no transaction ongoing. The failed transaction,
+ * if not already ended by a failed commit, is aborted.
+ * @retval     0     OK, _kv_txn is a new transaction with all updates of _kv_ops
+ * @retval    -1     Error, no transaction ongoing
+ */
+static int
+kvstore_replay(void)
+{
+    kvstore_op *ko;
+    int         ret;
+
+    if (_kv_txn){
+        mdb_txn_abort(_kv_txn);
+        _kv_txn = NULL;
+    }
+    do {
+        if (kvstore_grow() < 0)
+            goto err;
+        if ((ret = mdb_txn_begin(_kv_env, NULL, 0, &_kv_txn)) != 0){
+            _kv_txn = NULL;
+            clixon_err(OE_DB, 0, "mdb_txn_begin: %s", mdb_strerror(ret));
+            goto err;
+        }
+        for (ko = _kv_ops; ko != NULL; ko = ko->ko_next)
+            if ((ret = kvstore_txn_update(_kv_txn, ko->ko_key, ko->ko_val, ko->ko_vlen)) != 0)
+                break;
+        if (ret != 0){
+            mdb_txn_abort(_kv_txn);
+            _kv_txn = NULL;
+            if (ret != MDB_MAP_FULL){
+                clixon_err(OE_DB, 0, "Device store replay: %s", mdb_strerror(ret));
+                goto err;
+            }
+        }
+    } while (ret != 0);
+    return 0;
+ err:
+    kvstore_ops_free();
+    return -1;
+}
+
+/*! Put or delete one key in a write transaction
+ *
+ * Uses the ongoing transaction of controller_kvstore_begin if any, else one of its own.
+ * If the map is full, it is grown and the update is retried
+ * @param[in]  key   Key
+ * @param[in]  val   Value, or NULL to delete
+ * @param[in]  vlen  Length of value
+ * @retval     0     OK
+ * @retval    -1    Error
+ */
+static int
+kvstore_update(const char *key,
+               const char *val,
+               size_t      vlen)
+{
+    MDB_txn *txn;
+    int      ret;
+
+    if (_kv_env == NULL){
+        clixon_err(OE_DB, EINVAL, "Device store not open");
+        return -1;
+    }
+    if (_kv_txn != NULL){
+        while ((ret = kvstore_txn_update(_kv_txn, key, val, vlen)) == MDB_MAP_FULL)
+            if (kvstore_replay() < 0)
+                return -1;
+        if (ret == 0)
+            return kvstore_ops_add(key, val, vlen);
+    }
+    else {
+        do {
+            if ((ret = mdb_txn_begin(_kv_env, NULL, 0, &txn)) != 0){
+                clixon_err(OE_DB, 0, "mdb_txn_begin: %s", mdb_strerror(ret));
+                return -1;
+            }
+            if ((ret = kvstore_txn_update(txn, key, val, vlen)) == 0)
+                ret = mdb_txn_commit(txn);
+            else
+                mdb_txn_abort(txn);
+            if (ret == MDB_MAP_FULL && kvstore_grow() < 0)
+                return -1;
+        } while (ret == MDB_MAP_FULL);
+    }
+    if (ret != 0){
+        clixon_err(OE_DB, 0, "%s %s: %s", val?"mdb_put":"mdb_del", key, mdb_strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+#endif /* CONTROLLER_LMDB */
+
+/*! Open device store
+ *
+ * Creates the file if it does not exist
+ * @param[in]  path  Filename of store
+ * @retval     0     OK
+ * @retval    -1    Error
+ */
+int
+controller_kvstore_open(const char *path)
+{
+#ifdef CONTROLLER_LMDB
+    MDB_txn    *txn = NULL;
+    MDB_envinfo info;
+    int         ret;
+
+    if (_kv_env != NULL)
+        return 0;
+    if ((ret = mdb_env_create(&_kv_env)) != 0){
+        clixon_err(OE_DB, 0, "mdb_env_create: %s", mdb_strerror(ret));
+        goto err;
+    }
+    if (_kv_mapsize == 0)
+        _kv_mapsize = KVSTORE_MAPSIZE_INIT;
+    if ((ret = mdb_env_set_mapsize(_kv_env, _kv_mapsize)) != 0){
+        clixon_err(OE_DB, 0, "mdb_env_set_mapsize: %s", mdb_strerror(ret));
+        goto err;
+    }
+    if ((ret = mdb_env_open(_kv_env, path, MDB_NOSUBDIR, 0600)) != 0){
+        clixon_err(OE_DB, 0, "mdb_env_open %s: %s", path, mdb_strerror(ret));
+        goto err;
+    }
+    /* An existing store may have a larger map */
+    if ((ret = mdb_env_info(_kv_env, &info)) != 0){
+        clixon_err(OE_DB, 0, "mdb_env_info %s: %s", path, mdb_strerror(ret));
+        goto err;
+    }
+    _kv_mapsize = info.me_mapsize;
+    if ((ret = mdb_txn_begin(_kv_env, NULL, 0, &txn)) != 0 ||
+        (ret = mdb_dbi_open(txn, NULL, 0, &_kv_dbi)) != 0 ||
+        (ret = mdb_txn_commit(txn)) != 0){
+        if (txn)
+            mdb_txn_abort(txn);
+        clixon_err(OE_DB, 0, "mdb_dbi_open %s: %s", path, mdb_strerror(ret));
+        goto err;
+    }
+    return 0;
+ err:
+    if (_kv_env){
+        mdb_env_close(_kv_env);
+        _kv_env = NULL;
+    }
+    return -1;
+#else
+    clixon_err(OE_CFG, ENOTSUP, "Device store %s requires the controller to be configured --with-lmdb", path);
+    return -1;
+#endif
+}
+
+/*! Sync and close device store
+ */
+int
+controller_kvstore_close(void)
+{
+#ifdef CONTROLLER_LMDB
+    if (_kv_env == NULL)
+        return 0;
+    if (_kv_txn){
+        mdb_txn_abort(_kv_txn);
+        _kv_txn = NULL;
+    }
+    kvstore_ops_free();
+    mdb_env_sync(_kv_env, 1);
+    mdb_env_close(_kv_env);
+    _kv_env = NULL;
+#endif
+    return 0;
+}
+
+/*! Set initial map size, before the store is opened
+ *
+ * The map is grown when full, a small initial size is mainly for testing
+ * @param[in]  size  Initial map size in bytes, 0 for default
+ */
+void
+controller_kvstore_mapsize_set(size_t size)
+{
+    _kv_mapsize = size;
+}
+
+/*! Get current map size
+ *
+ * @retval     size  Map size in bytes, or initial map size if not open
+ */
+size_t
+controller_kvstore_mapsize(void)
+{
+    return _kv_mapsize;
+}
+
+/*! Device store is open
+ *
+ * @retval     1     Open, per-device configs are in the store
+ * @retval     0     Not open, per-device configs are datastore files
+ */
+int
+controller_kvstore_active(void)
+{
+#ifdef CONTROLLER_LMDB
+    return _kv_env != NULL;
+#else
+    return 0;
+#endif
+}
+
+/*! Begin a write transaction grouping several updates
+ *
+ * @retval     0     OK
+ * @retval    -1    Error
+ * @see controller_kvstore_commit
+ */
+int
+controller_kvstore_begin(void)
+{
+#ifdef CONTROLLER_LMDB
+    int ret;
+
+    if (_kv_env == NULL || _kv_txn != NULL){
+        clixon_err(OE_DB, EINVAL, "Device store not open or transaction ongoing");
+        return -1;
+    }
+    if ((ret = mdb_txn_begin(_kv_env, NULL, 0, &_kv_txn)) != 0){
+        clixon_err(OE_DB, 0, "mdb_txn_begin: %s", mdb_strerror(ret));
+        _kv_txn = NULL;
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+/*! Commit the write transaction started by controller_kvstore_begin
+ *
+ * @param[in]  abort  Discard the updates instead
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+controller_kvstore_commit(int abort)
+{
+#ifdef CONTROLLER_LMDB
+    int ret;
+
+    if (_kv_txn == NULL)
+        return 0;
+    if (abort)
+        mdb_txn_abort(_kv_txn);
+    else {
+        /* Commit ends the transaction also if it fails */
+        while ((ret = mdb_txn_commit(_kv_txn)) == MDB_MAP_FULL){
+            _kv_txn = NULL;
+            if (kvstore_replay() < 0)
+                return -1;
+        }
+        if (ret != 0){
+            _kv_txn = NULL;
+            kvstore_ops_free();
+            clixon_err(OE_DB, 0, "mdb_txn_commit: %s", mdb_strerror(ret));
+            return -1;
+        }
+    }
+    _kv_txn = NULL;
+    kvstore_ops_free();
+#endif
+    return 0;
+}
+
+/*! Set value of a key
+ *
+ * @param[in]  key   Key
+ * @param[in]  val   Value
+ * @param[in]  vlen  Length of value
+ * @retval     0     OK
+ * @retval    -1    Error
+ */
+int
+controller_kvstore_put(const char *key,
+                       const char *val,
+                       size_t      vlen)
+{
+#ifdef CONTROLLER_LMDB
+    return kvstore_update(key, val?val:"", val?vlen:0);
+#else
+    clixon_err(OE_DB, ENOTSUP, "Device store not available");
+    return -1;
+#endif
+}
+
+/*! Delete a key
+ *
+ * @param[in]  key   Key
+ * @retval     0     OK, also if key does not exist
+ * @retval    -1    Error
+ */
+int
+controller_kvstore_del(const char *key)
+{
+#ifdef CONTROLLER_LMDB
+    return kvstore_update(key, NULL, 0);
+#else
+    clixon_err(OE_DB, ENOTSUP, "Device store not available");
+    return -1;
+#endif
+}
+
+/*! Get value of a key
+ *
+ * @param[in]  key   Key
+ * @param[out] cb    Value is appended to this buffer
+ * @retval     1     Found
+ * @retval     0     Not found
+ * @retval    -1     Error
+ */
+int
+controller_kvstore_get(const char *key,
+                       cbuf       *cb)
+{
+#ifdef CONTROLLER_LMDB
+    int      retval = -1;
+    MDB_txn *txn = NULL;
+    MDB_val  k;
+    MDB_val  v;
+    int      ret;
+
+    if (_kv_env == NULL){
+        clixon_err(OE_DB, EINVAL, "Device store not open");
+        goto done;
+    }
+    k.mv_data = (void*)key;
+    k.mv_size = strlen(key);
+    if ((txn = _kv_txn) == NULL &&
+        (ret = mdb_txn_begin(_kv_env, NULL, MDB_RDONLY, &txn)) != 0){
+        clixon_err(OE_DB, 0, "mdb_txn_begin: %s", mdb_strerror(ret));
+        txn = NULL;
+        goto done;
+    }
+    if ((ret = mdb_get(txn, _kv_dbi, &k, &v)) == MDB_NOTFOUND){
+        retval = 0;
+        goto done;
+    }
+    if (ret != 0){
+        clixon_err(OE_DB, 0, "mdb_get %s: %s", key, mdb_strerror(ret));
+        goto done;
+    }
+    /* Copy out before the transaction ends, the mapping may change */
+    if (cbuf_append_buf(cb, v.mv_data, v.mv_size) < 0){
+        clixon_err(OE_UNIX, errno, "cbuf_append_buf");
+        goto done;
+    }
+    retval = 1;
+ done:
+    if (txn && txn != _kv_txn)
+        mdb_txn_abort(txn);
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+/*! Copy value of one key to another in one transaction
+ *
+ * @param[in]  from  Source key
+ * @param[in]  to    Destination key, deleted if source does not exist
+ * @retval     0     OK
+ * @retval    -1    Error
+ */
+int
+controller_kvstore_copy(const char *from,
+                        const char *to)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+    int   ret;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if ((ret = controller_kvstore_get(from, cb)) < 0)
+        goto done;
+    if (ret == 0)
+        retval = controller_kvstore_del(to);
+    else
+        retval = controller_kvstore_put(to, cbuf_get(cb), cbuf_len(cb));
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Call a function for each key with a given prefix, in key order
+ *
+ * Values are only valid during the callback. The store may not be updated by the callback.
+ * @param[in]  prefix  Key prefix, "" for all
+ * @param[in]  fn      Callback, stops the walk if it returns other than 0
+ * @param[in]  arg     Argument to callback
+ * @retval     0       OK
+ * @retval    -1       Error, or callback returned -1
+ */
+int
+controller_kvstore_each(const char       *prefix,
+                        kvstore_each_fn_t fn,
+                        void             *arg)
+{
+#ifdef CONTROLLER_LMDB
+    int         retval = -1;
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    MDB_val     k;
+    MDB_val     v;
+    MDB_cursor_op op = MDB_SET_RANGE;
+    size_t      plen = strlen(prefix);
+    int         ret;
+    int         fret;
+
+    if (_kv_env == NULL){
+        clixon_err(OE_DB, EINVAL, "Device store not open");
+        goto done;
+    }
+    if ((txn = _kv_txn) == NULL &&
+        (ret = mdb_txn_begin(_kv_env, NULL, MDB_RDONLY, &txn)) != 0){
+        clixon_err(OE_DB, 0, "mdb_txn_begin: %s", mdb_strerror(ret));
+        txn = NULL;
+        goto done;
+    }
+    if ((ret = mdb_cursor_open(txn, _kv_dbi, &cur)) != 0){
+        clixon_err(OE_DB, 0, "mdb_cursor_open: %s", mdb_strerror(ret));
+        goto done;
+    }
+    k.mv_data = (void*)prefix;
+    k.mv_size = plen;
+    if (plen == 0)
+        op = MDB_FIRST;
+    while ((ret = mdb_cursor_get(cur, &k, &v, op)) == 0){
+        op = MDB_NEXT;
+        if (k.mv_size < plen || memcmp(k.mv_data, prefix, plen) != 0)
+            break;
+        if ((fret = fn(k.mv_data, k.mv_size, v.mv_data, v.mv_size, arg)) < 0)
+            goto done;
+        if (fret > 0)
+            break;
+    }
+    if (ret != 0 && ret != MDB_NOTFOUND){
+        clixon_err(OE_DB, 0, "mdb_cursor_get: %s", mdb_strerror(ret));
+        goto done;
+    }
+    retval = 0;
+ done:
+    if (cur)
+        mdb_cursor_close(cur);
+    if (txn && txn != _kv_txn)
+        mdb_txn_abort(txn);
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+/*! Open device store if CONTROLLER_DEVICE_STORE is set
+ *
+ * @param[in]  h     Clixon handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_kvstore_init(clixon_handle h)
+{
+    char *path;
+
+    if ((path = clicon_option_str(h, "CONTROLLER_DEVICE_STORE")) == NULL ||
+        strlen(path) == 0)
+        return 0;
+    if (controller_kvstore_open(path) < 0)
+        return -1;
+    clixon_debug(CLIXON_DBG_CTRL, "Device configs in store %s", path);
+    return 0;
+}
+
+/*! Key of a device config of a type
+ */
+static int
+kvstore_config_key(cbuf *cb,
+                   char *devname,
+                   char *config_type)
+{
+    cprintf(cb, "%s/%s", config_type, devname);
+    return 0;
+}
+
+/*! Write device config to store
+ *
+ * The device config children are stored, attributes of the config node, eg operation, are not
+ * @param[in]  h           Clixon handle
+ * @param[in]  devname     Device name
+ * @param[in]  config_type Device config type, eg SYNCED
+ * @param[in]  xt          Config on the form devices/device/config, as to device_config_write
+ * @retval     0           OK
+ * @retval    -1           Error
+ */
+int
+controller_kvstore_config_write(clixon_handle h,
+                                char         *devname,
+                                char         *config_type,
+                                cxobj        *xt)
+{
+    int    retval = -1;
+    cbuf  *cbk = NULL;
+    cbuf  *cbv = NULL;
+    cxobj *xc;
+
+    if ((cbk = cbuf_new()) == NULL ||
+        (cbv = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    kvstore_config_key(cbk, devname, config_type);
+    /* Same as an empty datastore: no such device tree */
+    if ((xc = xpath_first(xt, NULL, "devices/device/config")) == NULL){
+        retval = controller_kvstore_del(cbuf_get(cbk));
+        goto done;
+    }
+    if (clixon_xml2cbuf(cbv, xc, 0, 0, NULL, -1, 1) < 0)
+        goto done;
+    if (controller_kvstore_put(cbuf_get(cbk), cbuf_get(cbv), cbuf_len(cbv)) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cbk)
+        cbuf_free(cbk);
+    if (cbv)
+        cbuf_free(cbv);
+    return retval;
+}
+
+/*! Read device config from store
+ *
+ * @param[in]  h           Clixon handle
+ * @param[in]  devname     Device name
+ * @param[in]  config_type Device config type, eg SYNCED
+ * @param[out] xtp         Config on the form devices/device/config as from xmldb_get0, or NULL
+ * @retval     1           OK
+ * @retval     0           No such device config
+ * @retval    -1           Error
+ */
+int
+controller_kvstore_config_read(clixon_handle h,
+                               char         *devname,
+                               char         *config_type,
+                               cxobj       **xtp)
+{
+    int        retval = -1;
+    cbuf      *cbk = NULL;
+    cbuf      *cb = NULL;
+    cxobj     *xt = NULL;
+    cxobj     *xerr = NULL;
+    yang_stmt *yspec;
+    int        ret;
+
+    if ((cbk = cbuf_new()) == NULL ||
+        (cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    kvstore_config_key(cbk, devname, config_type);
+    cprintf(cb, "<devices xmlns=\"%s\"><device><name>", CONTROLLER_NAMESPACE);
+    if (xml_chardata_cbuf_append(cb, 0, devname) < 0)
+        goto done;
+    cprintf(cb, "</name><config>");
+    if ((ret = controller_kvstore_get(cbuf_get(cbk), cb)) < 0)
+        goto done;
+    if (ret == 0){
+        retval = 0;
+        goto done;
+    }
+    cprintf(cb, "</config></device></devices>");
+    if ((yspec = clicon_dbspec_yang(h)) == NULL){
+        clixon_err(OE_YANG, 0, "No DB_SPEC");
+        goto done;
+    }
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xt, NULL) < 0)
+        goto done;
+    /* Bind also below the mount-point, as xmldb_get0 */
+    if ((ret = xml_bind_yang(h, xt, YB_MODULE, yspec, &xerr)) < 0)
+        goto done;
+    if (ret == 0){
+        clixon_err(OE_YANG, 0, "Device store %s: YANG bind failed", cbuf_get(cbk));
+        goto done;
+    }
+    if (xml_sort_recurse(xt) < 0)
+        goto done;
+    *xtp = xt;
+    xt = NULL;
+    retval = 1;
+ done:
+    if (xt)
+        xml_free(xt);
+    if (xerr)
+        xml_free(xerr);
+    if (cbk)
+        cbuf_free(cbk);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Copy device config of one type to another
+ *
+ * @param[in]  devname  Device name
+ * @param[in]  from     From config type
+ * @param[in]  to       To config type
+ * @retval     0        OK
+ * @retval    -1        Error
+ */
+int
+controller_kvstore_config_copy(char *devname,
+                               char *from,
+                               char *to)
+{
+    int   retval = -1;
+    cbuf *cb0 = NULL;
+    cbuf *cb1 = NULL;
+
+    if ((cb0 = cbuf_new()) == NULL ||
+        (cb1 = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    kvstore_config_key(cb0, devname, from);
+    kvstore_config_key(cb1, devname, to);
+    retval = controller_kvstore_copy(cbuf_get(cb0), cbuf_get(cb1));
+ done:
+    if (cb0)
+        cbuf_free(cb0);
+    if (cb1)
+        cbuf_free(cb1);
+    return retval;
+}
+
+/*! Delete device config of a type
+ *
+ * @param[in]  devname     Device name
+ * @param[in]  config_type Device config type, eg TRANSIENT
+ * @retval     0           OK, also if not stored
+ * @retval    -1           Error
+ */
+int
+controller_kvstore_config_delete(char *devname,
+                                 char *config_type)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    kvstore_config_key(cb, devname, config_type);
+    retval = controller_kvstore_del(cbuf_get(cb));
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Key marking that datastores have been imported
+ */
+#define KVSTORE_IMPORTED "import/SYNCED"
+
+/*! Import existing device-<name>-SYNCED datastores the first time the store is used
+ *
+ * Called at start. The import and a marker key are written in one transaction, so that
+ * it is done once and completely. The datastores are read without YANG binding since
+ * device YANGs are not yet mounted, the config is bound when read from the store.
+ * The datastore files are left as they are.
+ * @param[in]  h     Clixon handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_kvstore_import(clixon_handle h)
+{
+    int            retval = -1;
+    char          *dir;
+    DIR           *dp = NULL;
+    struct dirent *de;
+    cbuf          *cb = NULL;
+    cxobj         *xt = NULL;
+    char          *name;
+    size_t         len;
+    int            nr = 0;
+    int            ret;
+
+    if (!controller_kvstore_active() ||
+        (dir = clicon_option_str(h, "CLICON_XMLDB_DIR")) == NULL)
+        return 0;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if ((ret = controller_kvstore_get(KVSTORE_IMPORTED, cb)) < 0)
+        goto done;
+    if (ret == 1){
+        retval = 0;
+        goto done;
+    }
+    if ((dp = opendir(dir)) == NULL){
+        clixon_err(OE_UNIX, errno, "opendir %s", dir);
+        goto done;
+    }
+    if (controller_kvstore_begin() < 0)
+        goto done;
+    while ((de = readdir(dp)) != NULL){
+        name = de->d_name;
+        /* device-<name>-SYNCED_db, or a device-<name>-SYNCED.d directory with XMLDB_MULTI */
+        if (strncmp(name, "device-", strlen("device-")) != 0)
+            continue;
+        len = strlen(name);
+        if (len > strlen("device--SYNCED_db") &&
+            strcmp(name + len - strlen("-SYNCED_db"), "-SYNCED_db") == 0)
+            len -= strlen("_db");
+        else if (len > strlen("device--SYNCED.d") &&
+                 strcmp(name + len - strlen("-SYNCED.d"), "-SYNCED.d") == 0)
+            len -= strlen(".d");
+        else
+            continue;
+        cbuf_reset(cb);
+        cprintf(cb, "%.*s", (int)len, name);
+        if (xmldb_get0(h, cbuf_get(cb), YB_NONE, NULL, NULL, 1, WITHDEFAULTS_EXPLICIT, &xt, NULL, NULL) < 0)
+            goto abort;
+        /* devname is between "device-" and "-SYNCED" */
+        cbuf_reset(cb);
+        cprintf(cb, "%.*s", (int)(len - strlen("device--SYNCED")), name + strlen("device-"));
+        if (controller_kvstore_config_write(h, cbuf_get(cb), "SYNCED", xt) < 0)
+            goto abort;
+        xml_free(xt);
+        xt = NULL;
+        cbuf_reset(cb);
+        cprintf(cb, "%.*s", (int)len, name);
+        xmldb_clear(h, cbuf_get(cb));
+        nr++;
+    }
+    if (controller_kvstore_put(KVSTORE_IMPORTED, "", 0) < 0)
+        goto abort;
+    if (controller_kvstore_commit(0) < 0)
+        goto done;
+    if (nr)
+        clixon_log(h, LOG_NOTICE, "Imported %d device SYNCED configs into device store", nr);
+    retval = 0;
+ done:
+    if (xt)
+        xml_free(xt);
+    if (dp)
+        closedir(dp);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+ abort:
+    controller_kvstore_commit(1);
+    goto done;
+}
@@ -0,0 +1,86 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Embedded key-value store of per-device configs
+  */
+
+#ifndef _CONTROLLER_KVSTORE_H
+#define _CONTROLLER_KVSTORE_H
+
+/*
+ * Types
+ */
+/*! Callback of controller_kvstore_each
+ *
+ * @param[in]  key   Key, not NUL-terminated
+ * @param[in]  klen  Length of key
+ * @param[in]  val   Value, not NUL-terminated
+ * @param[in]  vlen  Length of value
+ * @param[in]  arg   Argument given to controller_kvstore_each
+ * @retval     0     Continue
+ * @retval     1     Stop
+ * @retval    -1     Error
+ */
+typedef int (*kvstore_each_fn_t)(const char *key, size_t klen, const char *val, size_t vlen, void *arg);
+
+/*
+ * Prototypes
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int controller_kvstore_open(const char *path);
+int controller_kvstore_close(void);
+void controller_kvstore_mapsize_set(size_t size);
+size_t controller_kvstore_mapsize(void);
+int controller_kvstore_active(void);
+int controller_kvstore_begin(void);
+int controller_kvstore_commit(int abort);
+int controller_kvstore_put(const char *key, const char *val, size_t vlen);
+int controller_kvstore_del(const char *key);
+int controller_kvstore_get(const char *key, cbuf *cb);
+int controller_kvstore_copy(const char *from, const char *to);
+int controller_kvstore_each(const char *prefix, kvstore_each_fn_t fn, void *arg);
+int controller_kvstore_init(clixon_handle h);
+int controller_kvstore_config_write(clixon_handle h, char *devname, char *config_type, cxobj *xt);
+int controller_kvstore_config_read(clixon_handle h, char *devname, char *config_type, cxobj **xtp);
+int controller_kvstore_config_copy(char *devname, char *from, char *to);
+int controller_kvstore_config_delete(char *devname, char *config_type);
+int controller_kvstore_import(clixon_handle h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONTROLLER_KVSTORE_H */
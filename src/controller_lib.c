@@ -91,6 +91,7 @@ static const map_str2int ptmap[] = {
     {"NONE",     PT_NONE},
     {"VALIDATE", PT_VALIDATE},
     {"COMMIT",   PT_COMMIT},
+    {"PREVIEW",  PT_PREVIEW},
     {NULL,       -1}
 };
 
@@ -569,6 +570,157 @@ controller_version(clixon_handle h,
     return 0;
 }
 
+/*! Add a string to a running 64-bit digest
+ *
+ * Uses FNV-1a which is fast and good enough to detect equality of small strings,
+ * it is not a cryptographic hash.
+ * @param[in]  hash  Running digest, initialize with CONTROLLER_HASH_INIT
+ * @param[in]  str   String to add, NULL is same as empty string
+ * @retval     hash  New digest
+ */
+uint64_t
+controller_hash_str(uint64_t    hash,
+                    const char *str)
+{
+    const unsigned char *p;
+
+    if (str != NULL)
+        for (p = (const unsigned char *)str; *p != '\0'; p++){
+            hash ^= (uint64_t)*p;
+            hash *= 0x100000001b3ULL;
+        }
+    /* Terminate string so that "ab"+"c" differs from "a"+"bc" */
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+/*! Compute digest of a RFC 8525 yang-library module-set
+ *
+ * The digest covers name and revision of all modules and is independent of
+ * module order. Two devices with the same digest have the same set of YANGs.
+ * @param[in]  xylib   XML yang-library on the form yang-library/module-set/module
+ * @param[out] digest  Digest, or 0 if no modules
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see device_handle_yang_lib_digest_get  Cached variant
+ */
+int
+controller_yang_lib_digest(cxobj    *xylib,
+                           uint64_t *digest)
+{
+    int      retval = -1;
+    cxobj   *xms;
+    cxobj   *xm;
+    uint64_t sum = 0;
+    uint64_t h1;
+    int      nr = 0;
+
+    if (digest == NULL){
+        clixon_err(OE_UNIX, EINVAL, "digest is NULL");
+        goto done;
+    }
+    *digest = 0;
+    if (xylib == NULL ||
+        (xms = xml_find_type(xylib, NULL, "module-set", CX_ELMNT)) == NULL)
+        goto ok;
+    xm = NULL;
+    while ((xm = xml_child_each(xms, xm, CX_ELMNT)) != NULL) {
+        if (strcmp(xml_name(xm), "module") != 0)
+            continue;
+        h1 = controller_hash_str(CONTROLLER_HASH_INIT, xml_find_body(xm, "name"));
+        h1 = controller_hash_str(h1, xml_find_body(xm, "revision"));
+        sum += h1; /* Commutative: order independent */
+        nr++;
+    }
+    if (nr)
+        *digest = (sum ^ (uint64_t)nr) * 0x100000001b3ULL;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Add an XML config subtree to a running digest, recursive help function
+ *
+ * @param[in]  x     XML element
+ * @param[in]  hash  Running digest
+ * @retval     hash  New digest
+ */
+static uint64_t
+controller_config_digest1(cxobj   *x,
+                          uint64_t hash)
+{
+    cxobj     *xc;
+    yang_stmt *y;
+
+    hash = controller_hash_str(hash, xml_name(x));
+    if ((y = xml_spec(x)) != NULL)
+        hash = controller_hash_str(hash, yang_find_mynamespace(y));
+    if (xml_child_nr_type(x, CX_ELMNT) == 0)
+        return controller_hash_str(hash, xml_body(x));
+    xc = NULL;
+    while ((xc = xml_child_each(x, xc, CX_ELMNT)) != NULL) {
+        if (xml_flag(xc, XML_FLAG_DEFAULT))
+            continue;
+        hash = controller_config_digest1(xc, hash);
+    }
+    /* End of children so that siblings and children differ */
+    return controller_hash_str(hash, NULL);
+}
+
+/*! Compute canonical digest of a device configuration
+ *
+ * The digest covers element names, namespaces and bodies of all children of the
+ * root, but not prefixes, attributes or default values.
+ * The tree is assumed to be bound to YANG and sorted, so that the same configuration
+ * received from the device and read from a datastore have the same digest.
+ * @param[in]  xroot   Root of device config, eg <config> or <data>
+ * @param[out] digest  Digest
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see controller_yang_lib_digest
+ */
+int
+controller_config_digest(cxobj    *xroot,
+                         uint64_t *digest)
+{
+    int      retval = -1;
+    cxobj   *x;
+    uint64_t hash = CONTROLLER_HASH_INIT;
+
+    if (digest == NULL){
+        clixon_err(OE_UNIX, EINVAL, "digest is NULL");
+        goto done;
+    }
+    if (xroot != NULL){
+        x = NULL;
+        while ((x = xml_child_each(xroot, x, CX_ELMNT)) != NULL) {
+            if (xml_flag(x, XML_FLAG_DEFAULT))
+                continue;
+            hash = controller_config_digest1(x, hash);
+        }
+    }
+    *digest = hash;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Add an XML config subtree, including its name, to a running digest
+ *
+ * Same canonical form as controller_config_digest, for digests of parts of a config
+ * @param[in]  x     XML element
+ * @param[in]  hash  Running digest, start with CONTROLLER_HASH_INIT
+ * @retval     hash  New digest
+ */
+uint64_t
+controller_config_digest_add(cxobj   *x,
+                             uint64_t hash)
+{
+    return controller_config_digest1(x, hash);
+}
+
 #ifdef CONTROLLER_JUNOS_ADD_COMMAND_FORWARDING
 /*! YANG module patch
  *
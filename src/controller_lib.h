@@ -86,6 +86,7 @@ enum push_type_t{
     PT_NONE = 0,     /* Do not push to devices */
     PT_VALIDATE,     /* Push to devices, validate and then discard on devices */
     PT_COMMIT,       /* Push to devices, and commit on devices. */
+    PT_PREVIEW,      /* Compute device edits locally, do not push to devices */
 };
 typedef enum push_type_t push_type;
 
@@ -101,6 +102,15 @@ enum actions_type_t{
 };
 typedef enum actions_type_t actions_type;
 
+/*
+ * Constants
+ */
+/*! Initial value of a running digest, see controller_hash_str
+ *
+ * 64-bit FNV-1a offset basis
+ */
+#define CONTROLLER_HASH_INIT 0xcbf29ce484222325ULL
+
 /*
  * Prototypes
  */
@@ -125,6 +135,10 @@ int controller_mount_xpath_get(char *devname, cbuf **cbxpath);
 int controller_mount_yspec_get(clixon_handle h, char *devname, yang_stmt **yspec1);
 int controller_mount_yspec_set(clixon_handle h, char *devname, yang_stmt *yspec1);
 int controller_version(clixon_handle h, FILE *f);
+uint64_t controller_hash_str(uint64_t hash, const char *str);
+int controller_yang_lib_digest(cxobj *xylib, uint64_t *digest);
+int controller_config_digest(cxobj *xroot, uint64_t *digest);
+uint64_t controller_config_digest_add(cxobj *x, uint64_t hash);
 #ifdef CONTROLLER_JUNOS_ADD_COMMAND_FORWARDING
 int controller_yang_patch_junos(clixon_handle h, yang_stmt *ymod);
 #endif
@@ -0,0 +1,374 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Memoized service actions
+  * If processes/services/memoize is set, a digest of the input and of the output of each
+  * service instance is recorded when a commit with its actions is done. The input is the instance config,
+  * except created, and the config selected by processes/services/memo-dependency. The output
+  * is the created paths and the device config at those paths.
+  * When actions are triggered again, an instance whose input and output digests are unchanged
+  * is not notified, and its created device config is kept instead of being stripped.
+  * Unless it shares a created object with a notified instance, since that object is stripped.
+  * The memo is in memory, it is cleared when the backend restarts, the action daemon
+  * subscribes to services-commit, or processes/services config changes.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_lib.h"
+#include "controller_memo.h"
+
+/*! Recorded digests of one service instance
+ */
+typedef struct {
+    uint64_t me_input;   /* Digest of instance config and dependencies */
+    uint64_t me_output;  /* Digest of created paths and their device config */
+} memo_entry;
+
+/*! Get memo table, create if not exists
+ *
+ * @param[in]  h    Clixon handle
+ * @retval     hash Memo table indexed by service instance
+ * @retval     NULL Error
+ */
+static clicon_hash_t *
+memo_get(clixon_handle h)
+{
+    clicon_hash_t *memo = NULL;
+
+    if (clicon_ptr_get(h, "controller-actions-memo", (void**)&memo) == 0 && memo != NULL)
+        return memo;
+    if ((memo = clicon_hash_init()) == NULL)
+        return NULL;
+    clicon_ptr_set(h, "controller-actions-memo", memo);
+    return memo;
+}
+
+/*! Memoization of service actions is enabled
+ *
+ * @param[in]  xt   Config tree, eg target of commit
+ * @retval     1    Enabled
+ * @retval     0    Disabled
+ */
+int
+controller_memo_enabled(cxobj *xt)
+{
+    cxobj *x;
+
+    if ((x = xpath_first(xt, NULL, "processes/services/memoize")) == NULL)
+        return 0;
+    return strcmp(xml_body(x) ? xml_body(x) : "", "true") == 0;
+}
+
+/*! Compute input and output digests of a service instance
+ *
+ * @param[in]  xt      Config tree with services and devices
+ * @param[in]  tag     Service instance, on the form <service>[<key>='<value>']
+ * @param[out] input   Digest of instance config, except created, and dependencies
+ * @param[out] output  Digest of created paths and device config at those paths
+ * @retval     1       OK
+ * @retval     0       No such instance
+ * @retval    -1       Error
+ */
+static int
+memo_digest(cxobj    *xt,
+            char     *tag,
+            uint64_t *input,
+            uint64_t *output)
+{
+    int      retval = -1;
+    cxobj   *xi;
+    cxobj   *xc;
+    cxobj   *xd;
+    cxobj   *xp;
+    cxobj  **vec = NULL;
+    size_t   veclen;
+    uint64_t hash;
+    int      i;
+
+    if ((xi = xpath_first(xt, NULL, "services/%s", tag)) == NULL){
+        retval = 0;
+        goto done;
+    }
+    hash = controller_hash_str(CONTROLLER_HASH_INIT, tag);
+    xc = NULL;
+    while ((xc = xml_child_each(xi, xc, CX_ELMNT)) != NULL){
+        if (strcmp(xml_name(xc), "created") == 0 || xml_flag(xc, XML_FLAG_DEFAULT))
+            continue;
+        hash = controller_config_digest_add(xc, hash);
+    }
+    /* Declared dependencies, in order */
+    if ((xd = xpath_first(xt, NULL, "processes/services")) != NULL){
+        xp = NULL;
+        while ((xp = xml_child_each(xd, xp, CX_ELMNT)) != NULL){
+            if (strcmp(xml_name(xp), "memo-dependency") != 0 || xml_body(xp) == NULL)
+                continue;
+            hash = controller_hash_str(hash, xml_body(xp));
+            if (xpath_vec(xt, NULL, "%s", &vec, &veclen, xml_body(xp)) < 0)
+                goto done;
+            for (i=0; i<veclen; i++)
+                hash = controller_config_digest_add(vec[i], hash);
+            if (vec){
+                free(vec);
+                vec = NULL;
+            }
+            hash = controller_hash_str(hash, NULL);
+        }
+    }
+    *input = hash;
+    /* Output: created paths and what they point to */
+    hash = CONTROLLER_HASH_INIT;
+    if ((xc = xml_find_type(xi, NULL, "created", CX_ELMNT)) != NULL){
+        xp = NULL;
+        while ((xp = xml_child_each(xc, xp, CX_ELMNT)) != NULL){
+            if (strcmp(xml_name(xp), "path") != 0 || xml_body(xp) == NULL)
+                continue;
+            hash = controller_hash_str(hash, xml_body(xp));
+            if ((xd = xpath_first(xt, NULL, "%s", xml_body(xp))) != NULL)
+                hash = controller_config_digest_add(xd, hash);
+            else
+                hash = controller_hash_str(hash, NULL);
+        }
+    }
+    *output = hash;
+    retval = 1;
+ done:
+    if (vec)
+        free(vec);
+    return retval;
+}
+
+/*! Check if a service instance can reuse its previous output
+ *
+ * @param[in]  h     Clixon handle
+ * @param[in]  xt    Config tree, eg target of commit
+ * @param[in]  tag   Service instance, on the form <service>[<key>='<value>']
+ * @retval     1     Input and output unchanged since last recorded, skip actions
+ * @retval     0     Changed or not recorded, run actions
+ * @retval    -1     Error
+ */
+int
+controller_memo_check(clixon_handle h,
+                      cxobj        *xt,
+                      char         *tag)
+{
+    clicon_hash_t *memo;
+    memo_entry    *me;
+    uint64_t       input;
+    uint64_t       output;
+    int            ret;
+
+    if ((memo = memo_get(h)) == NULL)
+        return -1;
+    if ((me = clicon_hash_value(memo, tag, NULL)) == NULL)
+        return 0;
+    if ((ret = memo_digest(xt, tag, &input, &output)) < 0)
+        return -1;
+    if (ret == 0){ /* Deleted instance */
+        clicon_hash_del(memo, tag);
+        return 0;
+    }
+    if (me->me_input != input || me->me_output != output)
+        return 0;
+    clixon_debug(CLIXON_DBG_CTRL, "%s: unchanged, reuse", tag);
+    return 1;
+}
+
+/*! Add created paths of a service instance to a set
+ */
+static int
+memo_paths_add(cxobj         *xt,
+               char          *tag,
+               clicon_hash_t *paths)
+{
+    cxobj *xc;
+    cxobj *xp;
+    char   one = 1;
+
+    if ((xc = xpath_first(xt, NULL, "services/%s/created", tag)) == NULL)
+        return 0;
+    xp = NULL;
+    while ((xp = xml_child_each(xc, xp, CX_ELMNT)) != NULL){
+        if (strcmp(xml_name(xp), "path") != 0 || xml_body(xp) == NULL)
+            continue;
+        if (clicon_hash_add(paths, xml_body(xp), &one, sizeof(one)) == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+/*! Check if a service instance has created any path in a set
+ */
+static int
+memo_paths_shared(cxobj         *xt,
+                  char          *tag,
+                  clicon_hash_t *paths)
+{
+    cxobj *xc;
+    cxobj *xp;
+
+    if ((xc = xpath_first(xt, NULL, "services/%s/created", tag)) == NULL)
+        return 0;
+    xp = NULL;
+    while ((xp = xml_child_each(xc, xp, CX_ELMNT)) != NULL){
+        if (strcmp(xml_name(xp), "path") != 0 || xml_body(xp) == NULL)
+            continue;
+        if (clicon_hash_lookup(paths, xml_body(xp)) != NULL)
+            return 1;
+    }
+    return 0;
+}
+
+/*! Do not reuse output of instances sharing created objects with notified instances
+ *
+ * Created objects of notified instances are stripped, also those shared with others.
+ * An instance sharing such an object must therefore run its actions again.
+ * @param[in]     xt      Config tree, eg target of commit
+ * @param[in,out] notify  Instances to notify, instances sharing objects are moved here
+ * @param[in,out] skip    Instances reusing their output
+ * @retval        0       OK
+ * @retval       -1       Error
+ */
+int
+controller_memo_shared(cxobj *xt,
+                       cvec  *notify,
+                       cvec  *skip)
+{
+    int            retval = -1;
+    clicon_hash_t *paths = NULL;
+    cg_var        *cv;
+    char          *tag;
+    int            i;
+    int            ret;
+
+    if (cvec_len(notify) == 0 || cvec_len(skip) == 0)
+        return 0;
+    if ((paths = clicon_hash_init()) == NULL)
+        goto done;
+    cv = NULL;
+    while ((cv = cvec_each(notify, cv)) != NULL)
+        if (memo_paths_add(xt, cv_name_get(cv), paths) < 0)
+            goto done;
+    /* Moved instances may in turn share objects with others, repeat until stable */
+    i = 0;
+    while (i < cvec_len(skip)){
+        tag = cv_name_get(cvec_i(skip, i));
+        if ((ret = memo_paths_shared(xt, tag, paths)) == 0){
+            i++;
+            continue;
+        }
+        if (memo_paths_add(xt, tag, paths) < 0)
+            goto done;
+        if (cvec_add_string(notify, tag, NULL) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+        if (cvec_del_i(skip, i) < 0)
+            goto done;
+        i = 0;
+    }
+    retval = 0;
+ done:
+    if (paths)
+        clicon_hash_free(paths);
+    return retval;
+}
+
+/*! Record input and output digests of service instances after a successful commit
+ *
+ * @param[in]  h     Clixon handle
+ * @param[in]  xt    Committed config tree, ie running
+ * @param[in]  cvv   Service instances, on the form name:<service>[<key>='<value>']
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_memo_record(clixon_handle h,
+                       cxobj        *xt,
+                       cvec         *cvv)
+{
+    clicon_hash_t *memo;
+    memo_entry     me;
+    cg_var        *cv = NULL;
+    char          *tag;
+    int            ret;
+
+    if ((memo = memo_get(h)) == NULL)
+        return -1;
+    while ((cv = cvec_each(cvv, cv)) != NULL){
+        tag = cv_name_get(cv);
+        if ((ret = memo_digest(xt, tag, &me.me_input, &me.me_output)) < 0)
+            return -1;
+        if (ret == 0){
+            clicon_hash_del(memo, tag);
+            continue;
+        }
+        if (clicon_hash_add(memo, tag, &me, sizeof(me)) == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+/*! Free memo, all service instances run actions when next triggered
+ *
+ * @param[in]  h       Clixon handle
+ */
+int
+controller_memo_free(clixon_handle h)
+{
+    clicon_hash_t *memo = NULL;
+
+    if (clicon_ptr_get(h, "controller-actions-memo", (void**)&memo) < 0 || memo == NULL)
+        return 0;
+    clicon_hash_free(memo);
+    clicon_ptr_del(h, "controller-actions-memo");
+    return 0;
+}
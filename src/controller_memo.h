@@ -0,0 +1,57 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Memoized service actions
+  */
+
+#ifndef _CONTROLLER_MEMO_H
+#define _CONTROLLER_MEMO_H
+
+/*
+ * Prototypes
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int controller_memo_enabled(cxobj *xt);
+int controller_memo_check(clixon_handle h, cxobj *xt, char *tag);
+int controller_memo_shared(cxobj *xt, cvec *notify, cvec *skip);
+int controller_memo_record(clixon_handle h, cxobj *xt, cvec *cvv);
+int controller_memo_free(clixon_handle h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONTROLLER_MEMO_H */
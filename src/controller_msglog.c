@@ -0,0 +1,363 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Sampled and rate-limited log of NETCONF messages of selected devices
+  * Messages of devices with message-log enabled are copied, possibly truncated, as raw
+  * records into a memory buffer. Sampling and rate limits are applied per device before
+  * copying. Records are formatted, one line per record with newlines escaped, and written
+  * to the log file in one batch from the event loop, once per second or when the buffer is
+  * half full. If the buffer is full, records are dropped and counted.
+  * See devices/message-log
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_device_state.h"
+#include "controller_device_handle.h"
+#include "controller_msglog.h"
+
+/*! Per-device sampling and rate state, stored in device handle
+ */
+typedef struct {
+    uint64_t ml_seq;      /* Message sequence number, for sampling */
+    time_t   ml_sec;      /* Current rate window */
+    uint32_t ml_win;      /* Logged messages in current rate window */
+    uint32_t ml_skipped;  /* Messages skipped by rate limit since last logged */
+} msglog_dev;
+
+/*! Record header in buffer, followed by device name and message
+ */
+typedef struct {
+    struct timeval mr_tv;
+    uint32_t       mr_len;      /* Original message length */
+    uint32_t       mr_datalen;  /* Copied (truncated) length */
+    uint32_t       mr_skipped;  /* Messages skipped by rate limit before this */
+    uint16_t       mr_namelen;
+    char           mr_dir;      /* 'R' received, 'S' sent */
+} msglog_rec;
+
+static FILE    *_msglog_f = NULL;       /* Log file, NULL if disabled */
+static char    *_msglog_buf = NULL;     /* Record buffer */
+static size_t   _msglog_size = 0;       /* Size of buffer */
+static size_t   _msglog_len = 0;        /* Used part of buffer */
+static uint32_t _msglog_sample = 1;
+static uint32_t _msglog_rate = 100;
+static uint32_t _msglog_maxlen = 1024;
+static uint64_t _msglog_dropped = 0;    /* Records dropped since last flush */
+static int      _msglog_timer = 0;      /* Flush is scheduled */
+static int      _msglog_timer_now = 0;  /* Scheduled flush is immediate */
+
+static int controller_msglog_flush_cb(int fd, void *arg);
+
+/*! Schedule flush of buffer
+ *
+ * @param[in]  now  If set, flush on next event loop round, otherwise after one second
+ */
+static int
+msglog_schedule(int now)
+{
+    struct timeval t;
+
+    if (_msglog_timer){
+        if (!now || _msglog_timer_now)
+            return 0;
+        clixon_event_unreg_timeout(controller_msglog_flush_cb, NULL);
+    }
+    gettimeofday(&t, NULL);
+    if (!now)
+        t.tv_sec++;
+    if (clixon_event_reg_timeout(t, controller_msglog_flush_cb, NULL, "controller message log") < 0)
+        return -1;
+    _msglog_timer = 1;
+    _msglog_timer_now = now;
+    return 0;
+}
+
+/*! Write message data on one line, escaping newlines, carriage returns and backslashes
+ *
+ * So that each record is one line in the log file
+ * @param[in]  data  Message data
+ * @param[in]  len   Length of data
+ */
+static void
+msglog_write_line(const char *data,
+                  size_t      len)
+{
+    size_t i;
+    size_t j;
+
+    for (i=0, j=0; i<len; i++){
+        if (data[i] != '\n' && data[i] != '\r' && data[i] != '\\')
+            continue;
+        fwrite(data + j, 1, i - j, _msglog_f);
+        fputs(data[i] == '\n' ? "\\n" : data[i] == '\r' ? "\\r" : "\\\\", _msglog_f);
+        j = i + 1;
+    }
+    fwrite(data + j, 1, len - j, _msglog_f);
+}
+
+/*! Format and write all records in buffer to the log file, called from event loop
+ *
+ * @param[in]  fd   Not used
+ * @param[in]  arg  Not used
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+controller_msglog_flush_cb(int   fd,
+                           void *arg)
+{
+    msglog_rec *mr;
+    size_t      off = 0;
+    char       *name;
+    char       *data;
+    struct tm   tm;
+    char        timestr[32];
+
+    _msglog_timer = 0;
+    _msglog_timer_now = 0;
+    if (_msglog_f == NULL){
+        _msglog_len = 0;
+        return 0;
+    }
+    while (off < _msglog_len){
+        mr = (msglog_rec*)(_msglog_buf + off);
+        name = (char*)(mr + 1);
+        data = name + mr->mr_namelen;
+        gmtime_r(&mr->mr_tv.tv_sec, &tm);
+        strftime(timestr, sizeof(timestr), "%Y-%m-%dT%H:%M:%S", &tm);
+        fprintf(_msglog_f, "%s.%06ldZ %.*s %s len=%" PRIu32,
+                timestr, (long)mr->mr_tv.tv_usec,
+                (int)mr->mr_namelen, name,
+                mr->mr_dir == 'R' ? "recv" : "send",
+                mr->mr_len);
+        if (mr->mr_skipped)
+            fprintf(_msglog_f, " skipped=%" PRIu32, mr->mr_skipped);
+        fprintf(_msglog_f, ": ");
+        msglog_write_line(data, mr->mr_datalen);
+        fprintf(_msglog_f, "%s\n", mr->mr_datalen < mr->mr_len ? "..." : "");
+        off += (sizeof(*mr) + mr->mr_namelen + mr->mr_datalen + 7) & ~(size_t)7;
+    }
+    if (_msglog_dropped){
+        fprintf(_msglog_f, "dropped=%" PRIu64 "\n", _msglog_dropped);
+        _msglog_dropped = 0;
+    }
+    fflush(_msglog_f);
+    _msglog_len = 0;
+    return 0;
+}
+
+/*! Configure message log, given devices/message-log
+ *
+ * Pending records are written before the configuration is changed
+ * @param[in]  h       Clixon handle
+ * @param[in]  file    Log file, or NULL to disable the log
+ * @param[in]  sample  Log every sample:th message of each device
+ * @param[in]  rate    Max logged messages per device and second, 0 is no limit
+ * @param[in]  maxlen  Max length of logged message
+ * @param[in]  size    Size of record buffer
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+controller_msglog_config(clixon_handle h,
+                         const char   *file,
+                         uint32_t      sample,
+                         uint32_t      rate,
+                         uint32_t      maxlen,
+                         uint32_t      size)
+{
+    int   retval = -1;
+    char *buf;
+
+    if (_msglog_len)
+        controller_msglog_flush_cb(0, NULL);
+    if (_msglog_f){
+        fclose(_msglog_f);
+        _msglog_f = NULL;
+    }
+    if (file != NULL){
+        if ((_msglog_f = fopen(file, "a")) == NULL){
+            clixon_err(OE_UNIX, errno, "fopen(%s)", file);
+            goto done;
+        }
+    }
+    if (size != _msglog_size){
+        if ((buf = realloc(_msglog_buf, size)) == NULL && size){
+            clixon_err(OE_UNIX, errno, "realloc");
+            goto done;
+        }
+        _msglog_buf = buf;
+        _msglog_size = size;
+    }
+    _msglog_sample = sample ? sample : 1;
+    _msglog_rate = rate;
+    _msglog_maxlen = maxlen;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Enable or disable message log of a device
+ *
+ * @param[in]  dh      Device handle
+ * @param[in]  enable  If set, log messages of device
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+controller_msglog_device(device_handle dh,
+                         int           enable)
+{
+    msglog_dev *ml;
+
+    if (!enable)
+        return device_handle_msglog_set(dh, NULL);
+    if (device_handle_msglog_get(dh) != NULL)
+        return 0;
+    if ((ml = calloc(1, sizeof(*ml))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        return -1;
+    }
+    return device_handle_msglog_set(dh, ml);
+}
+
+/*! Log a message to or from a device
+ *
+ * Cheap if the device is not enabled, or the message is not sampled or over the rate
+ * limit: no formatting is made on this path.
+ * @param[in]  dh    Device handle
+ * @param[in]  dir   'R' for received, 'S' for sent
+ * @param[in]  msg   Message
+ * @param[in]  len   Length of message
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_msglog(device_handle dh,
+                  char          dir,
+                  const char   *msg,
+                  size_t        len)
+{
+    msglog_dev    *ml;
+    msglog_rec    *mr;
+    struct timeval tv;
+    char          *name;
+    size_t         namelen;
+    size_t         datalen;
+    size_t         reclen;
+
+    if (_msglog_f == NULL ||
+        (ml = device_handle_msglog_get(dh)) == NULL)
+        return 0;
+    if (ml->ml_seq++ % _msglog_sample != 0)
+        return 0;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec != ml->ml_sec){
+        ml->ml_sec = tv.tv_sec;
+        ml->ml_win = 0;
+    }
+    if (_msglog_rate && ml->ml_win >= _msglog_rate){
+        ml->ml_skipped++;
+        return 0;
+    }
+    ml->ml_win++;
+    name = device_handle_name_get(dh);
+    namelen = strlen(name);
+    if (namelen > UINT16_MAX)
+        namelen = UINT16_MAX;
+    datalen = len < _msglog_maxlen ? len : _msglog_maxlen;
+    reclen = (sizeof(*mr) + namelen + datalen + 7) & ~(size_t)7;
+    if (_msglog_len + reclen > _msglog_size){
+        _msglog_dropped++;
+        return msglog_schedule(1);
+    }
+    mr = (msglog_rec*)(_msglog_buf + _msglog_len);
+    mr->mr_tv = tv;
+    mr->mr_len = len;
+    mr->mr_datalen = datalen;
+    mr->mr_skipped = ml->ml_skipped;
+    mr->mr_namelen = namelen;
+    mr->mr_dir = dir;
+    memcpy((char*)(mr + 1), name, namelen);
+    memcpy((char*)(mr + 1) + namelen, msg, datalen);
+    _msglog_len += reclen;
+    ml->ml_skipped = 0;
+    return msglog_schedule(_msglog_len > _msglog_size/2);
+}
+
+/*! Write pending records and free message log, called on exit
+ *
+ * @retval     0    OK
+ */
+int
+controller_msglog_exit(void)
+{
+    if (_msglog_timer){
+        clixon_event_unreg_timeout(controller_msglog_flush_cb, NULL);
+        _msglog_timer = 0;
+    }
+    if (_msglog_len)
+        controller_msglog_flush_cb(0, NULL);
+    if (_msglog_f){
+        fclose(_msglog_f);
+        _msglog_f = NULL;
+    }
+    if (_msglog_buf){
+        free(_msglog_buf);
+        _msglog_buf = NULL;
+    }
+    _msglog_size = 0;
+    return 0;
+}
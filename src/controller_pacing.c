@@ -0,0 +1,399 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Per-device request pacing
+  * Limits RPCs sent on the primary session of a device with a weak control-plane, as
+  * configured by pacing on the device or its device-profile:
+  * - max-outstanding: max number of RPCs awaiting rpc-reply
+  * - min-interval:    min time in ms between two RPCs
+  * - edit-rate:       max bytes/s of edit-config messages. After an edit of N bytes, the
+  *                    next edit is sent at the earliest N/edit-rate seconds later
+  * A message that may not be sent is queued, and sent in order when a reply is received or
+  * when a timer expires. The queue is flushed when the connection is closed.
+  * The secondary read session is not paced, it has at most one outstanding request.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_device_state.h"
+#include "controller_device_handle.h"
+#include "controller_device_send.h"
+#include "controller_pacing.h"
+
+/*! Max bytes from start of message searched for the RPC name
+ */
+#define PACING_RPC_PREFIX 256
+
+/*! Queued message
+ */
+typedef struct {
+    qelem_t  pm_qelem;   /* FIFO */
+    int      pm_socket;  /* Primary session socket when queued */
+    cbuf    *pm_cb;      /* Framed message, copied */
+    int      pm_edit;    /* Message is edit-config */
+} pacing_msg;
+
+/*! Pacing state of one device
+ */
+typedef struct {
+    device_handle  pd_dh;
+    uint32_t       pd_max;         /* Max outstanding RPCs, 0 is no limit */
+    uint32_t       pd_interval;    /* Min interval between RPCs in ms, 0 is no limit */
+    uint32_t       pd_rate;        /* Max edit-config bytes/s, 0 is no limit */
+    uint32_t       pd_outstanding; /* RPCs sent awaiting reply */
+    struct timeval pd_next;        /* Earliest time of next RPC */
+    struct timeval pd_edit_next;   /* Earliest time of next edit-config */
+    pacing_msg    *pd_queue;       /* Queued messages */
+    int            pd_timer;       /* Timer registered */
+} pacing_dev;
+
+static int pacing_timeout_cb(int fd, void *arg);
+
+/*! Message is an edit-config
+ */
+static int
+pacing_is_edit(cbuf *cb)
+{
+    size_t len;
+    char   c;
+    char  *p;
+    int    edit;
+
+    len = cbuf_len(cb);
+    if (len > PACING_RPC_PREFIX)
+        len = PACING_RPC_PREFIX;
+    p = cbuf_get(cb);
+    c = p[len];
+    p[len] = '\0';
+    edit = strstr(p, "<edit-config") != NULL;
+    p[len] = c;
+    return edit;
+}
+
+/*! Check if a message may be sent now
+ *
+ * @param[in]  pd    Pacing state
+ * @param[in]  edit  Message is edit-config
+ * @param[in]  now   Current time
+ * @param[out] wait  Time when it may be sent, if not blocked by outstanding RPCs
+ * @retval     2     May be sent now
+ * @retval     1     Wait until wait
+ * @retval     0     Wait for reply
+ */
+static int
+pacing_allowed(pacing_dev     *pd,
+               int             edit,
+               struct timeval *now,
+               struct timeval *wait)
+{
+    if (pd->pd_max && pd->pd_outstanding >= pd->pd_max)
+        return 0;
+    *wait = pd->pd_next;
+    if (edit && timercmp(&pd->pd_edit_next, wait, >))
+        *wait = pd->pd_edit_next;
+    if (timercmp(wait, now, >))
+        return 1;
+    return 2;
+}
+
+/*! Account for a message being sent now
+ */
+static void
+pacing_sent(pacing_dev     *pd,
+            cbuf           *cb,
+            int             edit,
+            struct timeval *now)
+{
+    struct timeval t;
+    uint64_t       us;
+
+    pd->pd_outstanding++;
+    t.tv_sec = pd->pd_interval / 1000;
+    t.tv_usec = (pd->pd_interval % 1000) * 1000;
+    timeradd(now, &t, &pd->pd_next);
+    if (edit && pd->pd_rate){
+        us = (uint64_t)cbuf_len(cb) * 1000000 / pd->pd_rate;
+        t.tv_sec = us / 1000000;
+        t.tv_usec = us % 1000000;
+        timeradd(now, &t, &pd->pd_edit_next);
+    }
+}
+
+/*! Send queued messages that are allowed, else set timer
+ *
+ * @param[in]  pd    Pacing state
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+pacing_drain(pacing_dev *pd)
+{
+    int            retval = -1;
+    pacing_msg    *pm;
+    struct timeval now;
+    struct timeval wait;
+    int            ret;
+
+    while ((pm = pd->pd_queue) != NULL){
+        gettimeofday(&now, NULL);
+        if ((ret = pacing_allowed(pd, pm->pm_edit, &now, &wait)) == 0)
+            break;
+        if (ret == 1){
+            if (!pd->pd_timer){
+                if (clixon_event_reg_timeout(wait, pacing_timeout_cb, pd, "Device pacing") < 0)
+                    goto done;
+                pd->pd_timer = 1;
+            }
+            break;
+        }
+        DELQ(pm, pd->pd_queue, pacing_msg *);
+        pacing_sent(pd, pm->pm_cb, pm->pm_edit, &now);
+        ret = device_send_msg_now(pd->pd_dh, pm->pm_socket, pm->pm_cb);
+        cbuf_free(pm->pm_cb);
+        free(pm);
+        if (ret < 0)
+            goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Pacing timer expired, send queued messages
+ */
+static int
+pacing_timeout_cb(int   fd,
+                  void *arg)
+{
+    pacing_dev *pd = (pacing_dev *)arg;
+
+    pd->pd_timer = 0;
+    return pacing_drain(pd);
+}
+
+/*! Pace a message to a device
+ *
+ * @param[in]  dh    Device handle
+ * @param[in]  s     Socket
+ * @param[in]  cb    Framed message, copied if queued
+ * @retval     1     Queued, it is sent later
+ * @retval     0     Send now
+ * @retval    -1     Error
+ */
+int
+controller_pacing_send(device_handle dh,
+                       int           s,
+                       cbuf         *cb)
+{
+    pacing_dev    *pd;
+    pacing_msg    *pm;
+    struct timeval now;
+    struct timeval wait;
+    int            edit;
+
+    if ((pd = device_handle_pacing_get(dh)) == NULL ||
+        s != device_handle_socket_get(dh))
+        return 0;
+    edit = pacing_is_edit(cb);
+    gettimeofday(&now, NULL);
+    /* Keep order: only send directly if nothing is queued */
+    if (pd->pd_queue == NULL &&
+        pacing_allowed(pd, edit, &now, &wait) == 2){
+        pacing_sent(pd, cb, edit, &now);
+        return 0;
+    }
+    if ((pm = calloc(1, sizeof(*pm))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        return -1;
+    }
+    if ((pm->pm_cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        free(pm);
+        return -1;
+    }
+    if (cbuf_append_buf(pm->pm_cb, cbuf_get(cb), cbuf_len(cb)) < 0){
+        clixon_err(OE_UNIX, errno, "cbuf_append_buf");
+        cbuf_free(pm->pm_cb);
+        free(pm);
+        return -1;
+    }
+    pm->pm_socket = s;
+    pm->pm_edit = edit;
+    ADDQ(pm, pd->pd_queue);
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "%s: paced, %u outstanding",
+                 device_handle_name_get(dh), pd->pd_outstanding);
+    if (pacing_drain(pd) < 0)
+        return -1;
+    return 1;
+}
+
+/*! An rpc-reply is received on the primary session, send queued messages
+ *
+ * @param[in]  dh    Device handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+controller_pacing_reply(device_handle dh)
+{
+    pacing_dev *pd;
+
+    if ((pd = device_handle_pacing_get(dh)) == NULL)
+        return 0;
+    if (pd->pd_outstanding)
+        pd->pd_outstanding--;
+    return pacing_drain(pd);
+}
+
+/*! Connection is closed, flush queued messages and reset state
+ *
+ * @param[in]  dh    Device handle
+ */
+int
+controller_pacing_close(device_handle dh)
+{
+    pacing_dev *pd;
+    pacing_msg *pm;
+
+    if ((pd = device_handle_pacing_get(dh)) == NULL)
+        return 0;
+    if (pd->pd_timer){
+        clixon_event_unreg_timeout(pacing_timeout_cb, pd);
+        pd->pd_timer = 0;
+    }
+    while ((pm = pd->pd_queue) != NULL){
+        DELQ(pm, pd->pd_queue, pacing_msg *);
+        cbuf_free(pm->pm_cb);
+        free(pm);
+    }
+    pd->pd_outstanding = 0;
+    timerclear(&pd->pd_next);
+    timerclear(&pd->pd_edit_next);
+    return 0;
+}
+
+/*! Get pacing leaf of a device, or of its device-profile if not set on the device
+ */
+static int
+pacing_leaf(cxobj    *xdev,
+            cxobj    *xprof,
+            char     *name,
+            uint32_t *val)
+{
+    cxobj *x;
+    char  *body;
+
+    *val = 0;
+    if ((x = xpath_first(xdev, NULL, "pacing/%s", name)) == NULL ||
+        xml_flag(x, XML_FLAG_DEFAULT)){
+        if (xprof)
+            x = xpath_first(xprof, NULL, "pacing/%s", name);
+    }
+    if (x == NULL || (body = xml_body(x)) == NULL)
+        return 0;
+    if (parse_uint32(body, val, NULL) < 1){
+        clixon_err(OE_UNIX, EINVAL, "error parsing pacing %s:%s", name, body);
+        return -1;
+    }
+    return 0;
+}
+
+/*! Set pacing of a device from its config
+ *
+ * Made when the device connects, and when pacing of the device or its device-profile
+ * is committed. Queued messages are sent if the new limits allow it.
+ * @param[in]  dh     Device handle
+ * @param[in]  xdev   Device config
+ * @param[in]  xprof  Device-profile config of device, or NULL
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+controller_pacing_device(device_handle dh,
+                         cxobj        *xdev,
+                         cxobj        *xprof)
+{
+    pacing_dev *pd;
+    uint32_t    max;
+    uint32_t    interval;
+    uint32_t    rate;
+
+    if (pacing_leaf(xdev, xprof, "max-outstanding", &max) < 0 ||
+        pacing_leaf(xdev, xprof, "min-interval", &interval) < 0 ||
+        pacing_leaf(xdev, xprof, "edit-rate", &rate) < 0)
+        return -1;
+    if (max == 0 && interval == 0 && rate == 0){
+        if ((pd = device_handle_pacing_get(dh)) != NULL && pd->pd_queue){
+            /* Send queued messages before pacing is removed */
+            pd->pd_max = pd->pd_interval = pd->pd_rate = 0;
+            timerclear(&pd->pd_next);
+            timerclear(&pd->pd_edit_next);
+            if (pacing_drain(pd) < 0)
+                return -1;
+        }
+        controller_pacing_close(dh);
+        return device_handle_pacing_set(dh, NULL);
+    }
+    if ((pd = device_handle_pacing_get(dh)) == NULL){
+        if ((pd = calloc(1, sizeof(*pd))) == NULL){
+            clixon_err(OE_UNIX, errno, "calloc");
+            return -1;
+        }
+        pd->pd_dh = dh;
+        if (device_handle_pacing_set(dh, pd) < 0)
+            return -1;
+    }
+    pd->pd_max = max;
+    pd->pd_interval = interval;
+    pd->pd_rate = rate;
+    return pacing_drain(pd);
+}
@@ -0,0 +1,269 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Device socket reactor
+  * Device sockets are registered here instead of directly in the clixon event loop.
+  * If the controller is configured with --enable-epoll, CONTROLLER_EPOLL is defined and
+  * the sockets are added to one epoll instance, and only the epoll fd is registered in
+  * the clixon event loop. Dispatch then costs O(ready sockets) instead of a select()
+  * scan of all sockets, and the number of device sessions is not limited by FD_SETSIZE.
+  * Otherwise, registration is passed on to the clixon event loop.
+  * @see util/clixon_controller_reactorbench.c
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_reactor.h"
+
+#ifdef CONTROLLER_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#ifdef CONTROLLER_EPOLL
+/*! Max number of events returned by one epoll_wait
+ */
+#define CONTROLLER_REACTOR_EVENTS 256
+
+/*! Registration of one socket, indexed by socket
+ */
+typedef struct {
+    int     (*re_fn)(int, void*); /* Callback, NULL if not registered */
+    void     *re_arg;             /* Callback argument */
+    uint32_t  re_gen;             /* Generation of registration, 0 if not registered */
+} reactor_entry;
+
+static int            _reactor_fd = -1;        /* epoll instance */
+static reactor_entry *_reactor_vec = NULL;     /* Registrations indexed by socket */
+static int            _reactor_len = 0;        /* Length of _reactor_vec */
+static int            _reactor_nr = 0;         /* Number of registered sockets */
+static uint32_t       _reactor_gen = 0;        /* Last generation of a registration */
+
+/*! Event data of a registration: generation in high and socket in low 32 bits
+ */
+#define REACTOR_DATA(gen, s) (((uint64_t)(gen) << 32) | (uint32_t)(s))
+
+/*! Dispatch ready sockets, called by clixon event loop when epoll fd is readable
+ *
+ * Sockets are level-triggered: each ready socket is called once per dispatch, which
+ * gives fairness between devices. A socket that still has input after its callback
+ * is reported again on the next round, without any extra syscall per socket.
+ * Registrations are looked up by socket before each callback, since a callback may
+ * unregister any socket, including its own. If it is closed and the socket number is
+ * reused by a new registration in the same dispatch, a pending event of the old socket
+ * has another generation than the new registration and is skipped.
+ * @param[in] efd  epoll fd
+ * @param[in] arg  Not used
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+static int
+controller_reactor_dispatch(int   efd,
+                            void *arg)
+{
+    int                retval = -1;
+    struct epoll_event events[CONTROLLER_REACTOR_EVENTS];
+    reactor_entry     *re;
+    int                n;
+    int                i;
+    int                s;
+    uint32_t           gen;
+
+    if ((n = epoll_wait(efd, events, CONTROLLER_REACTOR_EVENTS, 0)) < 0){
+        if (errno == EINTR)
+            goto ok;
+        clixon_err(OE_UNIX, errno, "epoll_wait");
+        goto done;
+    }
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "ready: %d", n);
+    for (i=0; i<n; i++){
+        s = (int)(uint32_t)events[i].data.u64;
+        gen = (uint32_t)(events[i].data.u64 >> 32);
+        if (s >= _reactor_len || (re = &_reactor_vec[s])->re_fn == NULL ||
+            re->re_gen != gen)
+            continue;
+        if (re->re_fn(s, re->re_arg) < 0)
+            goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+#endif /* CONTROLLER_EPOLL */
+
+/*! Register a device socket for input
+ *
+ * @param[in]  s    Socket
+ * @param[in]  fn   Function called when socket has input
+ * @param[in]  arg  Argument to fn
+ * @param[in]  str  Debug string
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see controller_reactor_unreg_fd
+ */
+int
+controller_reactor_reg_fd(int    s,
+                          int  (*fn)(int, void*),
+                          void  *arg,
+                          char  *str)
+{
+#ifdef CONTROLLER_EPOLL
+    int                retval = -1;
+    struct epoll_event ev;
+    reactor_entry     *vec;
+    int                len;
+
+    if (s < 0){
+        clixon_err(OE_UNIX, EINVAL, "s is negative");
+        goto done;
+    }
+    if (_reactor_fd == -1){
+        if ((_reactor_fd = epoll_create1(EPOLL_CLOEXEC)) < 0){
+            clixon_err(OE_UNIX, errno, "epoll_create1");
+            goto done;
+        }
+        if (clixon_event_reg_fd(_reactor_fd, controller_reactor_dispatch, NULL, "controller reactor") < 0)
+            goto done;
+    }
+    if (s >= _reactor_len){
+        len = _reactor_len ? _reactor_len : 64;
+        while (len <= s)
+            len *= 2;
+        if ((vec = realloc(_reactor_vec, len*sizeof(*vec))) == NULL){
+            clixon_err(OE_UNIX, errno, "realloc");
+            goto done;
+        }
+        memset(&vec[_reactor_len], 0, (len-_reactor_len)*sizeof(*vec));
+        _reactor_vec = vec;
+        _reactor_len = len;
+    }
+    if (++_reactor_gen == 0) /* 0 is not registered */
+        _reactor_gen++;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_DATA(_reactor_gen, s);
+    if (epoll_ctl(_reactor_fd, EPOLL_CTL_ADD, s, &ev) < 0){
+        clixon_err(OE_UNIX, errno, "epoll_ctl");
+        goto done;
+    }
+    _reactor_vec[s].re_fn = fn;
+    _reactor_vec[s].re_arg = arg;
+    _reactor_vec[s].re_gen = _reactor_gen;
+    _reactor_nr++;
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "%s: %d registered: %d", str, s, _reactor_nr);
+    retval = 0;
+ done:
+    return retval;
+#else
+    return clixon_event_reg_fd(s, fn, arg, str);
+#endif
+}
+
+/*! Unregister a device socket
+ *
+ * Must be called before the socket is closed
+ * @param[in]  s    Socket
+ * @param[in]  fn   Function registered with the socket
+ * @retval     0    OK
+ * @retval    -1    Error, or not found
+ * @see controller_reactor_reg_fd
+ */
+int
+controller_reactor_unreg_fd(int   s,
+                            int (*fn)(int, void*))
+{
+#ifdef CONTROLLER_EPOLL
+    int retval = -1;
+
+    if (s < 0 || s >= _reactor_len || _reactor_vec[s].re_fn != fn){
+        clixon_err(OE_EVENTS, 0, "socket %d not found", s);
+        goto done;
+    }
+    if (epoll_ctl(_reactor_fd, EPOLL_CTL_DEL, s, NULL) < 0){
+        clixon_err(OE_UNIX, errno, "epoll_ctl");
+        goto done;
+    }
+    _reactor_vec[s].re_fn = NULL;
+    _reactor_vec[s].re_arg = NULL;
+    _reactor_vec[s].re_gen = 0;
+    _reactor_nr--;
+    retval = 0;
+ done:
+    return retval;
+#else
+    return clixon_event_unreg_fd(s, fn);
+#endif
+}
+
+/*! Free reactor resources, called on exit
+ *
+ * @retval     0    OK
+ */
+int
+controller_reactor_free(void)
+{
+#ifdef CONTROLLER_EPOLL
+    if (_reactor_fd != -1){
+        clixon_event_unreg_fd(_reactor_fd, controller_reactor_dispatch);
+        close(_reactor_fd);
+        _reactor_fd = -1;
+    }
+    if (_reactor_vec){
+        free(_reactor_vec);
+        _reactor_vec = NULL;
+    }
+    _reactor_len = 0;
+    _reactor_nr = 0;
+    _reactor_gen = 0;
+#endif
+    return 0;
+}
@@ -34,6 +34,7 @@
 #include <syslog.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <regex.h>
 #include <assert.h>
 #include <sys/time.h>
 
@@ -53,6 +54,16 @@
 #include "controller_device_handle.h"
 #include "controller_device_send.h"
 #include "controller_transaction.h"
+#include "controller_dbview.h"
+#include "controller_state_cache.h"
+#include "controller_device_read.h"
+#include "controller_uring.h"
+#include "controller_reactor.h"
+#include "controller_msglog.h"
+#include "controller_span.h"
+#include "controller_template.h"
+#include "controller_memo.h"
+#include "controller_pacing.h"
 #include "controller_rpc.h"
 
 /*! Connect to device via Netconf SSH
@@ -99,7 +110,11 @@ connect_netconf_ssh(clixon_handle h,
     device_handle_framing_type_set(dh, NETCONF_SSH_EOM);
     cbuf_reset(cb); /* reuse cb for event dbg str */
     cprintf(cb, "Netconf ssh %s", addr);
-    if (clixon_event_reg_fd(s, device_input_cb, dh, cbuf_get(cb)) < 0)
+    if (controller_uring_recv_active()){
+        if (controller_uring_recv_reg(s, device_input_data, dh) < 0)
+            goto done;
+    }
+    else if (controller_reactor_reg_fd(s, device_input_cb, dh, cbuf_get(cb)) < 0)
         goto done;
     retval = 0;
  done:
@@ -108,6 +123,34 @@ connect_netconf_ssh(clixon_handle h,
     return retval;
 }
 
+/*! Apply settings of a device that may change while it is connected
+ *
+ * Message log and pacing, set on the device or else on its device-profile.
+ * Applied when the device connects and when the settings are committed.
+ * @param[in]  dh          Device handle
+ * @param[in]  xn          XML of device config
+ * @param[in]  xdevprofile XML of device-profile of device, or NULL
+ * @retval     0           OK
+ * @retval    -1           Error
+ */
+int
+controller_device_settings(device_handle dh,
+                           cxobj        *xn,
+                           cxobj        *xdevprofile)
+{
+    cxobj *xb;
+    char  *str;
+
+    if ((xb = xml_find_type(xn, NULL, "message-log", CX_ELMNT)) == NULL ||
+        xml_flag(xb, XML_FLAG_DEFAULT)){
+        if (xdevprofile)
+            xb = xml_find_type(xdevprofile, NULL, "message-log", CX_ELMNT);
+    }
+    if (controller_msglog_device(dh, xb && (str = xml_body(xb)) != NULL && strcmp(str, "true") == 0) < 0)
+        return -1;
+    return controller_pacing_device(dh, xn, xdevprofile);
+}
+
 /*! Connect to device
  *
  * Typically called from commit
@@ -216,6 +259,8 @@ controller_connect(clixon_handle           h,
     if (xb && (domain = xml_body(xb)) != NULL)
         if (device_handle_domain_set(dh, domain) < 0)
             goto done;
+    if (controller_device_settings(dh, xn, xdevprofile) < 0)
+        goto done;
     /* Parse and save local methods into RFC 8525 yang-lib module-set/module */
     if ((xmod = xml_find_type(xn, NULL, "module-set", CX_ELMNT)) == NULL)
         xmod = xml_find_type(xdevprofile, NULL, "module-set", CX_ELMNT);
@@ -243,16 +288,110 @@ controller_connect(clixon_handle           h,
     goto done;
 }
 
+/*! Append rendered edit-config message without NETCONF framing
+ *
+ * @param[in]  cb     Buffer to append to, XML encoded
+ * @param[in]  cbmsg  Framed edit-config message
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+push_preview_msg(cbuf *cb,
+                 cbuf *cbmsg)
+{
+    int   retval = -1;
+    char *start;
+    char *end;
+    char *p;
+    char  c;
+
+    if ((start = strstr(cbuf_get(cbmsg), "<rpc")) == NULL)
+        goto ok;
+    end = NULL;
+    p = start;
+    while ((p = strstr(p, "</rpc>")) != NULL)
+        end = p++;
+    if (end == NULL)
+        goto ok;
+    end += strlen("</rpc>");
+    c = *end;
+    *end = '\0';
+    retval = xml_chardata_cbuf_append(cb, 0, start);
+    *end = c;
+    if (retval < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Add the computed edit of one device to a push preview transaction
+ *
+ * @param[in]  ct      Transaction
+ * @param[in]  name    Device name
+ * @param[in]  dlen    Number of deleted nodes
+ * @param[in]  alen    Number of added nodes
+ * @param[in]  chlen   Number of changed nodes
+ * @param[in]  cbmsg1  First edit-config (delete), or NULL
+ * @param[in]  cbmsg2  Second edit-config (add and change), or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see push_device_one
+ */
+static int
+push_device_preview(controller_transaction *ct,
+                    char                   *name,
+                    int                     dlen,
+                    int                     alen,
+                    int                     chlen,
+                    cbuf                   *cbmsg1,
+                    cbuf                   *cbmsg2)
+{
+    int    retval = -1;
+    size_t size = 0;
+
+    if (ct->ct_preview == NULL &&
+        (ct->ct_preview = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (cbmsg1)
+        size += cbuf_len(cbmsg1);
+    if (cbmsg2)
+        size += cbuf_len(cbmsg2);
+    cprintf(ct->ct_preview, "<preview>");
+    cprintf(ct->ct_preview, "<name>%s</name>", name);
+    cprintf(ct->ct_preview, "<deleted>%d</deleted>", dlen);
+    cprintf(ct->ct_preview, "<added>%d</added>", alen);
+    cprintf(ct->ct_preview, "<changed>%d</changed>", chlen);
+    cprintf(ct->ct_preview, "<edit-size>%zu</edit-size>", size);
+    if (ct->ct_preview_edit){
+        cprintf(ct->ct_preview, "<edit-config>");
+        if (cbmsg1 && push_preview_msg(ct->ct_preview, cbmsg1) < 0)
+            goto done;
+        if (cbmsg2 && push_preview_msg(ct->ct_preview, cbmsg2) < 0)
+            goto done;
+        cprintf(ct->ct_preview, "</edit-config>");
+    }
+    cprintf(ct->ct_preview, "</preview>");
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Compute diff, construct edit-config and send to device
  *
  * 1) get previous device synced xml
  * 2) get current and compute diff with previous
  * 3) construct an edit-config, send it and validate it
  * 4) phase 2 commit
+ * If push type is PREVIEW, the edit-config is not sent, instead the edit is added to the
+ * transaction and the device leaves the transaction.
  * @param[in]  h       Clixon handle
  * @param[in]  xe      Request: <rpc><xn></rpc>
  * @param[in]  ct      Transaction
- * @param[in]  db      Device datastore
+ * @param[in]  xdb     Read-only view of datastore to push from
  * @param[out] cberr   Error message
  * @retval     1       OK
  * @retval     0       Failed, cbret set
@@ -263,13 +402,13 @@ static int
 push_device_one(clixon_handle           h,
                 device_handle           dh,
                 controller_transaction *ct,
-                char                   *db,
+                cxobj                  *xdb,
                 cbuf                  **cberr)
 {
     int        retval = -1;
     cxobj     *x0 = NULL;
-    cxobj     *x1;
-    cxobj     *x1t = NULL;
+    cxobj     *x1 = NULL;
+    cxobj     *xv;
     cbuf      *cb = NULL;
     char      *name;
     cxobj    **dvec = NULL;
@@ -297,9 +436,8 @@ push_device_one(clixon_handle           h,
         goto done;
     }
     cprintf(cb, "devices/device[name='%s']/config", name);
-    if (xmldb_get0(h, db, YB_MODULE, nsc, cbuf_get(cb), 1, WITHDEFAULTS_EXPLICIT, &x1t, NULL, NULL) < 0)
-        goto done;
-    if ((x1 = xpath_first(x1t, nsc, "%s", cbuf_get(cb))) == NULL){
+    /* Copy only the device config from the view, the diff below modifies it */
+    if ((xv = xpath_first(xdb, nsc, "%s", cbuf_get(cb))) == NULL){
         if ((*cberr = cbuf_new()) == NULL){
             clixon_err(OE_UNIX, errno, "cbuf_new");
             goto done;
@@ -307,6 +445,10 @@ push_device_one(clixon_handle           h,
         cprintf(*cberr, "Device not configured");
         goto failed;
     }
+    if (controller_dbview_copy(xv, NULL, &x1) < 0)
+        goto done;
+    if (x1 == NULL && (x1 = xml_new("config", NULL, CX_ELMNT)) == NULL)
+        goto done;
     yspec = NULL;
     if (controller_mount_yspec_get(h, name, &yspec) < 0)
         goto done;
@@ -333,10 +475,17 @@ push_device_one(clixon_handle           h,
                                            chvec0, chvec1, chlen,
                                            &cbmsg1, &cbmsg2) < 0)
             goto done;
+        if (ct->ct_push_type == PT_PREVIEW){
+            if (push_device_preview(ct, name, dlen, alen, chlen, cbmsg1, cbmsg2) < 0)
+                goto done;
+            device_handle_tid_set(dh, 0);
+            goto ok;
+        }
         if (cbmsg1)
             device_handle_outmsg_set(dh, 1, cbmsg1);
         if (cbmsg2)
             device_handle_outmsg_set(dh, 2, cbmsg2);
+        cbmsg1 = cbmsg2 = NULL;
         if (device_send_lock(h, dh, 1) < 0)
             goto done;
         device_handle_tid_set(dh, ct->ct_id);
@@ -346,8 +495,13 @@ push_device_one(clixon_handle           h,
     else{
         device_handle_tid_set(dh, 0);
     }
+ ok:
     retval = 1;
  done:
+    if (cbmsg1)
+        cbuf_free(cbmsg1);
+    if (cbmsg2)
+        cbuf_free(cbmsg2);
     if (dvec)
         free(dvec);
     if (avec)
@@ -360,8 +514,8 @@ push_device_one(clixon_handle           h,
         cbuf_free(cb);
     if (x0)
         xml_free(x0);
-    if (x1t)
-        xml_free(x1t);
+    if (x1)
+        xml_free(x1);
     return retval;
  failed:
     retval = 0;
@@ -448,7 +602,7 @@ rpc_config_pull(clixon_handle h,
     ct->ct_pull_transient = transient;
     if ((str = xml_find_body(xe, "merge")) != NULL)
         ct->ct_pull_merge = strcmp(str, "true") == 0;
-    if ((ret = xmldb_get0(h, "running", YB_MODULE, nsc, "devices/device", 1, 0, &xret, NULL, NULL)) < 0)
+    if ((ret = controller_dbview_get(h, "running", &xret)) < 0)
         goto done;
     if (ret == 0){
         clixon_err(OE_DB, 0, "Error when reading from running_db, unknown error");
@@ -471,6 +625,13 @@ rpc_config_pull(clixon_handle h,
         if (ret == 0)  /* Failed but cbret set */
             goto ok;
     } /* for */
+    /* Release view before copying running: its default nodes are in the running cache */
+    if (vec){
+        free(vec);
+        vec = NULL;
+    }
+    if (controller_dbview_release(h, &xret) < 0)
+        goto done;
     if (xmldb_db_reset(h, "tmpdev") < 0) /* Requires root access */
         goto done;
     if (xmldb_copy(h, "running", "tmpdev") < 0)
@@ -491,7 +652,7 @@ rpc_config_pull(clixon_handle h,
     if (vec)
         free(vec);
     if (xret)
-        xml_free(xret);
+        controller_dbview_release(h, &xret);
     return retval;
 }
 
@@ -688,8 +849,12 @@ strip_service_data_from_device_config(clixon_handle h,
     int     touch = 0;
 
     /* Get services/created read-only from running_db for reading */
-    if (xmldb_get0(h, "running", YB_NONE, NULL, NULL, 1, WITHDEFAULTS_EXPLICIT, &xt0, NULL, NULL) < 0)
+    if ((ret = controller_dbview_get(h, "running", &xt0)) < 0)
+        goto done;
+    if (ret == 0){
+        clixon_err(OE_DB, 0, "Error when reading from running_db, unknown error");
         goto done;
+    }
     /* Get services/created and devices from action_db for deleting */
     if (xmldb_get0(h, db, YB_NONE, NULL, NULL, 1, WITHDEFAULTS_EXPLICIT, &xt1, NULL, NULL) < 0)
         goto done;
@@ -751,6 +916,7 @@ strip_service_data_from_device_config(clixon_handle h,
             touch++;
         }
     }
+    controller_dbview_release(h, &xt0);
     if (touch){
         /* XXX Somewhat raw to replace the top-level tree, could do with op=REMOVE
          * of the sub-parts instead of marking and remove
@@ -773,7 +939,7 @@ strip_service_data_from_device_config(clixon_handle h,
     if (cbret)
         cbuf_free(cbret);
     if (xt0)
-        xml_free(xt0);
+        controller_dbview_release(h, &xt0);
     if (xt1)
         xml_free(xt1);
     return retval;
@@ -797,18 +963,28 @@ controller_commit_push(clixon_handle           h,
 {
     int           retval = -1;
     device_handle dh = NULL;
+    cxobj        *xdb = NULL;
     int           ret;
 
+    /* One view for all devices, db is not written while pushing */
+    if ((ret = controller_dbview_get(h, db, &xdb)) < 0)
+        goto done;
+    if (ret == 0){
+        clixon_err(OE_DB, 0, "Error when reading from %s", db);
+        goto done;
+    }
     while ((dh = device_handle_each(h, dh)) != NULL){
         if (device_handle_tid_get(dh) != ct->ct_id)
             continue;
-        if ((ret = push_device_one(h, dh, ct, db, cberr)) < 0)
+        if ((ret = push_device_one(h, dh, ct, xdb, cberr)) < 0)
             goto done;
         if (ret == 0)  /* Failed but cbret set */
             goto failed;
     }
     retval = 1;
  done:
+    if (xdb)
+        controller_dbview_release(h, &xdb);
     return retval;
  failed:
     retval = 0;
@@ -848,6 +1024,12 @@ commit_push_after_actions(clixon_handle           h,
          */
         if ((ret = controller_commit_push(h, ct, "actions", &cberr)) < 0)
             goto done;
+        if (ret == 1 && ct->ct_push_type == PT_PREVIEW){
+            /* Edits are computed, nothing is pushed or committed */
+            if (controller_transaction_done(h, ct, TR_SUCCESS) < 0)
+                goto done;
+            goto ok;
+        }
         if (ret == 0){
             if ((ct->ct_origin = strdup("controller")) == NULL){
                 clixon_err(OE_UNIX, errno, "strdup");
@@ -917,6 +1099,100 @@ commit_push_after_actions(clixon_handle           h,
     return retval;
 }
 
+/*! Remove service instances that can reuse their previous output
+ *
+ * With FORCE of all services, all instances are first listed explicitly.
+ * The remaining instances are saved in the transaction, and their digests are recorded
+ * when the transaction is committed, see controller_transaction_done.
+ * @param[in]  h        Clixon handle
+ * @param[in]  ct       Transaction
+ * @param[in]  xt       Target config tree
+ * @param[in]  actions  How to trigger service-commit notifications
+ * @param[in,out] cvv   Vector of service instances, on the form name:<service>[<key>='<value>']
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @see controller_memo.c
+ */
+static int
+controller_actions_memo(clixon_handle           h,
+                        controller_transaction *ct,
+                        cxobj                  *xt,
+                        actions_type            actions,
+                        cvec                   *cvv)
+{
+    int        retval = -1;
+    cvec      *cvv1 = NULL;
+    cvec      *skip = NULL;
+    cbuf      *cb = NULL;
+    cxobj     *xs;
+    cxobj     *xn;
+    cxobj     *xi;
+    char      *instance;
+    yang_stmt *y;
+    cg_var    *cv;
+    int        ret;
+
+    if ((cvv1 = cvec_new(0)) == NULL ||
+        (skip = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        goto done;
+    }
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (actions == AT_FORCE && cvec_len(cvv) == 0 &&
+        (xs = xpath_first(xt, NULL, "services")) != NULL){
+        xn = NULL;
+        while ((xn = xml_child_each(xs, xn, CX_ELMNT)) != NULL){
+            if ((y = xml_spec(xn)) != NULL && yang_keyword_get(y) != Y_LIST)
+                continue;
+            /* Assume first entry is key, as controller_actions_diff */
+            if ((xi = xml_find_type(xn, NULL, NULL, CX_ELMNT)) == NULL ||
+                (instance = xml_body(xi)) == NULL)
+                continue;
+            cbuf_reset(cb);
+            cprintf(cb, "%s[%s='%s']", xml_name(xn), xml_name(xi), instance);
+            if (cvec_add_string(cvv, cbuf_get(cb), NULL) < 0){
+                clixon_err(OE_UNIX, errno, "cvec_add_string");
+                goto done;
+            }
+        }
+    }
+    cv = NULL;
+    while ((cv = cvec_each(cvv, cv)) != NULL){
+        if ((ret = controller_memo_check(h, xt, cv_name_get(cv))) < 0)
+            goto done;
+        if (cvec_add_string(ret ? skip : cvv1, cv_name_get(cv), NULL) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+    if (controller_memo_shared(xt, cvv1, skip) < 0)
+        goto done;
+    cvec_reset(cvv);
+    cv = NULL;
+    while ((cv = cvec_each(cvv1, cv)) != NULL){
+        if (cvec_add_string(cvv, cv_name_get(cv), NULL) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+    if (ct->ct_memo)
+        cvec_free(ct->ct_memo);
+    ct->ct_memo = cvv1;
+    cvv1 = NULL;
+    retval = 0;
+ done:
+    if (cvv1)
+        cvec_free(cvv1);
+    if (skip)
+        cvec_free(skip);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
 /*! Compute diff of candidate + commit and trigger service-commit notify
  *
  * @param[in]  h         Clixon handle
@@ -957,12 +1233,16 @@ controller_commit_actions(clixon_handle           h,
         if (service_instance)
             cvec_add_string(cvv, service_instance, NULL);
     }
+    /* Reuse output of service instances whose input and output are unchanged */
+    if (services && controller_memo_enabled(td->td_target) &&
+        controller_actions_memo(h, ct, td->td_target, actions, cvv) < 0)
+        goto done;
     /* 1) copy candidate to actions and remove all device config tagged with services */
     if (xmldb_copy(h, "candidate", "actions") < 0)
         goto done;
     xmldb_volatile_set(h, "actions", 1);
     if (services &&
-        (actions == AT_FORCE || cvec_len(cvv) > 0)){
+        ((actions == AT_FORCE && ct->ct_memo == NULL) || cvec_len(cvv) > 0)){
         /* IF Services exist AND
            either service changes or forced,
            THEN notify services
@@ -975,6 +1255,11 @@ controller_commit_actions(clixon_handle           h,
         cprintf(notifycb, "<tid>%" PRIu64"</tid>", ct->ct_id);
         cprintf(notifycb, "<source>actions</source>");
         cprintf(notifycb, "<target>actions</target>");
+        if (ct->ct_spans){
+            cprintf(notifycb, "<traceparent>");
+            controller_span_traceparent(ct, notifycb);
+            cprintf(notifycb, "</traceparent>");
+        }
 
 	if (diff)
 	    cprintf(notifycb, "<diff>true</diff>");
@@ -1015,13 +1300,15 @@ controller_commit_actions(clixon_handle           h,
  * @param[in]  h       Clixon handle
  * @param[in]  device  Name of device to push to, can use wildchars for several, or NULL for all
  * @param[in]  tid     Transaction id
+ * @param[out] busy    Device in another transaction, matching was interrupted
  * @retval     0       OK, note if "closed" is set, then matching was interrupted
  * @retval    -1       Error
  */
 static int
 devices_match(clixon_handle   h,
               char           *device,
-              uint64_t        tid)
+              uint64_t        tid,
+              device_handle  *busy)
 {
     int           retval = -1;
     cxobj       **vec = NULL;
@@ -1035,7 +1322,7 @@ devices_match(clixon_handle   h,
     char         *body;
     int           ret;
 
-    if ((ret = xmldb_get0(h, "running", YB_MODULE, nsc, "devices", 1, 0, &xret, NULL, NULL)) < 0)
+    if ((ret = controller_dbview_get(h, "running", &xret)) < 0)
         goto done;
     if (ret == 0){
         clixon_err(OE_DB, 0, "Error when reading from running_db, unknown error");
@@ -1057,13 +1344,18 @@ devices_match(clixon_handle   h,
             continue;
         if (strcmp(body, "true") != 0)
             continue;
+        /* Device has a request of another transaction, eg get-device-state */
+        if (device_handle_tid_get(dh) != 0 && device_handle_tid_get(dh) != tid){
+            *busy = dh;
+            break;
+        }
         /* Include device in transaction */
         device_handle_tid_set(dh, tid);
     } /* for */
     retval = 0;
  done:
     if (xret)
-        xml_free(xret);
+        controller_dbview_release(h, &xret);
     if (vec)
         free(vec);
     return retval;
@@ -1143,6 +1435,83 @@ devices_local_change(clixon_handle       h,
     return retval;
 }
 
+/*! Copy datastore except devices not in transaction
+ *
+ * Devices without a device handle are copied.
+ * Equivalent to copying the whole datastore and purging other devices, but those
+ * devices are never copied.
+ * @param[in]  h      Clixon handle
+ * @param[in]  ct     Controller transaction
+ * @param[in]  db     Datastore
+ * @param[out] xtp    Copy of datastore, free with xml_free
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+devices_diff_copy(clixon_handle           h,
+                  controller_transaction *ct,
+                  char                   *db,
+                  cxobj                 **xtp)
+{
+    int           retval = -1;
+    cxobj        *xv = NULL;
+    cxobj        *xt = NULL;
+    cxobj        *xc;
+    cxobj        *xd;
+    cxobj        *xds = NULL;
+    cxobj        *x1;
+    device_handle dh;
+    char         *name;
+    int           ret;
+
+    if ((ret = controller_dbview_get(h, db, &xv)) < 0)
+        goto done;
+    if (ret == 0){
+        clixon_err(OE_DB, 0, "Error when reading from %s", db);
+        goto done;
+    }
+    if ((xt = xml_new(xml_name(xv), NULL, CX_ELMNT)) == NULL)
+        goto done;
+    if (xml_copy_one(xv, xt) < 0)
+        goto done;
+    xc = NULL;
+    while ((xc = xml_child_each(xv, xc, -1)) != NULL){
+        if (xml_type(xc) != CX_ELMNT || strcmp(xml_name(xc), "devices") != 0){
+            if (controller_dbview_copy(xc, xt, &x1) < 0)
+                goto done;
+            continue;
+        }
+        if ((xds = xml_new(xml_name(xc), NULL, CX_ELMNT)) == NULL)
+            goto done;
+        if (xml_copy_one(xc, xds) < 0)
+            goto done;
+        xd = NULL;
+        while ((xd = xml_child_each(xc, xd, -1)) != NULL){
+            if (xml_type(xd) == CX_ELMNT && strcmp(xml_name(xd), "device") == 0 &&
+                (name = xml_find_body(xd, "name")) != NULL &&
+                (dh = device_handle_find(h, name)) != NULL &&
+                device_handle_tid_get(dh) != ct->ct_id)
+                continue;
+            if (controller_dbview_copy(xd, xds, &x1) < 0)
+                goto done;
+        }
+        if (xml_addsub(xt, xds) < 0)
+            goto done;
+        xds = NULL;
+    }
+    *xtp = xt;
+    xt = NULL;
+    retval = 0;
+ done:
+    if (xds)
+        xml_free(xds);
+    if (xt)
+        xml_free(xt);
+    if (xv)
+        controller_dbview_release(h, &xv);
+    return retval;
+}
+
 /*! Diff candidate/running and fill in a diff transaction structure for devices in transaction
  *
  * and check if any changed device is closed
@@ -1166,21 +1535,11 @@ devices_diff(clixon_handle           h,
     char         *name;
     int           i;
 
-    if (xmldb_get0(h, "candidate", YB_MODULE, nsc, "/", 1, WITHDEFAULTS_EXPLICIT, &td->td_target, NULL, NULL) < 0)
+    /* Copy only devices in transaction */
+    if (devices_diff_copy(h, ct, "candidate", &td->td_target) < 0)
         goto done;
-    if (xmldb_get0(h, "running", YB_MODULE, nsc, "/", 1, WITHDEFAULTS_EXPLICIT, &td->td_src, NULL, NULL) < 0)
+    if (devices_diff_copy(h, ct, "running", &td->td_src) < 0)
         goto done;
-    /* Remove devices not in transaction */
-    dh = NULL;
-    while ((dh = device_handle_each(h, dh)) != NULL){
-        if (device_handle_tid_get(dh) == ct->ct_id)
-            continue;
-        name = device_handle_name_get(dh);
-        if ((xn = xpath_first(td->td_src, nsc, "devices/device[name='%s']", name)) != NULL)
-            xml_purge(xn);
-        if ((xn = xpath_first(td->td_target, nsc, "devices/device[name='%s']", name)) != NULL)
-            xml_purge(xn);
-    }
     if (xml_diff(td->td_src,
                  td->td_target,
                 &td->td_dvec,      /* removed: only in running */
@@ -1243,8 +1602,8 @@ devices_diff(clixon_handle           h,
  *
  * @param[in]  h      Clixon handle
  * @param[in]  ct     Controller transaction
- * @param[in]  dh     Device handle (reason=0,1)
- * @param[in]  reason 0: closed, 1: changed, 2: no devices, 3: no changes
+ * @param[in]  dh     Device handle (reason=0,1,4)
+ * @param[in]  reason 0: closed, 1: changed, 2: no devices, 3: no changes, 4: busy
  * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
  * @retval     0      OK
  * @retval    -1      Error
@@ -1279,6 +1638,9 @@ device_error(clixon_handle           h,
     case 3: /* unchanged */
         cprintf(cb, "No change to devices");
         break;
+    case 4: /* busy */
+        cprintf(cb, "Device '%s' is busy in another transaction (try again later)", name);
+        break;
     }
     if (netconf_operation_failed(cbret, "application", cbuf_get(cb))< 0)
         goto done;
@@ -1301,6 +1663,8 @@ device_error(clixon_handle           h,
 
 /*! Extended commit: trigger actions and device push
  *
+ * If push is PREVIEW, device edits are computed locally and saved in the transaction
+ * without contacting devices.
  * @param[in]  h       Clixon handle
  * @param[in]  xe      Request: <rpc><xn></rpc>
  * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
@@ -1330,6 +1694,7 @@ rpc_controller_commit(clixon_handle h,
     cbuf                   *cbtr = NULL;
     cbuf                   *cberr = NULL;
     device_handle           closed = NULL;
+    device_handle           busy = NULL;
     device_handle           changed = NULL;
     transaction_data_t     *td = NULL;
     char                   *service_instance = NULL;
@@ -1389,12 +1754,19 @@ rpc_controller_commit(clixon_handle h,
         goto ok;
     }
     ct->ct_push_type = pusht;
+    if ((str = xml_find_body(xe, "preview-edit-config")) != NULL)
+        ct->ct_preview_edit = strcmp(str, "true") == 0;
     ct->ct_actions_type = actions;
     ct->ct_sourcedb = sourcedb;
     sourcedb = NULL;
     /* Mark devices with transaction-id if name matches device pattern */
-    if (devices_match(h, device, ct->ct_id) < 0)
+    if (devices_match(h, device, ct->ct_id, &busy) < 0)
         goto done;
+    if (busy != NULL){
+        if (device_error(h, ct, busy, 4, cbret) < 0)
+            goto done;
+        goto ok;
+    }
     /* If there are no devices selected and push != NONE */
     if (controller_transaction_nr_devices(h, ct->ct_id) == 0 && pusht != PT_NONE){
         if (device_error(h, ct, NULL, 2, cbret) < 0)
@@ -1409,7 +1781,7 @@ rpc_controller_commit(clixon_handle h,
     if (devices_diff(h, ct, td, &closed) < 0)
         goto done;
     /* If device is closed and push != NONE, then error */
-    if (closed != NULL && pusht != PT_NONE){
+    if (closed != NULL && pusht != PT_NONE && pusht != PT_PREVIEW){
         if (device_error(h, ct, closed, 0, cbret) < 0)
             goto done;
         goto ok;
@@ -1433,7 +1805,12 @@ rpc_controller_commit(clixon_handle h,
                 goto done;
             goto ok;
         }
-        if (controller_transaction_nr_devices(h, ct->ct_id) == 0){
+        if (pusht == PT_PREVIEW){
+            /* Edits are computed, nothing is pushed */
+            if (controller_transaction_done(h, ct, TR_SUCCESS) < 0)
+                goto done;
+        }
+        else if (controller_transaction_nr_devices(h, ct->ct_id) == 0){
             /* No device started, close transaction */
             if (netconf_operation_failed(cbret, "application", "No changes to push")< 0)
                 goto done;
@@ -1519,11 +1896,11 @@ rpc_get_device_config(clixon_handle h,
     config_type = xml_find_body(xe, "config-type");
     dt = device_config_type_str2int(config_type);
     if (dt == DT_CANDIDATE){
-        if ((ret = xmldb_get0(h, "candidate", YB_MODULE, nsc, "devices/device", 1, 0, &xret, NULL, NULL)) < 0)
+        if ((ret = controller_dbview_get(h, "candidate", &xret)) < 0)
             goto done;
     }
     else{
-        if ((ret = xmldb_get0(h, "running", YB_MODULE, nsc, "devices/device", 1, 0, &xret, NULL, NULL)) < 0)
+        if ((ret = controller_dbview_get(h, "running", &xret)) < 0)
             goto done;
     }
     if (ret == 0){
@@ -1585,7 +1962,7 @@ rpc_get_device_config(clixon_handle h,
     if (vec)
         free(vec);
     if (xret)
-        xml_free(xret);
+        controller_dbview_release(h, &xret);
     if (xroot)
         xml_free(xroot);
     return retval;
@@ -1949,6 +2326,35 @@ datastore_diff_dsref(clixon_handle    h,
     return retval;
 }
 
+/*! Get read-only view of datastore unless already taken
+ *
+ * @param[in]     h    Clixon handle
+ * @param[in]     db   Datastore
+ * @param[in,out] xvp  View, release with controller_dbview_release
+ * @retval        0    OK
+ * @retval       -1    Error
+ */
+static int
+datastore_diff_view(clixon_handle h,
+                    char         *db,
+                    cxobj       **xvp)
+{
+    int retval = -1;
+    int ret;
+
+    if (*xvp == NULL){
+        if ((ret = controller_dbview_get(h, db, xvp)) < 0)
+            goto done;
+        if (ret == 0){
+            clixon_err(OE_DB, 0, "Error when reading from %s", db);
+            goto done;
+        }
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Given a device pattern, return diff in textual form between different device configs
  *
  * That is diff of configs for same device, only different variants, eg synced, transient, running, etc
@@ -1973,38 +2379,32 @@ datastore_diff_device(clixon_handle      h,
                       cbuf              *cbret)
 {
     int           retval = -1;
-    cbuf         *cbxpath = NULL;
     cbuf         *cberr = NULL;
     cbuf         *cb = NULL;
-    cxobj        *x1;
-    cxobj        *x2;
     cxobj        *x1m = NULL; /* malloced */
     cxobj        *x2m = NULL;
     cvec         *nsc = NULL;
-    cxobj        *xret = NULL;
-    cxobj        *x1ret = NULL;
-    cxobj        *x2ret = NULL;
+    cxobj        *xvrun = NULL; /* Read-only views */
+    cxobj        *xvcand = NULL;
+    cxobj        *xvact = NULL;
     cxobj       **vec = NULL;
     size_t        veclen;
     char         *devname;
     cxobj        *xdev;
+    cxobj        *xc;
     device_handle dh;
     int           i;
     int           ret;
     char         *ct;
 
-    if ((cbxpath = cbuf_new()) == NULL){
-        clixon_err(OE_UNIX, errno, "cbuf_new");
-        goto done;
-    }
     if ((cb = cbuf_new()) == NULL){
         clixon_err(OE_UNIX, errno, "cbuf_new");
         goto done;
     }
-    if (xmldb_get0(h, "running", YB_MODULE, nsc, "devices/device/name", 1, WITHDEFAULTS_EXPLICIT, &xret, NULL, NULL) < 0)
+    if (datastore_diff_view(h, "running", &xvrun) < 0)
         goto done;
     cprintf(cbret, "<rpc-reply xmlns=\"%s\">", NETCONF_BASE_NAMESPACE);
-    if (xpath_vec(xret, nsc, "devices/device/name", &vec, &veclen) < 0)
+    if (xpath_vec(xvrun, nsc, "devices/device/name", &vec, &veclen) < 0)
         goto done;
     for (i=0; i<veclen; i++){
         xdev = vec[i];
@@ -2014,28 +2414,28 @@ datastore_diff_device(clixon_handle      h,
             continue;
         if (pattern != NULL && fnmatch(pattern, devname, 0) != 0)
             continue;
-        x1 = x1m = NULL;
+        x1m = NULL;
         switch (dt1){
         case DT_RUNNING:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "running", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x1ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "running", &xvrun) < 0)
+                goto done;
+            if ((xc = xpath_first(xvrun, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x1m) < 0)
                 goto done;
-            x1 = xpath_first(x1ret, nsc, "devices/device/config");
             break;
         case DT_CANDIDATE:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "candidate", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x1ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "candidate", &xvcand) < 0)
+                goto done;
+            if ((xc = xpath_first(xvcand, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x1m) < 0)
                 goto done;
-            x1 = xpath_first(x1ret, nsc, "devices/device/config");
             break;
         case DT_ACTIONS:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "actions", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x1ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "actions", &xvact) < 0)
+                goto done;
+            if ((xc = xpath_first(xvact, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x1m) < 0)
                 goto done;
-            x1 = xpath_first(x1ret, nsc, "devices/device/config");
             break;
         case DT_SYNCED:
         case DT_TRANSIENT:
@@ -2050,28 +2450,28 @@ datastore_diff_device(clixon_handle      h,
             }
             break;
         }
-        x2 = x2m = NULL;
+        x2m = NULL;
         switch (dt2){
         case DT_RUNNING:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "running", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x2ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "running", &xvrun) < 0)
+                goto done;
+            if ((xc = xpath_first(xvrun, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x2m) < 0)
                 goto done;
-            x2 = xpath_first(x2ret, nsc, "devices/device/config");
             break;
         case DT_CANDIDATE:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "candidate", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x2ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "candidate", &xvcand) < 0)
+                goto done;
+            if ((xc = xpath_first(xvcand, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x2m) < 0)
                 goto done;
-            x2 = xpath_first(x2ret, nsc, "devices/device/config");
             break;
         case DT_ACTIONS:
-            cbuf_reset(cbxpath);
-            cprintf(cbxpath, "devices/device[name='%s']/config", devname);
-            if (xmldb_get0(h, "actions", YB_MODULE, nsc, cbuf_get(cbxpath), 1, WITHDEFAULTS_EXPLICIT, &x2ret, NULL, NULL) < 0)
+            if (datastore_diff_view(h, "actions", &xvact) < 0)
+                goto done;
+            if ((xc = xpath_first(xvact, nsc, "devices/device[name='%s']/config", devname)) != NULL &&
+                controller_dbview_copy(xc, NULL, &x2m) < 0)
                 goto done;
-            x2 = xpath_first(x2ret, nsc, "devices/device/config");
             break;
         case DT_SYNCED:
         case DT_TRANSIENT:
@@ -2089,7 +2489,7 @@ datastore_diff_device(clixon_handle      h,
         switch (format){
         case FORMAT_XML:
             cbuf_reset(cb);
-            if (clixon_xml_diff2cbuf(cb, x1?x1:x1m, x2?x2:x2m) < 0)
+            if (clixon_xml_diff2cbuf(cb, x1m, x2m) < 0)
                 goto done;
             if (cbuf_len(cb)){
                 cprintf(cbret, "<diff xmlns=\"%s\">", CONTROLLER_NAMESPACE);
@@ -2100,7 +2500,7 @@ datastore_diff_device(clixon_handle      h,
             break;
         case FORMAT_TEXT:
             cbuf_reset(cb);
-            if (clixon_text_diff2cbuf(cb, x1?x1:x1m, x2?x2:x2m) < 0)
+            if (clixon_text_diff2cbuf(cb, x1m, x2m) < 0)
                 goto done;
             if (cbuf_len(cb)){
                 cprintf(cbret, "<diff xmlns=\"%s\">", CONTROLLER_NAMESPACE);
@@ -2122,14 +2522,6 @@ datastore_diff_device(clixon_handle      h,
             xml_free(x2m);
             x2m = NULL;
         }
-        if (x1ret){
-            xml_free(x1ret);
-            x1ret = NULL;
-        }
-        if (x2ret){
-            xml_free(x2ret);
-            x2ret = NULL;
-        }
     }
     cprintf(cbret, "</rpc-reply>");
  ok:
@@ -2141,18 +2533,16 @@ datastore_diff_device(clixon_handle      h,
         xml_free(x2m);
     if (vec)
         free(vec);
-    if (xret)
-        xml_free(xret);
-    if (x1ret)
-        xml_free(x1ret);
-    if (x2ret)
-        xml_free(x2ret);
+    if (xvrun)
+        controller_dbview_release(h, &xvrun);
+    if (xvcand)
+        controller_dbview_release(h, &xvcand);
+    if (xvact)
+        controller_dbview_release(h, &xvact);
     if (cberr)
         cbuf_free(cberr);
     if (cb)
         cbuf_free(cb);
-    if (cbxpath)
-        cbuf_free(cbxpath);
     return retval;
 }
 
@@ -2256,6 +2646,7 @@ rpc_datastore_diff(clixon_handle h,
 
 /*! Intercept services-commit create-subscription and deny if there is already one
  *
+ * An accepted subscription is a new or restarted action daemon, clear memoized service actions.
  * The registration should be made from plugin-init to ensure the check is made before
  * the regular from_client_create_subscription callback
  * @param[in]  h       Clixon handle
@@ -2303,8 +2694,11 @@ check_services_commit_subscription(clixon_handle h,
             cbuf_reset(cbret);
             if (netconf_operation_failed(cbret, "application", "services-commit client already registered")< 0)
                 goto done;
+            goto ok;
         }
     }
+    /* A (re)connected action daemon may produce other output than memoized */
+    controller_memo_free(h);
  ok:
     retval = 0;
  done:
@@ -2349,6 +2743,44 @@ xvars2cvv(cxobj  *xvars,
     return retval;
 }
 
+/*! Add or replace variables in a cligen variable vector given XML of variables
+ *
+ * @param[in]  xvars  XML tree on the form: variables/variable/name,value
+ * @param[in]  cvv    Cvec, existing variables are replaced
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see xvars2cvv
+ */
+static int
+xvars2cvv_merge(cxobj *xvars,
+                cvec  *cvv)
+{
+    int     retval = -1;
+    cxobj  *xv;
+    char   *name;
+    char   *value;
+    cg_var *cv;
+
+    xv = NULL;
+    while ((xv = xml_child_each(xvars, xv, CX_ELMNT)) != NULL) {
+        name = xml_find_body(xv, "name");
+        value = xml_find_body(xv, "value");
+        if ((cv = cvec_find(cvv, name)) != NULL){
+            if (cv_string_set(cv, value ? value : "") == NULL){
+                clixon_err(OE_UNIX, errno, "cv_string_set");
+                goto done;
+            }
+        }
+        else if (cvec_add_string(cvv, name, value) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Action callback, see clixon-controller.yang: devices/template/apply
  *
  * @param[in]  h       Clixon handle
@@ -2375,9 +2807,13 @@ rpc_device_template_apply(clixon_handle h,
     cxobj        *xtmpl;
     cxobj        *xvars;
     cxobj        *xvars0;
+    cxobj        *xdvars;
     cvec         *cvv = NULL;
+    cvec         *cvvd = NULL;
     cxobj        *xv;
+    cxobj        *xconf;
     char         *varname;
+    controller_template *tm;
     cxobj        *xd;
     char         *devname;
     char         *pattern;
@@ -2385,7 +2821,6 @@ rpc_device_template_apply(clixon_handle h,
     int           i;
     int           ret;
     cxobj        *xerr = NULL;
-    cxobj        *xtc = NULL;
     cxobj        *xroot = NULL;
     cxobj        *xmnt = NULL;
     cxobj        *x;
@@ -2404,7 +2839,8 @@ rpc_device_template_apply(clixon_handle h,
             goto done;
         goto ok;
     }
-    if ((xtmpl = xpath_first(xret, nsc, "devices/template[name='%s']/config", tmplname)) == NULL){
+    if ((xtmpl = xpath_first(xret, nsc, "devices/template[name='%s']", tmplname)) == NULL ||
+        xml_find_type(xtmpl, NULL, "config", CX_ELMNT) == NULL){
         if (netconf_operation_failed(cbret, "application", "Template not found")< 0)
             goto done;
         goto ok;
@@ -2426,24 +2862,35 @@ rpc_device_template_apply(clixon_handle h,
             goto ok;
         }
     }
-    xv = NULL;
-    while ((xv = xml_child_each(xvars0, xv, CX_ELMNT)) != NULL) {
-        varname = xml_find_body(xv, "name");
-        if (xpath_first(xvars, nsc, "variable[name='%s']", varname) == NULL){
-            if (netconf_missing_element(cbret, "application", varname, "Template variable")< 0)
-                goto done;
-            goto ok;
+    /* Per-device bindings, eg from a CSV file, also only formal parameters */
+    xdvars = NULL;
+    while ((xdvars = xml_child_each(xe, xdvars, CX_ELMNT)) != NULL) {
+        if (strcmp(xml_name(xdvars), "device-variables") != 0)
+            continue;
+        xv = NULL;
+        while ((xv = xml_child_each(xml_find_type(xdvars, NULL, "variables", CX_ELMNT), xv, CX_ELMNT)) != NULL) {
+            varname = xml_find_body(xv, "name");
+            if (xpath_first(xvars0, nsc, "variable[name='%s']", varname) == NULL){
+                if (netconf_unknown_element(cbret, "application", varname, "No such template variable")< 0)
+                    goto done;
+                goto ok;
+            }
+        }
+    }
+    /* Without per-device bindings, all formal parameters must be bound here */
+    if (xml_find_type(xe, NULL, "device-variables", CX_ELMNT) == NULL){
+        xv = NULL;
+        while ((xv = xml_child_each(xvars0, xv, CX_ELMNT)) != NULL) {
+            varname = xml_find_body(xv, "name");
+            if (xpath_first(xvars, nsc, "variable[name='%s']", varname) == NULL){
+                if (netconf_missing_element(cbret, "application", varname, "Template variable")< 0)
+                    goto done;
+                goto ok;
+            }
         }
     }
     if (xvars2cvv(xvars, &cvv) < 0)
         goto done;
-    /* Destructively substitute variables in xtempl
-     * Maybe work on a copy instead?
-     */
-    if (cvv && xml_apply(xtmpl, CX_ELMNT, xml_template_apply, cvv) < 0)
-        goto done;
-    if (xml_sort_recurse(xtmpl) < 0)
-        goto done;
     if ((cb = cbuf_new()) == NULL){
         clixon_err(OE_UNIX, errno, "cbuf_new");
         goto done;
@@ -2454,16 +2901,37 @@ rpc_device_template_apply(clixon_handle h,
     /* Get devices from config */
     if (xpath_vec(xret, nsc, "devices/device", &vec, &veclen) < 0)
         goto done;
-    matching=0;
-    /* Apply xtempl on all matching devices */
+    /* 1. Check that all formal parameters are bound for all matching devices before applying */
     for (i=0; i<veclen; i++){
         xd = vec[i];
-        if ((devname = xml_find_body(xd, "name")) == NULL)
-            continue;
-        if (pattern != NULL && fnmatch(pattern, devname, 0) != 0)
+        if ((devname = xml_find_body(xd, "name")) == NULL ||
+            (pattern != NULL && fnmatch(pattern, devname, 0) != 0) ||
+            device_handle_find(h, devname) == NULL){
+            vec[i] = NULL;
             continue;
-        if ((dh = device_handle_find(h, devname)) == NULL)
+        }
+        xdvars = xpath_first(xe, nsc, "device-variables[devname='%s']/variables", devname);
+        xv = NULL;
+        while ((xv = xml_child_each(xvars0, xv, CX_ELMNT)) != NULL) {
+            varname = xml_find_body(xv, "name");
+            if (cvec_find(cvv, varname) == NULL &&
+                xpath_first(xdvars, nsc, "variable[name='%s']", varname) == NULL){
+                if (netconf_missing_element(cbret, "application", varname, "Template variable")< 0)
+                    goto done;
+                goto ok;
+            }
+        }
+    }
+    /* Compiled template: variables are substituted by filling its slots */
+    if (controller_template_get(xtmpl, &tm) < 0)
+        goto done;
+    matching=0;
+    /* 2. Apply xtempl on all matching devices */
+    for (i=0; i<veclen; i++){
+        if ((xd = vec[i]) == NULL)
             continue;
+        devname = xml_find_body(xd, "name");
+        dh = device_handle_find(h, devname);
         if (device_state_mount_point_get(devname, yspec0, &xroot, &xmnt) < 0)
             goto done;
         yspec1 = NULL;
@@ -2473,29 +2941,49 @@ rpc_device_template_apply(clixon_handle h,
             device_close_connection(dh, "No YANGs available");
             goto done;
         }
-        if ((xtc = xml_dup(xtmpl)) == NULL)
-            goto done;
-        if ((ret = xml_bind_yang(h, xtc, YB_MODULE, yspec1, &xerr)) < 0)
+        /* Device bindings override common bindings */
+        if (cvvd){
+            cvec_free(cvvd);
+            cvvd = NULL;
+        }
+        if ((xdvars = xpath_first(xe, nsc, "device-variables[devname='%s']/variables", devname)) != NULL){
+            if ((cvvd = cvec_dup(cvv)) == NULL){
+                clixon_err(OE_UNIX, errno, "cvec_dup");
+                goto done;
+            }
+            if (xvars2cvv_merge(xdvars, cvvd) < 0)
+                goto done;
+        }
+        /* Bound and sorted once per device yang spec, not per device */
+        if ((ret = controller_template_bind(h, tm, yspec1, &xerr)) < 0)
             goto done;
         if (ret == 0){
             if (clixon_xml2cbuf(cbret, xerr, 0, 0, NULL, -1, 0) < 0)
                 goto done;
             goto ok;
         }
-        while ((x = xml_child_i_type(xtc, 0, CX_ELMNT)) != NULL) {
-            if (xml_addsub(xmnt, x) < 0)
+        if (controller_template_fill(tm, cvvd ? cvvd : cvv, &xconf) < 0)
+            goto done;
+        /* Lend the filled config to the mount-point and move it back after put */
+        while ((x = xml_child_i_type(xconf, 0, CX_ELMNT)) != NULL) {
+            if (xml_addsub(xmnt, x) < 0){
+                controller_template_invalidate(tmplname);
                 goto done;
+            }
         }
-        if ((ret = xmldb_put(h, "candidate", OP_MERGE, xroot, NULL, cbret)) < 0)
+        ret = xmldb_put(h, "candidate", OP_MERGE, xroot, NULL, cbret);
+        while ((x = xml_child_i_type(xmnt, 0, CX_ELMNT)) != NULL) {
+            if (xml_addsub(xconf, x) < 0){
+                controller_template_invalidate(tmplname);
+                goto done;
+            }
+        }
+        if (ret < 0)
             goto done;
         if (ret == 0)
             goto ok;
         xml_rm(xroot);
         matching++;
-        if (xtc){
-            xml_free(xtc);
-            xtc = NULL;
-        }
         if (xroot){
             xml_free(xroot);
             xroot = NULL;
@@ -2509,14 +2997,14 @@ rpc_device_template_apply(clixon_handle h,
  done:
     if (cvv)
         cvec_free(cvv);
+    if (cvvd)
+        cvec_free(cvvd);
     if (cb)
         cbuf_free(cb);
     if (xret)
         xml_free(xret);
     if (xerr)
         xml_free(xerr);
-    if (xtc)
-        xml_free(xtc);
     if (xroot)
         xml_free(xroot);
     if (vec)
@@ -2763,6 +3251,873 @@ controller_edit_config(clixon_handle h,
     return retval;
 }
 
+/*! Match device names against a glob or regex pattern and return matching names
+ *
+ * Matching is made here instead of in the client to avoid sending all device names,
+ * or configs, to the client.
+ * @param[in]  h       Clixon handle
+ * @param[in]  xe      Request: <rpc><xn></rpc>
+ * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
+ * @param[in]  arg     client-entry
+ * @param[in]  regarg  User argument given at rpc_callback_register()
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+rpc_device_match(clixon_handle h,
+                 cxobj        *xe,
+                 cbuf         *cbret,
+                 void         *arg,
+                 void         *regarg)
+{
+    int           retval = -1;
+    char         *pattern;
+    char         *str;
+    int           regex = 0;
+    regex_t       re = {0,};
+    int           recomp = 0;
+    cvec         *nsc = NULL;
+    cxobj        *xret = NULL;
+    cxobj       **vec = NULL;
+    size_t        veclen;
+    char         *devname;
+    device_handle dh;
+    uint64_t      digest;
+    int           i;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((pattern = xml_find_body(xe, "pattern")) == NULL)
+        pattern = "*";
+    if ((str = xml_find_body(xe, "pattern-type")) != NULL)
+        regex = strcmp(str, "regex") == 0;
+    if (regex){
+        if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB) != 0){
+            if (netconf_invalid_value(cbret, "application", "Invalid regular expression")< 0)
+                goto done;
+            goto ok;
+        }
+        recomp++;
+    }
+    if (controller_dbview_get(h, "running", &xret) < 0)
+        goto done;
+    if (xpath_vec(xret, nsc, "devices/device/name", &vec, &veclen) < 0)
+        goto done;
+    cprintf(cbret, "<rpc-reply xmlns=\"%s\">", NETCONF_BASE_NAMESPACE);
+    for (i=0; i<veclen; i++){
+        if ((devname = xml_body(vec[i])) == NULL)
+            continue;
+        if (regex){
+            if (regexec(&re, devname, 0, NULL, 0) != 0)
+                continue;
+        }
+        else if (fnmatch(pattern, devname, 0) != 0)
+            continue;
+        cprintf(cbret, "<device xmlns=\"%s\">", CONTROLLER_NAMESPACE);
+        cprintf(cbret, "<name>%s</name>", devname);
+        if ((dh = device_handle_find(h, devname)) != NULL){
+            if (device_handle_yang_lib_digest_get(dh, &digest) < 0)
+                goto done;
+            if (digest)
+                cprintf(cbret, "<module-set-digest>%016" PRIx64 "</module-set-digest>", digest);
+        }
+        cprintf(cbret, "</device>");
+    }
+    cprintf(cbret, "</rpc-reply>");
+ ok:
+    retval = 0;
+ done:
+    if (recomp)
+        regfree(&re);
+    if (vec)
+        free(vec);
+    if (xret)
+        controller_dbview_release(h, &xret);
+    return retval;
+}
+
+/*! Add names of devices in a device-group to a cvec, including contained groups
+ *
+ * @param[in]  xdevs  XML devices container
+ * @param[in]  xg     XML device-group
+ * @param[in]  depth  Recursion depth, to break recursive group definitions
+ * @param[in]  cvv    Device names, each name added once
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+device_group_members(cxobj *xdevs,
+                     cxobj *xg,
+                     int    depth,
+                     cvec  *cvv)
+{
+    int    retval = -1;
+    cxobj *x;
+    cxobj *xg1;
+    char  *body;
+
+    if (depth > 16){
+        clixon_err(OE_CFG, ELOOP, "device-group recursion too deep");
+        goto done;
+    }
+    x = NULL;
+    while ((x = xml_child_each(xg, x, CX_ELMNT)) != NULL){
+        if ((body = xml_body(x)) == NULL)
+            continue;
+        if (strcmp(xml_name(x), "device-name") == 0){
+            if (cvec_find(cvv, body) == NULL &&
+                cvec_add_string(cvv, body, body) < 0){
+                clixon_err(OE_UNIX, errno, "cvec_add_string");
+                goto done;
+            }
+        }
+        else if (strcmp(xml_name(x), "device-group") == 0){
+            if ((xg1 = xpath_first(xdevs, NULL, "device-group[name='%s']", body)) != NULL &&
+                device_group_members(xdevs, xg1, depth+1, cvv) < 0)
+                goto done;
+        }
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Check if device uses a secondary read session, directly or via its device-profile
+ *
+ * @param[in]  xdevs  Devices container
+ * @param[in]  xdev   Device
+ * @retval     1      Read session enabled
+ * @retval     0      Not enabled
+ */
+static int
+device_read_session_enabled(cxobj *xdevs,
+                            cxobj *xdev)
+{
+    cxobj *xb;
+    cxobj *xprof;
+    char  *profile;
+
+    if (((xb = xml_find_type(xdev, NULL, "read-session", CX_ELMNT)) == NULL ||
+         xml_flag(xb, XML_FLAG_DEFAULT)) &&
+        (profile = xml_find_body(xdev, "device-profile")) != NULL &&
+        (xprof = xpath_first(xdevs, NULL, "device-profile[name='%s']", profile)) != NULL)
+        xb = xml_find_type(xprof, NULL, "read-session", CX_ELMNT);
+    return xb != NULL && xml_body(xb) != NULL && strcmp(xml_body(xb), "true") == 0;
+}
+
+/*! Get names of open devices where name or device-group matches
+ *
+ * If rsvec is given, matching devices with a secondary read session enabled are instead
+ * added to rsvec if their primary session is not closed.
+ * Devices are not marked with a transaction-id, see controller_transaction_get_dispatch
+ * @param[in]  h       Clixon handle
+ * @param[in]  pattern Name of device, can use wildchars, or NULL
+ * @param[in]  group   Name of device-group, can use wildchars, or NULL
+ * @param[out] devvec  Names of open devices
+ * @param[out] rsvec   Names of devices to read over secondary sessions, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see devices_match  for enabled devices in a controller-commit
+ */
+static int
+devices_open_match(clixon_handle h,
+                   char         *pattern,
+                   char         *group,
+                   cvec         *devvec,
+                   cvec         *rsvec)
+{
+    int           retval = -1;
+    cxobj        *xt = NULL;
+    cxobj        *xdevs;
+    cxobj        *xg;
+    cxobj        *x;
+    cvec         *cvv = NULL;
+    char         *name;
+    device_handle dh;
+
+    if (controller_dbview_get(h, "running", &xt) < 0)
+        goto done;
+    if ((xdevs = xpath_first(xt, NULL, "devices")) == NULL)
+        goto ok;
+    if (group != NULL){
+        if ((cvv = cvec_new(0)) == NULL){
+            clixon_err(OE_UNIX, errno, "cvec_new");
+            goto done;
+        }
+        xg = NULL;
+        while ((xg = xml_child_each(xdevs, xg, CX_ELMNT)) != NULL){
+            if (strcmp(xml_name(xg), "device-group") != 0)
+                continue;
+            if ((name = xml_find_body(xg, "name")) == NULL ||
+                fnmatch(group, name, 0) != 0)
+                continue;
+            if (device_group_members(xdevs, xg, 0, cvv) < 0)
+                goto done;
+        }
+    }
+    x = NULL;
+    while ((x = xml_child_each(xdevs, x, CX_ELMNT)) != NULL){
+        if (strcmp(xml_name(x), "device") != 0)
+            continue;
+        if ((name = xml_find_body(x, "name")) == NULL)
+            continue;
+        if (cvv != NULL){
+            if (cvec_find(cvv, name) == NULL)
+                continue;
+        }
+        else if (pattern != NULL && fnmatch(pattern, name, 0) != 0)
+            continue;
+        if ((dh = device_handle_find(h, name)) == NULL)
+            continue;
+        if (rsvec != NULL && device_read_session_enabled(xdevs, x)){
+            if (device_handle_conn_state_get(dh) != CS_CLOSED &&
+                cvec_add_string(rsvec, name, name) < 0){
+                clixon_err(OE_UNIX, errno, "cvec_add_string");
+                goto done;
+            }
+            continue;
+        }
+        if (device_handle_conn_state_get(dh) != CS_OPEN)
+            continue;
+        if (cvec_add_string(devvec, name, NULL) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+ ok:
+    retval = 0;
+ done:
+    if (cvv)
+        cvec_free(cvv);
+    if (xt)
+        controller_dbview_release(h, &xt);
+    return retval;
+}
+
+/*! Create the filter element of a get request to devices
+ *
+ * @param[in]  xe      Request: <rpc><xn></rpc>
+ * @param[out] filter  Malloced filter element as string, or NULL if no filter
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+get_device_state_filter(cxobj *xe,
+                        char **filter)
+{
+    int    retval = -1;
+    cbuf  *cb = NULL;
+    cxobj *xf;
+    cxobj *x;
+    char  *prefix;
+
+    *filter = NULL;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if ((xf = xml_find_type(xe, NULL, "xpath", CX_ELMNT)) != NULL){
+        cprintf(cb, "<filter type=\"xpath\" select=\"");
+        if (xml_chardata_cbuf_append(cb, 1, xml_body(xf)?xml_body(xf):"/") < 0)
+            goto done;
+        cprintf(cb, "\"");
+        /* Namespace declarations of xpath prefixes */
+        x = NULL;
+        while ((x = xml_child_each(xf, x, CX_ATTR)) != NULL){
+            if ((prefix = xml_prefix(x)) == NULL || strcmp(prefix, "xmlns") != 0)
+                continue;
+            cprintf(cb, " xmlns:%s=\"%s\"", xml_name(x), xml_value(x));
+        }
+        cprintf(cb, "/>");
+    }
+    else if ((xf = xml_find_type(xe, NULL, "subtree", CX_ELMNT)) != NULL){
+        cprintf(cb, "<filter type=\"subtree\">");
+        x = NULL;
+        while ((x = xml_child_each(xf, x, CX_ELMNT)) != NULL){
+            if (clixon_xml2cbuf(cb, x, 0, 0, NULL, -1, 0) < 0)
+                goto done;
+        }
+        cprintf(cb, "</filter>");
+    }
+    else
+        goto ok;
+    if ((*filter = strdup(cbuf_get(cb))) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Reply or failure of a get on a secondary read session
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  dh      Device handle
+ * @param[in]  tid     Transaction id
+ * @param[in]  xreply  rpc-reply from device, or NULL on failure
+ * @param[in]  reason  Failure reason, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see get_device_state_read
+ */
+static int
+get_device_state_read_cb(clixon_handle h,
+                         device_handle dh,
+                         uint64_t      tid,
+                         cxobj        *xreply,
+                         char         *reason)
+{
+    int                     retval = -1;
+    controller_transaction *ct;
+    cbuf                   *cb = NULL;
+    cbuf                   *cberr = NULL;
+    cxobj                  *xdata;
+    cxobj                  *xerr;
+    cxobj                  *x;
+
+    if ((ct = controller_transaction_find(h, tid)) == NULL ||
+        ct->ct_state == TS_DONE)
+        goto ok;
+    ct->ct_get_pending--;
+    if (xreply != NULL &&
+        (xerr = xml_find_type(xreply, NULL, "rpc-error", CX_ELMNT)) != NULL){
+        if ((cberr = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        if (netconf_err2cb(h, xerr, cberr) < 0)
+            goto done;
+        reason = cbuf_get(cberr);
+    }
+    if (reason){
+        if (controller_transaction_get_reply(h, ct, dh, NULL, reason) < 0)
+            goto done;
+        if (ct->ct_state != TS_RESOLVED)
+            controller_transaction_state_set(ct, TS_RESOLVED, TR_FAILED);
+        if (ct->ct_origin == NULL &&
+            (ct->ct_origin = strdup(device_handle_name_get(dh))) == NULL){
+            clixon_err(OE_UNIX, errno, "strdup");
+            goto done;
+        }
+        if (ct->ct_reason == NULL &&
+            (ct->ct_reason = strdup(reason)) == NULL){
+            clixon_err(OE_UNIX, errno, "strdup");
+            goto done;
+        }
+    }
+    else {
+        /* A reply without <data> is not cached */
+        if ((xdata = xml_find_type(xreply, NULL, "data", CX_ELMNT)) != NULL){
+            if ((cb = cbuf_new()) == NULL){
+                clixon_err(OE_UNIX, errno, "cbuf_new");
+                goto done;
+            }
+            x = NULL;
+            while ((x = xml_child_each(xdata, x, CX_ELMNT)) != NULL){
+                if (clixon_xml2cbuf(cb, x, 0, 0, NULL, -1, 0) < 0)
+                    goto done;
+            }
+            if (controller_state_cache_put(h, device_handle_name_get(dh), ct->ct_get_filter,
+                                           cbuf_get(cb)) < 0)
+                goto done;
+        }
+        if (controller_transaction_get_reply(h, ct, dh, cb?cbuf_get(cb):NULL, NULL) < 0)
+            goto done;
+    }
+    if (controller_transaction_nr_devices(h, tid) == 0){
+        if (ct->ct_state != TS_RESOLVED)
+            controller_transaction_state_set(ct, TS_RESOLVED, TR_SUCCESS);
+        if (controller_transaction_done(h, ct, -1) < 0)
+            goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    if (cberr)
+        cbuf_free(cberr);
+    return retval;
+}
+
+/*! Send get of a get-device-state transaction on the secondary read session of a device
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  ct      Transaction
+ * @param[in]  dh      Device handle
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see get_device_state_read_cb
+ */
+static int
+get_device_state_read(clixon_handle           h,
+                      controller_transaction *ct,
+                      device_handle           dh)
+{
+    int   retval = -1;
+    cbuf *cb = NULL;
+    int   ret;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<get>%s</get>", ct->ct_get_filter?ct->ct_get_filter:"");
+    /* Count first, the callback may be called directly */
+    ct->ct_get_pending++;
+    if ((ret = device_read_request(h, dh, cbuf_get(cb), get_device_state_read_cb, ct->ct_id)) < 0)
+        goto done;
+    if (ret == 0){
+        ct->ct_get_pending--;
+        if (controller_transaction_get_reply(h, ct, dh, NULL, "No open session") < 0)
+            goto done;
+        if (ct->ct_state != TS_RESOLVED)
+            controller_transaction_state_set(ct, TS_RESOLVED, TR_FAILED);
+    }
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Send a get to one or several open devices and return data as notifications
+ *
+ * A read-only transaction is created, it does not lock candidate and may run while
+ * another transaction is ongoing.
+ * The devices are queued and marked with the transaction-id when a get is sent to them.
+ * At most max-concurrent devices have outstanding gets. A device that is busy in another
+ * transaction when its turn comes fails.
+ * Replies are sent as device-state-reply notifications as they arrive or aggregated when
+ * the transaction is done.
+ * With max-age, devices with a fresh enough cached reply are answered from the cache.
+ * An aggregated request identical to an ongoing one joins it and gets the same tid.
+ * Devices with read-session enabled are read over secondary sessions.
+ * @param[in]  h       Clixon handle
+ * @param[in]  xe      Request: <rpc><xn></rpc>
+ * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
+ * @param[in]  arg     Domain specific arg, ec client-entry or FCGX_Request
+ * @param[in]  regarg  User argument given at rpc_callback_register()
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see controller_transaction_get_dispatch
+ */
+static int
+rpc_get_device_state(clixon_handle h,
+                     cxobj        *xe,
+                     cbuf         *cbret,
+                     void         *arg,
+                     void         *regarg)
+{
+    client_entry           *ce = (client_entry *)arg;
+    int                     retval = -1;
+    controller_transaction *ct = NULL;
+    cbuf                   *cbkey = NULL;
+    char                   *filter = NULL;
+    char                   *devname;
+    char                   *group;
+    char                   *str;
+    char                   *data;
+    int                     aggregate = 0;
+    uint32_t                maxage = 0;
+    device_handle           dh;
+    cvec                   *devvec = NULL;
+    cvec                   *rsvec = NULL;
+    cg_var                 *cv;
+    int                     ret;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((devvec = cvec_new(0)) == NULL ||
+        (rsvec = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        goto done;
+    }
+    devname = xml_find_body(xe, "devname");
+    group = xml_find_body(xe, "device-group");
+    if ((str = xml_find_body(xe, "aggregate")) != NULL)
+        aggregate = strcmp(str, "true") == 0;
+    if ((str = xml_find_body(xe, "max-age")) != NULL &&
+        parse_uint32(str, &maxage, NULL) < 0)
+        goto done;
+    if (get_device_state_filter(xe, &filter) < 0)
+        goto done;
+    if ((cbkey = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cbkey, "%s %s %u %s",
+            devname?devname:"", group?group:"", maxage, filter?filter:"");
+    /* Identical aggregated request ongoing: join it instead of asking the devices again */
+    if (aggregate &&
+        (ct = controller_transaction_get_find(h, cbuf_get(cbkey))) != NULL){
+        controller_state_cache_coalesced(h);
+        goto reply;
+    }
+    if (devices_open_match(h, devname, group, devvec, rsvec) < 0)
+        goto done;
+    if (controller_transaction_new_readonly(h, ce->ce_id, "get-device-state", &ct) < 0)
+        goto done;
+    ct->ct_get = 1;
+    ct->ct_get_aggregate = aggregate;
+    ct->ct_get_maxage = maxage;
+    ct->ct_get_filter = filter;
+    filter = NULL;
+    if (aggregate && (ct->ct_get_key = strdup(cbuf_get(cbkey))) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    if ((str = xml_find_body(xe, "max-concurrent")) != NULL &&
+        parse_uint32(str, &ct->ct_get_max, NULL) < 0)
+        goto done;
+    if ((str = xml_find_body(xe, "timeout")) != NULL &&
+        parse_uint32(str, &ct->ct_timeout, NULL) < 0)
+        goto done;
+    /* Serve devices with fresh enough cached replies directly, queue the others */
+    cv = NULL;
+    while ((cv = cvec_each(devvec, cv)) != NULL){
+        if ((dh = device_handle_find(h, cv_name_get(cv))) == NULL)
+            continue;
+        if (maxage){
+            if ((ret = controller_state_cache_get(h, cv_name_get(cv),
+                                                  ct->ct_get_filter, maxage, &data)) < 0)
+                goto done;
+            if (ret == 1){
+                if (controller_transaction_get_reply(h, ct, dh, data, NULL) < 0)
+                    goto done;
+                continue;
+            }
+        }
+        if (controller_transaction_get_queue(ct, cv_name_get(cv)) < 0)
+            goto done;
+    }
+    /* Devices with read sessions: from cache or queue a get on the secondary session */
+    cv = NULL;
+    while ((cv = cvec_each(rsvec, cv)) != NULL){
+        if ((dh = device_handle_find(h, cv_name_get(cv))) == NULL)
+            continue;
+        if (maxage){
+            if ((ret = controller_state_cache_get(h, cv_name_get(cv),
+                                                  ct->ct_get_filter, maxage, &data)) < 0)
+                goto done;
+            if (ret == 1){
+                if (controller_transaction_get_reply(h, ct, dh, data, NULL) < 0)
+                    goto done;
+                continue;
+            }
+        }
+        if (get_device_state_read(h, ct, dh) < 0)
+            goto done;
+    }
+    /* Send to queued devices, close transaction if none selected or all served from cache */
+    if (controller_transaction_get_dispatch(h, ct) < 0)
+        goto done;
+ reply:
+    cprintf(cbret, "<rpc-reply xmlns=\"%s\">", NETCONF_BASE_NAMESPACE);
+    cprintf(cbret, "<tid xmlns=\"%s\">%" PRIu64"</tid>", CONTROLLER_NAMESPACE, ct->ct_id);
+    cprintf(cbret, "</rpc-reply>");
+    retval = 0;
+ done:
+    if (filter)
+        free(filter);
+    if (devvec)
+        cvec_free(devvec);
+    if (rsvec)
+        cvec_free(rsvec);
+    if (cbkey)
+        cbuf_free(cbkey);
+    return retval;
+}
+
+/*! Validate an RPC against the YANG of a device
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  rpc     RPC element as string
+ * @param[in]  yspec   YANG spec of device mount-point
+ * @param[out] cbreason Reason if not valid
+ * @retval     1       Valid
+ * @retval     0       Not valid, reason in cbreason
+ * @retval    -1       Error
+ */
+static int
+device_rpc_validate(clixon_handle h,
+                    char         *rpc,
+                    yang_stmt    *yspec,
+                    cbuf         *cbreason)
+{
+    int    retval = -1;
+    cbuf  *cb = NULL;
+    cxobj *xt = NULL;
+    cxobj *xrpc;
+    cxobj *xerr = NULL;
+    int    ret;
+
+    if (yspec == NULL){
+        cprintf(cbreason, "No YANG of device");
+        goto invalid;
+    }
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<rpc xmlns=\"%s\">%s</rpc>", NETCONF_BASE_NAMESPACE, rpc);
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xt, NULL) < 0)
+        goto done;
+    if ((xrpc = xml_find_type(xt, NULL, "rpc", CX_ELMNT)) == NULL){
+        clixon_err(OE_XML, 0, "rpc element not found");
+        goto done;
+    }
+    if ((ret = xml_bind_yang_rpc(h, xrpc, yspec, &xerr)) < 0)
+        goto done;
+    if (ret == 0){
+        cprintf(cbreason, "RPC not valid for device YANG: ");
+        if (xerr && netconf_err2cb(h,
+                                   xml_find_type(xerr, NULL, "rpc-error", CX_ELMNT),
+                                   cbreason) < 0)
+            goto done;
+        goto invalid;
+    }
+    retval = 1;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    if (xt)
+        xml_free(xt);
+    if (xerr)
+        xml_free(xerr);
+    return retval;
+ invalid:
+    retval = 0;
+    goto done;
+}
+
+/*! Send an arbitrary RPC to one or several devices
+ *
+ * The RPC is validated against the mount-point YANG of each selected device. Devices
+ * where validation fails are reported as failed and leave the transaction directly.
+ * The RPC is then sent to the remaining devices with at most max-concurrent outstanding,
+ * in the same way as get-device-state.
+ * Replies are sent as device-rpc-reply notifications with reply times, and statistics in
+ * the last notification.
+ * @param[in]  h       Clixon handle
+ * @param[in]  xe      Request: <rpc><xn></rpc>
+ * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
+ * @param[in]  arg     Domain specific arg, ec client-entry or FCGX_Request
+ * @param[in]  regarg  User argument given at rpc_callback_register()
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see rpc_get_device_state
+ */
+static int
+rpc_device_rpc(clixon_handle h,
+               cxobj        *xe,
+               cbuf         *cbret,
+               void         *arg,
+               void         *regarg)
+{
+    client_entry           *ce = (client_entry *)arg;
+    int                     retval = -1;
+    controller_transaction *ct = NULL;
+    cbuf                   *cberr = NULL;
+    cbuf                   *cb = NULL;
+    cbuf                   *cbreason = NULL;
+    cxobj                  *xrpc;
+    cxobj                  *x;
+    char                   *ns = NULL;
+    char                   *str;
+    device_handle           dh;
+    cvec                   *devvec = NULL;
+    cvec                   *failvec = NULL;
+    cg_var                 *cv;
+    yang_stmt              *yspec;
+    yang_stmt              *yspec_prev = NULL;
+    int                     valid = 0;
+    int                     ret;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((xrpc = xml_find_type(xe, NULL, "rpc", CX_ELMNT)) == NULL ||
+        (x = xml_child_i_type(xrpc, 0, CX_ELMNT)) == NULL){
+        if (netconf_missing_element(cbret, "application", "rpc", "No RPC given") < 0)
+            goto done;
+        goto ok;
+    }
+    if (xml2ns(x, xml_prefix(x), &ns) < 0)
+        goto done;
+    if (ns == NULL){
+        if (netconf_unknown_namespace(cbret, "application", xml_name(x), "No namespace of RPC") < 0)
+            goto done;
+        goto ok;
+    }
+    /* Namespace may be declared in an ancestor */
+    if (xmlns_set(x, xml_prefix(x), ns) < 0)
+        goto done;
+    if ((cb = cbuf_new()) == NULL ||
+        (cbreason = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (clixon_xml2cbuf(cb, x, 0, 0, NULL, -1, 0) < 0)
+        goto done;
+    if ((ret = controller_transaction_new(h, ce->ce_id, "device-rpc", &ct, &cberr)) < 0)
+        goto done;
+    if (ret == 0){
+        if (netconf_operation_failed(cbret, "application", cbuf_get(cberr))< 0)
+            goto done;
+        goto ok;
+    }
+    ct->ct_get = 1;
+    if ((ct->ct_rpc = strdup(cbuf_get(cb))) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    gettimeofday(&ct->ct_rpc_start, NULL);
+    if ((str = xml_find_body(xe, "max-concurrent")) != NULL &&
+        parse_uint32(str, &ct->ct_get_max, NULL) < 0)
+        goto done;
+    if ((str = xml_find_body(xe, "timeout")) != NULL &&
+        parse_uint32(str, &ct->ct_timeout, NULL) < 0)
+        goto done;
+    if ((str = xml_find_body(xe, "aggregate")) != NULL)
+        ct->ct_get_aggregate = strcmp(str, "true") == 0;
+    if ((devvec = cvec_new(0)) == NULL ||
+        (failvec = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        goto done;
+    }
+    if (devices_open_match(h,
+                           xml_find_body(xe, "devname"),
+                           xml_find_body(xe, "device-group"),
+                           devvec, NULL) < 0)
+        goto done;
+    /* Validate per device, devices with same YANG share the result */
+    cv = NULL;
+    while ((cv = cvec_each(devvec, cv)) != NULL){
+        if (controller_mount_yspec_get(h, cv_name_get(cv), &yspec) < 0)
+            goto done;
+        if (yspec_prev == NULL || yspec != yspec_prev){
+            cbuf_reset(cbreason);
+            if ((valid = device_rpc_validate(h, ct->ct_rpc, yspec, cbreason)) < 0)
+                goto done;
+            yspec_prev = yspec;
+        }
+        if (valid){
+            if (controller_transaction_get_queue(ct, cv_name_get(cv)) < 0)
+                goto done;
+        }
+        else if (cvec_add_string(failvec, cv_name_get(cv), cbuf_get(cbreason)) < 0){
+            clixon_err(OE_UNIX, errno, "cvec_add_string");
+            goto done;
+        }
+    }
+    /* Devices where validation failed leave directly */
+    cv = NULL;
+    while ((cv = cvec_each(failvec, cv)) != NULL){
+        if ((dh = device_handle_find(h, cv_name_get(cv))) == NULL)
+            continue;
+        if (controller_transaction_failed(h, ct->ct_id, ct, dh, TR_FAILED_DEV_LEAVE,
+                                          cv_name_get(cv), cv_string_get(cv)) < 0)
+            goto done;
+        if (ct->ct_state == TS_DONE)
+            break;
+    }
+    /* Send to queued devices, close transaction if none selected */
+    if (ct->ct_state != TS_DONE &&
+        controller_transaction_get_dispatch(h, ct) < 0)
+        goto done;
+    cprintf(cbret, "<rpc-reply xmlns=\"%s\">", NETCONF_BASE_NAMESPACE);
+    cprintf(cbret, "<tid xmlns=\"%s\">%" PRIu64"</tid>", CONTROLLER_NAMESPACE, ct->ct_id);
+    cprintf(cbret, "</rpc-reply>");
+ ok:
+    retval = 0;
+ done:
+    if (devvec)
+        cvec_free(devvec);
+    if (failvec)
+        cvec_free(failvec);
+    if (cb)
+        cbuf_free(cb);
+    if (cbreason)
+        cbuf_free(cbreason);
+    if (cberr)
+        cbuf_free(cberr);
+    return retval;
+}
+
+/*! Find devices whose config has drifted from the last synced config
+ *
+ * Pull the config of one or several open devices with at most max-concurrent outstanding,
+ * in the same way as get-device-state. A digest of each config is computed when it is
+ * received and compared with the digest of the SYNCED datastore. The config is not stored
+ * unless the device has drifted and a diff is requested, in which case it is stored as
+ * TRANSIENT.
+ * Drifted and failed devices are sent in one drift-scan-reply notification when done.
+ * The transaction is read-only and may run while another transaction is ongoing. A device
+ * that is busy in another transaction fails.
+ * @param[in]  h       Clixon handle
+ * @param[in]  xe      Request: <rpc><xn></rpc>
+ * @param[out] cbret   Return xml tree, eg <rpc-reply>..., <rpc-error..
+ * @param[in]  arg     Domain specific arg, ec client-entry or FCGX_Request
+ * @param[in]  regarg  User argument given at rpc_callback_register()
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see rpc_get_device_state
+ */
+static int
+rpc_drift_scan(clixon_handle h,
+               cxobj        *xe,
+               cbuf         *cbret,
+               void         *arg,
+               void         *regarg)
+{
+    client_entry           *ce = (client_entry *)arg;
+    int                     retval = -1;
+    controller_transaction *ct = NULL;
+    cvec                   *devvec = NULL;
+    cg_var                 *cv;
+    char                   *str;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if (controller_transaction_new_readonly(h, ce->ce_id, "drift-scan", &ct) < 0)
+        goto done;
+    ct->ct_get = 1;
+    ct->ct_get_aggregate = 1;
+    ct->ct_drift = 1;
+    if ((str = xml_find_body(xe, "max-concurrent")) != NULL &&
+        parse_uint32(str, &ct->ct_get_max, NULL) < 0)
+        goto done;
+    if ((str = xml_find_body(xe, "timeout")) != NULL &&
+        parse_uint32(str, &ct->ct_timeout, NULL) < 0)
+        goto done;
+    if ((str = xml_find_body(xe, "diff")) != NULL)
+        ct->ct_drift_diff = strcmp(str, "true") == 0;
+    if ((devvec = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        goto done;
+    }
+    if (devices_open_match(h,
+                           xml_find_body(xe, "devname"),
+                           xml_find_body(xe, "device-group"),
+                           devvec, NULL) < 0)
+        goto done;
+    cv = NULL;
+    while ((cv = cvec_each(devvec, cv)) != NULL)
+        if (controller_transaction_get_queue(ct, cv_name_get(cv)) < 0)
+            goto done;
+    /* Send to queued devices, close transaction if none selected */
+    if (controller_transaction_get_dispatch(h, ct) < 0)
+        goto done;
+    cprintf(cbret, "<rpc-reply xmlns=\"%s\">", NETCONF_BASE_NAMESPACE);
+    cprintf(cbret, "<tid xmlns=\"%s\">%" PRIu64"</tid>", CONTROLLER_NAMESPACE, ct->ct_id);
+    cprintf(cbret, "</rpc-reply>");
+    retval = 0;
+ done:
+    if (devvec)
+        cvec_free(devvec);
+    return retval;
+}
+
 /*! Register callback for rpc calls
  */
 int
@@ -2818,6 +4173,30 @@ controller_rpc_init(clixon_handle h)
                               "device-template-apply"
                               ) < 0)
         goto done;
+    if (rpc_callback_register(h, rpc_device_match,
+                              NULL,
+                              CONTROLLER_NAMESPACE,
+                              "device-match"
+                              ) < 0)
+        goto done;
+    if (rpc_callback_register(h, rpc_get_device_state,
+                              NULL,
+                              CONTROLLER_NAMESPACE,
+                              "get-device-state"
+                              ) < 0)
+        goto done;
+    if (rpc_callback_register(h, rpc_device_rpc,
+                              NULL,
+                              CONTROLLER_NAMESPACE,
+                              "device-rpc"
+                              ) < 0)
+        goto done;
+    if (rpc_callback_register(h, rpc_drift_scan,
+                              NULL,
+                              CONTROLLER_NAMESPACE,
+                              "drift-scan"
+                              ) < 0)
+        goto done;
     /* Check that services subscriptions is just done once */
     if (rpc_callback_register(h,
                               check_services_commit_subscription,
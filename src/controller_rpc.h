@@ -49,6 +49,7 @@
 extern "C" {
 #endif
 
+int controller_device_settings(device_handle dh, cxobj *xn, cxobj *xdevprofile);
 int controller_device_apply(clixon_handle h, cxobj *xe, cbuf *cbret, void *arg, void *regarg);
 int controller_rpc_init(clixon_handle h);
 
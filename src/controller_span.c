@@ -0,0 +1,333 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Trace spans of controller transactions, exported as OTLP-JSON
+  * If CONTROLLER_TRACE_FILE is set, each transaction gets a trace with a root span.
+  * Child spans are added for each transaction state (phase) and for each device state
+  * waiting for a device reply, ie per device RPC.
+  * When the transaction is done, the spans are appended to the file as one line of an
+  * OTLP-JSON ExportTraceServiceRequest, which an OpenTelemetry collector can read with
+  * its file receiver.
+  * The trace context is propagated to action daemons as a W3C traceparent in the
+  * services-commit notification.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_lib.h"
+#include "controller_device_state.h"
+#include "controller_device_handle.h"
+#include "controller_transaction.h"
+#include "controller_span.h"
+
+/*! OTLP span kinds and status codes
+ */
+#define SPAN_KIND_INTERNAL 1
+#define SPAN_KIND_CLIENT   3
+#define SPAN_STATUS_OK     1
+#define SPAN_STATUS_ERROR  2
+
+/*! Random non-zero 64-bit trace- or span-id
+ *
+ * xorshift64* generator, seeded once from /dev/urandom
+ */
+static uint64_t
+span_random(void)
+{
+    static uint64_t x = 0;
+    struct timeval  tv;
+    int             fd;
+
+    if (x == 0){
+        if ((fd = open("/dev/urandom", O_RDONLY)) >= 0){
+            if (read(fd, &x, sizeof(x)) != sizeof(x))
+                x = 0;
+            close(fd);
+        }
+        if (x == 0){
+            gettimeofday(&tv, NULL);
+            x = ((uint64_t)tv.tv_sec << 32) ^ tv.tv_usec ^ ((uint64_t)getpid() << 16) ^ 1;
+        }
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/*! Append JSON string with escapes
+ */
+static void
+span_json_str(cbuf       *cb,
+              const char *str)
+{
+    const char *s;
+
+    cprintf(cb, "\"");
+    for (s = str ? str : ""; *s; s++){
+        switch (*s){
+        case '"':
+        case '\\':
+            cprintf(cb, "\\%c", *s);
+            break;
+        case '\n':
+            cprintf(cb, "\\n");
+            break;
+        default:
+            if ((unsigned char)*s < 0x20)
+                cprintf(cb, "\\u%04x", (unsigned char)*s);
+            else
+                cprintf(cb, "%c", *s);
+            break;
+        }
+    }
+    cprintf(cb, "\"");
+}
+
+/*! Append OTLP-JSON span
+ *
+ * @param[in]  cb       Buffer
+ * @param[in]  ct       Transaction
+ * @param[in]  spanid   Span-id
+ * @param[in]  parent   Parent span-id, 0 for root
+ * @param[in]  name     Span name
+ * @param[in]  kind     Span kind
+ * @param[in]  start    Start time
+ * @param[in]  end      End time
+ * @param[in]  key      Attribute key or NULL
+ * @param[in]  value    Attribute value
+ * @param[in]  error    Error message, or NULL if OK
+ */
+static void
+span_json(cbuf                   *cb,
+          controller_transaction *ct,
+          uint64_t                spanid,
+          uint64_t                parent,
+          const char             *name,
+          int                     kind,
+          struct timeval         *start,
+          struct timeval         *end,
+          const char             *key,
+          const char             *value,
+          const char             *error)
+{
+    if (cbuf_len(cb) && cbuf_get(cb)[cbuf_len(cb)-1] == '}')
+        cprintf(cb, ",");
+    cprintf(cb, "{\"traceId\":\"%016" PRIx64 "%016" PRIx64 "\"",
+            ct->ct_trace_id[0], ct->ct_trace_id[1]);
+    cprintf(cb, ",\"spanId\":\"%016" PRIx64 "\"", spanid);
+    if (parent)
+        cprintf(cb, ",\"parentSpanId\":\"%016" PRIx64 "\"", parent);
+    cprintf(cb, ",\"name\":");
+    span_json_str(cb, name);
+    cprintf(cb, ",\"kind\":%d", kind);
+    cprintf(cb, ",\"startTimeUnixNano\":\"%" PRIu64 "\"",
+            (uint64_t)start->tv_sec*1000000000 + (uint64_t)start->tv_usec*1000);
+    cprintf(cb, ",\"endTimeUnixNano\":\"%" PRIu64 "\"",
+            (uint64_t)end->tv_sec*1000000000 + (uint64_t)end->tv_usec*1000);
+    cprintf(cb, ",\"attributes\":[{\"key\":\"controller.tid\",\"value\":{\"intValue\":\"%" PRIu64 "\"}}",
+            ct->ct_id);
+    if (key){
+        cprintf(cb, ",{\"key\":");
+        span_json_str(cb, key);
+        cprintf(cb, ",\"value\":{\"stringValue\":");
+        span_json_str(cb, value);
+        cprintf(cb, "}}");
+    }
+    cprintf(cb, "]");
+    if (error){
+        cprintf(cb, ",\"status\":{\"code\":%d,\"message\":", SPAN_STATUS_ERROR);
+        span_json_str(cb, error);
+        cprintf(cb, "}");
+    }
+    else
+        cprintf(cb, ",\"status\":{\"code\":%d}", SPAN_STATUS_OK);
+    cprintf(cb, "}");
+}
+
+/*! Start trace of transaction, if CONTROLLER_TRACE_FILE is set
+ *
+ * @param[in]  h    Clixon handle
+ * @param[in]  ct   Transaction
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+controller_span_begin(clixon_handle           h,
+                      controller_transaction *ct)
+{
+    int      retval = -1;
+    char    *file;
+
+    if ((file = clicon_option_str(h, "CONTROLLER_TRACE_FILE")) == NULL ||
+        strlen(file) == 0)
+        goto ok;
+    ct->ct_trace_id[0] = span_random();
+    ct->ct_trace_id[1] = span_random();
+    ct->ct_span_id = span_random();
+    gettimeofday(&ct->ct_trace_start, NULL);
+    if (ct->ct_timestamp.tv_sec == 0)
+        ct->ct_timestamp = ct->ct_trace_start;
+    if ((ct->ct_spans = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Add ended child span to traced transaction
+ *
+ * @param[in]  ct      Transaction
+ * @param[in]  name    Span name
+ * @param[in]  start   Start time of span, end time is now
+ * @param[in]  device  Device name, or NULL if not a device span
+ * @param[in]  error   Error message, or NULL if OK
+ * @retval     0       OK
+ */
+int
+controller_span_add(controller_transaction *ct,
+                    const char             *name,
+                    struct timeval         *start,
+                    const char             *device,
+                    const char             *error)
+{
+    struct timeval end;
+
+    if (ct->ct_spans == NULL)
+        return 0;
+    gettimeofday(&end, NULL);
+    span_json(ct->ct_spans, ct, span_random(), ct->ct_span_id,
+              name,
+              device ? SPAN_KIND_CLIENT : SPAN_KIND_INTERNAL,
+              start, &end,
+              device ? "device.name" : NULL, device,
+              error);
+    return 0;
+}
+
+/*! Get W3C traceparent of transaction root span
+ *
+ * @param[in]  ct   Transaction
+ * @param[in]  cb   Buffer where traceparent is appended, if traced
+ * @retval     1    Traced, traceparent appended
+ * @retval     0    Not traced
+ */
+int
+controller_span_traceparent(controller_transaction *ct,
+                            cbuf                   *cb)
+{
+    if (ct->ct_spans == NULL)
+        return 0;
+    cprintf(cb, "00-%016" PRIx64 "%016" PRIx64 "-%016" PRIx64 "-01",
+            ct->ct_trace_id[0], ct->ct_trace_id[1], ct->ct_span_id);
+    return 1;
+}
+
+/*! End trace of transaction and append it to CONTROLLER_TRACE_FILE
+ *
+ * @param[in]  h    Clixon handle
+ * @param[in]  ct   Transaction
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+controller_span_end(clixon_handle           h,
+                    controller_transaction *ct)
+{
+    int            retval = -1;
+    cbuf          *cb = NULL;
+    struct timeval end;
+    char          *file;
+    FILE          *f = NULL;
+
+    if (ct->ct_spans == NULL)
+        goto ok;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    gettimeofday(&end, NULL);
+    cprintf(cb, "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+            "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"clixon-controller\"}}]},"
+            "\"scopeSpans\":[{\"scope\":{\"name\":\"clixon-controller\"},\"spans\":[");
+    span_json(cb, ct, ct->ct_span_id, 0,
+              ct->ct_description ? ct->ct_description : "transaction",
+              SPAN_KIND_INTERNAL,
+              &ct->ct_trace_start, &end,
+              "controller.result", transaction_result_int2str(ct->ct_result),
+              ct->ct_result == TR_SUCCESS ? NULL : (ct->ct_reason ? ct->ct_reason : "failed"));
+    if (cbuf_len(ct->ct_spans))
+        cprintf(cb, ",%s", cbuf_get(ct->ct_spans));
+    cprintf(cb, "]}]}]}\n");
+    cbuf_free(ct->ct_spans);
+    ct->ct_spans = NULL;
+    if ((file = clicon_option_str(h, "CONTROLLER_TRACE_FILE")) == NULL)
+        goto ok;
+    if ((f = fopen(file, "a")) == NULL){
+        clixon_log(h, LOG_WARNING, "%s: fopen(%s): %s", __func__, file, strerror(errno));
+        goto ok;
+    }
+    fputs(cbuf_get(cb), f);
+ ok:
+    retval = 0;
+ done:
+    if (f)
+        fclose(f);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
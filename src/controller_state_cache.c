@@ -0,0 +1,371 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Cache of device replies of get-device-state
+  * Replies are cached per device and filter, where the filter is the <filter> element sent
+  * to the device as serialized from the parsed request, ie normalized.
+  * Entries are kept in a list in least-recently-used order and evicted from the head when
+  * the total size of cached data exceeds devices/state-cache-size.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/time.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_state_cache.h"
+
+/* Default max size in bytes of cached data, if devices/state-cache-size is not set */
+#define STATE_CACHE_SIZE_DEFAULT (1024*1024)
+
+/*! Cached reply from one device for one filter
+ */
+struct state_cache_entry {
+    qelem_t        se_qelem;   /* LRU list, least recently used first */
+    char          *se_key;     /* <devname> <filter> */
+    char          *se_data;    /* Serialized data from device */
+    size_t         se_size;    /* Size of key and data */
+    struct timeval se_time;    /* When data was received from device */
+};
+typedef struct state_cache_entry state_cache_entry;
+
+/*! Cache of device replies and statistics
+ */
+struct state_cache {
+    state_cache_entry *sc_lru;       /* LRU list of entries */
+    clicon_hash_t     *sc_hash;      /* Entries indexed by key */
+    size_t             sc_size;      /* Total size of entries */
+    uint32_t           sc_entries;   /* Number of entries */
+    uint64_t           sc_hits;      /* Device replies served from cache */
+    uint64_t           sc_misses;    /* Device replies not found in cache, or too old */
+    uint64_t           sc_coalesced; /* Requests joining an identical ongoing request */
+};
+typedef struct state_cache state_cache;
+
+/*! Get state cache, create if not exists
+ *
+ * @param[in]  h    Clixon handle
+ * @retval     sc   State cache
+ * @retval     NULL Error
+ */
+static state_cache *
+state_cache_get(clixon_handle h)
+{
+    state_cache *sc = NULL;
+
+    if (clicon_ptr_get(h, "controller-state-cache", (void**)&sc) == 0 && sc != NULL)
+        return sc;
+    if ((sc = malloc(sizeof(*sc))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        return NULL;
+    }
+    memset(sc, 0, sizeof(*sc));
+    if ((sc->sc_hash = clicon_hash_init()) == NULL){
+        free(sc);
+        return NULL;
+    }
+    clicon_ptr_set(h, "controller-state-cache", sc);
+    return sc;
+}
+
+/*! Create cache key of device and filter
+ *
+ * @param[in]  devname Device name
+ * @param[in]  filter  Filter element, or NULL
+ * @param[out] cb      Key
+ */
+static int
+state_cache_key(char *devname,
+                char *filter,
+                cbuf *cb)
+{
+    cprintf(cb, "%s %s", devname, filter?filter:"");
+    return 0;
+}
+
+/*! Remove and free one cache entry
+ *
+ * @param[in]  sc  State cache
+ * @param[in]  se  Cache entry
+ */
+static int
+state_cache_entry_free(state_cache       *sc,
+                       state_cache_entry *se)
+{
+    clicon_hash_del(sc->sc_hash, se->se_key);
+    DELQ(se, sc->sc_lru, state_cache_entry *);
+    sc->sc_size -= se->se_size;
+    sc->sc_entries--;
+    free(se->se_key);
+    if (se->se_data)
+        free(se->se_data);
+    free(se);
+    return 0;
+}
+
+/*! Max size of cached data
+ */
+static size_t
+state_cache_size_max(clixon_handle h)
+{
+    int size;
+
+    if ((size = clicon_data_int_get(h, "controller-state-cache-size")) < 0)
+        return STATE_CACHE_SIZE_DEFAULT;
+    return size;
+}
+
+/*! Get cached reply of a device if not older than maxage
+ *
+ * A hit moves the entry to the end of the LRU list.
+ * @param[in]  h       Clixon handle
+ * @param[in]  devname Device name
+ * @param[in]  filter  Filter element, or NULL
+ * @param[in]  maxage  Max age of cached reply in seconds
+ * @param[out] datap   Cached data, valid until next cache update
+ * @retval     1       Hit
+ * @retval     0       Miss
+ * @retval    -1       Error
+ */
+int
+controller_state_cache_get(clixon_handle h,
+                           char         *devname,
+                           char         *filter,
+                           uint32_t      maxage,
+                           char        **datap)
+{
+    int                 retval = -1;
+    state_cache        *sc;
+    state_cache_entry **sep;
+    state_cache_entry  *se;
+    cbuf               *cb = NULL;
+    struct timeval      now;
+    struct timeval      age;
+
+    if ((sc = state_cache_get(h)) == NULL)
+        goto done;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    state_cache_key(devname, filter, cb);
+    if ((sep = clicon_hash_value(sc->sc_hash, cbuf_get(cb), NULL)) == NULL)
+        goto miss;
+    se = *sep;
+    gettimeofday(&now, NULL);
+    timersub(&now, &se->se_time, &age);
+    if (age.tv_sec >= (time_t)maxage)
+        goto miss;
+    /* Most recently used last */
+    DELQ(se, sc->sc_lru, state_cache_entry *);
+    ADDQ(se, sc->sc_lru);
+    sc->sc_hits++;
+    *datap = se->se_data;
+    retval = 1;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+ miss:
+    sc->sc_misses++;
+    retval = 0;
+    goto done;
+}
+
+/*! Save reply of a device
+ *
+ * Replace existing entry if any, then evict least recently used entries until size is
+ * within limit.
+ * @param[in]  h       Clixon handle
+ * @param[in]  devname Device name
+ * @param[in]  filter  Filter element, or NULL
+ * @param[in]  data    Serialized data from device
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+controller_state_cache_put(clixon_handle h,
+                           char         *devname,
+                           char         *filter,
+                           char         *data)
+{
+    int                 retval = -1;
+    state_cache        *sc;
+    state_cache_entry **sep;
+    state_cache_entry  *se = NULL;
+    cbuf               *cb = NULL;
+    size_t              size;
+    size_t              max;
+
+    if ((sc = state_cache_get(h)) == NULL)
+        goto done;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    state_cache_key(devname, filter, cb);
+    if ((sep = clicon_hash_value(sc->sc_hash, cbuf_get(cb), NULL)) != NULL)
+        state_cache_entry_free(sc, *sep);
+    max = state_cache_size_max(h);
+    size = cbuf_len(cb) + strlen(data);
+    if (size > max) /* Also if cache is disabled */
+        goto ok;
+    while (sc->sc_lru != NULL && sc->sc_size + size > max)
+        state_cache_entry_free(sc, sc->sc_lru);
+    if ((se = malloc(sizeof(*se))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memset(se, 0, sizeof(*se));
+    if ((se->se_key = strdup(cbuf_get(cb))) == NULL ||
+        (se->se_data = strdup(data)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    se->se_size = size;
+    gettimeofday(&se->se_time, NULL);
+    if (clicon_hash_add(sc->sc_hash, se->se_key, &se, sizeof(se)) == NULL)
+        goto done;
+    ADDQ(se, sc->sc_lru);
+    sc->sc_size += size;
+    sc->sc_entries++;
+    se = NULL;
+ ok:
+    retval = 0;
+ done:
+    if (se){
+        if (se->se_key)
+            free(se->se_key);
+        if (se->se_data)
+            free(se->se_data);
+        free(se);
+    }
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! A request has joined an identical ongoing request
+ *
+ * @param[in]  h       Clixon handle
+ */
+int
+controller_state_cache_coalesced(clixon_handle h)
+{
+    state_cache *sc;
+
+    if ((sc = state_cache_get(h)) == NULL)
+        return -1;
+    sc->sc_coalesced++;
+    return 0;
+}
+
+/*! Get state cache statistics as state data
+ *
+ * @param[in]    h        Clixon handle
+ * @param[in]    nsc      External XML namespace context, or NULL
+ * @param[in]    xpath    String with XPath syntax. or NULL for all
+ * @param[out]   xstate   XML tree, <config/> on entry.
+ * @retval       0        OK
+ * @retval      -1        Error
+ */
+int
+controller_state_cache_statedata(clixon_handle h,
+                                 cvec         *nsc,
+                                 char         *xpath,
+                                 cxobj        *xstate)
+{
+    int          retval = -1;
+    state_cache *sc;
+    cbuf        *cb = NULL;
+    uint64_t     total;
+
+    if ((sc = state_cache_get(h)) == NULL)
+        goto done;
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "<devices xmlns=\"%s\"><state-cache>", CONTROLLER_NAMESPACE);
+    cprintf(cb, "<entries>%u</entries>", sc->sc_entries);
+    cprintf(cb, "<size>%zu</size>", sc->sc_size);
+    cprintf(cb, "<hits>%" PRIu64 "</hits>", sc->sc_hits);
+    cprintf(cb, "<misses>%" PRIu64 "</misses>", sc->sc_misses);
+    cprintf(cb, "<coalesced>%" PRIu64 "</coalesced>", sc->sc_coalesced);
+    if ((total = sc->sc_hits + sc->sc_misses) != 0)
+        cprintf(cb, "<hit-rate>%" PRIu64 ".%02" PRIu64 "</hit-rate>",
+                (sc->sc_hits*10000/total)/100, (sc->sc_hits*10000/total)%100);
+    cprintf(cb, "</state-cache></devices>");
+    if (clixon_xml_parse_string(cbuf_get(cb), YB_NONE, NULL, &xstate, NULL) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Free state cache
+ *
+ * @param[in]  h       Clixon handle
+ */
+int
+controller_state_cache_free(clixon_handle h)
+{
+    state_cache *sc = NULL;
+
+    if (clicon_ptr_get(h, "controller-state-cache", (void**)&sc) < 0 || sc == NULL)
+        return 0;
+    while (sc->sc_lru != NULL)
+        state_cache_entry_free(sc, sc->sc_lru);
+    clicon_hash_free(sc->sc_hash);
+    free(sc);
+    clicon_ptr_del(h, "controller-state-cache");
+    return 0;
+}
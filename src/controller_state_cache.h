@@ -0,0 +1,57 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Cache of device replies of get-device-state
+  */
+
+#ifndef _CONTROLLER_STATE_CACHE_H
+#define _CONTROLLER_STATE_CACHE_H
+
+/*
+ * Prototypes
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int controller_state_cache_get(clixon_handle h, char *devname, char *filter, uint32_t maxage, char **datap);
+int controller_state_cache_put(clixon_handle h, char *devname, char *filter, char *data);
+int controller_state_cache_coalesced(clixon_handle h);
+int controller_state_cache_statedata(clixon_handle h, cvec *nsc, char *xpath, cxobj *xstate);
+int controller_state_cache_free(clixon_handle h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONTROLLER_STATE_CACHE_H */
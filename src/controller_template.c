@@ -0,0 +1,493 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Compiled device templates
+  * A device template is compiled once into a copy of its config where each body containing
+  * ${var} references is a slot: a list of literal parts and formal variable indexes.
+  * Applying the template with a set of variable bindings fills the slots without scanning
+  * any strings, which makes applying one template to many devices with different bindings
+  * cheap. The compiled config is bound and sorted once per device yang spec, and after a
+ * fill only lists whose keys are filled are re-sorted.
+ * A compiled template is invalidated when the template config is changed.
+  * See devices/template and rpc device-template-apply
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_template.h"
+
+/*! Variable slot: a body whose value is literals interleaved with variables
+ *
+ * The value is ts_lit[0] var[ts_var[0]] ts_lit[1] ... var[ts_var[n-1]] ts_lit[n]
+ */
+typedef struct {
+    cxobj  *ts_body;   /* Body node in compiled config */
+    int     ts_nvar;   /* Number of variable references */
+    int    *ts_var;    /* Formal variable index of each reference */
+    char  **ts_lit;    /* ts_nvar+1 literal parts */
+} tmpl_slot;
+
+/*! Compiled template
+ */
+struct controller_template {
+    qelem_t    tm_qelem;   /* List header */
+    char      *tm_name;    /* Template name */
+    cxobj     *tm_xml;     /* Copy of template config with filled slots */
+    yang_stmt *tm_yspec;   /* Yang spec tm_xml is bound to, or NULL */
+    int        tm_nformal; /* Number of formal variables */
+    char     **tm_formal;  /* Formal variable names */
+    int        tm_nslot;   /* Number of slots */
+    tmpl_slot *tm_slot;    /* Slots */
+};
+
+/* List of compiled templates */
+static controller_template *_templates = NULL;
+
+/*! Free a compiled template
+ */
+static int
+template_free(controller_template *tm)
+{
+    tmpl_slot *ts;
+    int        i;
+    int        j;
+
+    if (tm->tm_name)
+        free(tm->tm_name);
+    if (tm->tm_xml)
+        xml_free(tm->tm_xml);
+    for (i=0; i<tm->tm_nformal; i++)
+        free(tm->tm_formal[i]);
+    if (tm->tm_formal)
+        free(tm->tm_formal);
+    for (i=0; i<tm->tm_nslot; i++){
+        ts = &tm->tm_slot[i];
+        for (j=0; j<=ts->ts_nvar; j++)
+            if (ts->ts_lit && ts->ts_lit[j])
+                free(ts->ts_lit[j]);
+        if (ts->ts_lit)
+            free(ts->ts_lit);
+        if (ts->ts_var)
+            free(ts->ts_var);
+    }
+    if (tm->tm_slot)
+        free(tm->tm_slot);
+    free(tm);
+    return 0;
+}
+
+/*! Get formal variable index given a name, or -1
+ */
+static int
+template_formal(controller_template *tm,
+                const char          *name,
+                size_t               len)
+{
+    int i;
+
+    for (i=0; i<tm->tm_nformal; i++)
+        if (strlen(tm->tm_formal[i]) == len &&
+            strncmp(tm->tm_formal[i], name, len) == 0)
+            return i;
+    return -1;
+}
+
+/*! Compile one body into a slot if it references formal variables
+ *
+ * References to names that are not formal variables are kept as literals.
+ * @param[in]  tm   Compiled template
+ * @param[in]  xb   Body node
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+template_compile_body(controller_template *tm,
+                      cxobj               *xb)
+{
+    int        retval = -1;
+    char      *b;
+    char      *p;
+    char      *lit;
+    char      *e;
+    int        k;
+    tmpl_slot  ts = {0,};
+    tmpl_slot *slots;
+
+    if ((b = xml_value(xb)) == NULL || strstr(b, "${") == NULL)
+        goto ok;
+    /* At most one reference per "${" */
+    for (p = b, k = 0; (p = strstr(p, "${")) != NULL; p += 2, k++);
+    if ((ts.ts_var = calloc(k, sizeof(int))) == NULL ||
+        (ts.ts_lit = calloc(k + 1, sizeof(char*))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        goto done;
+    }
+    ts.ts_body = xb;
+    lit = p = b;
+    while ((p = strstr(p, "${")) != NULL){
+        if ((e = strchr(p + 2, '}')) == NULL)
+            break;
+        if ((k = template_formal(tm, p + 2, e - p - 2)) < 0){
+            p += 2;
+            continue;
+        }
+        if ((ts.ts_lit[ts.ts_nvar] = strndup(lit, p - lit)) == NULL){
+            clixon_err(OE_UNIX, errno, "strndup");
+            goto done;
+        }
+        ts.ts_var[ts.ts_nvar++] = k;
+        lit = p = e + 1;
+    }
+    if (ts.ts_nvar == 0)
+        goto ok;
+    if ((ts.ts_lit[ts.ts_nvar] = strdup(lit)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    if ((slots = realloc(tm->tm_slot, (tm->tm_nslot + 1) * sizeof(tmpl_slot))) == NULL){
+        clixon_err(OE_UNIX, errno, "realloc");
+        goto done;
+    }
+    tm->tm_slot = slots;
+    tm->tm_slot[tm->tm_nslot++] = ts;
+    memset(&ts, 0, sizeof(ts));
+ ok:
+    retval = 0;
+ done:
+    for (k=0; ts.ts_lit && k<=ts.ts_nvar; k++)
+        if (ts.ts_lit[k])
+            free(ts.ts_lit[k]);
+    if (ts.ts_lit)
+        free(ts.ts_lit);
+    if (ts.ts_var)
+        free(ts.ts_var);
+    return retval;
+}
+
+/*! Compile bodies of a subtree, recursive
+ */
+static int
+template_compile_tree(controller_template *tm,
+                      cxobj               *x)
+{
+    cxobj *xc = NULL;
+
+    while ((xc = xml_child_each(x, xc, -1)) != NULL){
+        switch (xml_type(xc)){
+        case CX_BODY:
+            if (template_compile_body(tm, xc) < 0)
+                return -1;
+            break;
+        case CX_ELMNT:
+            if (template_compile_tree(tm, xc) < 0)
+                return -1;
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+/*! Compile a template
+ *
+ * @param[in]  xtmpl  Template list entry: template/name,variables,config
+ * @param[out] tmpp   Compiled template
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+template_compile(cxobj                *xtmpl,
+                 controller_template **tmpp)
+{
+    int                  retval = -1;
+    controller_template *tm = NULL;
+    cxobj               *xvars;
+    cxobj               *xv;
+    cxobj               *xc;
+    char                *name;
+
+    if ((tm = calloc(1, sizeof(*tm))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        goto done;
+    }
+    if ((tm->tm_name = strdup(xml_find_body(xtmpl, "name"))) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    if ((xvars = xml_find_type(xtmpl, NULL, "variables", CX_ELMNT)) != NULL){
+        if ((tm->tm_formal = calloc(xml_child_nr_type(xvars, CX_ELMNT) + 1, sizeof(char*))) == NULL){
+            clixon_err(OE_UNIX, errno, "calloc");
+            goto done;
+        }
+        xv = NULL;
+        while ((xv = xml_child_each(xvars, xv, CX_ELMNT)) != NULL) {
+            if ((name = xml_find_body(xv, "name")) == NULL)
+                continue;
+            if ((tm->tm_formal[tm->tm_nformal] = strdup(name)) == NULL){
+                clixon_err(OE_UNIX, errno, "strdup");
+                goto done;
+            }
+            tm->tm_nformal++;
+        }
+    }
+    if ((xc = xml_find_type(xtmpl, NULL, "config", CX_ELMNT)) == NULL){
+        if ((tm->tm_xml = xml_new("config", NULL, CX_ELMNT)) == NULL)
+            goto done;
+    }
+    else if ((tm->tm_xml = xml_dup(xc)) == NULL)
+        goto done;
+    if (template_compile_tree(tm, tm->tm_xml) < 0)
+        goto done;
+    clixon_debug(CLIXON_DBG_CTRL, "template %s: %d slots", tm->tm_name, tm->tm_nslot);
+    *tmpp = tm;
+    tm = NULL;
+    retval = 0;
+ done:
+    if (tm)
+        template_free(tm);
+    return retval;
+}
+
+/*! Get compiled template, compile it if not already done
+ *
+ * @param[in]  xtmpl  Template list entry in running: devices/template
+ * @param[out] tmpp   Compiled template, valid until invalidated
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see controller_template_invalidate
+ */
+int
+controller_template_get(cxobj                *xtmpl,
+                        controller_template **tmpp)
+{
+    controller_template *tm;
+    char                *name;
+
+    if ((name = xml_find_body(xtmpl, "name")) == NULL){
+        clixon_err(OE_XML, EINVAL, "Template without name");
+        return -1;
+    }
+    if ((tm = _templates) != NULL){
+        do {
+            if (strcmp(tm->tm_name, name) == 0){
+                *tmpp = tm;
+                return 0;
+            }
+            tm = NEXTQ(controller_template *, tm);
+        } while (tm && tm != _templates);
+    }
+    if (template_compile(xtmpl, &tm) < 0)
+        return -1;
+    ADDQ(tm, _templates);
+    *tmpp = tm;
+    return 0;
+}
+
+/*! Clear yang binding of a node, xml_apply callback
+ */
+static int
+template_unbind(cxobj *x,
+                void  *arg)
+{
+    xml_spec_set(x, NULL);
+    return 0;
+}
+
+/*! Bind compiled template config to yang spec of a device and sort it
+ *
+ * Only done if not already bound to the same yang spec, which is the common case with
+ * shared device yangs.
+ * @param[in]  h      Clixon handle
+ * @param[in]  tm     Compiled template
+ * @param[in]  yspec  Yang spec of device mount-point
+ * @param[out] xerrp  Error XML if not bound, free with xml_free
+ * @retval     1      OK
+ * @retval     0      Failed to bind, reason in xerrp
+ * @retval    -1      Error
+ */
+int
+controller_template_bind(clixon_handle        h,
+                         controller_template *tm,
+                         yang_stmt           *yspec,
+                         cxobj              **xerrp)
+{
+    int ret;
+
+    if (tm->tm_yspec == yspec)
+        return 1;
+    if (tm->tm_yspec){
+        if (xml_apply(tm->tm_xml, CX_ELMNT, template_unbind, NULL) < 0)
+            return -1;
+        tm->tm_yspec = NULL;
+    }
+    if ((ret = xml_bind_yang(h, tm->tm_xml, YB_MODULE, yspec, xerrp)) <= 0)
+        return ret;
+    if (xml_sort_recurse(tm->tm_xml) < 0)
+        return -1;
+    tm->tm_yspec = yspec;
+    return 1;
+}
+
+/*! Re-sort the siblings of a slot if it is a list key or a leaf-list value
+ *
+ * @param[in]  ts   Slot
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+template_sort_slot(tmpl_slot *ts)
+{
+    cxobj     *x;
+    cxobj     *xl;
+    yang_stmt *y;
+
+    if ((x = xml_parent(ts->ts_body)) == NULL || (y = xml_spec(x)) == NULL)
+        return 0;
+    if (yang_keyword_get(y) == Y_LEAF_LIST)
+        return xml_sort(xml_parent(x));
+    if ((xl = xml_parent(x)) != NULL && (y = xml_spec(xl)) != NULL &&
+        yang_keyword_get(y) == Y_LIST && xml_parent(xl) != NULL)
+        return xml_sort(xml_parent(xl));
+    return 0;
+}
+
+/*! Fill the slots of a compiled template given variable bindings
+ *
+ * Formal variables not in cvv are substituted with the empty string.
+ * If bound, lists and leaf-lists whose keys or values are filled are re-sorted.
+ * @param[in]  tm     Compiled template
+ * @param[in]  cvv    Actual variable bindings, name and string value
+ * @param[out] xconf  Filled template config, valid until next fill. Children may be
+ *                    moved out temporarily but must be moved back in order
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+controller_template_fill(controller_template *tm,
+                         cvec                *cvv,
+                         cxobj              **xconf)
+{
+    int        retval = -1;
+    char     **vals = NULL;
+    cbuf      *cb = NULL;
+    cg_var    *cv;
+    tmpl_slot *ts;
+    int        i;
+    int        j;
+
+    if ((vals = calloc(tm->tm_nformal + 1, sizeof(char*))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        goto done;
+    }
+    for (i=0; i<tm->tm_nformal; i++)
+        if (cvv && (cv = cvec_find(cvv, tm->tm_formal[i])) != NULL)
+            vals[i] = cv_string_get(cv);
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    for (i=0; i<tm->tm_nslot; i++){
+        ts = &tm->tm_slot[i];
+        cbuf_reset(cb);
+        for (j=0; j<ts->ts_nvar; j++)
+            cprintf(cb, "%s%s", ts->ts_lit[j], vals[ts->ts_var[j]] ? vals[ts->ts_var[j]] : "");
+        cprintf(cb, "%s", ts->ts_lit[j]);
+        if (xml_value_set(ts->ts_body, cbuf_get(cb)) < 0)
+            goto done;
+    }
+    /* Re-sort siblings of filled list keys and leaf-list values */
+    if (tm->tm_yspec){
+        for (i=0; i<tm->tm_nslot; i++)
+            if (template_sort_slot(&tm->tm_slot[i]) < 0)
+                goto done;
+    }
+    *xconf = tm->tm_xml;
+    retval = 0;
+ done:
+    if (vals)
+        free(vals);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Invalidate a compiled template, eg when the template config is changed
+ *
+ * @param[in]  name   Template name, or NULL for all templates
+ */
+int
+controller_template_invalidate(const char *name)
+{
+    controller_template *tm;
+    controller_template *tmnext;
+    int                  last;
+
+    if ((tm = _templates) == NULL)
+        return 0;
+    do {
+        tmnext = NEXTQ(controller_template *, tm);
+        last = (tmnext == _templates);
+        if (name == NULL || strcmp(tm->tm_name, name) == 0){
+            DELQ(tm, _templates, controller_template *);
+            template_free(tm);
+        }
+        tm = tmnext;
+    } while (_templates && !last);
+    return 0;
+}
+
+/*! Free all compiled templates
+ */
+int
+controller_template_exit(void)
+{
+    return controller_template_invalidate(NULL);
+}
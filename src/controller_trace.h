@@ -0,0 +1,74 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * USDT static tracepoints, for perf and bpftrace
+  * Enabled with configure --enable-usdt, otherwise the tracepoints are empty.
+  * All probes are in provider "controller":
+  *   frame_read(name, len)               Device input read, bytes
+  *   frame_complete(name, len)           Complete netconf frame received from device
+  *   device_send(name, len)              Framed message sent to device
+  *   device_state(name, state0, state)   Device connection state change (conn_state)
+  *   transaction_state(tid, state0, state, result)  Transaction state change, result after change
+  *   config_read_start(name, type)       Device datastore read, type is eg "SYNCED"
+  *   config_read_done(name, type, retval)
+  *   config_write_start(name, type)      Device datastore write
+  *   config_write_done(name, type, retval)
+  * See util/trace for bpftrace scripts
+  */
+
+#ifndef _CONTROLLER_TRACE_H
+#define _CONTROLLER_TRACE_H
+
+#ifdef CONTROLLER_USDT
+#include <sys/sdt.h>
+
+#define CONTROLLER_TRACE2(probe, a1, a2) \
+    DTRACE_PROBE2(controller, probe, a1, a2)
+#define CONTROLLER_TRACE3(probe, a1, a2, a3) \
+    DTRACE_PROBE3(controller, probe, a1, a2, a3)
+#define CONTROLLER_TRACE4(probe, a1, a2, a3, a4) \
+    DTRACE_PROBE4(controller, probe, a1, a2, a3, a4)
+
+#else /* CONTROLLER_USDT */
+
+/* Arguments are not evaluated, only referenced to avoid unused warnings */
+#define CONTROLLER_TRACE2(probe, a1, a2) \
+    do { if (0) { (void)(a1); (void)(a2); } } while (0)
+#define CONTROLLER_TRACE3(probe, a1, a2, a3) \
+    do { if (0) { (void)(a1); (void)(a2); (void)(a3); } } while (0)
+#define CONTROLLER_TRACE4(probe, a1, a2, a3, a4) \
+    do { if (0) { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } } while (0)
+
+#endif /* CONTROLLER_USDT */
+
+#endif /* _CONTROLLER_TRACE_H */
@@ -93,6 +93,11 @@
 #include "controller_device_send.h"
 #include "controller_device_handle.h"
 #include "controller_transaction.h"
+#include "controller_trace.h"
+#include "controller_span.h"
+#include "controller_state_cache.h"
+#include "controller_dbview.h"
+#include "controller_memo.h"
 
 /*! Set new transaction state and timestamp
  *
@@ -106,6 +111,8 @@ controller_transaction_state_set(controller_transaction *ct,
                                  transaction_state       state,
                                  transaction_result      result)
 {
+    transaction_state state0;
+
     switch (state) {
     case TS_INIT:
         assert(ct->ct_state != TS_DONE);
@@ -148,10 +155,19 @@ controller_transaction_state_set(controller_transaction *ct,
                          transaction_state_int2str(ct->ct_state),
                          transaction_state_int2str(state));
     }
+    state0 = ct->ct_state;
     ct->ct_state = state;
     if (result != -1 &&
         (state == TS_RESOLVED || state == TS_DONE))
         ct->ct_result = result;
+    CONTROLLER_TRACE4(transaction_state, ct->ct_id, state0, state, ct->ct_result);
+    if (ct->ct_spans){
+        if (state0 != state)
+            controller_span_add(ct, transaction_state_int2str(state0), &ct->ct_timestamp, NULL, NULL);
+        if (state == TS_DONE &&
+            controller_span_end(ct->ct_h, ct) < 0)
+            return -1;
+    }
     gettimeofday(&ct->ct_timestamp, NULL);
     return 0;
 }
@@ -281,11 +297,11 @@ controller_transaction_new(clixon_handle            h,
     }
     else
         lock_id = 0; /* Reuse lock */
-    /* Exclusive lock of single active transaction */
+    /* Exclusive lock of single active transaction, except read-only transactions */
     if (clicon_ptr_get(h, "controller-transaction-list", (void**)&ct_list) == 0 &&
         (ct = ct_list) != NULL) {
         do {
-            if (ct->ct_state != TS_DONE){
+            if (ct->ct_state != TS_DONE && !ct->ct_readonly){
                 if ((*cberr = cbuf_new()) == NULL){
                     clixon_err(OE_UNIX, errno, "cbuf_new");
                     goto done;
@@ -312,6 +328,8 @@ controller_transaction_new(clixon_handle            h,
         clixon_err(OE_UNIX, errno, "strdup");
         goto done;
     }
+    if (controller_span_begin(h, ct) < 0)
+        goto done;
     (void)clicon_ptr_get(h, "controller-transaction-list", (void**)&ct_list);
     ADDQ(ct, ct_list);
     clicon_ptr_set(h, "controller-transaction-list", (void*)ct_list);
@@ -334,6 +352,61 @@ controller_transaction_new(clixon_handle            h,
     goto done;
 }
 
+/*! Create read-only controller transaction
+ *
+ * A read-only transaction does not lock candidate and may be created while another
+ * transaction is ongoing. It does not mark devices, reads are done over secondary sessions.
+ * @param[in]  h           Clixon handle
+ * @param[in]  ce_id       Client id
+ * @param[in]  description Description of transaction
+ * @param[out] ctp         Transaction struct (if retval = 0)
+ * @retval     0           OK
+ * @retval    -1           Error
+ * @see controller_transaction_new
+ */
+int
+controller_transaction_new_readonly(clixon_handle            h,
+                                    uint32_t                 ce_id,
+                                    char                    *description,
+                                    controller_transaction **ctp)
+{
+    int                     retval = -1;
+    controller_transaction *ct = NULL;
+    controller_transaction *ct_list = NULL;
+
+    clixon_debug(CLIXON_DBG_CTRL, "");
+    if ((ct = malloc(sizeof(*ct))) == NULL){
+        clixon_err(OE_NETCONF, errno, "malloc");
+        goto done;
+    }
+    memset(ct, 0, sizeof(*ct));
+    ct->ct_h = h;
+    ct->ct_client_id = ce_id;
+    ct->ct_readonly = 1;
+    if (transaction_new_id(h, &ct->ct_id) < 0)
+        goto done;
+    if (description &&
+        (ct->ct_description = strdup(description)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    if (controller_span_begin(h, ct) < 0)
+        goto done;
+    (void)clicon_ptr_get(h, "controller-transaction-list", (void**)&ct_list);
+    ADDQ(ct, ct_list);
+    clicon_ptr_set(h, "controller-transaction-list", (void*)ct_list);
+    *ctp = ct;
+    ct = NULL;
+    retval = 0;
+ done:
+    if (ct){
+        if (ct->ct_description)
+            free(ct->ct_description);
+        free(ct);
+    }
+    return retval;
+}
+
 /*! Free transaction itself
  */
 static int
@@ -349,6 +422,24 @@ controller_transaction_free1(controller_transaction *ct)
         free(ct->ct_warning);
     if (ct->ct_sourcedb)
         free(ct->ct_sourcedb);
+    if (ct->ct_memo)
+        cvec_free(ct->ct_memo);
+    if (ct->ct_get_filter)
+        free(ct->ct_get_filter);
+    if (ct->ct_get_key)
+        free(ct->ct_get_key);
+    if (ct->ct_get_replies)
+        cbuf_free(ct->ct_get_replies);
+    if (ct->ct_get_queue)
+        cvec_free(ct->ct_get_queue);
+    if (ct->ct_get_shared)
+        cvec_free(ct->ct_get_shared);
+    if (ct->ct_rpc)
+        free(ct->ct_rpc);
+    if (ct->ct_preview)
+        cbuf_free(ct->ct_preview);
+    if (ct->ct_spans)
+        cbuf_free(ct->ct_spans);
     free(ct);
     return 0;
 }
@@ -404,30 +495,91 @@ controller_transaction_done(clixon_handle           h,
     uint32_t      iddb;
     char         *db = "candidate";
     device_handle dh;
+    cbuf         *cb = NULL;
+    struct timeval now;
+    cxobj        *xt = NULL;
 
     clixon_debug(CLIXON_DBG_CTRL, "%s", transaction_result_int2str(ct->ct_state));
     controller_transaction_state_set(ct, TS_DONE, result);
-    iddb = xmldb_islocked(h, db);
-    if (iddb == TRANSACTION_CLIENT_ID){
-        if (xmldb_unlock(h, db) < 0)
-            goto done;
-        /* user callback */
-        if (clixon_plugin_lockdb_all(h, db, 0, TRANSACTION_CLIENT_ID) < 0)
-            goto done;
+    /* A read-only transaction has no lock, and other transactions may be ongoing */
+    if (!ct->ct_readonly){
+        iddb = xmldb_islocked(h, db);
+        if (iddb == TRANSACTION_CLIENT_ID){
+            if (xmldb_unlock(h, db) < 0)
+                goto done;
+            /* user callback */
+            if (clixon_plugin_lockdb_all(h, db, 0, TRANSACTION_CLIENT_ID) < 0)
+                goto done;
+        }
     }
-    /* Unmark all devices */
+    /* Unmark devices of this transaction */
     dh = NULL;
     while ((dh = device_handle_each(h, dh)) != NULL){
         if (device_handle_tid_get(dh) == ct->ct_id)
             device_handle_tid_set(dh, 0);
-        device_handle_outmsg_set(dh, 1, NULL);
-        device_handle_outmsg_set(dh, 2, NULL);
+        if (!ct->ct_readonly){
+            device_handle_outmsg_set(dh, 1, NULL);
+            device_handle_outmsg_set(dh, 2, NULL);
+        }
+    }
+    /* Aggregated get-device-state replies are sent before the transaction notification */
+    if (ct->ct_get && ct->ct_rpc == NULL && !ct->ct_drift && ct->ct_get_aggregate){
+        if (stream_notify(h, "device-state-reply",
+                          "<device-state-reply xmlns=\"%s\"><tid>%" PRIu64 "</tid>%s</device-state-reply>",
+                          CONTROLLER_NAMESPACE, ct->ct_id,
+                          ct->ct_get_replies?cbuf_get(ct->ct_get_replies):"") < 0)
+            goto done;
+    }
+    /* device-rpc: last notification with aggregated replies, if any, and statistics */
+    if (ct->ct_get && ct->ct_rpc != NULL){
+        if ((cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        if (ct->ct_get_aggregate && ct->ct_get_replies)
+            cprintf(cb, "%s", cbuf_get(ct->ct_get_replies));
+        gettimeofday(&now, NULL);
+        timersub(&now, &ct->ct_rpc_start, &now);
+        cprintf(cb, "<statistics>");
+        cprintf(cb, "<devices>%u</devices>", ct->ct_rpc_nr);
+        if (ct->ct_rpc_nr){
+            cprintf(cb, "<min>%" PRIu64 "</min>", ct->ct_rpc_min);
+            cprintf(cb, "<max>%" PRIu64 "</max>", ct->ct_rpc_max);
+            cprintf(cb, "<avg>%" PRIu64 "</avg>", ct->ct_rpc_sum/ct->ct_rpc_nr);
+        }
+        cprintf(cb, "<total>%" PRIu64 "</total>",
+                (uint64_t)now.tv_sec*1000000 + now.tv_usec);
+        cprintf(cb, "</statistics>");
+        if (stream_notify(h, "device-rpc-reply",
+                          "<device-rpc-reply xmlns=\"%s\"><tid>%" PRIu64 "</tid>%s</device-rpc-reply>",
+                          CONTROLLER_NAMESPACE, ct->ct_id, cbuf_get(cb)) < 0)
+            goto done;
+    }
+    /* drift-scan: one notification with drifted and failed devices */
+    if (ct->ct_get && ct->ct_drift){
+        if (stream_notify(h, "drift-scan-reply",
+                          "<drift-scan-reply xmlns=\"%s\"><tid>%" PRIu64 "</tid>"
+                          "<compared>%u</compared><drifted>%u</drifted>%s</drift-scan-reply>",
+                          CONTROLLER_NAMESPACE, ct->ct_id, ct->ct_drift_nr, ct->ct_drift_drifted,
+                          ct->ct_get_replies?cbuf_get(ct->ct_get_replies):"") < 0)
+            goto done;
+    }
+    /* Record digests of memoized service instances once committed, see controller_memo.c */
+    if (ct->ct_result == TR_SUCCESS && ct->ct_memo && cvec_len(ct->ct_memo)){
+        if (controller_dbview_get(h, "running", &xt) < 0)
+            goto done;
+        if (xt && controller_memo_record(h, xt, ct->ct_memo) < 0)
+            goto done;
     }
     /* This should be the only place */
     if (controller_transaction_notify(h, ct) < 0)
         goto done;
     retval = 0;
  done:
+    if (xt)
+        controller_dbview_release(h, &xt);
+    if (cb)
+        cbuf_free(cb);
     return retval;
 }
 
@@ -459,23 +611,67 @@ controller_transaction_find(clixon_handle  h,
  *
  * @param[in]  h      Clixon handle
  * @param[in]  tid    Transaction id
- * @param[in]  state  In state (or -1 for any)
  * @retval     nr     Number of devices in transaction
  */
 int
 controller_transaction_nr_devices(clixon_handle h,
                                   uint64_t      tid)
 {
-    device_handle dh = NULL;
-    int           nr = 0;
+    int                     nr;
+    controller_transaction *ct;
 
-    while ((dh = device_handle_each(h, dh)) != NULL){
-        if (device_handle_tid_get(dh) == tid)
-            nr++;
+    nr = device_handle_tid_nr(h, tid);
+    /* Devices with outstanding reads on secondary sessions, or waiting for a request,
+     * are also in the transaction */
+    if ((ct = controller_transaction_find(h, tid)) != NULL){
+        nr += ct->ct_get_pending;
+        if (ct->ct_get_queue)
+            nr += cvec_len(ct->ct_get_queue) - ct->ct_get_next;
+        if (ct->ct_get_shared)
+            nr += cvec_len(ct->ct_get_shared);
     }
     return nr;
 }
 
+/*! Commit devices of a batched pull not yet committed when the pull ends in failure
+ *
+ * With CONTROLLER_PULL_BATCH_SIZE or CONTROLLER_PULL_BATCH_INTERVAL, configs of devices
+ * pulled successfully are committed also if other devices fail, as they are in earlier
+ * batches. Without, the last device commits, see CS_DEVICE_SYNC.
+ * @param[in]  h   Clixon handle
+ * @param[in]  ct  Transaction
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
+static int
+controller_transaction_pull_flush(clixon_handle           h,
+                                  controller_transaction *ct)
+{
+    int   retval = -1;
+    cbuf *cbret = NULL;
+
+    if (ct->ct_pull_transient || ct->ct_pull_batch_nr == 0 ||
+        (clicon_option_int(h, "CONTROLLER_PULL_BATCH_SIZE") == 0 &&
+         clicon_option_int(h, "CONTROLLER_PULL_BATCH_INTERVAL") == 0))
+        goto ok;
+    if ((cbret = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    clixon_debug(CLIXON_DBG_CTRL, "pull batch of %u devices", ct->ct_pull_batch_nr);
+    ct->ct_pull_batch_nr = 0;
+    if (candidate_commit(h, NULL, "tmpdev", 0, 0, cbret) <= 0)
+        clixon_log(h, LOG_WARNING, "%s: Failed to commit last pull batch: %s",
+                   __func__, cbuf_len(cbret) ? cbuf_get(cbret) : clixon_err_reason());
+    xmldb_delete(h, "tmpdev");
+ ok:
+    retval = 0;
+ done:
+    if (cbret)
+        cbuf_free(cbret);
+    return retval;
+}
+
 /*! A controller transaction (device) has failed
  *
  * This device failed, ie validation has failed, the device lost connection, etc
@@ -510,6 +706,7 @@ controller_transaction_failed(clixon_handle           h,
                               char                   *reason)
 {
     int retval = -1;
+    int dispatch = 0;
 
     if (ct == NULL){
         device_close_connection(dh, "Device not associated with transaction");
@@ -517,6 +714,14 @@ controller_transaction_failed(clixon_handle           h,
     }
     clixon_debug(CLIXON_DBG_CTRL, "");
     if (dh != NULL && devclose != TR_FAILED_DEV_IGNORE){
+        if (ct->ct_get &&
+            controller_transaction_get_reply(h, ct, dh, NULL, reason?reason:"Failed") < 0)
+            goto done;
+        /* Other transactions waiting for the same get also fail */
+        if (ct->ct_get && ct->ct_rpc == NULL && !ct->ct_drift &&
+            controller_transaction_get_shared(h, dh, ct->ct_get_filter, NULL,
+                                              reason?reason:"Failed") < 0)
+            goto done;
         if (devclose == TR_FAILED_DEV_CLOSE){
             /* 1.2 The error is not recoverable */
             /* 1.2.1 close the device */
@@ -539,9 +744,14 @@ controller_transaction_failed(clixon_handle           h,
                     goto done;
                 }
             }
+            if (controller_transaction_pull_flush(h, ct) < 0)
+                goto done;
             if (controller_transaction_done(h, ct, TR_FAILED) < 0)
                 goto done;
         }
+        /* Send get to next waiting device, if any, when failure is recorded */
+        else if (ct->ct_get)
+            dispatch = 1;
     }
     if (ct->ct_state == TS_INIT || ct->ct_state == TS_ACTIONS){
         /* 1.3 The transition is not in an error state
@@ -566,6 +776,9 @@ controller_transaction_failed(clixon_handle           h,
     else if (ct->ct_result == TR_SUCCESS){
         clixon_err(OE_XML, 0, "Sanity: may not be in resolved OK state");
     }
+    if (dispatch && ct->ct_state != TS_DONE &&
+        controller_transaction_get_dispatch(h, ct) < 0)
+        goto done;
     retval = 0;
  done:
     clixon_debug(CLIXON_DBG_CTRL, "retval:%d", retval);
@@ -655,6 +868,346 @@ controller_transaction_wait_trigger(clixon_handle h,
     return retval;
 }
 
+/*! Add device to the queue of a get-device-state, device-rpc or drift-scan transaction
+ *
+ * Queued devices are not marked with the transaction-id until a request is sent to them
+ * @param[in]  ct     Controller transaction
+ * @param[in]  name   Device name
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see controller_transaction_get_dispatch
+ */
+int
+controller_transaction_get_queue(controller_transaction *ct,
+                                 char                   *name)
+{
+    if (ct->ct_get_queue == NULL &&
+        (ct->ct_get_queue = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        return -1;
+    }
+    if (cvec_add_string(ct->ct_get_queue, name, NULL) < 0){
+        clixon_err(OE_UNIX, errno, "cvec_add_string");
+        return -1;
+    }
+    return 0;
+}
+
+/*! Compare get filters of two transactions, NULL is no filter
+ */
+static int
+transaction_get_filter_eq(char *f1,
+                          char *f2)
+{
+    if (f1 == NULL || f2 == NULL)
+        return f1 == f2;
+    return strcmp(f1, f2) == 0;
+}
+
+/*! Check if a device has an outstanding get with the same filter in another transaction
+ *
+ * @param[in]  h      Clixon handle
+ * @param[in]  ct     Controller transaction
+ * @param[in]  dh     Device handle
+ * @retval     1      Yes, the reply of that get can be shared
+ * @retval     0      No
+ */
+static int
+transaction_get_inflight(clixon_handle           h,
+                         controller_transaction *ct,
+                         device_handle           dh)
+{
+    controller_transaction *ct1;
+    uint64_t                tid;
+
+    if (ct->ct_rpc || ct->ct_drift)
+        return 0;
+    if ((tid = device_handle_tid_get(dh)) == 0 || tid == ct->ct_id)
+        return 0;
+    if (device_handle_conn_state_get(dh) != CS_DEVICE_GET)
+        return 0;
+    if ((ct1 = controller_transaction_find(h, tid)) == NULL ||
+        ct1->ct_state == TS_DONE || !ct1->ct_get || ct1->ct_rpc || ct1->ct_drift)
+        return 0;
+    return transaction_get_filter_eq(ct->ct_get_filter, ct1->ct_get_filter);
+}
+
+/*! Send get or rpc to queued devices of a get-device-state, device-rpc or drift-scan transaction
+ *
+ * A device is marked with the transaction-id when its request is sent, so that the number
+ * of outstanding requests is the number of marked devices.
+ * At most ct_get_max devices have outstanding requests at any time.
+ * If a get with the same filter is already outstanding on a device in another transaction,
+ * the device waits for that reply instead of sending a new get (single-flight).
+ * A queued device that is no longer open, or is busy in another transaction, fails.
+ * Done the transaction if no devices are left.
+ * @param[in]  h      Clixon handle
+ * @param[in]  ct     Controller transaction
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see controller_transaction_get_reply
+ */
+int
+controller_transaction_get_dispatch(clixon_handle           h,
+                                    controller_transaction *ct)
+{
+    int           retval = -1;
+    device_handle dh;
+    uint32_t      active;
+    conn_state    state;
+    cg_var       *cv;
+    char         *reason;
+
+    if (ct->ct_rpc)
+        state = CS_DEVICE_RPC;
+    else if (ct->ct_drift)
+        state = CS_DEVICE_DRIFT;
+    else
+        state = CS_DEVICE_GET;
+    active = device_handle_tid_nr(h, ct->ct_id);
+    while (ct->ct_get_queue && ct->ct_get_next < cvec_len(ct->ct_get_queue)){
+        if (ct->ct_get_max && active >= ct->ct_get_max)
+            break;
+        cv = cvec_i(ct->ct_get_queue, ct->ct_get_next++);
+        if ((dh = device_handle_find(h, cv_name_get(cv))) == NULL)
+            continue;
+        if (transaction_get_inflight(h, ct, dh)){
+            if (ct->ct_get_shared == NULL &&
+                (ct->ct_get_shared = cvec_new(0)) == NULL){
+                clixon_err(OE_UNIX, errno, "cvec_new");
+                goto done;
+            }
+            if (cvec_add_string(ct->ct_get_shared, cv_name_get(cv), NULL) < 0){
+                clixon_err(OE_UNIX, errno, "cvec_add_string");
+                goto done;
+            }
+            if (controller_state_cache_coalesced(h) < 0)
+                goto done;
+            continue;
+        }
+        reason = NULL;
+        if (device_handle_tid_get(dh) != 0)
+            reason = "Device is busy in another transaction";
+        else if (device_handle_conn_state_get(dh) != CS_OPEN)
+            reason = "Device is not open";
+        if (reason){
+            if (controller_transaction_get_reply(h, ct, dh, NULL, reason) < 0)
+                goto done;
+            if (ct->ct_state == TS_INIT){
+                controller_transaction_state_set(ct, TS_RESOLVED, TR_FAILED);
+                if (ct->ct_origin == NULL &&
+                    (ct->ct_origin = strdup(cv_name_get(cv))) == NULL){
+                    clixon_err(OE_UNIX, errno, "strdup");
+                    goto done;
+                }
+                if (ct->ct_reason == NULL &&
+                    (ct->ct_reason = strdup(reason)) == NULL){
+                    clixon_err(OE_UNIX, errno, "strdup");
+                    goto done;
+                }
+            }
+            continue;
+        }
+        device_handle_tid_set(dh, ct->ct_id);
+        if (ct->ct_rpc){
+            if (device_send_rpc(h, dh, ct->ct_rpc) < 0)
+                goto done;
+        }
+        else if (ct->ct_drift){
+            if (device_send_get_config(h, dh, device_handle_socket_get(dh)) < 0)
+                goto done;
+        }
+        else if (device_send_get(h, dh, ct->ct_get_filter) < 0)
+            goto done;
+        if (device_state_set(dh, state) < 0)
+            goto done;
+        active++;
+    }
+    clixon_debug(CLIXON_DBG_CTRL, "%" PRIu64 " active:%u", ct->ct_id, active);
+    if (ct->ct_state != TS_DONE &&
+        controller_transaction_nr_devices(h, ct->ct_id) == 0){
+        if (controller_transaction_done(h, ct,
+                                        ct->ct_state == TS_RESOLVED ? -1 : TR_SUCCESS) < 0)
+            goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Share the reply of a get from a device with transactions waiting for it
+ *
+ * @param[in]  h      Clixon handle
+ * @param[in]  dh     Device handle
+ * @param[in]  filter Filter of the get
+ * @param[in]  data   Serialized data from device, or NULL
+ * @param[in]  reason Failure reason, or NULL on success
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see controller_transaction_get_dispatch
+ */
+int
+controller_transaction_get_shared(clixon_handle h,
+                                  device_handle dh,
+                                  char         *filter,
+                                  char         *data,
+                                  char         *reason)
+{
+    int                     retval = -1;
+    controller_transaction *ct_list = NULL;
+    controller_transaction *ct;
+    cg_var                 *cv;
+    char                   *name;
+
+    name = device_handle_name_get(dh);
+    if (clicon_ptr_get(h, "controller-transaction-list", (void**)&ct_list) < 0 ||
+        (ct = ct_list) == NULL)
+        goto ok;
+    do {
+        if (ct->ct_state != TS_DONE &&
+            ct->ct_get_shared != NULL &&
+            transaction_get_filter_eq(ct->ct_get_filter, filter) &&
+            (cv = cvec_find(ct->ct_get_shared, name)) != NULL){
+            cvec_del(ct->ct_get_shared, cv);
+            if (controller_transaction_get_reply(h, ct, dh, data, reason) < 0)
+                goto done;
+            if (reason && ct->ct_state == TS_INIT){
+                controller_transaction_state_set(ct, TS_RESOLVED, TR_FAILED);
+                if (ct->ct_origin == NULL &&
+                    (ct->ct_origin = strdup(name)) == NULL){
+                    clixon_err(OE_UNIX, errno, "strdup");
+                    goto done;
+                }
+                if (ct->ct_reason == NULL &&
+                    (ct->ct_reason = strdup(reason)) == NULL){
+                    clixon_err(OE_UNIX, errno, "strdup");
+                    goto done;
+                }
+            }
+            /* Done if no devices left, else send to next queued device */
+            if (controller_transaction_get_dispatch(h, ct) < 0)
+                goto done;
+        }
+        ct = NEXTQ(controller_transaction *, ct);
+    } while (ct && ct != ct_list);
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Reply from one device in a get-device-state, device-rpc or drift-scan transaction
+ *
+ * Either notify the reply directly, or save it until the transaction is done.
+ * A device-rpc reply received in DEVICE-RPC state also records its reply time.
+ * @param[in]  h      Clixon handle
+ * @param[in]  ct     Controller transaction
+ * @param[in]  dh     Device handle
+ * @param[in]  data   Serialized data from device, or diff text if drift-scan, or NULL
+ * @param[in]  reason Failure reason, or NULL on success
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+controller_transaction_get_reply(clixon_handle           h,
+                                 controller_transaction *ct,
+                                 device_handle           dh,
+                                 char                   *data,
+                                 char                   *reason)
+{
+    int            retval = -1;
+    cbuf          *cb = NULL;
+    char          *stream;
+    struct timeval now;
+    struct timeval t;
+    uint64_t       us;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (ct->ct_rpc)
+        stream = "device-rpc-reply";
+    else if (ct->ct_drift)
+        stream = "drift-scan-reply";
+    else
+        stream = "device-state-reply";
+    cprintf(cb, "<device>");
+    cprintf(cb, "<name>%s</name>", device_handle_name_get(dh));
+    cprintf(cb, "<result>%s</result>", transaction_result_int2str(reason?TR_FAILED:TR_SUCCESS));
+    if (reason){
+        cprintf(cb, "<reason>");
+        if (xml_chardata_cbuf_append(cb, 0, reason) < 0)
+            goto done;
+        cprintf(cb, "</reason>");
+    }
+    if (ct->ct_rpc && device_handle_conn_state_get(dh) == CS_DEVICE_RPC){
+        gettimeofday(&now, NULL);
+        device_handle_conn_time_get(dh, &t);
+        timersub(&now, &t, &t);
+        us = (uint64_t)t.tv_sec*1000000 + t.tv_usec;
+        cprintf(cb, "<time>%" PRIu64 "</time>", us);
+        if (ct->ct_rpc_nr == 0 || us < ct->ct_rpc_min)
+            ct->ct_rpc_min = us;
+        if (us > ct->ct_rpc_max)
+            ct->ct_rpc_max = us;
+        ct->ct_rpc_sum += us;
+        ct->ct_rpc_nr++;
+    }
+    if (data && ct->ct_drift){
+        cprintf(cb, "<diff>");
+        if (xml_chardata_cbuf_append(cb, 0, data) < 0)
+            goto done;
+        cprintf(cb, "</diff>");
+    }
+    else if (data)
+        cprintf(cb, "<data>%s</data>", data);
+    cprintf(cb, "</device>");
+    if (ct->ct_get_aggregate){
+        if (ct->ct_get_replies == NULL &&
+            (ct->ct_get_replies = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(ct->ct_get_replies, "%s", cbuf_get(cb));
+    }
+    else if (stream_notify(h, stream,
+                           "<%s xmlns=\"%s\"><tid>%" PRIu64 "</tid>%s</%s>",
+                           stream, CONTROLLER_NAMESPACE, ct->ct_id, cbuf_get(cb), stream) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Find ongoing get-device-state transaction with identical request
+ *
+ * @param[in]  h    Clixon handle
+ * @param[in]  key  Request key
+ * @retval     ct   Transaction
+ * @retval     NULL Not found
+ */
+controller_transaction *
+controller_transaction_get_find(clixon_handle h,
+                                char         *key)
+{
+    controller_transaction *ct_list = NULL;
+    controller_transaction *ct = NULL;
+
+    if (clicon_ptr_get(h, "controller-transaction-list", (void**)&ct_list) == 0 &&
+        (ct = ct_list) != NULL) {
+        do {
+            if (ct->ct_get && ct->ct_state != TS_DONE &&
+                ct->ct_get_key && strcmp(ct->ct_get_key, key) == 0)
+                return ct;
+            ct = NEXTQ(controller_transaction *, ct);
+        } while (ct && ct != ct_list);
+    }
+    return NULL;
+}
+
 /*! Get transactions statedata
  *
  * @param[in]    h        Clixon handle
@@ -704,6 +1257,8 @@ controller_transaction_statedata(clixon_handle   h,
             }
             if (ct->ct_state != TS_INIT)
                 cprintf(cb, "<result>%s</result>", transaction_result_int2str(ct->ct_result));
+            if (ct->ct_preview)
+                cprintf(cb, "%s", cbuf_get(ct->ct_preview));
             tv = &ct->ct_timestamp;
             if (tv->tv_sec != 0){
                 char timestr[28];
@@ -51,16 +51,49 @@ struct controller_transaction_t{
     uint32_t           ct_client_id;     /* Client id of originator (may be stale) */
     int                ct_pull_transient;/* pull: dont commit locally */
     int                ct_pull_merge;    /* pull: Merge instead of replace */
+    uint32_t           ct_pull_batch_nr; /* pull: Devices pulled since last batch commit */
+    struct timeval     ct_pull_batch_time;/* pull: Time of last batch commit */
     push_type          ct_push_type;     /* push to remote devices: Do not, validate, or commit */
     actions_type       ct_actions_type;  /* How to trigger service-commit notifications,
                                             and thereby action scripts */
     char              *ct_sourcedb;      /* Source datastore (candidate or running)
                                             as given by rpc controller-commit (stripped prefix) */
+    cvec              *ct_memo;          /* actions: Notified service instances if memoized */
     char              *ct_description;   /* Description of transaction */
     char              *ct_origin;        /* Originator of error (if result is != SUCCESS) */
     char              *ct_reason;        /* Reason of error (if result != SUCCESS) */
     char              *ct_warning;       /* Warning, first encountered */
     struct timeval     ct_timestamp;     /* Timestamp when entering current state */
+    uint32_t           ct_timeout;       /* Device timeout in seconds, 0 means device-timeout */
+    int                ct_readonly;      /* No candidate lock, may run with other transactions */
+    int                ct_get;           /* get-device-state or device-rpc: fan-out to devices */
+    char              *ct_get_filter;    /* get: <filter> element sent to devices, or NULL */
+    char              *ct_get_key;       /* get: Request key, identical requests may join */
+    uint32_t           ct_get_maxage;    /* get: Max age of cached device replies, 0 is no cache */
+    uint32_t           ct_get_max;       /* get: Max outstanding device requests, 0 is no limit */
+    int                ct_get_aggregate; /* get: Notify all device replies when done */
+    cbuf              *ct_get_replies;   /* get: Aggregated device replies */
+    uint32_t           ct_get_pending;   /* get: Outstanding reads on secondary read sessions */
+    cvec              *ct_get_queue;     /* get: Names of devices waiting for a request */
+    int                ct_get_next;      /* get: Index of next device in ct_get_queue */
+    cvec              *ct_get_shared;    /* get: Devices waiting for the reply of an identical
+                                            get of another transaction */
+    char              *ct_rpc;           /* device-rpc: RPC sent to devices, NULL for get */
+    struct timeval     ct_rpc_start;     /* device-rpc: Time of request */
+    uint32_t           ct_rpc_nr;        /* device-rpc: Number of device replies */
+    uint64_t           ct_rpc_min;       /* device-rpc: Min reply time in us */
+    uint64_t           ct_rpc_max;       /* device-rpc: Max reply time in us */
+    uint64_t           ct_rpc_sum;       /* device-rpc: Sum of reply times in us */
+    int                ct_drift;         /* drift-scan: compare device config with synced */
+    int                ct_drift_diff;    /* drift-scan: Include diff of drifted devices */
+    uint32_t           ct_drift_nr;      /* drift-scan: Number of compared devices */
+    uint32_t           ct_drift_drifted; /* drift-scan: Number of drifted devices */
+    int                ct_preview_edit;  /* push preview: Include rendered edit-config */
+    cbuf              *ct_preview;       /* push preview: Per-device edits */
+    uint64_t           ct_trace_id[2];   /* Trace-id, if traced */
+    uint64_t           ct_span_id;       /* Root span-id, if traced */
+    struct timeval     ct_trace_start;   /* Start time of root span */
+    cbuf              *ct_spans;         /* Ended child spans as OTLP-JSON, NULL if not traced */
 };
 typedef struct controller_transaction_t controller_transaction;
 
@@ -85,6 +118,7 @@ extern "C" {
 int   controller_transaction_state_set(controller_transaction *ct, transaction_state state, transaction_result result);
 int   controller_transaction_notify(clixon_handle h, controller_transaction *ct);
 int   controller_transaction_new(clixon_handle h, uint32_t ce_id, char *description, controller_transaction **ct, cbuf **cberr);
+int   controller_transaction_new_readonly(clixon_handle h, uint32_t ce_id, char *description, controller_transaction **ct);
 int   controller_transaction_free(clixon_handle h, controller_transaction *ct);
 int   controller_transaction_free_all(clixon_handle h);
 int   controller_transaction_done(clixon_handle h, controller_transaction *ct, transaction_result result);
@@ -95,6 +129,12 @@ int   controller_transaction_failed(clixon_handle h, uint64_t tid, controller_tr
                                     tr_failed_devclose devclose, char *origin, char *reason);
 int   controller_transaction_wait(clixon_handle h, uint64_t tid);
 int   controller_transaction_wait_trigger(clixon_handle h, uint64_t tid, int commit);
+int   controller_transaction_get_queue(controller_transaction *ct, char *name);
+int   controller_transaction_get_dispatch(clixon_handle h, controller_transaction *ct);
+int   controller_transaction_get_shared(clixon_handle h, device_handle dh, char *filter, char *data, char *reason);
+int   controller_transaction_get_reply(clixon_handle h, controller_transaction *ct, device_handle dh,
+                                       char *data, char *reason);
+controller_transaction *controller_transaction_get_find(clixon_handle h, char *key);
 int   controller_transaction_statedata(clixon_handle h, cvec *nsc, char *xpath, cxobj *xstate);
 
 #ifdef __cplusplus
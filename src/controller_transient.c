@@ -0,0 +1,390 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Volatile in-memory cache of TRANSIENT device configs
+  * Configs pulled with transient, eg by push check, drift-scan or config-pull transient,
+  * are kept in memory instead of being written to the device-<name>-TRANSIENT datastore.
+  * The cache holds at most CONTROLLER_TRANSIENT_CACHE_SIZE devices, the least recently used
+  * config is dropped when evicted. A config is only written to its datastore when explicitly
+  * persisted, eg when it is referred to in an error message. Any stored copy is deleted when
+  * the device config is cached again, so that a dropped config is not read from a stale
+  * datastore.
+  * The cache is volatile: it is lost when the backend exits.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_transient.h"
+#include "controller_kvstore.h"
+
+/*! Cached transient config of one device
+ */
+struct transient_entry {
+    qelem_t  te_qelem;  /* LRU list, least recently used first */
+    char    *te_name;   /* Device name */
+    cxobj   *te_xt;     /* Config as given to device_config_write: devices/device/config */
+};
+typedef struct transient_entry transient_entry;
+
+/*! Transient config cache
+ */
+struct transient_cache {
+    transient_entry *tc_lru;     /* LRU list of entries */
+    clicon_hash_t   *tc_hash;    /* Entries indexed by device name */
+    clicon_hash_t   *tc_stored;  /* Devices without stored copy: 0, persisted: 1 */
+    uint32_t         tc_entries; /* Number of entries */
+};
+typedef struct transient_cache transient_cache;
+
+/*! Get transient cache, create if not exists
+ *
+ * @param[in]  h    Clixon handle
+ * @retval     tc   Transient cache
+ * @retval     NULL Error
+ */
+static transient_cache *
+transient_cache_get(clixon_handle h)
+{
+    transient_cache *tc = NULL;
+
+    if (clicon_ptr_get(h, "controller-transient-cache", (void**)&tc) == 0 && tc != NULL)
+        return tc;
+    if ((tc = malloc(sizeof(*tc))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        return NULL;
+    }
+    memset(tc, 0, sizeof(*tc));
+    if ((tc->tc_hash = clicon_hash_init()) == NULL){
+        free(tc);
+        return NULL;
+    }
+    if ((tc->tc_stored = clicon_hash_init()) == NULL){
+        clicon_hash_free(tc->tc_hash);
+        free(tc);
+        return NULL;
+    }
+    clicon_ptr_set(h, "controller-transient-cache", tc);
+    return tc;
+}
+
+/*! Remove and free one cache entry
+ */
+static int
+transient_entry_free(transient_cache *tc,
+                     transient_entry *te)
+{
+    clicon_hash_del(tc->tc_hash, te->te_name);
+    DELQ(te, tc->tc_lru, transient_entry *);
+    tc->tc_entries--;
+    free(te->te_name);
+    if (te->te_xt)
+        xml_free(te->te_xt);
+    free(te);
+    return 0;
+}
+
+/*! Write cached config of a device to its TRANSIENT datastore
+ *
+ * @param[in]  h    Clixon handle
+ * @param[in]  te   Cache entry
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+transient_entry_write(clixon_handle    h,
+                      transient_entry *te)
+{
+    int    retval = -1;
+    cbuf  *cb = NULL;
+    cbuf  *cbret = NULL;
+    cxobj *xt = NULL;
+    int    ret;
+
+    if ((cb = cbuf_new()) == NULL ||
+        (cbret = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if (controller_kvstore_active()){
+        retval = controller_kvstore_config_write(h, te->te_name, "TRANSIENT", te->te_xt);
+        goto done;
+    }
+    cprintf(cb, "device-%s-TRANSIENT", te->te_name);
+    /* Must make a copy: xmldb_put strips attributes */
+    if ((xt = xml_dup(te->te_xt)) == NULL)
+        goto done;
+    if (xmldb_db_reset(h, cbuf_get(cb)) < 0)
+        goto done;
+    if ((ret = xmldb_put(h, cbuf_get(cb), OP_REPLACE, xt, clicon_username_get(h), cbret)) < 0)
+        goto done;
+    if (ret == 0)
+        clixon_log(h, LOG_WARNING, "%s: Failed to write transient config: %s",
+                   te->te_name, cbuf_get(cbret));
+    retval = 0;
+ done:
+    if (xt)
+        xml_free(xt);
+    if (cb)
+        cbuf_free(cb);
+    if (cbret)
+        cbuf_free(cbret);
+    return retval;
+}
+
+/*! Delete stored TRANSIENT config of a device, unless known not to exist
+ *
+ * A stored copy is written by controller_transient_persist, or may remain from an earlier
+ * run of the backend.
+ * @param[in]  h       Clixon handle
+ * @param[in]  tc      Transient cache
+ * @param[in]  devname Device name
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+transient_stored_delete(clixon_handle    h,
+                        transient_cache *tc,
+                        char            *devname)
+{
+    int   retval = -1;
+    int  *stored;
+    int   zero = 0;
+    cbuf *cb = NULL;
+
+    if ((stored = clicon_hash_value(tc->tc_stored, devname, NULL)) != NULL && *stored == 0)
+        goto ok;
+    if (controller_kvstore_active()){
+        if (controller_kvstore_config_delete(devname, "TRANSIENT") < 0)
+            goto done;
+    }
+    else {
+        if ((cb = cbuf_new()) == NULL){
+            clixon_err(OE_UNIX, errno, "cbuf_new");
+            goto done;
+        }
+        cprintf(cb, "device-%s-TRANSIENT", devname);
+        if (xmldb_exists(h, cbuf_get(cb)) == 1 &&
+            xmldb_delete(h, cbuf_get(cb)) < 0)
+            goto done;
+    }
+    if (clicon_hash_add(tc->tc_stored, devname, &zero, sizeof(zero)) == NULL)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Max number of cached configs, 0 means no cache
+ */
+static uint32_t
+transient_cache_size_max(clixon_handle h)
+{
+    int size;
+
+    if ((size = clicon_option_int(h, "CONTROLLER_TRANSIENT_CACHE_SIZE")) < 0)
+        return 0;
+    return size;
+}
+
+/*! Save transient config of a device in memory
+ *
+ * Replaces any existing entry of the device. Drops least recently used entries until size
+ * is within limit, they are not written to their datastores.
+ * @param[in]  h       Clixon handle
+ * @param[in]  devname Device name
+ * @param[in]  xt      Config on the form devices/device/config, copied
+ * @retval     1       Cached
+ * @retval     0       Not cached: cache disabled, write to datastore instead
+ * @retval    -1       Error
+ */
+int
+controller_transient_put(clixon_handle h,
+                         char         *devname,
+                         cxobj        *xt)
+{
+    int               retval = -1;
+    transient_cache  *tc;
+    transient_entry **tep;
+    transient_entry  *te = NULL;
+    uint32_t          max;
+
+    if ((max = transient_cache_size_max(h)) == 0)
+        goto nocache;
+    if ((tc = transient_cache_get(h)) == NULL)
+        goto done;
+    if ((tep = clicon_hash_value(tc->tc_hash, devname, NULL)) != NULL)
+        transient_entry_free(tc, *tep);
+    while (tc->tc_lru != NULL && tc->tc_entries >= max)
+        transient_entry_free(tc, tc->tc_lru);
+    if (transient_stored_delete(h, tc, devname) < 0)
+        goto done;
+    if ((te = malloc(sizeof(*te))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memset(te, 0, sizeof(*te));
+    if ((te->te_name = strdup(devname)) == NULL){
+        clixon_err(OE_UNIX, errno, "strdup");
+        goto done;
+    }
+    if ((te->te_xt = xml_dup(xt)) == NULL)
+        goto done;
+    if (clicon_hash_add(tc->tc_hash, te->te_name, &te, sizeof(te)) == NULL)
+        goto done;
+    ADDQ(te, tc->tc_lru);
+    tc->tc_entries++;
+    te = NULL;
+    retval = 1;
+ done:
+    if (te){
+        if (te->te_name)
+            free(te->te_name);
+        if (te->te_xt)
+            xml_free(te->te_xt);
+        free(te);
+    }
+    return retval;
+ nocache:
+    retval = 0;
+    goto done;
+}
+
+/*! Get transient config of a device from memory
+ *
+ * @param[in]  h       Clixon handle
+ * @param[in]  devname Device name
+ * @param[out] xconfig Copy of device config element, free with xml_free. Empty if the
+ *                     cached config has no device config
+ * @retval     1       Hit
+ * @retval     0       Not in cache, read datastore instead
+ * @retval    -1       Error
+ */
+int
+controller_transient_get(clixon_handle h,
+                         char         *devname,
+                         cxobj       **xconfig)
+{
+    transient_cache  *tc;
+    transient_entry **tep;
+    transient_entry  *te;
+    cxobj            *xc;
+    cxobj            *xa;
+
+    if ((tc = transient_cache_get(h)) == NULL)
+        return -1;
+    if ((tep = clicon_hash_value(tc->tc_hash, devname, NULL)) == NULL)
+        return 0;
+    te = *tep;
+    xc = xpath_first(te->te_xt, NULL, "devices/device/config");
+    if (xconfig && xc == NULL){
+        if ((*xconfig = xml_new("config", NULL, CX_ELMNT)) == NULL)
+            return -1;
+    }
+    else if (xconfig){
+        if ((*xconfig = xml_dup(xc)) == NULL)
+            return -1;
+        /* Strip operation attribute, as xmldb_put does */
+        if ((xa = xml_find_type(*xconfig, NULL, "operation", CX_ATTR)) != NULL)
+            xml_purge(xa);
+    }
+    /* Most recently used last */
+    DELQ(te, tc->tc_lru, transient_entry *);
+    ADDQ(te, tc->tc_lru);
+    return 1;
+}
+
+/*! Write transient config of a device to its datastore, it is also kept in memory
+ *
+ * Use when the datastore is referred to, eg device-<name>-TRANSIENT_db in an error message
+ * @param[in]  h       Clixon handle
+ * @param[in]  devname Device name
+ * @retval     0       OK, also if not cached
+ * @retval    -1       Error
+ */
+int
+controller_transient_persist(clixon_handle h,
+                             char         *devname)
+{
+    transient_cache  *tc;
+    transient_entry **tep;
+    int               one = 1;
+
+    if ((tc = transient_cache_get(h)) == NULL)
+        return -1;
+    if ((tep = clicon_hash_value(tc->tc_hash, devname, NULL)) == NULL)
+        return 0;
+    if (clicon_hash_add(tc->tc_stored, devname, &one, sizeof(one)) == NULL)
+        return -1;
+    return transient_entry_write(h, *tep);
+}
+
+/*! Free transient cache
+ *
+ * @param[in]  h       Clixon handle
+ */
+int
+controller_transient_free(clixon_handle h)
+{
+    transient_cache *tc = NULL;
+
+    if (clicon_ptr_get(h, "controller-transient-cache", (void**)&tc) < 0 || tc == NULL)
+        return 0;
+    while (tc->tc_lru != NULL)
+        transient_entry_free(tc, tc->tc_lru);
+    clicon_hash_free(tc->tc_hash);
+    clicon_hash_free(tc->tc_stored);
+    free(tc);
+    clicon_ptr_del(h, "controller-transient-cache");
+    return 0;
+}
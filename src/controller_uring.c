@@ -0,0 +1,832 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Batched sends to and receives from devices using io_uring
+  * If built with CONTROLLER_IO_URING (configure --with-liburing), messages to devices are
+  * queued and submitted in one io_uring_submit() when control returns to the event loop,
+  * so that a push to many devices costs one syscall per event loop round instead of one
+  * write per device. Completions are signalled on an eventfd registered in the event loop.
+  * Messages queued to the same socket are submitted as one chain of linked writes, in order.
+  * Device sockets may also be read with multishot receives into a ring of provided
+  * buffers, instead of one read() per socket and event loop round.
+  * If io_uring can not be set up, or without CONTROLLER_IO_URING, messages are written
+  * directly with clixon_msg_send10() and sockets are read from the event loop.
+  * @see util/clixon_controller_uringbench.c
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/time.h>
+#ifdef CONTROLLER_IO_URING
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <liburing.h>
+#endif
+
+/* clicon */
+#include <cligen/cligen.h>
+
+/* Clicon library functions. */
+#include <clixon/clixon.h>
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_uring.h"
+
+#ifdef CONTROLLER_IO_URING
+/*! Number of submission queue entries
+ */
+#define CONTROLLER_URING_ENTRIES 256
+
+/*! Max number of linked writes to one socket in one submission
+ */
+#define CONTROLLER_URING_LINK 16
+
+/*! Buffer group id of provided receive buffers
+ */
+#define CONTROLLER_URING_BGID 1
+
+/*! Number of provided receive buffers, power of 2
+ */
+#define CONTROLLER_URING_BUFS 256
+
+/*! Size of one provided receive buffer
+ */
+#define CONTROLLER_URING_BUFSIZE BUFSIZ
+
+/*! Kind of a submission, first field of user data
+ */
+enum uring_kind {
+    URING_SEND = 1,
+    URING_RECV
+};
+
+/*! One queued message
+ */
+typedef struct uring_send {
+    enum uring_kind    us_kind;     /* URING_SEND */
+    struct uring_send *us_next;
+    int                us_socket;   /* -1 if detached by controller_uring_close */
+    char              *us_buf;      /* Message, framed */
+    size_t             us_len;      /* Length of message */
+    size_t             us_off;      /* Bytes written so far */
+    int                us_prep;     /* Write is prepared and not completed */
+} uring_send;
+
+/*! Multishot receive of one socket
+ */
+typedef struct uring_recv {
+    enum uring_kind              ur_kind;   /* URING_RECV */
+    int                          ur_socket; /* -1 if detached by controller_uring_close */
+    controller_uring_recv_fn_t  *ur_fn;     /* Called with received data */
+    void                        *ur_arg;    /* Argument to ur_fn */
+    int                          ur_armed;  /* Receive is prepared and not terminated */
+} uring_recv;
+
+/*! Send queue and receive of one socket, indexed by socket
+ */
+typedef struct {
+    uring_send                *uq_head;     /* First message */
+    uring_send                *uq_tail;
+    int                        uq_inflight; /* Number of prepared writes not completed */
+    int                        uq_error;    /* Errno of a failed write in the current chain */
+    controller_uring_err_fn_t *uq_fn;       /* Called on write error */
+    void                      *uq_arg;      /* Argument to uq_fn */
+    uring_recv                *uq_recv;     /* Multishot receive, or NULL */
+} uring_queue;
+
+static int          _uring_active = 0;    /* io_uring is set up */
+static struct io_uring _uring;
+static int          _uring_efd = -1;      /* Completion eventfd */
+static int          _uring_pending = 0;   /* Submission scheduled */
+static uring_queue *_uring_vec = NULL;    /* Send queues indexed by socket */
+static int          _uring_len = 0;       /* Length of _uring_vec */
+static struct io_uring_buf_ring *_uring_br = NULL; /* Provided buffer ring, NULL if no receives */
+static char        *_uring_bufs = NULL;   /* Receive buffers of the ring */
+
+static int controller_uring_submit_cb(int fd, void *arg);
+
+/*! Get queue of socket, grow queue vector if needed
+ *
+ * @param[in]  s    Socket
+ * @retval     uq   Socket queue
+ * @retval     NULL Error
+ */
+static uring_queue *
+uring_queue_get(int s)
+{
+    uring_queue *vec;
+    int          len;
+
+    if (s < 0){
+        clixon_err(OE_UNIX, EINVAL, "s is negative");
+        return NULL;
+    }
+    if (s >= _uring_len){
+        len = _uring_len ? _uring_len : 64;
+        while (len <= s)
+            len *= 2;
+        if ((vec = realloc(_uring_vec, len*sizeof(*vec))) == NULL){
+            clixon_err(OE_UNIX, errno, "realloc");
+            return NULL;
+        }
+        memset(&vec[_uring_len], 0, (len-_uring_len)*sizeof(*vec));
+        _uring_vec = vec;
+        _uring_len = len;
+    }
+    return &_uring_vec[s];
+}
+
+/*! Free first message of a socket queue
+ */
+static void
+uring_queue_pop(uring_queue *uq)
+{
+    uring_send *us;
+
+    if ((us = uq->uq_head) != NULL){
+        if ((uq->uq_head = us->us_next) == NULL)
+            uq->uq_tail = NULL;
+        free(us->us_buf);
+        free(us);
+    }
+}
+
+/*! Drop all messages of a socket queue
+ *
+ * Messages with prepared writes are detached and freed on completion
+ */
+static void
+uring_queue_drop(uring_queue *uq)
+{
+    uring_send *us;
+
+    while ((us = uq->uq_head) != NULL){
+        if (us->us_prep){
+            if ((uq->uq_head = us->us_next) == NULL)
+                uq->uq_tail = NULL;
+            us->us_socket = -1;
+            us->us_next = NULL;
+        }
+        else
+            uring_queue_pop(uq);
+    }
+    uq->uq_inflight = 0;
+    uq->uq_error = 0;
+}
+
+/*! Get a submission queue entry, submit what is queued if full
+ */
+static struct io_uring_sqe *
+uring_sqe_get(void)
+{
+    struct io_uring_sqe *sqe;
+    int                  ret;
+
+    if ((sqe = io_uring_get_sqe(&_uring)) == NULL){
+        if ((ret = io_uring_submit(&_uring)) < 0){
+            clixon_err(OE_UNIX, -ret, "io_uring_submit");
+            return NULL;
+        }
+        if ((sqe = io_uring_get_sqe(&_uring)) == NULL){
+            clixon_err(OE_UNIX, EAGAIN, "io_uring_get_sqe");
+            return NULL;
+        }
+    }
+    return sqe;
+}
+
+/*! Schedule submission when control returns to the event loop
+ *
+ * Batches submissions of all sockets of this round
+ */
+static int
+uring_submit_schedule(void)
+{
+    struct timeval t;
+
+    if (_uring_pending)
+        return 0;
+    gettimeofday(&t, NULL);
+    if (clixon_event_reg_timeout(t, controller_uring_submit_cb, NULL, "controller uring submit") < 0)
+        return -1;
+    _uring_pending = 1;
+    return 0;
+}
+
+/*! Prepare linked writes of the messages in a socket queue, and schedule submission
+ *
+ * The writes are linked so that they are done in order. If a write is short, the rest of
+ * the chain is cancelled and prepared again when the chain has completed.
+ * A new chain is not prepared while writes of a socket are in flight.
+ * @param[in]  uq   Socket send queue
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+uring_queue_prep(uring_queue *uq)
+{
+    int                  retval = -1;
+    struct io_uring_sqe *sqe;
+    uring_send          *us;
+    int                  n = 0;
+    int                  i;
+    int                  ret;
+
+    if (uq->uq_head == NULL || uq->uq_inflight){
+        retval = 0;
+        goto done;
+    }
+    for (us = uq->uq_head; us && n < CONTROLLER_URING_LINK; us = us->us_next)
+        n++;
+    /* A chain must not be split between submissions */
+    if (io_uring_sq_space_left(&_uring) < (unsigned)n &&
+        (ret = io_uring_submit(&_uring)) < 0){
+        clixon_err(OE_UNIX, -ret, "io_uring_submit");
+        goto done;
+    }
+    for (i = 0, us = uq->uq_head; i < n; i++, us = us->us_next){
+        if ((sqe = uring_sqe_get()) == NULL)
+            goto done;
+        io_uring_prep_write(sqe, us->us_socket, us->us_buf + us->us_off, us->us_len - us->us_off, -1);
+        io_uring_sqe_set_data(sqe, us);
+        if (i < n-1)
+            io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+        us->us_prep = 1;
+        uq->uq_inflight++;
+    }
+    if (uring_submit_schedule() < 0)
+        goto done;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Prepare a multishot receive of a socket into provided buffers
+ *
+ * @param[in]  ur   Socket receive
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+uring_recv_prep(uring_recv *ur)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = uring_sqe_get()) == NULL)
+        return -1;
+    io_uring_prep_recv_multishot(sqe, ur->ur_socket, NULL, 0, 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+    sqe->buf_group = CONTROLLER_URING_BGID;
+    io_uring_sqe_set_data(sqe, ur);
+    ur->ur_armed = 1;
+    return uring_submit_schedule();
+}
+
+/*! Return a provided buffer to the ring
+ */
+static void
+uring_buf_recycle(int bid)
+{
+    io_uring_buf_ring_add(_uring_br, _uring_bufs + bid*CONTROLLER_URING_BUFSIZE,
+                          CONTROLLER_URING_BUFSIZE, bid,
+                          io_uring_buf_ring_mask(CONTROLLER_URING_BUFS), 0);
+    io_uring_buf_ring_advance(_uring_br, 1);
+}
+
+/*! Set up ring of provided receive buffers
+ *
+ * Requires Linux 5.19. If not available, sockets are read from the event loop
+ * @retval     0    OK, _uring_br is NULL if not available
+ * @retval    -1    Error
+ */
+static int
+uring_buf_ring_setup(void)
+{
+    int                     retval = -1;
+    struct io_uring_buf_reg reg;
+    void                   *ring;
+    size_t                  len;
+    int                     ret;
+    int                     i;
+
+    len = CONTROLLER_URING_BUFS * sizeof(struct io_uring_buf);
+    if ((ring = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0)) == MAP_FAILED){
+        clixon_err(OE_UNIX, errno, "mmap");
+        goto done;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)ring;
+    reg.ring_entries = CONTROLLER_URING_BUFS;
+    reg.bgid = CONTROLLER_URING_BGID;
+    if ((ret = io_uring_register_buf_ring(&_uring, &reg, 0)) < 0){
+        clixon_log(NULL, LOG_NOTICE, "io_uring provided buffers not available: %s, using event loop reads",
+                   strerror(-ret));
+        munmap(ring, len);
+        goto ok;
+    }
+    if ((_uring_bufs = malloc(CONTROLLER_URING_BUFS * CONTROLLER_URING_BUFSIZE)) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        io_uring_unregister_buf_ring(&_uring, CONTROLLER_URING_BGID);
+        munmap(ring, len);
+        goto done;
+    }
+    _uring_br = (struct io_uring_buf_ring *)ring;
+    io_uring_buf_ring_init(_uring_br);
+    for (i=0; i<CONTROLLER_URING_BUFS; i++)
+        io_uring_buf_ring_add(_uring_br, _uring_bufs + i*CONTROLLER_URING_BUFSIZE,
+                              CONTROLLER_URING_BUFSIZE, i,
+                              io_uring_buf_ring_mask(CONTROLLER_URING_BUFS), i);
+    io_uring_buf_ring_advance(_uring_br, CONTROLLER_URING_BUFS);
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Submit all prepared writes and receives, called from event loop
+ *
+ * @param[in]  fd   Not used
+ * @param[in]  arg  Not used
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+controller_uring_submit_cb(int   fd,
+                           void *arg)
+{
+    int retval = -1;
+    int ret;
+
+    _uring_pending = 0;
+    if ((ret = io_uring_submit(&_uring)) < 0){
+        clixon_err(OE_UNIX, -ret, "io_uring_submit");
+        goto done;
+    }
+    clixon_debug(CLIXON_DBG_CTRL | CLIXON_DBG_DETAIL, "submitted: %d", ret);
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Handle completion of a write
+ *
+ * When all writes of a chain have completed, a short write is continued with the next
+ * chain, and a failed write drops the remaining messages and calls the error callback
+ * of the socket.
+ * @param[in]  us   Message
+ * @param[in]  res  Result of write
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+uring_send_complete(uring_send *us,
+                    int         res)
+{
+    uring_queue               *uq;
+    controller_uring_err_fn_t *fn;
+    void                      *arg;
+    int                        s;
+    int                        err;
+
+    if ((s = us->us_socket) == -1){ /* Detached by controller_uring_close */
+        free(us->us_buf);
+        free(us);
+        return 0;
+    }
+    uq = &_uring_vec[s];
+    uq->uq_inflight--;
+    us->us_prep = 0;
+    /* Writes of a chain complete in order, us is the head of the queue */
+    if (uq->uq_error)
+        uring_queue_pop(uq);                  /* Cancelled after a failed write */
+    else if (res == -ECANCELED)
+        ;                                     /* Cancelled after a short write, prepared again */
+    else if (res < 0){
+        uq->uq_error = -res;
+        uring_queue_pop(uq);
+    }
+    else if ((us->us_off += res) >= us->us_len)
+        uring_queue_pop(uq);
+    if (uq->uq_inflight)
+        return 0;
+    if ((err = uq->uq_error) != 0){
+        clixon_debug(CLIXON_DBG_CTRL, "write socket %d: %s", s, strerror(err));
+        fn = uq->uq_fn;
+        arg = uq->uq_arg;
+        uring_queue_drop(uq);
+        if (fn)
+            return fn(s, err, arg);
+        return 0;
+    }
+    return uring_queue_prep(uq);
+}
+
+/*! Handle completion of a multishot receive
+ *
+ * Received data is passed to the receive callback of the socket, and the buffer is
+ * returned to the ring. The receive is prepared again if it was terminated, eg when
+ * buffers run out.
+ * @param[in]  ur    Socket receive
+ * @param[in]  res   Result of receive
+ * @param[in]  flags Flags of completion
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+uring_recv_complete(uring_recv *ur,
+                    int         res,
+                    unsigned    flags)
+{
+    int   retval = -1;
+    int   bid = -1;
+    int   more;
+    char *buf = NULL;
+
+    more = (flags & IORING_CQE_F_MORE) != 0;
+    if (flags & IORING_CQE_F_BUFFER){
+        bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        buf = _uring_bufs + bid*CONTROLLER_URING_BUFSIZE;
+    }
+    if (ur->ur_socket != -1){
+        if (res > 0 && buf){
+            if (ur->ur_fn(ur->ur_socket, (unsigned char*)buf, res, 0, ur->ur_arg) < 0)
+                goto done;
+        }
+        else if (res == 0 || (res < 0 && res != -ENOBUFS && res != -ECANCELED)){
+            if (res < 0)
+                clixon_debug(CLIXON_DBG_CTRL, "recv socket %d: %s", ur->ur_socket, strerror(-res));
+            if (ur->ur_fn(ur->ur_socket, NULL, 0, 1, ur->ur_arg) < 0)
+                goto done;
+        }
+    }
+    retval = 0;
+ done:
+    if (bid != -1)
+        uring_buf_recycle(bid);
+    /* The callback may have detached ur, it is freed when its receive has terminated */
+    if (!more){
+        ur->ur_armed = 0;
+        if (ur->ur_socket == -1)
+            free(ur);
+        else if (retval == 0 && res != 0 && uring_recv_prep(ur) < 0)
+            retval = -1;
+    }
+    return retval;
+}
+
+/*! Reap completions, called from event loop when completion eventfd is readable
+ *
+ * @param[in]  efd  Completion eventfd
+ * @param[in]  arg  Not used
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+controller_uring_complete_cb(int   efd,
+                             void *arg)
+{
+    int                  retval = -1;
+    struct io_uring_cqe *cqe;
+    void                *ud;
+    uint64_t             n;
+    unsigned             flags;
+    int                  res;
+
+    if (read(efd, &n, sizeof(n)) < 0 && errno != EAGAIN){
+        clixon_err(OE_UNIX, errno, "read");
+        goto done;
+    }
+    while (io_uring_peek_cqe(&_uring, &cqe) == 0){
+        ud = io_uring_cqe_get_data(cqe);
+        res = cqe->res;
+        flags = cqe->flags;
+        io_uring_cqe_seen(&_uring, cqe);
+        if (ud == NULL) /* Cancel */
+            continue;
+        if (*(enum uring_kind *)ud == URING_RECV){
+            if (uring_recv_complete((uring_recv *)ud, res, flags) < 0)
+                goto done;
+        }
+        else if (uring_send_complete((uring_send *)ud, res) < 0)
+            goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+#endif /* CONTROLLER_IO_URING */
+
+/*! Set up io_uring for sends and receives, fall back to direct writes if not available
+ *
+ * @param[in]  h    Clixon handle
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+controller_uring_init(clixon_handle h)
+{
+#ifdef CONTROLLER_IO_URING
+    int retval = -1;
+    int ret;
+
+    if ((ret = io_uring_queue_init(CONTROLLER_URING_ENTRIES, &_uring, 0)) < 0){
+        clixon_log(h, LOG_NOTICE, "io_uring not available: %s, using direct writes", strerror(-ret));
+        goto ok;
+    }
+    if ((_uring_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0){
+        clixon_err(OE_UNIX, errno, "eventfd");
+        goto done;
+    }
+    if ((ret = io_uring_register_eventfd(&_uring, _uring_efd)) < 0){
+        clixon_err(OE_UNIX, -ret, "io_uring_register_eventfd");
+        goto done;
+    }
+    if (clixon_event_reg_fd(_uring_efd, controller_uring_complete_cb, NULL, "controller uring") < 0)
+        goto done;
+    _uring_active = 1;
+    if (uring_buf_ring_setup() < 0)
+        goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+/*! Send a framed message to a device socket
+ *
+ * With io_uring, the message is copied and queued. If a write fails, the remaining
+ * messages to the socket are dropped and fn is called, later from the event loop.
+ * @param[in]  s      Socket
+ * @param[in]  descr  Description of peer, for logging
+ * @param[in]  cb     Framed message
+ * @param[in]  fn     Called if a queued write fails, or NULL
+ * @param[in]  arg    Argument to fn
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+controller_uring_send(int                        s,
+                      const char                *descr,
+                      cbuf                      *cb,
+                      controller_uring_err_fn_t *fn,
+                      void                      *arg)
+{
+#ifdef CONTROLLER_IO_URING
+    int          retval = -1;
+    uring_send  *us = NULL;
+    uring_queue *uq;
+
+    if (!_uring_active)
+        return clixon_msg_send10(s, descr, cb);
+    if ((uq = uring_queue_get(s)) == NULL)
+        goto done;
+    clixon_debug(CLIXON_DBG_MSG, "Send [%s]: %s", descr, cbuf_get(cb));
+    if ((us = malloc(sizeof(*us))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memset(us, 0, sizeof(*us));
+    us->us_kind = URING_SEND;
+    us->us_socket = s;
+    us->us_len = cbuf_len(cb);
+    if ((us->us_buf = malloc(us->us_len)) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memcpy(us->us_buf, cbuf_get(cb), us->us_len);
+    uq->uq_fn = fn;
+    uq->uq_arg = arg;
+    if (uq->uq_tail)
+        uq->uq_tail->us_next = us;
+    else
+        uq->uq_head = us;
+    uq->uq_tail = us;
+    us = NULL;
+    if (uring_queue_prep(uq) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (us){
+        if (us->us_buf)
+            free(us->us_buf);
+        free(us);
+    }
+    return retval;
+#else
+    return clixon_msg_send10(s, descr, cb);
+#endif
+}
+
+/*! Check if device sockets are read with io_uring
+ *
+ * @retval     1    Yes, register with controller_uring_recv_reg
+ * @retval     0    No, register in the event loop
+ */
+int
+controller_uring_recv_active(void)
+{
+#ifdef CONTROLLER_IO_URING
+    return _uring_active && _uring_br != NULL;
+#else
+    return 0;
+#endif
+}
+
+/*! Read a device socket with io_uring
+ *
+ * fn is called from the event loop with received data, or with eof set when the socket
+ * is closed by the peer. Stop with controller_uring_close.
+ * @param[in]  s    Socket
+ * @param[in]  fn   Called with received data
+ * @param[in]  arg  Argument to fn
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see controller_uring_recv_active
+ */
+int
+controller_uring_recv_reg(int                         s,
+                          controller_uring_recv_fn_t *fn,
+                          void                       *arg)
+{
+#ifdef CONTROLLER_IO_URING
+    int          retval = -1;
+    uring_queue *uq;
+    uring_recv  *ur;
+
+    if (!controller_uring_recv_active()){
+        clixon_err(OE_UNIX, ENOTSUP, "io_uring receive not active");
+        goto done;
+    }
+    if ((uq = uring_queue_get(s)) == NULL)
+        goto done;
+    if (uq->uq_recv != NULL){
+        clixon_err(OE_UNIX, EEXIST, "socket %d already registered", s);
+        goto done;
+    }
+    if ((ur = malloc(sizeof(*ur))) == NULL){
+        clixon_err(OE_UNIX, errno, "malloc");
+        goto done;
+    }
+    memset(ur, 0, sizeof(*ur));
+    ur->ur_kind = URING_RECV;
+    ur->ur_socket = s;
+    ur->ur_fn = fn;
+    ur->ur_arg = arg;
+    uq->uq_recv = ur;
+    if (uring_recv_prep(ur) < 0)
+        goto done;
+    retval = 0;
+ done:
+    return retval;
+#else
+    clixon_err(OE_UNIX, ENOTSUP, "io_uring receive not active");
+    return -1;
+#endif
+}
+
+/*! Drop queued messages and receive of a socket, must be called before the socket is closed
+ *
+ * Prepared but unsubmitted writes and receives refer to the socket number. They are
+ * submitted and then cancelled, so that they are not issued on a reused socket number.
+ * @param[in]  s    Socket
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+controller_uring_close(int s)
+{
+#ifdef CONTROLLER_IO_URING
+    int                  retval = -1;
+    uring_queue         *uq;
+    uring_recv          *ur;
+    struct io_uring_sqe *sqe;
+    int                  ret;
+
+    if (!_uring_active || s < 0 || s >= _uring_len){
+        retval = 0;
+        goto done;
+    }
+    uq = &_uring_vec[s];
+    ur = uq->uq_recv;
+    if (uq->uq_inflight || (ur && ur->ur_armed)){
+        if (io_uring_sq_ready(&_uring) > 0 &&
+            (ret = io_uring_submit(&_uring)) < 0){
+            clixon_err(OE_UNIX, -ret, "io_uring_submit");
+            goto done;
+        }
+        if ((sqe = uring_sqe_get()) == NULL)
+            goto done;
+        io_uring_prep_cancel_fd(sqe, s, IORING_ASYNC_CANCEL_ALL);
+        io_uring_sqe_set_data(sqe, NULL);
+        if ((ret = io_uring_submit(&_uring)) < 0){
+            clixon_err(OE_UNIX, -ret, "io_uring_submit");
+            goto done;
+        }
+    }
+    uring_queue_drop(uq);
+    uq->uq_fn = NULL;
+    uq->uq_arg = NULL;
+    if (ur){
+        /* Freed when its receive has terminated */
+        ur->ur_socket = -1;
+        if (!ur->ur_armed)
+            free(ur);
+        uq->uq_recv = NULL;
+    }
+    retval = 0;
+ done:
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+/*! Free io_uring resources, called on exit
+ *
+ * @retval     0    OK
+ */
+int
+controller_uring_exit(void)
+{
+#ifdef CONTROLLER_IO_URING
+    int i;
+
+    if (_uring_pending){
+        clixon_event_unreg_timeout(controller_uring_submit_cb, NULL);
+        _uring_pending = 0;
+    }
+    if (_uring_active){
+        clixon_event_unreg_fd(_uring_efd, controller_uring_complete_cb);
+        io_uring_queue_exit(&_uring);
+        _uring_active = 0;
+    }
+    if (_uring_br){
+        munmap(_uring_br, CONTROLLER_URING_BUFS * sizeof(struct io_uring_buf));
+        _uring_br = NULL;
+    }
+    if (_uring_bufs){
+        free(_uring_bufs);
+        _uring_bufs = NULL;
+    }
+    if (_uring_efd != -1){
+        close(_uring_efd);
+        _uring_efd = -1;
+    }
+    if (_uring_vec){
+        for (i=0; i<_uring_len; i++){
+            while (_uring_vec[i].uq_head)
+                uring_queue_pop(&_uring_vec[i]);
+            if (_uring_vec[i].uq_recv)
+                free(_uring_vec[i].uq_recv);
+        }
+        free(_uring_vec);
+        _uring_vec = NULL;
+    }
+    _uring_len = 0;
+#endif
+    return 0;
+}
@@ -51,6 +51,8 @@ test -d $dir || mkdir -p $dir
 test -d $CFD || mkdir -p $CFD
 
 fyang=$dir/myyang.yang
+# Action daemon log, one "tid:" debug line per services-commit notification
+SLOG=$dir/service.log
 
 : ${clixon_controller_xpath:=clixon_controller_xpath}
 
@@ -102,7 +104,7 @@ EOF
 
 cat<<EOF > $CFD/action-command.xml
 <clixon-config xmlns="http://clicon.org/config">
-  <CONTROLLER_ACTION_COMMAND xmlns="http://clicon.org/controller-config">${BINDIR}/clixon_controller_service -f $CFG</CONTROLLER_ACTION_COMMAND>
+  <CONTROLLER_ACTION_COMMAND xmlns="http://clicon.org/controller-config">${BINDIR}/clixon_controller_service -f $CFG -l f$SLOG -D app</CONTROLLER_ACTION_COMMAND>
 </clixon-config>
 EOF
 
@@ -975,6 +977,61 @@ expectpart "$(${clixon_cli} -m configure -1f $CFG apply services myyang:testA fo
 new "apply all services"
 expectpart "$(${clixon_cli} -m configure -1f $CFG apply services 2>&1)" 0 "OK"
 
+new "enable service memoization"
+expectpart "$(${clixon_cli} -m configure -1f $CFG set processes services memoize true)" 0 ""
+
+new "commit memoize"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit 2>&1)" 0 "OK"
+
+new "apply all services, record memo"
+expectpart "$(${clixon_cli} -m configure -1f $CFG apply services 2>&1)" 0 "OK"
+
+nr0=$(sudo grep -c "tid:" $SLOG) || true
+
+new "apply all services, memoized"
+expectpart "$(${clixon_cli} -m configure -1f $CFG apply services 2>&1)" 0 "OK"
+
+new "Check action daemon not invoked"
+nr1=$(sudo grep -c "tid:" $SLOG) || true
+if [ "$nr1" != "$nr0" ]; then
+    err "$nr0 services-commit notifications" "$nr1"
+fi
+
+new "Check A0x kept"
+expectpart "$(${clixon_cli} -1f $CFG show configuration devices device openconfig1 config interfaces interface A0x)" 0 "A0x"
+
+new "commit diff memoized"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit diff 2>&1)" 0 OK --not-- "<interface"
+
+new "apply single service, memoized"
+expectpart "$(${clixon_cli} -m configure -1f $CFG apply services myyang:testA foo 2>&1)" 0 "OK"
+
+new "Check action daemon not invoked for single service"
+nr1=$(sudo grep -c "tid:" $SLOG) || true
+if [ "$nr1" != "$nr0" ]; then
+    err "$nr0 services-commit notifications" "$nr1"
+fi
+
+new "restart action daemon"
+expectpart "$(${clixon_cli} -1f $CFG processes services restart 2>&1)" 0 ""
+
+sleep $sleep
+
+new "apply all services after action daemon restart"
+expectpart "$(${clixon_cli} -m configure -1f $CFG apply services 2>&1)" 0 "OK"
+
+new "Check action daemon invoked, memo cleared"
+nr1=$(sudo grep -c "tid:" $SLOG) || true
+if [ "$nr1" -le "$nr0" ]; then
+    err "more than $nr0 services-commit notifications" "$nr1"
+fi
+
+new "disable service memoization"
+expectpart "$(${clixon_cli} -m configure -1f $CFG delete processes services memoize)" 0 ""
+
+new "commit no memoize"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit 2>&1)" 0 "OK"
+
 if $BE; then
     new "Kill old backend"
     stop_backend -f $CFG
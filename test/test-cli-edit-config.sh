@@ -70,6 +70,14 @@ function testrun()
     new "Set hostname to test on openconfig*"
     expectpart "$($clixon_cli -1 -f $CFG -m configure 'set devices device openconfig* config system config hostname test')" 0 ""
 
+    new "Commit preview on openconfig*"
+    expectpart "$($clixon_cli -1 -f $CFG -m configure commit preview 2>&1)" 0 "^openconfig1: deleted:0 added:0 changed:1 size:" "^openconfig2: deleted:0 added:0 changed:1 size:" OK
+
+    for container in $CONTAINERS; do
+        new "Verify hostname not pushed to $container"
+        expectpart "$(ssh -l $USER $container clixon_cli -1 show configuration cli)" 0 --not-- "system config hostname test"
+    done
+
     new "Commit on openconfig*"
     expectpart "$($clixon_cli -1 -f $CFG -m configure commit)" 0 ""
 
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+# CLI load of config file in batches
+# Save config to file, load it back in small batches and check there is no diff
+# Load a file with a modified device and check diff
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+CFG=${SYSCONFDIR}/clixon/controller.xml
+
+dir=/var/tmp/$0
+test -d $dir || mkdir -p $dir
+fconfig=$dir/config.xml
+
+# Reset devices
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "Wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+new "Save candidate to file"
+expectpart "$($clixon_cli -1f $CFG -m configure save $fconfig)" 0 "^$"
+
+new "Load replace in batches"
+expectpart "$($clixon_cli -1f $CFG -m configure load replace xml filename $fconfig batch 100 2>&1)" 0 "^$"
+
+new "Verify no diff"
+expectpart "$($clixon_cli -1f $CFG -m configure show compare)" 0 "^$"
+
+new "Modify device 1 in file"
+sed -i "s/<hostname>${IMG}1<\/hostname>/<hostname>batchhost<\/hostname>/" $fconfig
+
+new "Load merge in batches"
+expectpart "$($clixon_cli -1f $CFG -m configure load merge xml filename $fconfig batch 100 2>&1)" 0 "^$"
+
+new "Verify diff"
+expectpart "$($clixon_cli -1f $CFG -m configure -o CLICON_CLI_OUTPUT_FORMAT=text show compare)" 0 "^-\ *hostname ${IMG}1;" "^+\ *hostname batchhost;"
+
+new "Batched load of json is not supported"
+expectpart "$($clixon_cli -1f $CFG -m configure load merge json filename $fconfig batch 100 2>&1)" 255 "Batched load only supported for xml format"
+
+new "discard"
+expectpart "$($clixon_cli -1f $CFG -m configure discard)" 0 "^$"
+
+cat <<EOF > $fconfig
+<config>
+   <devices xmlns="http://clicon.org/controller">
+      <device>
+         <name>xdev1</name>
+         <enabled>false</enabled>
+      </device>
+      <device>
+         <name>xdev2</name>
+         <enabled>false</enabled>
+      </device>
+   </devices>
+</config>
+EOF
+
+new "Load create in batches of one device"
+expectpart "$($clixon_cli -1f $CFG -m configure load create xml filename $fconfig batch 10 2>&1)" 0 "^$"
+
+new "Verify both devices created"
+expectpart "$($clixon_cli -1f $CFG -m configure show compare)" 0 "xdev1" "xdev2"
+
+new "Load create of existing devices fails"
+expectpart "$($clixon_cli -1f $CFG -m configure load create xml filename $fconfig batch 10 2>&1)" 255 "data-exists"
+
+new "discard"
+expectpart "$($clixon_cli -1f $CFG -m configure discard)" 0 "^$"
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+rm -rf $dir
+
+endtest
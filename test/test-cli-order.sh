@@ -36,6 +36,23 @@ function sleep_open()
     fi
 }
 
+# Pull device config and check order of dns servers
+# Args:
+# 1: order     Expected space-separated addresses in order
+function check_device_order()
+{
+    order=$1
+
+    new "pull"
+    expectpart "$($clixon_cli -1 -f $CFG pull)" 0 ""
+
+    new "check device order: $order"
+    ret=$($clixon_cli -1 -f $CFG -o CLICON_CLI_OUTPUT_FORMAT=text show config | grep -o "address [0-9.]*;" | tr -d ';' | awk '{print $2}' | tr '\n' ' ')
+    if [ "$ret" != "$order " ]; then
+        err "$order " "$ret"
+    fi
+}
+
 if $BE; then
     new "Kill old backend"
     sudo clixon_backend -s init -f $CFG -z
@@ -111,6 +128,88 @@ new "commit fail"
 echo "$clixon_cli -1  -m configure -f $CFG commit push"
 expectpart "$($clixon_cli -1  -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
 
+# Ordered-by user inserts and deletes are pushed to the device in order
+new "pull to sync order"
+expectpart "$($clixon_cli -1 -f $CFG pull)" 0 ""
+
+new "delete all servers"
+expectpart "$($clixon_cli -1 -m configure -f $CFG delete devices device openconfig1 config system dns servers)" 0 ""
+
+new "commit push delete all"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
+
+for a in 1.1.1.1 2.2.2.2 3.3.3.3; do
+    new "add $a"
+    expectpart "$($clixon_cli -1 -m configure -f $CFG set devices device openconfig1 config system dns servers server $a config address $a)" 0 ""
+done
+
+new "commit push add three"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
+
+check_device_order "1.1.1.1 2.2.2.2 3.3.3.3"
+
+new "insert 0.0.0.0 first"
+ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0" message-id="42">
+  <edit-config>
+    <target><candidate/></target>
+    <config>
+      <devices xmlns="http://clicon.org/controller">
+        <device>
+          <name>openconfig1</name>
+          <config>
+            <system xmlns="http://openconfig.net/yang/system">
+              <dns>
+                <servers>
+                  <server xmlns:yang="urn:ietf:params:xml:ns:yang:1" yang:insert="first">
+                    <address>0.0.0.0</address>
+                    <config>
+                      <address>0.0.0.0</address>
+                    </config>
+                  </server>
+                </servers>
+              </dns>
+            </system>
+          </config>
+        </device>
+      </devices>
+    </config>
+  </edit-config>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo "$ret" | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err "<ok/>" "$ret"
+fi
+
+new "commit push insert first"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
+
+check_device_order "0.0.0.0 1.1.1.1 2.2.2.2 3.3.3.3"
+
+new "delete middle 2.2.2.2"
+expectpart "$($clixon_cli -1 -m configure -f $CFG delete devices device openconfig1 config system dns servers server 2.2.2.2)" 0 ""
+
+new "commit push delete middle"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
+
+check_device_order "0.0.0.0 1.1.1.1 3.3.3.3"
+
+new "add 4.4.4.4 last"
+expectpart "$($clixon_cli -1 -m configure -f $CFG set devices device openconfig1 config system dns servers server 4.4.4.4 config address 4.4.4.4)" 0 ""
+
+new "commit push insert last"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit push 2>&1)" 0 "^OK$"
+
+check_device_order "0.0.0.0 1.1.1.1 3.3.3.3 4.4.4.4"
+
 if $BE; then
     new "Kill old backend"
     stop_backend -f $CFG
@@ -235,6 +235,14 @@ cmd="set devices device-profile myprofile yang-config BIND"
 new "$cmd"
 expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
 
+cmd="set devices device-profile myprofile pacing max-outstanding 1"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+cmd="set devices device-profile myprofile pacing min-interval 10"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
 new "commit"
 expectpart "$($clixon_cli -1 -m configure -f $CFG commit local)" 0 "^$"
 
@@ -272,6 +280,154 @@ if [ "$res" != "$nr" ]; then
     err1 "$nr devices" "$res"
 fi
 
+# Pacing: requests over the limit are queued and sent min-interval apart
+# Use the message log to check send times of the RPCs of a reconnect
+interval=300
+MLOG=$dir/messages.log
+
+cmd="set devices device-profile myprofile pacing min-interval $interval"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+cmd="set devices device-profile myprofile message-log true"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+cmd="set devices message-log file $MLOG"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+cmd="set devices message-log rate-limit 0"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+new "commit"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit local)" 0 "^$"
+
+new "connection close"
+expectpart "$($clixon_cli -1 -f $CFG connection close)" 0 "^$"
+
+sudo rm -f $MLOG
+
+new "connection open paced"
+expectpart "$($clixon_cli -1 -f $CFG connection open)" 0 "^$"
+
+sleep 2
+
+new "Verify controller paced"
+res=$(${clixon_cli} -1f $CFG show connections | grep OPEN | wc -l)
+if [ "$res" != "$nr" ]; then
+    err1 "$nr devices" "$res"
+fi
+
+# Per device: sends are at least interval apart (spaced), there is a reply between two
+# sends (max-outstanding 1), and some sends come later than interval/2 after the
+# reply they waited for, ie they were queued
+for i in $(seq 1 $nr); do
+    NAME="$IMG$i"
+    new "Check $NAME requests queued and spaced by min-interval $interval ms"
+    res=$(sudo grep " $NAME \(send\|recv\) " $MLOG | awk -v iv=$interval '
+function ms(ts,   t, hms) {
+    split(ts, t, "T")
+    split(t[2], hms, ":")
+    return ((hms[1]*60 + hms[2])*60 + hms[3])*1000
+}
+function gap(t0, t1) {
+    return t1 >= t0 ? t1 - t0 : t1 + 86400000 - t0
+}
+{
+    t = ms($1)
+    if ($3 == "send"){
+        if (sends && gap(last, t) < iv - 1)
+            spaced++
+        if (prev == "send")
+            outstanding++
+        if (prev == "recv" && sends && gap(recv, t) >= iv/2)
+            queued++
+        last = t
+        sends++
+    }
+    else
+        recv = t
+    prev = $3
+}
+END { printf "sends:%d queued:%d early:%d outstanding:%d\n", sends, queued, spaced, outstanding }')
+    if [ -z "$(echo "$res" | grep -E "sends:([2-9]|[1-9][0-9]+) queued:[1-9][0-9]* early:0 outstanding:0")" ]; then
+        err "sends:>1 queued:>0 early:0 outstanding:0" "$res"
+    fi
+done
+
+# Delete a device while a paced request to it is queued
+# The pacing timer and queue are freed with the device, the backend survives the timeout
+NAME=${IMG}1
+interval=8000
+
+cmd="set devices device-profile myprofile pacing min-interval $interval"
+new "$cmd"
+expectpart "$($clixon_cli -1 -m configure -f $CFG $cmd)" 0 "^$"
+
+new "commit"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit local)" 0 "^$"
+
+# Send a config-pull rpc to NAME without waiting for the transaction to complete
+# Args:
+# 1: msg     Test message
+function pull_one()
+{
+    msg=$1
+
+    new "$msg"
+    ret=$(${clixon_netconf} -q0 -f $CFG <<EOF
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0" message-id="42">
+  <config-pull xmlns="http://clicon.org/controller">
+    <devname>$NAME</devname>
+  </config-pull>
+</rpc>]]>]]>
+EOF
+       )
+    match=$(echo "$ret" | grep --null -Eo "<rpc-error>") || true
+    if [ -n "$match" ]; then
+        err "no rpc-error" "$ret"
+    fi
+}
+
+pull_one "pull $NAME, sent directly"
+
+sleep 1
+
+sends=$(sudo grep -c " $NAME send " $MLOG)
+
+pull_one "pull $NAME, queued for $interval ms"
+
+sleep 1
+
+new "Check pull of $NAME is queued"
+res=$(sudo grep -c " $NAME send " $MLOG)
+if [ "$res" != "$sends" ]; then
+    err "$sends sends" "$res"
+fi
+
+new "delete device $NAME"
+expectpart "$($clixon_cli -1 -m configure -f $CFG delete devices device $NAME)" 0 "^$"
+
+new "commit"
+expectpart "$($clixon_cli -1 -m configure -f $CFG commit local)" 0 "^$"
+
+# Past the time the queued request would have been sent
+sleep $((interval/1000))
+
+new "Verify backend after paced device deleted"
+res=$(${clixon_cli} -1f $CFG show connections | grep OPEN | wc -l)
+if [ "$res" != "$((nr-1))" ]; then
+    err1 "$((nr-1)) devices" "$res"
+fi
+
+new "Check no send to $NAME after delete"
+res=$(sudo grep -c " $NAME send " $MLOG)
+if [ "$res" != "$sends" ]; then
+    err "$sends sends" "$res"
+fi
+
 if $BE; then
     new "Kill old backend"
     stop_backend -f $CFG
@@ -0,0 +1,143 @@
+#!/usr/bin/env bash
+# Backend device name matching using rpc device-match
+# Reset devices and backend, match devices with glob and regex patterns
+# Check that module-set digests of devices of the same type are equal
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+CFG=${SYSCONFDIR}/clixon/controller.xml
+
+# Reset devices
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "Wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+# Send device-match rpc
+# 1: pattern
+# 2: pattern-type
+function device_match()
+{
+    local pat=$1
+    local ptype=$2
+
+    ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-match xmlns="http://clicon.org/controller">
+      <pattern>${pat}</pattern>
+      <pattern-type>${ptype}</pattern-type>
+   </device-match>
+</rpc>]]>]]>
+EOF
+       )
+}
+
+new "device-match glob all"
+device_match "*" glob
+#echo "ret:$ret"
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "$ret"
+fi
+for i in $(seq 1 $nr); do
+    NAME=$IMG$i
+    match=$(echo $ret | grep --null -Eo "<device xmlns=\"http://clicon.org/controller\"><name>$NAME</name><module-set-digest>[0-9a-f]*</module-set-digest></device>") || true
+    if [ -z "$match" ]; then
+        err1 "$NAME" "$ret"
+    fi
+done
+
+new "device-match same digest for all devices"
+nrdigest=$(echo $ret | grep -Eo "<module-set-digest>[0-9a-f]*</module-set-digest>" | sort -u | wc -l)
+if [ $nrdigest -ne 1 ]; then
+    err1 "1 digest" "$nrdigest"
+fi
+
+new "device-match glob one"
+device_match "${IMG}1" glob
+match=$(echo $ret | grep --null -Eo "<name>${IMG}2</name>") || true
+if [ -n "$match" ]; then
+    err1 "Only ${IMG}1" "$ret"
+fi
+match=$(echo $ret | grep --null -Eo "<name>${IMG}1</name>") || true
+if [ -z "$match" ]; then
+    err1 "${IMG}1" "$ret"
+fi
+
+new "device-match regex"
+device_match "^${IMG}[2-9]$" regex
+match=$(echo $ret | grep --null -Eo "<name>${IMG}1</name>") || true
+if [ -n "$match" ]; then
+    err1 "Not ${IMG}1" "$ret"
+fi
+match=$(echo $ret | grep --null -Eo "<name>${IMG}2</name>") || true
+if [ -z "$match" ]; then
+    err1 "${IMG}2" "$ret"
+fi
+
+new "device-match no match"
+device_match "xxx*" glob
+match=$(echo $ret | grep --null -Eo "<device ") || true
+if [ -n "$match" ]; then
+    err1 "No devices" "$ret"
+fi
+
+new "device-match invalid regex"
+device_match "[" regex
+match=$(echo $ret | grep --null -Eo "<error-tag>invalid-value</error-tag>") || true
+if [ -z "$match" ]; then
+    err1 "invalid-value" "$ret"
+fi
+
+new "CLI show config of device glob"
+expectpart "$($clixon_cli -1f $CFG show config devices device ${IMG}* config interfaces interface x config name)" 0 "${IMG}1:" "<name>x</name>"
+
+new "CLI device name completion"
+expectpart "$(echo "connection open ?" | $clixon_cli -f $CFG 2> /dev/null)" 0 "${IMG}1" "${IMG}2"
+
+new "CLI device name completion of typed prefix"
+expectpart "$(echo "connection open ${IMG}1?" | $clixon_cli -f $CFG 2> /dev/null)" 0 "${IMG}1" --not-- "${IMG}2"
+
+# Same CLI session: names are cached first, then updated by device-change notifications
+new "CLI device name cache updated on commit"
+ret=$(printf "connection open ${IMG}?\nconfigure\nset devices device xdev enabled false\ncommit local\nexit\nconnection open xd?\n" | $clixon_cli -f $CFG 2> /dev/null)
+match=$(echo "${ret##*open xd}" | grep --null -Eo "xdev") || true
+if [ -z "$match" ]; then
+    err1 "xdev" "$ret"
+fi
+
+new "CLI device name cache updated on delete"
+ret=$(printf "connection open ${IMG}?\nconfigure\ndelete devices device xdev\ncommit local\nexit\nconnection open xd?\n" | $clixon_cli -f $CFG 2> /dev/null)
+match=$(echo "${ret##*open xd}" | grep --null -Eo "xdev") || true
+if [ -n "$match" ]; then
+    err1 "No xdev" "$ret"
+fi
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+
+endtest
@@ -0,0 +1,359 @@
+#!/usr/bin/env bash
+# Fan-out get of config and state data from devices using rpc get-device-state
+# Get from all devices with a concurrency limit, and from one device
+# Check that closed devices are not selected
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+CFG=${SYSCONFDIR}/clixon/controller.xml
+
+# Reset devices
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "Wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+new "get-device-state rpc returns tid"
+ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>*</devname>
+      <max-concurrent>1</max-concurrent>
+   </get-device-state>
+</rpc>]]>]]>
+EOF
+   )
+#echo "ret:$ret"
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "$ret"
+fi
+match=$(echo $ret | grep --null -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>") || true
+if [ -z "$match" ]; then
+    err1 "tid" "$ret"
+fi
+
+# Let the transaction complete
+sleep $sleep
+
+new "CLI get state from all devices"
+ret=$($clixon_cli -1f $CFG show devices state 2>&1)
+for i in $(seq 1 $nr); do
+    NAME=$IMG$i
+    match=$(echo "$ret" | grep --null -Eo "^$NAME:") || true
+    if [ -z "$match" ]; then
+        err1 "$NAME:" "$ret"
+    fi
+done
+match=$(echo "$ret" | grep --null -Eo "Failed") || true
+if [ -n "$match" ]; then
+    err1 "No failure" "$ret"
+fi
+
+new "CLI get state from one device"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}1 state 2>&1)" 0 "^${IMG}1:" "<interfaces" --not-- "^${IMG}2:"
+
+new "Netconf get-device-state served from cache"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}1</devname>
+      <max-age>3600</max-age>
+   </get-device-state>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "$ret"
+fi
+
+new "Netconf two get-device-state without waiting, read-only transactions do not lock"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}1</devname>
+   </get-device-state>
+</rpc>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="43">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}2</devname>
+   </get-device-state>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "No error" "$ret"
+fi
+match=$(echo "$ret" | grep -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>" | wc -l) || true
+if [ "$match" != "2" ]; then
+    err1 "2 tids" "$ret"
+fi
+
+sleep $sleep
+
+new "Netconf two identical get-device-state share one device get"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}2</devname>
+   </get-device-state>
+</rpc>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="43">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}2</devname>
+   </get-device-state>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "No error" "$ret"
+fi
+
+sleep $sleep
+
+new "Check coalesced get"
+expectpart "$($clixon_cli -1f $CFG show state xml)" 0 "<state-cache>" "<coalesced>[1-9][0-9]*</coalesced>"
+
+new "Check state-cache hits"
+expectpart "$($clixon_cli -1f $CFG show state xml)" 0 "<state-cache>" "<hits>1</hits>" "<hit-rate>"
+
+new "Netconf device-rpc with RPC not in device YANG"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-rpc xmlns="http://clicon.org/controller">
+      <devname>${IMG}1</devname>
+      <rpc><xyz xmlns="urn:example:xyz"/></rpc>
+   </device-rpc>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "$ret"
+fi
+match=$(echo $ret | grep --null -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>") || true
+if [ -z "$match" ]; then
+    err1 "tid" "$ret"
+fi
+
+new "Check device-rpc transaction failed"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "<result>FAILED</result>" "RPC not valid for device YANG"
+
+new "Netconf device-rpc with example RPC to all devices"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-rpc xmlns="http://clicon.org/controller">
+      <devname>${IMG}*</devname>
+      <max-concurrent>1</max-concurrent>
+      <rpc><example xmlns="urn:example:clixon"><x>42</x></example></rpc>
+   </device-rpc>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "No error" "$ret"
+fi
+match=$(echo $ret | grep --null -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>") || true
+if [ -z "$match" ]; then
+    err1 "tid" "$ret"
+fi
+
+sleep $sleep
+
+new "Check device-rpc transaction succeeded"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "<description>device-rpc</description>" "<result>SUCCESS</result>" --not-- "<reason>"
+
+new "Enable read session on ${IMG}1"
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices device ${IMG}1 read-session true)" 0 ""
+
+new "commit local"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit local)" 0 ""
+
+new "CLI get state from one device over read session"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}1 state 2>&1)" 0 "^${IMG}1:" "<interfaces" --not-- "Failed"
+
+new "Read session requests of ${IMG}1"
+ret=$($clixon_cli -1f $CFG show state xml)
+rsreq0=$(echo "$ret" | tr -d '\n' | grep -o "<name>${IMG}1</name>.*" | grep -o "<read-session-requests>[0-9]*" | head -1 | grep -o "[0-9]*$") || true
+if [ -z "$rsreq0" ]; then
+    err1 "read-session-requests" "$ret"
+fi
+
+new "Netconf get-device-state on ${IMG}1 while a pull transaction is active"
+ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <config-pull xmlns="http://clicon.org/controller">
+      <devname>*</devname>
+   </config-pull>
+</rpc>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="43">
+   <get-device-state xmlns="http://clicon.org/controller">
+      <devname>${IMG}1</devname>
+   </get-device-state>
+</rpc>]]>]]>
+EOF
+   )
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    err1 "No error" "$ret"
+fi
+match=$(echo "$ret" | grep -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>" | wc -l) || true
+if [ "$match" != "2" ]; then
+    err1 "2 tids" "$ret"
+fi
+
+sleep $sleep
+
+new "Check get-device-state used the read session of ${IMG}1"
+ret=$($clixon_cli -1f $CFG show state xml)
+rsreq1=$(echo "$ret" | tr -d '\n' | grep -o "<name>${IMG}1</name>.*" | grep -o "<read-session-requests>[0-9]*" | head -1 | grep -o "[0-9]*$") || true
+if [ -z "$rsreq1" ] || [ "$rsreq1" -le "$rsreq0" ]; then
+    err1 "read-session-requests > $rsreq0" "$rsreq1"
+fi
+
+new "Close ${IMG}2"
+expectpart "$($clixon_cli -1f $CFG connection close ${IMG}2)" 0 "^$"
+
+new "CLI get state from closed device"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}2 state 2>&1)" 0 "^$"
+
+new "Open ${IMG}2"
+expectpart "$($clixon_cli -1f $CFG connection open ${IMG}2)" 0 "^$"
+
+new "Enable message log of ${IMG}2"
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices message-log file $dir/messages.log)" 0 ""
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices device ${IMG}2 message-log true)" 0 ""
+
+new "commit local"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit local)" 0 ""
+
+new "CLI get state from ${IMG}2 with message log"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}2 state 2>&1)" 0 "^${IMG}2:" "<interfaces"
+
+sleep 2
+
+new "Check message log"
+expectpart "$(sudo cat $dir/messages.log)" 0 "${IMG}2 send len=" "${IMG}2 recv len=" --not-- "${IMG}1 "
+
+new "Check message log has one line per record"
+res=$(sudo grep -c -v -E '^[0-9]{4}-[0-9]{2}-[0-9]{2}T[^ ]+Z [^ ]+ (send|recv) len=[0-9]+|^dropped=' $dir/messages.log)
+if [ "$res" != "0" ]; then
+    err1 "0 other lines" "$res"
+fi
+
+new "Set device-profile without message log on ${IMG}1"
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices device-profile mlprofile message-log false)" 0 ""
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices device ${IMG}1 device-profile mlprofile)" 0 ""
+
+new "commit local"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit local)" 0 ""
+
+new "Enable message log in device-profile, device stays open"
+expectpart "$(${clixon_cli} -m configure -1f $CFG set devices device-profile mlprofile message-log true)" 0 ""
+
+new "commit local"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit local)" 0 ""
+
+new "CLI get state from ${IMG}1 with message log from device-profile"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}1 state 2>&1)" 0 "^${IMG}1:" "<interfaces"
+
+sleep 2
+
+new "Check message log of ${IMG}1"
+expectpart "$(sudo cat $dir/messages.log)" 0 "${IMG}1 send len=" "${IMG}1 recv len="
+
+new "Delete message log"
+expectpart "$(${clixon_cli} -m configure -1f $CFG delete devices message-log)" 0 ""
+
+new "commit local"
+expectpart "$(${clixon_cli} -m configure -1f $CFG commit local)" 0 ""
+
+nr1=$(sudo wc -l < $dir/messages.log)
+
+new "CLI get state from ${IMG}2 without message log"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}2 state 2>&1)" 0 "^${IMG}2:" "<interfaces"
+
+sleep 2
+
+new "Check message log is closed"
+nr2=$(sudo wc -l < $dir/messages.log)
+if [ "$nr1" != "$nr2" ]; then
+    err1 "$nr1 lines" "$nr2"
+fi
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+endtest
@@ -0,0 +1,103 @@
+#!/usr/bin/env bash
+# Drift scan: compare device configs with last synced config using digests
+# First no device has drifted and no config is stored
+# Then change device configs on devices (not controller) and scan with diff
+# Check that the config of drifted devices is stored as transient
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+CFG=${SYSCONFDIR}/clixon/controller.xml
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "Wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+# drift-scan rpc
+# 1: diff true/false
+function drift_scan()
+{
+    diff=$1
+
+    ret=$(${clixon_netconf} -q0f $CFG <<EOF
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0" message-id="42">
+   <drift-scan xmlns="http://clicon.org/controller">
+      <devname>*</devname>
+      <max-concurrent>1</max-concurrent>
+      <diff>$diff</diff>
+   </drift-scan>
+</rpc>]]>]]>
+EOF
+       )
+    match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+    if [ -n "$match" ]; then
+        err1 "$ret"
+    fi
+    match=$(echo $ret | grep --null -Eo "<tid xmlns=\"http://clicon.org/controller\">[0-9]*</tid>") || true
+    if [ -z "$match" ]; then
+        err1 "tid" "$ret"
+    fi
+    # Let the transaction complete
+    sleep $sleep
+}
+
+new "drift-scan no drift"
+drift_scan false
+
+new "Check drift-scan transaction"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "<description>drift-scan</description>" "<result>SUCCESS</result>"
+
+# Change device configs on devices (not controller)
+. ./change-devices.sh
+
+new "drift-scan with diff"
+drift_scan true
+
+new "Check drift-scan transaction"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "<description>drift-scan</description>" "<result>SUCCESS</result>"
+
+CONFIG='<interfaces xmlns="http://openconfig.net/yang/interfaces"><interface><name>y</name><config><name>y</name><type xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">ianaift:atm</type></config></interface><interface><name>z</name><config><name>z</name><type xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">ianaift:usb</type></config></interface></interfaces><system xmlns="http://openconfig.net/yang/system">'
+
+for i in $(seq 1 $nr); do
+    NAME=$IMG$i
+    new "Check transient config of drifted device $NAME"
+    ret=$(${clixon_netconf} -q0 -f $CFG <<EOF
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0" message-id="43">
+  <get-device-config xmlns="http://clicon.org/controller">
+    <devname>$NAME</devname>
+    <config-type>TRANSIENT</config-type>
+  </get-device-config>
+</rpc>]]>]]>
+EOF
+      )
+    match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+    if [ -n "$match" ]; then
+        err1 "$ret"
+    fi
+    match=$(echo $ret | grep --null -Eo "$CONFIG") || true
+    if [ -z "$match" ]; then
+        err1 "$CONFIG" "$ret"
+    fi
+done
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+endtest
@@ -0,0 +1,154 @@
+#!/usr/bin/env bash
+# LMDB store of per-device configs, CONTROLLER_DEVICE_STORE, requires controller configured --with-lmdb
+# 1. Grouped writes with a small initial map size, the map is grown within the transaction
+# 2. Existing device-<name>-SYNCED datastores are imported when the backend first starts with the store
+# 3. Device check, push error message and pull with the store
+# 4. The store is kept over restart and not imported again
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+dir=/var/tmp/$0
+test -d $dir || mkdir -p $dir
+
+ret=$(clixon_controller_kvbench -X -n 1 -s 100 -d $dir 2>&1)
+if [ $? -ne 0 ]; then
+    echo "...skipped: device store not available: $ret"
+    if [ "$s" = $0 ]; then exit 0; else return 0; fi
+fi
+
+DB=${LOCALSTATEDIR}/controller
+STORE=$DB/test-kvstore.mdb
+
+# Read SYNCED config of all devices with datastore-diff, fails if there is no such device config
+# Args:
+# 1: msg     Test message
+function check_synced()
+{
+    msg=$1
+
+    for i in $(seq 1 $nr); do
+        NAME=$IMG$i
+        new "$msg: datastore-diff $NAME SYNCED"
+        ret=$(${clixon_netconf} -qe0 -f $CFG <<EOF
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+  xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0"
+  message-id="42">
+  <datastore-diff xmlns="http://clicon.org/controller">
+    <devname>$NAME</devname>
+    <config-type1>SYNCED</config-type1>
+    <config-type2>RUNNING</config-type2>
+  </datastore-diff>
+</rpc>]]>]]>
+EOF
+           )
+        match=$(echo "$ret" | grep --null -Eo "<rpc-error>") || true
+        if [ -n "$match" ]; then
+            err "no rpc-error" "$ret"
+        fi
+    done
+}
+
+new "kvbench batch with small map"
+ret=$(clixon_controller_kvbench -X -n 200 -s 10000 -m 65536 -d $dir)
+expectpart "$ret" 0 "store write batch .* 200 devices" "store enumerate .* 200 devices"
+
+new "kvbench map is grown"
+mapsize=$(echo "$ret" | grep "store mapsize" | awk '{print $3}')
+if [ -z "$mapsize" ] || [ "$mapsize" -le 65536 ]; then
+    err "mapsize > 65536" "$mapsize"
+fi
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+sudo rm -f $STORE $STORE-lock
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG without device store"
+    start_backend -s init -f $CFG
+fi
+
+new "wait backend"
+wait_backend
+
+# Reset controller, pulls SYNCED datastores
+. ./reset-controller.sh
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+
+    new "Start new backend -s running -f $CFG -o CONTROLLER_DEVICE_STORE=$STORE"
+    start_backend -s running -f $CFG -o CONTROLLER_DEVICE_STORE=$STORE
+fi
+
+new "wait backend"
+wait_backend
+
+new "Check store created"
+sudo test -f $STORE || err "$STORE" "$(sudo ls $DB)"
+
+# Not connected, SYNCED is only in the store if imported
+check_synced "Imported"
+
+new "connect"
+expectpart "$($clixon_cli -1 -f $CFG connection open 2>&1)" 0 ""
+
+new "check ${IMG}1 in sync"
+expectpart "$($clixon_cli -1 -f $CFG show devices ${IMG}1 check 2>&1)" 0 --not-- "out-of-sync"
+
+new "push validate expected ok"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "OK" --not-- "failed Device"
+
+# Change device configs on devices (not controller)
+. ./change-devices.sh
+
+new "push validate expected fail"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "Transaction [0-9]* failed"
+
+new "Check error refers to datastore-diff, not to datastore files"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "has changed config" "datastore-diff devname ${IMG}[0-9]* config-type1 SYNCED config-type2 TRANSIENT" --not-- "TRANSIENT_db"
+
+new "pull"
+expectpart "$($clixon_cli -1 -f $CFG pull replace 2>&1)" 0 "OK"
+
+new "check ${IMG}1 in sync after pull"
+expectpart "$($clixon_cli -1 -f $CFG show devices ${IMG}1 check 2>&1)" 0 --not-- "out-of-sync"
+
+new "push validate after pull"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "OK" --not-- "failed Device"
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+
+    new "Restart backend -s running -f $CFG -o CONTROLLER_DEVICE_STORE=$STORE"
+    start_backend -s running -f $CFG -o CONTROLLER_DEVICE_STORE=$STORE
+fi
+
+new "wait backend"
+wait_backend
+
+check_synced "Restart"
+
+new "connect after restart"
+expectpart "$($clixon_cli -1 -f $CFG connection open 2>&1)" 0 ""
+
+new "push validate after restart"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "OK" --not-- "failed Device"
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+sudo rm -f $STORE $STORE-lock
+rm -rf $dir
+
+endtest
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+# Pull with progressive batch commits, CONTROLLER_PULL_BATCH_SIZE
+# Change the config directly on the devices, pull with a batch size of one device,
+# and check that all pulled configs are committed and in sync
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+if [ $nr -lt 2 ]; then
+    echo "Test requires nr=$nr to be greater than 1"
+    if [ "$s" = $0 ]; then exit 0; else return 0; fi
+fi
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG -o CONTROLLER_PULL_BATCH_SIZE=1"
+    start_backend -s init -f $CFG -o CONTROLLER_PULL_BATCH_SIZE=1
+fi
+
+new "wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+# Remove x, change y, and add z directly on devices
+. ./change-devices.sh
+
+new "pull"
+expectpart "$($clixon_cli -1 -f $CFG pull 2>&1)" 0 ""
+
+new "Check last transaction"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "<result>SUCCESS</result>"
+
+for i in $(seq 1 $nr); do
+    NAME=$IMG$i
+
+    new "Check $NAME config pulled"
+    expectpart "$($clixon_cli -1 -f $CFG show config devices device $NAME config interfaces)" 0 "<name>z</name>" "ianaift:atm" --not-- "<name>x</name>"
+
+    new "Check $NAME in sync"
+    expectpart "$($clixon_cli -1 -f $CFG show devices $NAME check 2>&1)" 0 --not-- "out-of-sync"
+done
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+endtest
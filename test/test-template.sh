@@ -124,6 +124,135 @@ expectpart "$($clixon_cli -1 -f $CFG -m configure -o CLICON_CLI_OUTPUT_FORMAT=te
 new "rollback"
 expectpart "$($clixon_cli -1 -f $CFG -m configure rollback)" 0 "^$"
 
+new "Apply template NETCONF with device variables, missing variable"
+ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-template-apply xmlns="http://clicon.org/controller">
+      <devname>openconfig1</devname>
+      <template>interfaces</template>
+      <variables>
+         <variable>
+            <name>NAME</name>
+            <value>z</value>
+         </variable>
+      </variables>
+      <device-variables>
+         <devname>openconfig1</devname>
+         <variables>
+            <variable>
+               <name>NAME</name>
+               <value>y</value>
+            </variable>
+         </variables>
+      </device-variables>
+   </device-template-apply>
+</rpc>]]>]]>
+EOF
+)
+
+new "Check missing variable"
+expectpart "$ret" 0 "<error-tag>missing-element</error-tag>" "<bad-element>TYPE</bad-element>"
+
+new "Apply template NETCONF, variable missing for second device only"
+ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-template-apply xmlns="http://clicon.org/controller">
+      <devname>openconfig*</devname>
+      <template>interfaces</template>
+      <variables>
+         <variable>
+            <name>NAME</name>
+            <value>z</value>
+         </variable>
+      </variables>
+      <device-variables>
+         <devname>openconfig1</devname>
+         <variables>
+            <variable>
+               <name>TYPE</name>
+               <value>ianaift:v35</value>
+            </variable>
+         </variables>
+      </device-variables>
+   </device-template-apply>
+</rpc>]]>]]>
+EOF
+)
+
+new "Check missing variable of second device"
+expectpart "$ret" 0 "<error-tag>missing-element</error-tag>" "<bad-element>TYPE</bad-element>"
+
+new "Verify not applied to first device"
+expectpart "$($clixon_cli -1 -f $CFG -m configure -o CLICON_CLI_OUTPUT_FORMAT=text show compare)" 0 --not-- "interface z" "^+"
+
+new "Apply template NETCONF with device variables"
+ret=$(${clixon_netconf} -0 -f $CFG <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+   <capabilities>
+      <capability>urn:ietf:params:netconf:base:1.0</capability>
+   </capabilities>
+</hello>]]>]]>
+<rpc xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"
+     xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0"
+     message-id="42">
+   <device-template-apply xmlns="http://clicon.org/controller">
+      <devname>openconfig1</devname>
+      <template>interfaces</template>
+      <variables>
+         <variable>
+            <name>NAME</name>
+            <value>z</value>
+         </variable>
+         <variable>
+            <name>TYPE</name>
+            <value>ianaift:v35</value>
+         </variable>
+      </variables>
+      <device-variables>
+         <devname>openconfig1</devname>
+         <variables>
+            <variable>
+               <name>NAME</name>
+               <value>y</value>
+            </variable>
+         </variables>
+      </device-variables>
+   </device-template-apply>
+</rpc>]]>]]>
+EOF
+)
+
+new "Check no errors of apply"
+match=$(echo $ret | grep --null -Eo "<rpc-error>") || true
+if [ -n "$match" ]; then
+    echo "netconf rpc-error detected"
+    err1 "$ret"
+    exit 1
+fi
+
+new "Verify compare device variables"
+expectpart "$($clixon_cli -1 -f $CFG -m configure -o CLICON_CLI_OUTPUT_FORMAT=text show compare)" 0 "^+\ *interface y {" "^+\ *description \"Config of interface y,y and ianaift:v35 type\";" --not-- "interface z" "^\-"
+
+new "rollback"
+expectpart "$($clixon_cli -1 -f $CFG -m configure rollback)" 0 "^$"
+
 # Use CLI load and apply template
 new "delete template"
 expectpart "$($clixon_cli -1 -f $CFG -m configure delete devices template interfaces)" 0 "^$"
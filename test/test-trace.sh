@@ -0,0 +1,264 @@
+#!/usr/bin/env bash
+#
+# Trace spans of controller transactions written to CONTROLLER_TRACE_FILE
+# Check that child spans have the root span as parent, that span-ids are random,
+# and that the span of the C action daemon is a child of the transaction root span
+# Uses util/controller_service.c as C-based server
+#
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+if [ $nr -lt 2 ]; then
+    echo "Test requires nr=$nr to be greater than 1"
+    if [ "$s" = $0 ]; then exit 0; else return 0; fi
+fi
+
+dir=/var/tmp/$0
+CFG=$dir/controller.xml
+CFD=$dir/confdir
+test -d $dir || mkdir -p $dir
+test -d $CFD || mkdir -p $CFD
+
+fyang=$dir/myyang.yang
+
+: ${clixon_controller_xpath:=clixon_controller_xpath}
+
+# source IMG/USER etc
+. ./site.sh
+
+# Common NACM scripts
+. ./nacm.sh
+
+cat<<EOF > $CFG
+<clixon-config xmlns="http://clicon.org/config">
+  <CLICON_CONFIGFILE>$CFG</CLICON_CONFIGFILE>
+  <CLICON_CONFIGDIR>$CFD</CLICON_CONFIGDIR>
+  <CLICON_FEATURE>ietf-netconf:startup</CLICON_FEATURE>
+  <CLICON_FEATURE>clixon-restconf:allow-auth-none</CLICON_FEATURE>
+  <CLICON_CONFIG_EXTEND>clixon-controller-config</CLICON_CONFIG_EXTEND>
+  <CLICON_YANG_DIR>${DATADIR}/clixon</CLICON_YANG_DIR>
+  <CLICON_YANG_DIR>${DATADIR}/controller/main</CLICON_YANG_DIR>
+  <CLICON_YANG_DIR>${DATADIR}/controller/common</CLICON_YANG_DIR>
+  <CLICON_YANG_MAIN_DIR>$dir</CLICON_YANG_MAIN_DIR>
+  <CLICON_YANG_DOMAIN_DIR>$dir</CLICON_YANG_DOMAIN_DIR>
+  <CLICON_CLI_MODE>operation</CLICON_CLI_MODE>
+  <CLICON_CLI_DIR>${LIBDIR}/controller/cli</CLICON_CLI_DIR>
+  <CLICON_CLISPEC_DIR>${LIBDIR}/controller/clispec</CLICON_CLISPEC_DIR>
+  <CLICON_BACKEND_DIR>${LIBDIR}/controller/backend</CLICON_BACKEND_DIR>
+  <CLICON_SOCK>${LOCALSTATEDIR}/run/controller.sock</CLICON_SOCK>
+  <CLICON_SOCK_GROUP>${CLICON_GROUP}</CLICON_SOCK_GROUP>
+  <CLICON_SOCK_PRIO>true</CLICON_SOCK_PRIO>
+  <CLICON_BACKEND_PIDFILE>${LOCALSTATEDIR}/run/controller.pid</CLICON_BACKEND_PIDFILE>
+  <CLICON_XMLDB_DIR>$dir</CLICON_XMLDB_DIR>
+  <CLICON_XMLDB_MULTI>true</CLICON_XMLDB_MULTI>
+  <CLICON_STARTUP_MODE>init</CLICON_STARTUP_MODE>
+  <CLICON_STREAM_DISCOVERY_RFC5277>true</CLICON_STREAM_DISCOVERY_RFC5277>
+  <CLICON_RESTCONF_USER>${CLICON_USER}</CLICON_RESTCONF_USER>
+  <CLICON_RESTCONF_PRIVILEGES>drop_perm</CLICON_RESTCONF_PRIVILEGES>
+  <CLICON_RESTCONF_INSTALLDIR>${SBINDIR}</CLICON_RESTCONF_INSTALLDIR>
+  <CLICON_BACKEND_USER>${CLICON_USER}</CLICON_BACKEND_USER>
+  <CLICON_VALIDATE_STATE_XML>true</CLICON_VALIDATE_STATE_XML>
+  <CLICON_CLI_HELPSTRING_TRUNCATE>true</CLICON_CLI_HELPSTRING_TRUNCATE>
+  <CLICON_CLI_HELPSTRING_LINES>1</CLICON_CLI_HELPSTRING_LINES>
+  <CLICON_CLI_OUTPUT_FORMAT>text</CLICON_CLI_OUTPUT_FORMAT>
+  <CLICON_YANG_SCHEMA_MOUNT>true</CLICON_YANG_SCHEMA_MOUNT>
+  <CLICON_YANG_SCHEMA_MOUNT_SHARE>true</CLICON_YANG_SCHEMA_MOUNT_SHARE>
+  <CLICON_NACM_CREDENTIALS>exact</CLICON_NACM_CREDENTIALS>
+  <CLICON_NACM_MODE>internal</CLICON_NACM_MODE>
+  <CLICON_NACM_DISABLED_ON_EMPTY>true</CLICON_NACM_DISABLED_ON_EMPTY>
+</clixon-config>
+EOF
+
+cat<<EOF > $CFD/autocli.xml
+<clixon-config xmlns="http://clicon.org/config">
+  <autocli>
+     <module-default>false</module-default>
+     <list-keyword-default>kw-nokey</list-keyword-default>
+     <treeref-state-default>true</treeref-state-default>
+     <grouping-treeref>true</grouping-treeref>
+     <rule>
+       <name>include controller</name>
+       <module-name>clixon-controller</module-name>
+       <operation>enable</operation>
+     </rule>
+     <rule>
+       <name>include openconfig</name>
+       <module-name>openconfig*</module-name>
+       <operation>enable</operation>
+     </rule>
+     <!-- there are many more arista/openconfig top-level modules -->
+  </autocli>
+</clixon-config>
+EOF
+
+cat <<EOF > $fyang
+module myyang {
+    yang-version 1.1;
+    namespace "urn:example:test";
+    prefix test;
+    import clixon-controller {
+      prefix ctrl;
+    }
+    revision 2023-03-22{
+	description "Initial prototype";
+    }
+    augment "/ctrl:services" {
+	list testA {
+	    description "Test A service";
+	    key a_name;
+	    leaf a_name {
+		description "Test A instance";
+		type string;
+	    }
+
+	    leaf-list params{
+	       type string;
+               min-elements 1; /* For validate fail*/
+	   } 
+           uses ctrl:created-by-service;
+	}
+    }
+    augment "/ctrl:services" {
+	list testB {
+	   description "Test B service";
+	   key b_name;
+	   leaf b_name {
+		description "Test B instance";
+	      type string;
+	   }
+	   leaf-list params{
+	      type string;
+	   }
+           uses ctrl:created-by-service;
+	}
+    }
+}
+EOF
+
+RULES=$(cat <<EOF
+   <nacm xmlns="urn:ietf:params:xml:ns:yang:ietf-netconf-acm">
+     <enable-nacm>true</enable-nacm>
+     <read-default>permit</read-default>
+     <write-default>permit</write-default>
+     <exec-default>permit</exec-default>
+
+     $NGROUPS
+
+     $NADMIN
+
+   </nacm>
+EOF
+)
+
+# Start from startup which by default should start it
+# First disable services process
+cat <<EOF > $dir/startup_db
+<config>
+  <processes xmlns="http://clicon.org/controller">
+    <services>
+      <enabled>true</enabled>
+    </services>
+  </processes>
+  $RULES
+</config>
+EOF
+
+TRACE=$dir/trace.json
+rm -f $TRACE
+
+cat<<EOF > $CFD/trace.xml
+<clixon-config xmlns="http://clicon.org/config">
+  <CONTROLLER_TRACE_FILE xmlns="http://clicon.org/controller-config">$TRACE</CONTROLLER_TRACE_FILE>
+</clixon-config>
+EOF
+
+cat<<EOF > $CFD/action-command.xml
+<clixon-config xmlns="http://clicon.org/config">
+  <CONTROLLER_ACTION_COMMAND xmlns="http://clicon.org/controller-config">${BINDIR}/clixon_controller_service -f $CFG</CONTROLLER_ACTION_COMMAND>
+</clixon-config>
+EOF
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+if $BE; then
+    new "Start new backend -s startup -f $CFG -D $DBG"
+    sudo clixon_backend -s startup -f $CFG -D $DBG
+fi
+
+new "Wait backend 1"
+wait_backend
+
+# Reset controller by initiating with clixon/openconfig devices and a pull
+. ./reset-controller.sh
+rm -f $TRACE
+
+new "Set service"
+expectpart "$(${clixon_cli} -1f $CFG -m configure set services testA foo params A1)" 0 ""
+
+new "commit push"
+expectpart "$(${clixon_cli} -1f $CFG -m configure commit push 2>&1)" 0 "OK" --not-- Error
+
+new "Check trace file"
+if [ ! -f $TRACE ]; then
+    err "$TRACE" "no trace file"
+fi
+
+# Root span is the first span of the controller line with an action span
+new "Get controller trace of commit"
+line=$(grep '"stringValue":"clixon-controller"' $TRACE | grep '"name":"ACTIONS"' | tail -1)
+if [ -z "$line" ]; then
+    err "controller trace with ACTIONS span" "$(cat $TRACE)"
+fi
+traceid=$(echo "$line" | grep -o '"traceId":"[0-9a-f]*"' | head -1 | cut -d'"' -f4)
+root=$(echo "$line" | grep -o '"spanId":"[0-9a-f]*"' | head -1 | cut -d'"' -f4)
+if [ ${#traceid} -ne 32 -o ${#root} -ne 16 ]; then
+    err "32 hex trace-id and 16 hex span-id" "$traceid $root"
+fi
+
+new "Check root span has no parent"
+expectpart "$(echo "$line" | grep -o '{"traceId":"[0-9a-f]*","spanId":"'$root'"[^}]*' | head -1)" 0 "\"spanId\":\"$root\"" --not-- parentSpanId
+
+new "Check all spans have same trace-id"
+nr1=$(echo "$line" | grep -o '"traceId":"[0-9a-f]*"' | sort -u | wc -l)
+if [ $nr1 -ne 1 ]; then
+    err "1" "$nr1"
+fi
+
+new "Check all child spans have root span as parent"
+nr1=$(echo "$line" | grep -o '"spanId":"[0-9a-f]*"' | wc -l)
+nr2=$(echo "$line" | grep -o '"parentSpanId":"'$root'"' | wc -l)
+if [ $nr1 -lt 3 -o $nr2 -ne $((nr1 - 1)) ]; then
+    err "$((nr1 - 1)) children of $root" "$nr2"
+fi
+
+new "Check span-ids are distinct"
+nr2=$(echo "$line" | grep -o '"spanId":"[0-9a-f]*"' | sort -u | wc -l)
+if [ $nr1 -ne $nr2 ]; then
+    err "$nr1 distinct span-ids" "$nr2"
+fi
+
+new "Check span-ids are not sequential"
+for i in 1 2 3; do
+    next=$(printf "%016x" $((16#$root + i)))
+    if echo "$line" | grep -q "\"spanId\":\"$next\""; then
+        err "random span-id" "$next"
+    fi
+done
+
+new "Check action daemon span is child of root span"
+expectpart "$(grep '"stringValue":"clixon_controller_service"' $TRACE)" 0 "\"traceId\":\"$traceid\"" "\"parentSpanId\":\"$root\"" "\"name\":\"services-commit\""
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+rm -f $CFD/trace.xml
+
+endtest
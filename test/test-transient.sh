@@ -0,0 +1,114 @@
+#!/usr/bin/env bash
+# In-memory cache of TRANSIENT device configs, CONTROLLER_TRANSIENT_CACHE_SIZE
+# 1. Device check and push validate keep the transient config in memory, no datastore is written
+# 2. A transient config referred to in an error message is written to its datastore
+# 3. The stored copy is deleted when the device config is cached again
+# 4. With a cache of one device, configs are evicted without being written
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+if [ $nr -lt 2 ]; then
+    echo "Test requires nr=$nr to be greater than 1"
+    if [ "$s" = $0 ]; then exit 0; else return 0; fi
+fi
+
+DB=${LOCALSTATEDIR}/controller
+
+# Check if TRANSIENT datastore of a device is stored
+# Args:
+# 1: name     Device name
+# 2: nr       Expected number of datastore files, 0 if not stored
+function check_stored()
+{
+    name=$1
+    expect=$2
+
+    new "Check $name TRANSIENT stored: $expect"
+    ret=$(sudo ls $DB | grep -c "device-$name-TRANSIENT") || true
+    if [ "$expect" = 0 -a "$ret" != 0 ]; then
+        err "no device-$name-TRANSIENT" "$(sudo ls $DB)"
+    elif [ "$expect" != 0 -a "$ret" = 0 ]; then
+        err "device-$name-TRANSIENT" "$(sudo ls $DB)"
+    fi
+}
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+NAME=${IMG}1
+
+new "check $NAME in sync"
+expectpart "$($clixon_cli -1 -f $CFG show devices $NAME check 2>&1)" 0 --not-- "out-of-sync"
+
+check_stored $NAME 0
+
+new "push validate expected ok"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "OK" --not-- "failed Device"
+
+check_stored $NAME 0
+
+# Change device configs on devices (not controller)
+. ./change-devices.sh
+
+new "push validate expected fail"
+expectpart "$($clixon_cli -1 -f $CFG push validate 2>&1)" 0 "Transaction [0-9]* failed"
+
+new "Check error refers to TRANSIENT datastore"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 "has changed config" "device-[a-z0-9]*-TRANSIENT_db"
+
+check_stored $NAME 1
+
+new "pull"
+expectpart "$($clixon_cli -1 -f $CFG pull replace 2>&1)" 0 "OK"
+
+new "check $NAME in sync after pull"
+expectpart "$($clixon_cli -1 -f $CFG show devices $NAME check 2>&1)" 0 --not-- "out-of-sync"
+
+check_stored $NAME 0
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+
+    new "Start new backend -s running -f $CFG -o CONTROLLER_TRANSIENT_CACHE_SIZE=1"
+    start_backend -s running -f $CFG -o CONTROLLER_TRANSIENT_CACHE_SIZE=1
+fi
+
+new "wait backend"
+wait_backend
+
+new "connect"
+expectpart "$($clixon_cli -1 -f $CFG connection open 2>&1)" 0 ""
+
+for i in 1 2; do
+    for j in $(seq 1 $nr); do
+        new "check $IMG$j in sync with cache of one device, round $i"
+        expectpart "$($clixon_cli -1 -f $CFG show devices $IMG$j check 2>&1)" 0 --not-- "out-of-sync"
+    done
+done
+
+for j in $(seq 1 $nr); do
+    check_stored $IMG$j 0
+done
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+endtest
@@ -0,0 +1,77 @@
+#!/usr/bin/env bash
+# io_uring sends and receives, requires controller configured --with-liburing
+# 1. Send and receive with clixon_controller_uringbench, also short writes of large messages
+# 2. Close and open devices repeatedly with pushes in between, so that device sockets
+#    are closed with writes and receives in flight and socket numbers are reused
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+set -u
+
+ret=$(clixon_controller_uringbench -n 1 -r 1 2>&1)
+if [ $? -ne 0 ]; then
+    echo "...skipped: io_uring not available: $ret"
+    if [ "$s" = $0 ]; then exit 0; else return 0; fi
+fi
+
+new "uringbench small messages"
+expectpart "$(clixon_controller_uringbench -n 50 -s 100 -r 500)" 0 "io_uring sessions:50" "cpu .* us/round"
+
+new "uringbench large messages, short writes"
+expectpart "$(clixon_controller_uringbench -n 20 -s 1000000 -r 10)" 0 "io_uring sessions:20" "cpu .* us/round"
+
+# Reset devices with initial config
+. ./reset-devices.sh
+
+if $BE; then
+    new "Kill old backend"
+    sudo clixon_backend -s init -f $CFG -z
+
+    new "Start new backend -s init -f $CFG"
+    start_backend -s init -f $CFG
+fi
+
+new "wait backend"
+wait_backend
+
+# Reset controller
+. ./reset-controller.sh
+
+for i in 1 2 3 4 5; do
+    new "edit $i"
+    expectpart "$($clixon_cli -1 -f $CFG -m configure set devices device ${IMG}* config interfaces interface x config description uring$i)" 0 "^$"
+
+    new "push commit $i"
+    expectpart "$($clixon_cli -1 -f $CFG -m configure commit)" 0 "^$"
+
+    new "close connections $i"
+    expectpart "$($clixon_cli -1 -f $CFG connection close)" 0 "^$"
+
+    new "open connections $i"
+    expectpart "$($clixon_cli -1 -f $CFG connection open)" 0 "^$"
+
+    sleep $sleep
+
+    new "Verify $nr devices open $i"
+    res=$(${clixon_cli} -1f $CFG show connections | grep OPEN | wc -l)
+    if [ "$res" != "$nr" ]; then
+        err1 "$nr open devices" "$res"
+    fi
+done
+
+new "Check device config"
+expectpart "$($clixon_cli -1f $CFG show config devices device ${IMG}* config interfaces interface x config description)" 0 "${IMG}1:" "<description>uring5</description>"
+
+new "Check device in sync"
+expectpart "$($clixon_cli -1f $CFG show devices ${IMG}1 check 2>&1)" 0 --not-- "out-of-sync"
+
+new "Check no invalid frames"
+expectpart "$($clixon_cli -1 -f $CFG show transaction)" 0 --not-- "Invalid frame"
+
+if $BE; then
+    new "Kill old backend"
+    stop_backend -f $CFG
+fi
+
+endtest
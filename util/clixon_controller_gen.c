@@ -0,0 +1,983 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Synthetic config generator for benchmarks
+  * Walks a YANG spec, eg the YANG of a mounted device domain, and emits a valid
+  * config of a target size: list cardinalities, presence of optional leaves and the
+  * random seed are given as options. Values are generated from the leaf types,
+  * honouring ranges, lengths, enumerations and some well-known ietf-inet-types.
+  * Nodes that can not be generated valid are skipped: when/must constraints,
+  * leafrefs, identityrefs, and strings with unknown patterns.
+  * In mutation mode (-m), a config is read and N random changes are made: leaf values
+  * changed, list entries deleted or added.
+  * Example:
+  *   clixon_controller_gen -Y /usr/local/share/clixon -y mydomain/ -S 10000000 -n 20 > cfg.xml
+  *   clixon_controller_gen -Y /usr/local/share/clixon -y mydomain/ -f cfg.xml -m 100 > cfg2.xml
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+/* cligen */
+#include <cligen/cligen.h>
+
+/* clixon */
+#include "clixon/clixon.h"
+
+/* Command line options to be passed to getopt(3) */
+#define GEN_OPTS "hD:l:y:Y:s:S:n:p:f:m:PV"
+
+/* Top symbol of generated config */
+#define GEN_TOP "config"
+
+/*! Generator context
+ */
+typedef struct {
+    clixon_handle gc_h;
+    uint64_t      gc_rng;      /* xorshift64* state */
+    size_t        gc_size;     /* Target size in bytes, 0 is no limit */
+    size_t        gc_len;      /* Estimated size so far */
+    uint32_t      gc_card;     /* Max list/leaf-list entries */
+    uint32_t      gc_optional; /* Percent of optional leaves to generate */
+    uint64_t      gc_seq;      /* Sequence for unique keys */
+} gen_ctx;
+
+static int
+usage(char *argv0)
+{
+    fprintf(stderr, "usage:%s [options]\n"
+            "where options are\n"
+            "\t-h \t\tHelp\n"
+            "\t-D <level> \tDebug\n"
+            "\t-l <s|e|o|f<file>> \tLog on (s)yslog, std(e)rr, std(o)ut or (f)ile (stderr is default)\n"
+            "\t-y <filename> \tYang filename or dir (load all files)\n"
+            "\t-Y <dir> \tYang dirs (can be several)\n"
+            "\t-s <seed> \tRandom seed (default 1)\n"
+            "\t-S <bytes> \tTarget size of config (default 1000000, 0 is no limit)\n"
+            "\t-n <nr> \tMax entries of each list and leaf-list (default 10)\n"
+            "\t-p <percent> \tPercent of optional leaves to generate (default 50)\n"
+            "\t-f <file> \tXML config file to mutate, use with -m\n"
+            "\t-m <nr> \tMutation mode: make <nr> random changes of config in -f (or stdin)\n"
+            "\t-P \t\tPretty-print output\n"
+            "\t-V \t\tValidate output, exit with error if not valid\n",
+            argv0
+            );
+    exit(0);
+}
+
+/*! Random number, xorshift64*
+ *
+ * Same sequence on all platforms for a given seed
+ */
+static uint64_t
+gen_rand(gen_ctx *gc)
+{
+    uint64_t x = gc->gc_rng;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    gc->gc_rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/*! Random number in [0, n)
+ */
+static uint64_t
+gen_rand_n(gen_ctx *gc,
+           uint64_t n)
+{
+    return n ? gen_rand(gc) % n : 0;
+}
+
+/*! Strip prefix of a type name
+ */
+static char *
+gen_strip_prefix(char *name)
+{
+    char *p;
+
+    if (name && (p = strchr(name, ':')) != NULL)
+        return p + 1;
+    return name;
+}
+
+/*! Get first range or length interval of a type, if any
+ *
+ * @param[in]  cvv   Range/length cvec from yang_type_get
+ * @param[out] min   Min value as string, or NULL
+ * @param[out] max   Max value as string, or NULL
+ */
+static void
+gen_range(cvec *cvv,
+          char *min,
+          char *max,
+          size_t len)
+{
+    cg_var *cv = NULL;
+
+    min[0] = max[0] = '\0';
+    while (cvv && (cv = cvec_each(cvv, cv)) != NULL){
+        if (cv_name_get(cv) == NULL)
+            continue;
+        if (strcmp(cv_name_get(cv), "range_min") == 0 && min[0] == '\0')
+            cv2str(cv, min, len);
+        else if (strcmp(cv_name_get(cv), "range_max") == 0 && max[0] == '\0'){
+            cv2str(cv, max, len);
+            break;
+        }
+    }
+}
+
+/*! Generate a value of a well-known string typedef
+ *
+ * @retval  1  Generated
+ * @retval  0  Not a known typedef
+ */
+static int
+gen_value_typedef(gen_ctx *gc,
+                  char    *tname,
+                  uint64_t seq,
+                  cbuf    *cb)
+{
+    uint64_t r = seq ? seq : gen_rand(gc);
+
+    tname = gen_strip_prefix(tname);
+    if (tname == NULL)
+        return 0;
+    if (strcmp(tname, "ipv4-address") == 0 ||
+        strcmp(tname, "ip-address") == 0 ||
+        strcmp(tname, "ipv4-address-no-zone") == 0 ||
+        strcmp(tname, "ip-address-no-zone") == 0)
+        cprintf(cb, "10.%u.%u.%u", (unsigned)(r>>16)&0xff, (unsigned)(r>>8)&0xff, (unsigned)(r&0xff));
+    else if (strcmp(tname, "ipv6-address") == 0 ||
+             strcmp(tname, "ipv6-address-no-zone") == 0)
+        cprintf(cb, "2001:db8::%x:%x", (unsigned)(r>>16)&0xffff, (unsigned)(r&0xffff));
+    else if (strcmp(tname, "ipv4-prefix") == 0 ||
+             strcmp(tname, "ip-prefix") == 0)
+        cprintf(cb, "10.%u.%u.0/24", (unsigned)(r>>8)&0xff, (unsigned)(r&0xff));
+    else if (strcmp(tname, "ipv6-prefix") == 0)
+        cprintf(cb, "2001:db8:%x::/64", (unsigned)(r&0xffff));
+    else if (strcmp(tname, "mac-address") == 0 ||
+             strcmp(tname, "phys-address") == 0)
+        cprintf(cb, "02:00:%02x:%02x:%02x:%02x",
+                (unsigned)(r>>24)&0xff, (unsigned)(r>>16)&0xff, (unsigned)(r>>8)&0xff, (unsigned)(r&0xff));
+    else if (strcmp(tname, "domain-name") == 0 ||
+             strcmp(tname, "host") == 0)
+        cprintf(cb, "host%" PRIu64 ".example.com", r % 1000000);
+    else if (strcmp(tname, "uri") == 0)
+        cprintf(cb, "http://example.com/%" PRIu64, r % 1000000);
+    else if (strcmp(tname, "date-and-time") == 0)
+        cprintf(cb, "2024-01-%02uT%02u:%02u:00Z",
+                (unsigned)(r%28)+1, (unsigned)(r>>8)%24, (unsigned)(r>>16)%60);
+    else
+        return 0;
+    return 1;
+}
+
+/*! Generate an integer value within type bounds and range
+ *
+ * @param[in]  seq  If non-zero, unique value derived from seq (for keys and leaf-lists)
+ */
+static int
+gen_value_int(gen_ctx *gc,
+              char    *restype,
+              char    *min,
+              char    *max,
+              uint64_t seq,
+              cbuf    *cb)
+{
+    int       sign;
+    int       bits;
+    long long lo;
+    long long hi;
+    unsigned long long ulo;
+    unsigned long long uhi;
+    uint64_t  r;
+
+    sign = restype[0] == 'i';
+    bits = atoi(restype + (sign ? 3 : 4));
+    if (sign){
+        lo = bits < 64 ? -(1LL << (bits-1)) : LLONG_MIN;
+        hi = bits < 64 ? (1LL << (bits-1)) - 1 : LLONG_MAX;
+        if (min[0])
+            lo = strtoll(min, NULL, 10);
+        if (max[0])
+            hi = strtoll(max, NULL, 10);
+        if (hi < lo)
+            return 0;
+        r = seq ? seq - 1 : gen_rand(gc);
+        if ((unsigned long long)(hi - lo) < ULLONG_MAX)
+            r %= (unsigned long long)(hi - lo) + 1;
+        cprintf(cb, "%lld", lo + (long long)r);
+    }
+    else {
+        ulo = 0;
+        uhi = bits < 64 ? (1ULL << bits) - 1 : ULLONG_MAX;
+        if (min[0])
+            ulo = strtoull(min, NULL, 10);
+        if (max[0])
+            uhi = strtoull(max, NULL, 10);
+        if (uhi < ulo)
+            return 0;
+        r = seq ? seq - 1 : gen_rand(gc);
+        if (uhi - ulo < ULLONG_MAX)
+            r %= (uhi - ulo) + 1;
+        cprintf(cb, "%llu", ulo + (unsigned long long)r);
+    }
+    return 1;
+}
+
+/*! Generate a value of a leaf or leaf-list
+ *
+ * @param[in]  gc    Generator context
+ * @param[in]  ys    Leaf or leaf-list yang
+ * @param[in]  seq   If non-zero, make value unique given seq (keys and leaf-lists)
+ * @param[out] cb    Value
+ * @param[out] empty Set if type is empty (no value)
+ * @retval     1     Generated
+ * @retval     0     Type not supported
+ * @retval    -1     Error
+ */
+static int
+gen_value(gen_ctx   *gc,
+          yang_stmt *ys,
+          uint64_t   seq,
+          cbuf      *cb,
+          int       *empty)
+{
+    int        retval = -1;
+    char      *origtype = NULL;
+    yang_stmt *yrestype = NULL;
+    int        options = 0;
+    cvec      *cvv = NULL;
+    cvec      *patterns = NULL;
+    cvec      *regexps = NULL;
+    uint8_t    fraction = 0;
+    char      *restype;
+    yang_stmt *y;
+    yang_stmt *ychosen;
+    int        n;
+    int        i;
+    char       min[64];
+    char       max[64];
+    size_t     len;
+    size_t     minlen;
+
+    *empty = 0;
+    if ((patterns = cvec_new(0)) == NULL ||
+        (regexps = cvec_new(0)) == NULL){
+        clixon_err(OE_UNIX, errno, "cvec_new");
+        goto done;
+    }
+    if (yang_type_get(ys, &origtype, &yrestype, &options, &cvv, patterns, regexps, &fraction) < 0)
+        goto done;
+    if (yrestype == NULL)
+        goto unsupported;
+    restype = yang_argument_get(yrestype);
+    gen_range(cvv, min, max, sizeof(min));
+    if (gen_value_typedef(gc, origtype, seq, cb) == 1)
+        goto ok;
+    if (strcmp(restype, "string") == 0){
+        if (cvec_len(patterns) > 0)
+            goto unsupported;
+        minlen = min[0] ? strtoul(min, NULL, 10) : 0;
+        len = max[0] ? strtoul(max, NULL, 10) : 64;
+        if (seq)
+            cprintf(cb, "%s-%" PRIu64, yang_argument_get(ys), seq);
+        else
+            cprintf(cb, "%s-%" PRIx64, yang_argument_get(ys), gen_rand(gc) & 0xffffff);
+        if (len < cbuf_len(cb)){
+            if (seq) /* Keep unique suffix */
+                cbuf_reset(cb), cprintf(cb, "%" PRIu64, seq);
+            if (len < cbuf_len(cb))
+                cbuf_trunc(cb, len);
+        }
+        while (cbuf_len(cb) < minlen)
+            cprintf(cb, "x");
+    }
+    else if (strncmp(restype, "int", 3) == 0 ||
+             strncmp(restype, "uint", 4) == 0){
+        if (gen_value_int(gc, restype, min, max, seq, cb) == 0)
+            goto unsupported;
+    }
+    else if (strcmp(restype, "boolean") == 0){
+        if (seq > 2)
+            goto unsupported;
+        cprintf(cb, "%s", (seq ? seq == 1 : gen_rand_n(gc, 2)) ? "true" : "false");
+    }
+    else if (strcmp(restype, "enumeration") == 0 ||
+             strcmp(restype, "bits") == 0){
+        n = 0;
+        y = NULL;
+        while ((y = yn_each(yrestype, y)) != NULL)
+            if (yang_keyword_get(y) == Y_ENUM || yang_keyword_get(y) == Y_BIT)
+                n++;
+        if (n == 0 || seq > n)
+            goto unsupported;
+        i = seq ? seq - 1 : gen_rand_n(gc, n);
+        ychosen = NULL;
+        y = NULL;
+        while ((y = yn_each(yrestype, y)) != NULL)
+            if ((yang_keyword_get(y) == Y_ENUM || yang_keyword_get(y) == Y_BIT) && i-- == 0){
+                ychosen = y;
+                break;
+            }
+        cprintf(cb, "%s", yang_argument_get(ychosen));
+    }
+    else if (strcmp(restype, "decimal64") == 0){
+        if (min[0] && !seq)
+            cprintf(cb, "%s", min); /* Range is rare, use lower bound */
+        else if (min[0] || max[0])
+            goto unsupported;
+        else
+            cprintf(cb, "%" PRIu64 ".%0*u",
+                    seq ? seq : gen_rand_n(gc, 10000), fraction ? fraction : 1, 0);
+    }
+    else if (strcmp(restype, "empty") == 0){
+        if (seq > 1)
+            goto unsupported;
+        *empty = 1;
+    }
+    else if (strcmp(restype, "binary") == 0){
+        if (seq)
+            goto unsupported;
+        cprintf(cb, "AAECAw==");
+    }
+    else if (strcmp(restype, "union") == 0){
+        /* Use first member type that is a well-known typedef */
+        y = NULL;
+        while ((y = yn_each(yrestype, y)) != NULL){
+            if (yang_keyword_get(y) == Y_TYPE &&
+                gen_value_typedef(gc, yang_argument_get(y), seq, cb) == 1)
+                goto ok;
+        }
+        goto unsupported;
+    }
+    else /* leafref, identityref, instance-identifier */
+        goto unsupported;
+ ok:
+    retval = 1;
+ done:
+    if (patterns)
+        cvec_free(patterns);
+    if (regexps)
+        cvec_free(regexps);
+    return retval;
+ unsupported:
+    retval = 0;
+    goto done;
+}
+
+/*! Check if a yang node is skipped: config false, or constrained by when or must
+ */
+static int
+gen_skip(yang_stmt *ys)
+{
+    return yang_config(ys) == 0 ||
+        yang_find(ys, Y_WHEN, NULL) != NULL ||
+        yang_find(ys, Y_MUST, NULL) != NULL;
+}
+
+/*! Check if a leaf is mandatory
+ */
+static int
+gen_mandatory(yang_stmt *ys)
+{
+    yang_stmt *ym;
+
+    return (ym = yang_find(ys, Y_MANDATORY, NULL)) != NULL &&
+        strcmp(yang_argument_get(ym), "true") == 0;
+}
+
+/*! Create a leaf with value
+ *
+ * @retval  1   Created
+ * @retval  0   Value not supported
+ * @retval -1   Error
+ */
+static int
+gen_leaf(gen_ctx   *gc,
+         yang_stmt *ys,
+         cxobj     *xp,
+         uint64_t   seq)
+{
+    int    retval = -1;
+    cbuf  *cb = NULL;
+    cxobj *x;
+    cxobj *xb;
+    int    empty;
+    int    ret;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    if ((ret = gen_value(gc, ys, seq, cb, &empty)) < 0)
+        goto done;
+    if (ret == 0)
+        goto unsupported;
+    if ((x = xml_new(yang_argument_get(ys), xp, CX_ELMNT)) == NULL)
+        goto done;
+    xml_spec_set(x, ys);
+    if (!empty){
+        if ((xb = xml_new("body", x, CX_BODY)) == NULL)
+            goto done;
+        if (xml_value_set(xb, cbuf_get(cb)) < 0)
+            goto done;
+    }
+    gc->gc_len += 2*strlen(yang_argument_get(ys)) + 5 + cbuf_len(cb);
+    retval = 1;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+ unsupported:
+    retval = 0;
+    goto done;
+}
+
+static int gen_children(gen_ctx *gc, yang_stmt *yp, cxobj *xp, cvec *keys);
+
+/*! Check if target size is reached
+ */
+static int
+gen_full(gen_ctx *gc)
+{
+    return gc->gc_size && gc->gc_len >= gc->gc_size;
+}
+
+/*! Generate entries of a list
+ */
+static int
+gen_list(gen_ctx   *gc,
+         yang_stmt *ys,
+         cxobj     *xp)
+{
+    int        retval = -1;
+    cvec      *keys;
+    cg_var    *cvk;
+    yang_stmt *yk;
+    yang_stmt *y;
+    cxobj     *x;
+    uint64_t   n;
+    uint64_t   i;
+    uint64_t   minel = 0;
+    uint64_t   maxel = 0;
+    int        ret;
+
+    if ((y = yang_find(ys, Y_MIN_ELEMENTS, NULL)) != NULL)
+        minel = strtoull(yang_argument_get(y), NULL, 10);
+    if ((y = yang_find(ys, Y_MAX_ELEMENTS, NULL)) != NULL &&
+        strcmp(yang_argument_get(y), "unbounded") != 0)
+        maxel = strtoull(yang_argument_get(y), NULL, 10);
+    n = 1 + gen_rand_n(gc, gc->gc_card);
+    if (n < minel)
+        n = minel;
+    if (maxel && n > maxel)
+        n = maxel;
+    keys = yang_cvec_get(ys);
+    for (i=0; i<n; i++){
+        if (gen_full(gc) && i >= minel)
+            break;
+        if ((x = xml_new(yang_argument_get(ys), xp, CX_ELMNT)) == NULL)
+            goto done;
+        xml_spec_set(x, ys);
+        gc->gc_seq++;
+        cvk = NULL;
+        while (keys && (cvk = cvec_each(keys, cvk)) != NULL){
+            if ((yk = yang_find(ys, Y_LEAF, cv_string_get(cvk))) == NULL)
+                break;
+            if ((ret = gen_leaf(gc, yk, x, gc->gc_seq)) < 0)
+                goto done;
+            if (ret == 0)
+                break;
+        }
+        if (cvk != NULL){ /* Key type not supported, skip list */
+            xml_purge(x);
+            break;
+        }
+        if (gen_children(gc, ys, x, keys) < 0)
+            goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Generate a data node
+ */
+static int
+gen_node(gen_ctx   *gc,
+         yang_stmt *ys,
+         cxobj     *xp,
+         cvec      *keys)
+{
+    int        retval = -1;
+    yang_stmt *y;
+    cxobj     *x;
+    char      *ns;
+    uint64_t   n;
+    uint64_t   i;
+    int        nr;
+
+    if (gen_skip(ys))
+        goto ok;
+    switch (yang_keyword_get(ys)){
+    case Y_CONTAINER:
+        if ((x = xml_new(yang_argument_get(ys), xp, CX_ELMNT)) == NULL)
+            goto done;
+        xml_spec_set(x, ys);
+        if (xml_parent(xp) == NULL &&
+            (ns = yang_find_mynamespace(ys)) != NULL &&
+            xmlns_set(x, NULL, ns) < 0)
+            goto done;
+        if (gen_children(gc, ys, x, NULL) < 0)
+            goto done;
+        /* Remove empty non-presence containers */
+        if (xml_child_nr_type(x, CX_ELMNT) == 0 &&
+            yang_find(ys, Y_PRESENCE, NULL) == NULL)
+            xml_purge(x);
+        else
+            gc->gc_len += 2*strlen(yang_argument_get(ys)) + 5;
+        break;
+    case Y_LIST:
+        nr = xml_child_nr_type(xp, CX_ELMNT);
+        if (gen_list(gc, ys, xp) < 0)
+            goto done;
+        if (xml_parent(xp) == NULL &&
+            (ns = yang_find_mynamespace(ys)) != NULL){
+            x = NULL;
+            while ((x = xml_child_each(xp, x, CX_ELMNT)) != NULL)
+                if (nr-- <= 0 && xmlns_set(x, NULL, ns) < 0)
+                    goto done;
+        }
+        break;
+    case Y_LEAF:
+        if (keys && cvec_find(keys, yang_argument_get(ys)) != NULL)
+            break; /* Keys are generated first by gen_list */
+        if (!gen_mandatory(ys) &&
+            (yang_find(ys, Y_DEFAULT, NULL) != NULL ||
+             gen_rand_n(gc, 100) >= gc->gc_optional))
+            break;
+        if (gen_leaf(gc, ys, xp, 0) < 0)
+            goto done;
+        break;
+    case Y_LEAF_LIST:
+        if (gen_rand_n(gc, 100) >= gc->gc_optional)
+            break;
+        n = 1 + gen_rand_n(gc, gc->gc_card);
+        for (i=0; i<n; i++)
+            if (gen_leaf(gc, ys, xp, ++gc->gc_seq) < 1)
+                break;
+        break;
+    case Y_CHOICE:
+        /* Pick one case or shorthand data node */
+        n = 0;
+        y = NULL;
+        while ((y = yn_each(ys, y)) != NULL)
+            if (yang_datanode(y) || yang_keyword_get(y) == Y_CASE)
+                n++;
+        if (n == 0)
+            break;
+        i = gen_rand_n(gc, n);
+        y = NULL;
+        while ((y = yn_each(ys, y)) != NULL)
+            if ((yang_datanode(y) || yang_keyword_get(y) == Y_CASE) && i-- == 0)
+                break;
+        if (yang_keyword_get(y) == Y_CASE){
+            if (gen_children(gc, y, xp, NULL) < 0)
+                goto done;
+        }
+        else if (gen_node(gc, y, xp, NULL) < 0)
+            goto done;
+        break;
+    default:
+        break;
+    }
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Generate data node children of a yang node
+ */
+static int
+gen_children(gen_ctx   *gc,
+             yang_stmt *yp,
+             cxobj     *xp,
+             cvec      *keys)
+{
+    yang_stmt *y = NULL;
+
+    while ((y = yn_each(yp, y)) != NULL){
+        if (gen_full(gc))
+            break;
+        if (gen_node(gc, y, xp, keys) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*! Collect config leaves (not keys) and list entries of a tree
+ */
+static int
+gen_collect(cxobj   *xn,
+            cxobj ***vec,
+            size_t  *len,
+            size_t  *alloc)
+{
+    cxobj     *x = NULL;
+    yang_stmt *y;
+    cxobj    **v;
+
+    while ((x = xml_child_each(xn, x, CX_ELMNT)) != NULL){
+        if ((y = xml_spec(x)) == NULL || yang_config(y) == 0)
+            continue;
+        if ((yang_keyword_get(y) == Y_LEAF && !yang_key_match(yang_parent_get(y), yang_argument_get(y), NULL)) ||
+            yang_keyword_get(y) == Y_LIST){
+            if (*len >= *alloc){
+                *alloc = *alloc ? 2 * *alloc : 1024;
+                if ((v = realloc(*vec, *alloc * sizeof(cxobj*))) == NULL){
+                    clixon_err(OE_UNIX, errno, "realloc");
+                    return -1;
+                }
+                *vec = v;
+            }
+            (*vec)[(*len)++] = x;
+        }
+        if (gen_collect(x, vec, len, alloc) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*! Make random changes of a config
+ *
+ * 60% change a leaf value, 20% delete a list entry, 20% add a list entry
+ * @param[in]  gc    Generator context
+ * @param[in]  xt    Config tree, bound to YANG
+ * @param[in]  nr    Number of changes
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+gen_mutate(gen_ctx *gc,
+           cxobj   *xt,
+           uint32_t nr)
+{
+    int        retval = -1;
+    cxobj    **vec = NULL;
+    size_t     len;
+    size_t     alloc = 0;
+    cxobj     *x;
+    cxobj     *xp;
+    cxobj     *xb;
+    yang_stmt *y;
+    cbuf      *cb = NULL;
+    uint32_t   i;
+    uint32_t   j;
+    uint64_t   r;
+    int        empty;
+    int        ret;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    gc->gc_size = 0;
+    gc->gc_seq = 1000000000;  /* Keys of added entries */
+    for (i=0, j=0; i<nr && j<nr*10; j++){
+        len = 0;
+        if (gen_collect(xt, &vec, &len, &alloc) < 0)
+            goto done;
+        if (len == 0)
+            break;
+        x = vec[gen_rand_n(gc, len)];
+        y = xml_spec(x);
+        r = gen_rand_n(gc, 100);
+        if (yang_keyword_get(y) == Y_LEAF){
+            if (r >= 60)
+                continue;
+            cbuf_reset(cb);
+            if ((ret = gen_value(gc, y, 0, cb, &empty)) < 0)
+                goto done;
+            if (ret == 0 || empty)
+                continue;
+            if ((xb = xml_body_get(x)) == NULL &&
+                (xb = xml_new("body", x, CX_BODY)) == NULL)
+                goto done;
+            if (xml_value_set(xb, cbuf_get(cb)) < 0)
+                goto done;
+        }
+        else if (r < 60)
+            continue;
+        else if (r < 80){
+            if (xml_purge(x) < 0)
+                goto done;
+        }
+        else {
+            xp = xml_parent(x);
+            gc->gc_card = 1;
+            if (gen_list(gc, y, xp) < 0)
+                goto done;
+        }
+        i++;
+    }
+    if (i < nr)
+        fprintf(stderr, "Made %u of %u changes\n", i, nr);
+    retval = 0;
+ done:
+    if (vec)
+        free(vec);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    int           retval = -1;
+    char         *argv0 = argv[0];
+    int           c;
+    clixon_handle h;
+    int           logdst = CLIXON_LOG_STDERR;
+    int           dbg = 0;
+    char         *yang_file_dir = NULL;
+    yang_stmt    *yspec = NULL;
+    yang_stmt    *ymod = NULL;
+    yang_stmt    *y;
+    struct stat   st;
+    cxobj        *xcfg = NULL;
+    cxobj        *x0 = NULL;
+    cxobj        *xt = NULL;
+    cxobj        *xerr = NULL;
+    cbuf         *cb = NULL;
+    FILE         *fp = NULL;
+    gen_ctx       gc = {0,};
+    uint64_t      seed = 1;
+    uint32_t      mutations = 0;
+    int           pretty = 0;
+    int           validate = 0;
+    int           ret;
+
+    gc.gc_size = 1000000;
+    gc.gc_card = 10;
+    gc.gc_optional = 50;
+    /* Initialize clixon handle */
+    if ((h = clixon_handle_init()) == NULL)
+        goto done;
+    gc.gc_h = h;
+    clixon_log_init(h, "gen", LOG_DEBUG, logdst);
+    /* Initialize config tree (needed for -Y below) */
+    if ((xcfg = xml_new("clixon-config", NULL, CX_ELMNT)) == NULL)
+        goto done;
+    if (clicon_conf_xml_set(h, xcfg) < 0)
+        goto done;
+    optind = 1;
+    opterr = 0;
+    while ((c = getopt(argc, argv, GEN_OPTS)) != -1)
+        switch (c) {
+        case 'h':
+            usage(argv0);
+            break;
+        case 'D':
+            if (sscanf(optarg, "%d", &dbg) != 1)
+                usage(argv0);
+            break;
+        case 'l': /* Log destination: s|e|o|f */
+            if ((logdst = clixon_log_opt(optarg[0])) < 0)
+                usage(argv[0]);
+            if (logdst == CLIXON_LOG_FILE &&
+                strlen(optarg)>1 &&
+                clixon_log_file(optarg+1) < 0)
+                goto done;
+            break;
+        case 'y':
+            yang_file_dir = optarg;
+            break;
+        case 'Y':
+            if (clicon_option_add(h, "CLICON_YANG_DIR", optarg) < 0)
+                goto done;
+            break;
+        case 's':
+            if (sscanf(optarg, "%" SCNu64, &seed) != 1)
+                usage(argv0);
+            break;
+        case 'S':
+            if (sscanf(optarg, "%zu", &gc.gc_size) != 1)
+                usage(argv0);
+            break;
+        case 'n':
+            if (sscanf(optarg, "%u", &gc.gc_card) != 1 || gc.gc_card == 0)
+                usage(argv0);
+            break;
+        case 'p':
+            if (sscanf(optarg, "%u", &gc.gc_optional) != 1 || gc.gc_optional > 100)
+                usage(argv0);
+            break;
+        case 'f':
+            if ((fp = fopen(optarg, "r")) == NULL){
+                clixon_err(OE_UNIX, errno, "fopen(%s)", optarg);
+                goto done;
+            }
+            break;
+        case 'm':
+            if (sscanf(optarg, "%u", &mutations) != 1)
+                usage(argv0);
+            break;
+        case 'P':
+            pretty = 1;
+            break;
+        case 'V':
+            validate = 1;
+            break;
+        default:
+            usage(argv[0]);
+            break;
+        }
+    clixon_log_init(h, "gen", dbg?LOG_DEBUG:LOG_INFO, logdst);
+    clixon_debug_init(h, dbg);
+    /* Zero seed would make xorshift stuck at zero */
+    gc.gc_rng = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    if (yang_file_dir == NULL){
+        clixon_err(OE_YANG, EINVAL, "-y is required");
+        goto done;
+    }
+    yang_init(h);
+    if ((yspec = yspec_new(h, YANG_DATA_TOP)) == NULL)
+        goto done;
+    if (stat(yang_file_dir, &st) < 0){
+        clixon_err(OE_YANG, errno, "%s not found", yang_file_dir);
+        goto done;
+    }
+    if (S_ISDIR(st.st_mode)){
+        if (yang_spec_load_dir(h, yang_file_dir, yspec) < 0)
+            goto done;
+    }
+    else{
+        if (yang_spec_parse_file(h, yang_file_dir, yspec) < 0)
+            goto done;
+    }
+    if (mutations){
+        if (clixon_xml_parse_file(fp ? fp : stdin, YB_NONE, NULL, &x0, NULL) < 0){
+            fprintf(stderr, "Error: parsing: %s\n", clixon_err_reason());
+            goto done;
+        }
+        /* Accept <config> top symbol or bare data */
+        if ((xt = xml_find_type(x0, NULL, GEN_TOP, CX_ELMNT)) == NULL)
+            xt = x0;
+        if ((ret = xml_bind_yang(h, xt, YB_MODULE, yspec, &xerr)) < 0)
+            goto done;
+        if (ret == 0){
+            fprintf(stderr, "Error: YANG binding of input failed\n");
+            goto done;
+        }
+        if (gen_mutate(&gc, xt, mutations) < 0)
+            goto done;
+    }
+    else {
+        if ((x0 = xml_new(GEN_TOP, NULL, CX_ELMNT)) == NULL)
+            goto done;
+        xt = x0;
+        while ((ymod = yn_each(yspec, ymod)) != NULL){
+            if (yang_keyword_get(ymod) != Y_MODULE)
+                continue;
+            y = NULL;
+            while ((y = yn_each(ymod, y)) != NULL){
+                if (gen_full(&gc))
+                    break;
+                if (gen_node(&gc, y, xt, NULL) < 0)
+                    goto done;
+            }
+        }
+    }
+    if (xml_sort_recurse(xt) < 0)
+        goto done;
+    if (validate){
+        if ((ret = xml_yang_validate_all_top(h, xt, &xerr)) < 0)
+            goto done;
+        if (ret > 0 && (ret = xml_yang_validate_add(h, xt, &xerr)) < 0)
+            goto done;
+        if (ret == 0){
+            if ((cb = cbuf_new()) == NULL){
+                clixon_err(OE_XML, errno, "cbuf_new");
+                goto done;
+            }
+            if (netconf_err2cb(h, xerr, cb) < 0)
+                goto done;
+            fprintf(stderr, "xml validation error: %s\n", cbuf_get(cb));
+            goto done;
+        }
+    }
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_XML, errno, "cbuf_new");
+        goto done;
+    }
+    cbuf_reset(cb);
+    if (clixon_xml2cbuf(cb, xt, 0, pretty, NULL, -1, 0) < 0)
+        goto done;
+    fprintf(stdout, "%s\n", cbuf_get(cb));
+    retval = 0;
+ done:
+    if (cb)
+        cbuf_free(cb);
+    if (xerr)
+        xml_free(xerr);
+    if (x0)
+        xml_free(x0);
+    if (xcfg)
+        xml_free(xcfg);
+    if (fp)
+        fclose(fp);
+    if (h)
+        clixon_handle_exit(h);
+    return retval;
+}
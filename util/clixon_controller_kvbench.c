@@ -0,0 +1,363 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Benchmark of the LMDB device store against one datastore file per device
+  * Writes, reads and parses, and enumerates the SYNCED configs of N devices, first as
+  * device-<name>-SYNCED_db files in a directory, then as keys in one LMDB file.
+  * Requires the controller to be configured --with-lmdb for the store part.
+  * Example:
+  *   for n in 1000 10000 20000; do clixon_controller_kvbench -n $n -d /var/tmp/kvbench; done
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <syslog.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+/* cligen */
+#include <cligen/cligen.h>
+
+/* clixon */
+#include "clixon/clixon.h"
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_kvstore.h"
+
+/* Command line options to be passed to getopt(3) */
+#define KVBENCH_OPTS "hD:n:s:d:m:X"
+
+static int
+usage(char *argv0)
+{
+    fprintf(stderr, "usage:%s [options]\n"
+            "where options are\n"
+            "\t-h \t\tHelp\n"
+            "\t-D <level> \tDebug\n"
+            "\t-n <nr> \tNumber of devices (default 20000)\n"
+            "\t-s <bytes> \tApproximate config size per device (default 10000)\n"
+            "\t-d <dir> \tDirectory of datastore files and store (default /tmp/kvbench)\n"
+            "\t-m <bytes> \tInitial map size of store, grown when full (default 1G)\n"
+            "\t-X \t\tSkip file per device, only run store\n",
+            argv0
+            );
+    exit(0);
+}
+
+/*! Device config children of approximate size
+ */
+static void
+kvbench_config(uint32_t size,
+               cbuf    *cb)
+{
+    uint32_t i;
+
+    cprintf(cb, "<interfaces xmlns=\"urn:example:bench\">");
+    for (i = 0; cbuf_len(cb) < size; i++)
+        cprintf(cb, "<interface><name>eth%u</name><description>Interface number %u</description>"
+                "<mtu>1500</mtu><enabled>true</enabled></interface>", i, i);
+    cprintf(cb, "</interfaces>");
+}
+
+/*! Print elapsed time since t0
+ */
+static void
+kvbench_print(char           *name,
+              struct timeval *t0,
+              uint32_t        n)
+{
+    struct timeval t1;
+    struct timeval td;
+
+    gettimeofday(&t1, NULL);
+    timersub(&t1, t0, &td);
+    fprintf(stdout, "%-24s %ld.%06ld s %u devices\n",
+            name, (long)td.tv_sec, (long)td.tv_usec, n);
+}
+
+/*! Write, read and enumerate one datastore file per device, as xmldb
+ */
+static int
+kvbench_files(char     *dir,
+              uint32_t  n,
+              cbuf     *cbc)
+{
+    int            retval = -1;
+    cbuf          *cb = NULL;
+    struct timeval t0;
+    FILE          *f;
+    cxobj         *xt;
+    DIR           *dp = NULL;
+    struct dirent *de;
+    uint32_t       i;
+    uint32_t       nr = 0;
+
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "%s/device-d%u-SYNCED_db", dir, i);
+        if ((f = fopen(cbuf_get(cb), "w")) == NULL){
+            clixon_err(OE_UNIX, errno, "fopen %s", cbuf_get(cb));
+            goto done;
+        }
+        fprintf(f, "<config><devices xmlns=\"%s\"><device><name>d%u</name><config>%s</config>"
+                "</device></devices></config>", CONTROLLER_NAMESPACE, i, cbuf_get(cbc));
+        fclose(f);
+    }
+    kvbench_print("files write", &t0, n);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "%s/device-d%u-SYNCED_db", dir, i);
+        if ((f = fopen(cbuf_get(cb), "r")) == NULL){
+            clixon_err(OE_UNIX, errno, "fopen %s", cbuf_get(cb));
+            goto done;
+        }
+        xt = NULL;
+        if (clixon_xml_parse_file(f, YB_NONE, NULL, &xt, NULL) < 0){
+            fclose(f);
+            goto done;
+        }
+        fclose(f);
+        xml_free(xt);
+    }
+    kvbench_print("files read+parse", &t0, n);
+    gettimeofday(&t0, NULL);
+    if ((dp = opendir(dir)) == NULL){
+        clixon_err(OE_UNIX, errno, "opendir %s", dir);
+        goto done;
+    }
+    while ((de = readdir(dp)) != NULL)
+        if (strncmp(de->d_name, "device-", strlen("device-")) == 0)
+            nr++;
+    kvbench_print("files enumerate", &t0, nr);
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "%s/device-d%u-SYNCED_db", dir, i);
+        unlink(cbuf_get(cb));
+    }
+    retval = 0;
+ done:
+    if (dp)
+        closedir(dp);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
+/*! Count entries, callback of controller_kvstore_each
+ */
+static int
+kvbench_count(const char *key,
+              size_t      klen,
+              const char *val,
+              size_t      vlen,
+              void       *arg)
+{
+    (*(uint32_t*)arg)++;
+    return 0;
+}
+
+/*! Write, read and enumerate device configs in the store
+ */
+static int
+kvbench_store(char     *dir,
+              uint32_t  n,
+              cbuf     *cbc)
+{
+    int            retval = -1;
+    cbuf          *cb = NULL;
+    cbuf          *cbv = NULL;
+    struct timeval t0;
+    cxobj         *xt;
+    uint32_t       i;
+    uint32_t       nr = 0;
+
+    if ((cb = cbuf_new()) == NULL ||
+        (cbv = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "%s/devices.mdb", dir);
+    unlink(cbuf_get(cb));
+    if (controller_kvstore_open(cbuf_get(cb)) < 0)
+        goto done;
+    /* Batch first into the empty store, a small map is then grown within the transaction */
+    gettimeofday(&t0, NULL);
+    if (controller_kvstore_begin() < 0)
+        goto done;
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "SYNCED/d%u", i);
+        if (controller_kvstore_put(cbuf_get(cb), cbuf_get(cbc), cbuf_len(cbc)) < 0)
+            goto done;
+    }
+    if (controller_kvstore_commit(0) < 0)
+        goto done;
+    kvbench_print("store write batch", &t0, n);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "SYNCED/d%u", i);
+        if (controller_kvstore_put(cbuf_get(cb), cbuf_get(cbc), cbuf_len(cbc)) < 0)
+            goto done;
+    }
+    kvbench_print("store write", &t0, n);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < n; i++){
+        cbuf_reset(cb);
+        cprintf(cb, "SYNCED/d%u", i);
+        cbuf_reset(cbv);
+        cprintf(cbv, "<config><devices xmlns=\"%s\"><device><name>d%u</name><config>",
+                CONTROLLER_NAMESPACE, i);
+        if (controller_kvstore_get(cbuf_get(cb), cbv) != 1)
+            goto done;
+        cprintf(cbv, "</config></device></devices></config>");
+        xt = NULL;
+        if (clixon_xml_parse_string(cbuf_get(cbv), YB_NONE, NULL, &xt, NULL) < 0)
+            goto done;
+        xml_free(xt);
+    }
+    kvbench_print("store read+parse", &t0, n);
+    gettimeofday(&t0, NULL);
+    if (controller_kvstore_each("SYNCED/", kvbench_count, &nr) < 0)
+        goto done;
+    kvbench_print("store enumerate", &t0, nr);
+    fprintf(stdout, "store mapsize %zu\n", controller_kvstore_mapsize());
+    retval = 0;
+ done:
+    controller_kvstore_close();
+    if (cb){
+        cbuf_reset(cb);
+        cprintf(cb, "%s/devices.mdb", dir);
+        unlink(cbuf_get(cb));
+        cprintf(cb, "-lock");
+        unlink(cbuf_get(cb));
+        cbuf_free(cb);
+    }
+    if (cbv)
+        cbuf_free(cbv);
+    return retval;
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    int           retval = -1;
+    char         *argv0 = argv[0];
+    int           c;
+    clixon_handle h;
+    int           dbg = 0;
+    cbuf         *cbc = NULL;
+    uint32_t      n = 20000;
+    uint32_t      size = 10000;
+    char         *dir = "/tmp/kvbench";
+    int           files = 1;
+    size_t        mapsize;
+
+    if ((h = clixon_handle_init()) == NULL)
+        goto done;
+    clixon_log_init(h, "kvbench", LOG_DEBUG, CLIXON_LOG_STDERR);
+    optind = 1;
+    opterr = 0;
+    while ((c = getopt(argc, argv, KVBENCH_OPTS)) != -1)
+        switch (c) {
+        case 'h':
+            usage(argv0);
+            break;
+        case 'D':
+            if (sscanf(optarg, "%d", &dbg) != 1)
+                usage(argv0);
+            break;
+        case 'n':
+            if (sscanf(optarg, "%u", &n) != 1)
+                usage(argv0);
+            break;
+        case 's':
+            if (sscanf(optarg, "%u", &size) != 1)
+                usage(argv0);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        case 'm':
+            if (sscanf(optarg, "%zu", &mapsize) != 1)
+                usage(argv0);
+            controller_kvstore_mapsize_set(mapsize);
+            break;
+        case 'X':
+            files = 0;
+            break;
+        default:
+            usage(argv[0]);
+            break;
+        }
+    clixon_debug_init(h, dbg);
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST){
+        clixon_err(OE_UNIX, errno, "mkdir %s", dir);
+        goto done;
+    }
+    if ((cbc = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    kvbench_config(size, cbc);
+    fprintf(stdout, "devices:%u config:%zu bytes\n", n, cbuf_len(cbc));
+    if (files && kvbench_files(dir, n, cbc) < 0)
+        goto done;
+    if (kvbench_store(dir, n, cbc) < 0)
+        goto done;
+    retval = 0;
+ done:
+    if (cbc)
+        cbuf_free(cbc);
+    if (h)
+        clixon_handle_exit(h);
+    return retval;
+}
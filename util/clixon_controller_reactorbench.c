@@ -0,0 +1,287 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Benchmark of device socket dispatch with a mostly idle fleet of device sessions
+  * N sessions are socket pairs whose controller side is registered with
+  * controller_reactor_reg_fd(). In each round A of them get one byte of input, and the
+  * clixon event loop dispatches them. Prints wall time and CPU time per round.
+  * Build the controller with and without --enable-epoll to compare epoll with the
+  * select() scan of the clixon event loop. Without epoll N is limited by FD_SETSIZE.
+  * Example:
+  *   for n in 100 400 20000; do clixon_controller_reactorbench -n $n -a 10 -r 10000; done
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+
+/* cligen */
+#include <cligen/cligen.h>
+
+/* clixon */
+#include "clixon/clixon.h"
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_reactor.h"
+
+/* Command line options to be passed to getopt(3) */
+#define REACTORBENCH_OPTS "hD:n:a:r:"
+
+/*! Benchmark state, shared by all socket callbacks
+ */
+typedef struct {
+    int      *rb_peer;    /* Device side of each session, vector of n sockets */
+    uint32_t  rb_n;       /* Number of sessions */
+    uint32_t  rb_active;  /* Number of sessions with input per round */
+    uint32_t  rb_rounds;  /* Number of rounds */
+    uint32_t  rb_round;   /* Current round */
+    uint32_t  rb_recv;    /* Input received in current round */
+} reactorbench;
+
+static int
+usage(char *argv0)
+{
+    fprintf(stderr, "usage:%s [options]\n"
+            "where options are\n"
+            "\t-h \t\tHelp\n"
+            "\t-D <level> \tDebug\n"
+            "\t-n <nr> \tNumber of device sessions (default 400)\n"
+            "\t-a <nr> \tNumber of sessions with input per round (default 10)\n"
+            "\t-r <nr> \tNumber of rounds (default 10000)\n",
+            argv0
+            );
+    exit(0);
+}
+
+/*! Send one byte from the device side of the active sessions of a round
+ *
+ * The active sessions are spread over all sessions and shift every round
+ */
+static int
+reactorbench_send(reactorbench *rb)
+{
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < rb->rb_active; i++){
+        j = (i * (rb->rb_n / rb->rb_active) + rb->rb_round) % rb->rb_n;
+        if (write(rb->rb_peer[j], "x", 1) != 1){
+            clixon_err(OE_UNIX, errno, "write");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*! Read input of one session, start next round when all active sessions are read
+ */
+static int
+reactorbench_input(int   s,
+                   void *arg)
+{
+    reactorbench *rb = (reactorbench *)arg;
+    char          c;
+
+    if (read(s, &c, 1) != 1){
+        clixon_err(OE_UNIX, errno, "read");
+        return -1;
+    }
+    if (++rb->rb_recv < rb->rb_active)
+        return 0;
+    rb->rb_recv = 0;
+    if (++rb->rb_round == rb->rb_rounds){
+        clixon_exit_set(1);
+        return 0;
+    }
+    return reactorbench_send(rb);
+}
+
+/*! Print time per round
+ */
+static void
+reactorbench_print(char           *name,
+                   struct timeval *td,
+                   uint32_t        rounds)
+{
+    double us;
+
+    us = ((double)td->tv_sec*1000000 + td->tv_usec) / rounds;
+    fprintf(stdout, "%-8s %ld.%06ld s %.2f us/round\n",
+            name, (long)td->tv_sec, (long)td->tv_usec, us);
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    int             retval = -1;
+    char           *argv0 = argv[0];
+    int             c;
+    clixon_handle   h;
+    int             dbg = 0;
+    reactorbench    rb = {0,};
+    int            *socks = NULL;
+    int             sv[2];
+    uint32_t        i;
+    struct rlimit   rl;
+    struct rusage   ru0;
+    struct rusage   ru1;
+    struct timeval  t0;
+    struct timeval  t1;
+    struct timeval  td;
+    struct timeval  tu;
+    struct timeval  ts;
+
+    rb.rb_n = 400;
+    rb.rb_active = 10;
+    rb.rb_rounds = 10000;
+    if ((h = clixon_handle_init()) == NULL)
+        goto done;
+    clixon_log_init(h, "reactorbench", LOG_DEBUG, CLIXON_LOG_STDERR);
+    optind = 1;
+    opterr = 0;
+    while ((c = getopt(argc, argv, REACTORBENCH_OPTS)) != -1)
+        switch (c) {
+        case 'h':
+            usage(argv0);
+            break;
+        case 'D':
+            if (sscanf(optarg, "%d", &dbg) != 1)
+                usage(argv0);
+            break;
+        case 'n':
+            if (sscanf(optarg, "%u", &rb.rb_n) != 1)
+                usage(argv0);
+            break;
+        case 'a':
+            if (sscanf(optarg, "%u", &rb.rb_active) != 1)
+                usage(argv0);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%u", &rb.rb_rounds) != 1)
+                usage(argv0);
+            break;
+        default:
+            usage(argv[0]);
+            break;
+        }
+    clixon_debug_init(h, dbg);
+    if (rb.rb_active == 0 || rb.rb_active > rb.rb_n || rb.rb_rounds == 0)
+        usage(argv0);
+#ifndef CONTROLLER_EPOLL
+    if (2*rb.rb_n + 16 > FD_SETSIZE){
+        clixon_err(OE_UNIX, EINVAL, "%u sessions exceed FD_SETSIZE without --enable-epoll", rb.rb_n);
+        goto done;
+    }
+#endif
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0){
+        clixon_err(OE_UNIX, errno, "getrlimit");
+        goto done;
+    }
+    if (rl.rlim_cur < 2*rb.rb_n + 16){
+        rl.rlim_cur = 2*rb.rb_n + 16;
+        if (rl.rlim_max < rl.rlim_cur)
+            rl.rlim_max = rl.rlim_cur;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0){
+            clixon_err(OE_UNIX, errno, "setrlimit");
+            goto done;
+        }
+    }
+    if ((socks = calloc(rb.rb_n, sizeof(int))) == NULL ||
+        (rb.rb_peer = calloc(rb.rb_n, sizeof(int))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        goto done;
+    }
+    for (i = 0; i < rb.rb_n; i++){
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0){
+            clixon_err(OE_UNIX, errno, "socketpair");
+            goto done;
+        }
+        socks[i] = sv[0];
+        rb.rb_peer[i] = sv[1];
+        if (controller_reactor_reg_fd(socks[i], reactorbench_input, &rb, "reactorbench") < 0)
+            goto done;
+    }
+#ifdef CONTROLLER_EPOLL
+    fprintf(stdout, "epoll sessions:%u active:%u rounds:%u\n", rb.rb_n, rb.rb_active, rb.rb_rounds);
+#else
+    fprintf(stdout, "select sessions:%u active:%u rounds:%u\n", rb.rb_n, rb.rb_active, rb.rb_rounds);
+#endif
+    if (reactorbench_send(&rb) < 0)
+        goto done;
+    gettimeofday(&t0, NULL);
+    getrusage(RUSAGE_SELF, &ru0);
+    if (clixon_event_loop(h) < 0)
+        goto done;
+    getrusage(RUSAGE_SELF, &ru1);
+    gettimeofday(&t1, NULL);
+    timersub(&t1, &t0, &td);
+    reactorbench_print("wall", &td, rb.rb_rounds);
+    timersub(&ru1.ru_utime, &ru0.ru_utime, &tu);
+    timersub(&ru1.ru_stime, &ru0.ru_stime, &ts);
+    timeradd(&tu, &ts, &td);
+    reactorbench_print("cpu", &td, rb.rb_rounds);
+    retval = 0;
+ done:
+    if (socks){
+        for (i = 0; i < rb.rb_n; i++)
+            if (socks[i] > 0){
+                controller_reactor_unreg_fd(socks[i], reactorbench_input);
+                close(socks[i]);
+            }
+        free(socks);
+    }
+    if (rb.rb_peer){
+        for (i = 0; i < rb.rb_n; i++)
+            if (rb.rb_peer[i] > 0)
+                close(rb.rb_peer[i]);
+        free(rb.rb_peer);
+    }
+    controller_reactor_free();
+    if (h)
+        clixon_handle_exit(h);
+    return retval;
+}
@@ -26,11 +26,16 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fcntl.h>
 #include <syslog.h>
 #include <fnmatch.h>
 #include <errno.h>
 #include <pwd.h>
+#include <sys/time.h>
 
 #include <cligen/cligen.h>
 #include <clixon/clixon.h>
@@ -492,6 +497,84 @@ service_action_instance(clixon_handle h,
     return retval;
 }
 
+/*! Append span of this action as child of controller transaction to CONTROLLER_TRACE_FILE
+ *
+ * The span is one OTLP-JSON line, with the trace-id and parent span-id of the W3C
+ * traceparent in the services-commit notification.
+ * @param[in]  h            Clixon handle
+ * @param[in]  traceparent  W3C traceparent: 00-<trace-id>-<parent-id>-<flags>
+ * @param[in]  tidstr       Transaction id
+ * @param[in]  start        Start time of action
+ * @param[in]  error        Error message, or NULL if OK
+ * @retval     0            OK
+ * @retval    -1            Error
+ */
+static int
+service_action_span(clixon_handle   h,
+                    char           *traceparent,
+                    char           *tidstr,
+                    struct timeval *start,
+                    char           *error)
+{
+    int            retval = -1;
+    char          *file;
+    char           traceid[33];
+    char           parentid[17];
+    uint64_t       spanid = 0;
+    struct timeval end;
+    cbuf          *cb = NULL;
+    FILE          *f = NULL;
+    int            fd;
+
+    if ((file = clicon_option_str(h, "CONTROLLER_TRACE_FILE")) == NULL ||
+        strlen(file) == 0)
+        goto ok;
+    if (sscanf(traceparent, "00-%32[0-9a-f]-%16[0-9a-f]-", traceid, parentid) != 2 ||
+        strlen(traceid) != 32 || strlen(parentid) != 16){
+        clixon_log(h, LOG_WARNING, "%s: malformed traceparent: %s", __func__, traceparent);
+        goto ok;
+    }
+    if ((fd = open("/dev/urandom", O_RDONLY)) >= 0){
+        if (read(fd, &spanid, sizeof(spanid)) != sizeof(spanid))
+            spanid = 0;
+        close(fd);
+    }
+    if (spanid == 0)
+        spanid = ((uint64_t)random() << 32) | random() | 1;
+    gettimeofday(&end, NULL);
+    if ((cb = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    cprintf(cb, "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+            "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"%s\"}}]},"
+            "\"scopeSpans\":[{\"scope\":{\"name\":\"%s\"},\"spans\":[",
+            __PROGRAM__, __PROGRAM__);
+    cprintf(cb, "{\"traceId\":\"%s\",\"spanId\":\"%016" PRIx64 "\",\"parentSpanId\":\"%s\"",
+            traceid, spanid, parentid);
+    cprintf(cb, ",\"name\":\"services-commit\",\"kind\":2");
+    cprintf(cb, ",\"startTimeUnixNano\":\"%" PRIu64 "\"",
+            (uint64_t)start->tv_sec*1000000000 + (uint64_t)start->tv_usec*1000);
+    cprintf(cb, ",\"endTimeUnixNano\":\"%" PRIu64 "\"",
+            (uint64_t)end.tv_sec*1000000000 + (uint64_t)end.tv_usec*1000);
+    cprintf(cb, ",\"attributes\":[{\"key\":\"controller.tid\",\"value\":{\"intValue\":\"%s\"}}]",
+            tidstr);
+    cprintf(cb, ",\"status\":{\"code\":%d}}]}]}]}\n", error ? 2 : 1);
+    if ((f = fopen(file, "a")) == NULL){
+        clixon_log(h, LOG_WARNING, "%s: fopen(%s): %s", __func__, file, strerror(errno));
+        goto ok;
+    }
+    fputs(cbuf_get(cb), f);
+ ok:
+    retval = 0;
+ done:
+    if (f)
+        fclose(f);
+    if (cb)
+        cbuf_free(cb);
+    return retval;
+}
+
 /*! Service commit notification handling, actions on test* services on all devices
  *
  * @param[in]  h            Clixon handle
@@ -521,8 +604,11 @@ service_action_handler(clixon_handle      h,
     char   *tidstr;
     char   *sourcedb = NULL;
     char   *targetdb = NULL;
+    char   *traceparent;
+    struct timeval start;
 
     clixon_debug(CLIXON_DBG_CTRL, "");
+    gettimeofday(&start, NULL);
     if (clixon_xml_parse_string(notification, YB_NONE, NULL, &xt, NULL) < 0)
         goto done;
     if ((xn = xpath_first(xt, 0, "notification/services-commit")) == NULL){
@@ -541,7 +627,13 @@ service_action_handler(clixon_handle      h,
         clixon_err(OE_NETCONF, EFAULT, "Notification malformed: no source");
         goto done;
     }
+    /* Trace context of controller transaction, parent of spans made by action */
+    traceparent = xml_find_body(xn, "traceparent");
+    clixon_debug(CLIXON_DBG_CTRL, "tid:%s traceparent:%s", tidstr, traceparent?traceparent:"");
     if (send_error){
+        if (traceparent &&
+            service_action_span(h, traceparent, tidstr, &start, "simulated error") < 0)
+            goto done;
         if (send_transaction_error(h, tidstr, "simulated error") < 0)
             goto done;
         goto ok;
@@ -567,6 +659,10 @@ service_action_handler(clixon_handle      h,
                 goto done;
         }
     }
+    /* Before done, so the span is written when the transaction ends */
+    if (traceparent &&
+        service_action_span(h, traceparent, tidstr, &start, NULL) < 0)
+        goto done;
     if (send_transaction_actions_done(h, tidstr) < 0)
         goto done;
  ok:
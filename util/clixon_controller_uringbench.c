@@ -0,0 +1,307 @@
+/*
+ *
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2023 Olof Hagsand
+
+  This file is part of CLIXON.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 3 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+  *
+  * Benchmark of io_uring sends and receives against direct writes and event loop reads
+  * N sessions are socket pairs. In each round a message of S bytes is sent on one end of
+  * every session with controller_uring_send(), and received on the other end with
+  * controller_uring_recv_reg(), as the backend sends to and receives from devices.
+  * With -d, io_uring is not set up and messages are written directly and read from the
+  * clixon event loop. Requires the controller to be configured --with-liburing.
+  * Example:
+  *   for n in 100 400; do clixon_controller_uringbench -n $n; clixon_controller_uringbench -n $n -d; done
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "clixon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+
+/* cligen */
+#include <cligen/cligen.h>
+
+/* clixon */
+#include "clixon/clixon.h"
+
+/* Controller includes */
+#include "controller.h"
+#include "controller_uring.h"
+
+/* Command line options to be passed to getopt(3) */
+#define URINGBENCH_OPTS "hD:n:s:r:d"
+
+/*! Benchmark state, shared by all socket callbacks
+ */
+typedef struct {
+    int      *ub_send;    /* Sending side of each session, vector of n sockets */
+    int      *ub_recv;    /* Receiving side of each session, vector of n sockets */
+    uint32_t  ub_n;       /* Number of sessions */
+    cbuf     *ub_msg;     /* Message sent each round */
+    uint32_t  ub_rounds;  /* Number of rounds */
+    uint32_t  ub_round;   /* Current round */
+    size_t    ub_recvd;   /* Bytes received in current round */
+} uringbench;
+
+static int
+usage(char *argv0)
+{
+    fprintf(stderr, "usage:%s [options]\n"
+            "where options are\n"
+            "\t-h \t\tHelp\n"
+            "\t-D <level> \tDebug\n"
+            "\t-n <nr> \tNumber of sessions (default 100)\n"
+            "\t-s <bytes> \tMessage size (default 1000)\n"
+            "\t-r <nr> \tNumber of rounds (default 1000)\n"
+            "\t-d \t\tDirect writes and event loop reads, no io_uring\n",
+            argv0
+            );
+    exit(0);
+}
+
+/*! Send the message on all sessions
+ */
+static int
+uringbench_send(uringbench *ub)
+{
+    uint32_t i;
+
+    for (i = 0; i < ub->ub_n; i++)
+        if (controller_uring_send(ub->ub_send[i], "uringbench", ub->ub_msg, NULL, NULL) < 0)
+            return -1;
+    return 0;
+}
+
+/*! Count received data, start next round when the message is received on all sessions
+ */
+static int
+uringbench_data(int            s,
+                unsigned char *buf,
+                size_t         len,
+                int            eof,
+                void          *arg)
+{
+    uringbench *ub = (uringbench *)arg;
+
+    if (eof){
+        clixon_err(OE_UNIX, 0, "socket %d closed", s);
+        return -1;
+    }
+    ub->ub_recvd += len;
+    if (ub->ub_recvd < ub->ub_n * cbuf_len(ub->ub_msg))
+        return 0;
+    ub->ub_recvd = 0;
+    if (++ub->ub_round == ub->ub_rounds){
+        clixon_exit_set(1);
+        return 0;
+    }
+    return uringbench_send(ub);
+}
+
+/*! Read a session from the event loop
+ */
+static int
+uringbench_input(int   s,
+                 void *arg)
+{
+    unsigned char buf[BUFSIZ];
+    ssize_t       len;
+
+    if ((len = read(s, buf, sizeof(buf))) < 0){
+        clixon_err(OE_UNIX, errno, "read");
+        return -1;
+    }
+    return uringbench_data(s, buf, len, len == 0, arg);
+}
+
+/*! Print time per round
+ */
+static void
+uringbench_print(char           *name,
+                 struct timeval *td,
+                 uint32_t        rounds)
+{
+    double us;
+
+    us = ((double)td->tv_sec*1000000 + td->tv_usec) / rounds;
+    fprintf(stdout, "%-8s %ld.%06ld s %.2f us/round\n",
+            name, (long)td->tv_sec, (long)td->tv_usec, us);
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    int             retval = -1;
+    char           *argv0 = argv[0];
+    int             c;
+    clixon_handle   h;
+    int             dbg = 0;
+    uringbench      ub = {0,};
+    uint32_t        size = 1000;
+    int             direct = 0;
+    int             sv[2];
+    uint32_t        i;
+    struct rusage   ru0;
+    struct rusage   ru1;
+    struct timeval  t0;
+    struct timeval  t1;
+    struct timeval  td;
+    struct timeval  tu;
+    struct timeval  ts;
+
+    ub.ub_n = 100;
+    ub.ub_rounds = 1000;
+    if ((h = clixon_handle_init()) == NULL)
+        goto done;
+    clixon_log_init(h, "uringbench", LOG_DEBUG, CLIXON_LOG_STDERR);
+    optind = 1;
+    opterr = 0;
+    while ((c = getopt(argc, argv, URINGBENCH_OPTS)) != -1)
+        switch (c) {
+        case 'h':
+            usage(argv0);
+            break;
+        case 'D':
+            if (sscanf(optarg, "%d", &dbg) != 1)
+                usage(argv0);
+            break;
+        case 'n':
+            if (sscanf(optarg, "%u", &ub.ub_n) != 1)
+                usage(argv0);
+            break;
+        case 's':
+            if (sscanf(optarg, "%u", &size) != 1)
+                usage(argv0);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%u", &ub.ub_rounds) != 1)
+                usage(argv0);
+            break;
+        case 'd':
+            direct = 1;
+            break;
+        default:
+            usage(argv[0]);
+            break;
+        }
+    clixon_debug_init(h, dbg);
+    if (ub.ub_n == 0 || size == 0 || ub.ub_rounds == 0)
+        usage(argv0);
+    if (direct && 2*ub.ub_n + 16 > FD_SETSIZE){
+        clixon_err(OE_UNIX, EINVAL, "%u sessions exceed FD_SETSIZE with -d", ub.ub_n);
+        goto done;
+    }
+    if (!direct){
+        if (controller_uring_init(h) < 0)
+            goto done;
+        if (!controller_uring_recv_active()){
+            clixon_err(OE_UNIX, ENOTSUP, "io_uring receive not available, configure --with-liburing");
+            goto done;
+        }
+    }
+    if ((ub.ub_msg = cbuf_new()) == NULL){
+        clixon_err(OE_UNIX, errno, "cbuf_new");
+        goto done;
+    }
+    while (cbuf_len(ub.ub_msg) < size)
+        cprintf(ub.ub_msg, "x");
+    if ((ub.ub_send = calloc(ub.ub_n, sizeof(int))) == NULL ||
+        (ub.ub_recv = calloc(ub.ub_n, sizeof(int))) == NULL){
+        clixon_err(OE_UNIX, errno, "calloc");
+        goto done;
+    }
+    for (i = 0; i < ub.ub_n; i++){
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0){
+            clixon_err(OE_UNIX, errno, "socketpair");
+            goto done;
+        }
+        ub.ub_send[i] = sv[0];
+        ub.ub_recv[i] = sv[1];
+        if (direct){
+            if (clixon_event_reg_fd(sv[1], uringbench_input, &ub, "uringbench") < 0)
+                goto done;
+        }
+        else if (controller_uring_recv_reg(sv[1], uringbench_data, &ub) < 0)
+            goto done;
+    }
+    fprintf(stdout, "%s sessions:%u size:%u rounds:%u\n",
+            direct?"direct":"io_uring", ub.ub_n, size, ub.ub_rounds);
+    if (uringbench_send(&ub) < 0)
+        goto done;
+    gettimeofday(&t0, NULL);
+    getrusage(RUSAGE_SELF, &ru0);
+    if (clixon_event_loop(h) < 0)
+        goto done;
+    getrusage(RUSAGE_SELF, &ru1);
+    gettimeofday(&t1, NULL);
+    timersub(&t1, &t0, &td);
+    uringbench_print("wall", &td, ub.ub_rounds);
+    timersub(&ru1.ru_utime, &ru0.ru_utime, &tu);
+    timersub(&ru1.ru_stime, &ru0.ru_stime, &ts);
+    timeradd(&tu, &ts, &td);
+    uringbench_print("cpu", &td, ub.ub_rounds);
+    retval = 0;
+ done:
+    for (i = 0; ub.ub_send && i < ub.ub_n; i++){
+        if (ub.ub_send[i] > 0){
+            controller_uring_close(ub.ub_send[i]);
+            close(ub.ub_send[i]);
+        }
+        if (ub.ub_recv[i] > 0){
+            if (direct)
+                clixon_event_unreg_fd(ub.ub_recv[i], uringbench_input);
+            controller_uring_close(ub.ub_recv[i]);
+            close(ub.ub_recv[i]);
+        }
+    }
+    if (ub.ub_send)
+        free(ub.ub_send);
+    if (ub.ub_recv)
+        free(ub.ub_recv);
+    if (ub.ub_msg)
+        cbuf_free(ub.ub_msg);
+    controller_uring_exit();
+    if (h)
+        clixon_handle_exit(h);
+    return retval;
+}